@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "slac_frames.h"
+
+// Attenuation statistics of one sounding: the SLAC_ATTEN_GROUPS bytes of
+// every CM_ATTEN_PROFILE.IND are summed four groups per 32 bit word, split
+// into the even and odd bytes so each group has a 16 bit lane (SWAR). The
+// squares and the running min/max are kept per group in the same pass.
+// atten_finish() derives mean, variance and the min/max-trimmed mean of all
+// groups in one pass.
+#define ATTEN_WORDS         ((SLAC_ATTEN_GROUPS + 3) / 4)
+#define ATTEN_MAX_SAMPLES   255     // 255 * 255 still fits a 16 bit lane
+
+struct AttenAccum {
+    uint32_t sum[2][ATTEN_WORDS];   // [0]: groups 4w and 4w+2, [1]: 4w+1 and 4w+3
+    uint32_t sq[SLAC_ATTEN_GROUPS];
+    uint8_t min[SLAC_ATTEN_GROUPS];
+    uint8_t max[SLAC_ATTEN_GROUPS];
+    uint8_t samples;
+};
+
+struct AttenStats {
+    uint8_t mean[SLAC_ATTEN_GROUPS];        // what ATTEN_CHAR.IND reports
+    uint8_t trimmed[SLAC_ATTEN_GROUPS];     // mean without each group's min and max (>= 3 samples)
+    uint16_t var[SLAC_ATTEN_GROUPS];        // population variance, dB^2
+    uint16_t max_var;
+    uint8_t samples;
+};
+
+void atten_reset(AttenAccum *a);
+// groups points at SLAC_ATTEN_GROUPS bytes. Returns false once ATTEN_MAX_SAMPLES are in.
+bool atten_add(AttenAccum *a, const uint8_t *groups);
+void atten_finish(const AttenAccum *a, AttenStats *out);
+uint16_t atten_group_sum(const AttenAccum *a, uint8_t group);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "evse_config.h"
+
+// Bounded FIFO of frame handles (pbufs) between the SPI task and the lwIP
+// tcpip thread. A full queue refuses the item and counts it, so the producer
+// decides what to drop. Not locked; callers serialise access.
+
+#define BRIDGE_QUEUE_MAX 32
+
+#if LWIP_BRIDGE_RX_QUEUE < 1 || LWIP_BRIDGE_RX_QUEUE > BRIDGE_QUEUE_MAX || \
+    LWIP_BRIDGE_TX_QUEUE < 1 || LWIP_BRIDGE_TX_QUEUE > BRIDGE_QUEUE_MAX
+#error "LWIP_BRIDGE_RX_QUEUE and LWIP_BRIDGE_TX_QUEUE must be 1..BRIDGE_QUEUE_MAX"
+#endif
+
+struct BridgeQueueStats {
+    uint32_t pushed;
+    uint32_t popped;
+    uint32_t overflow;      // push found the queue full
+    uint8_t high_water;
+};
+
+struct BridgeQueue {
+    void *items[BRIDGE_QUEUE_MAX];
+    uint8_t capacity;
+    uint8_t head;
+    uint8_t count;
+    BridgeQueueStats stats;
+};
+
+void bridge_queue_init(BridgeQueue *q, uint8_t capacity);
+bool bridge_queue_push(BridgeQueue *q, void *item);
+// Oldest item, or nullptr when empty.
+void *bridge_queue_peek(const BridgeQueue *q);
+void *bridge_queue_pop(BridgeQueue *q);
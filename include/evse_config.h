@@ -76,6 +76,117 @@
 #define CONTACTOR_AUX_ACTIVE_HIGH 1
 #endif
 
+// === QCA7005 SPI link ===
+#ifndef QCA_RX_IRQ_ENABLE
+#define QCA_RX_IRQ_ENABLE 1        // 1: PIN_QCA700X_INT wakes the SPI task, 0: poll from the protocol task
+#endif
+#ifndef QCA_SPI_TASK_PRIORITY
+#define QCA_SPI_TASK_PRIORITY 3
+#endif
+#ifndef QCA_SPI_TASK_STACK
+#define QCA_SPI_TASK_STACK 6144
+#endif
+#ifndef QCA_SPI_TASK_CORE
+#define QCA_SPI_TASK_CORE 1
+#endif
+#ifndef QCA_SPI_TASK_BUDGET_US
+#define QCA_SPI_TASK_BUDGET_US 5000 // one wake-up longer than this counts as an overrun
+#endif
+#ifndef QCA_RX_FALLBACK_POLL_MS
+#define QCA_RX_FALLBACK_POLL_MS 100 // safety net for a missed IRQ edge
+#endif
+#ifndef QCA_SPI_DMA_ENABLE
+#define QCA_SPI_DMA_ENABLE 1        // spi_master + DMA; 0 = Arduino SPIClass with manual CS
+#endif
+#ifndef QCA_SPI_HOST
+#define QCA_SPI_HOST SPI2_HOST
+#endif
+#ifndef QCA_SPI_CLOCK_HZ
+#define QCA_SPI_CLOCK_HZ 10000000   // QCA7005 is specified up to 12 MHz
+#endif
+#ifndef QCA_RDBUF_WATERMARK
+#define QCA_RDBUF_WATERMARK 0       // bytes; 0 keeps the modem default
+#endif
+#ifndef QCA_WRBUF_WATERMARK
+#define QCA_WRBUF_WATERMARK 1536    // bytes; WRBUF_BELOW_WM fires when the write buffer fill drops below this
+#endif
+#ifndef QCA_INTR_ENABLE_MASK
+#define QCA_INTR_ENABLE_MASK (SPI_INT_PKT_AVLBL | SPI_INT_RDBUF_ERR | SPI_INT_WRBUF_ERR | SPI_INT_CPU_ON)
+#endif
+#ifndef QCA_BUF_ERR_RESET_THRESHOLD
+#define QCA_BUF_ERR_RESET_THRESHOLD 3 // consecutive buffer-error wake-ups before a full modem reset
+#endif
+#ifndef QCA_TX_QUEUE_DEPTH
+#define QCA_TX_QUEUE_DEPTH 6        // frames waiting for modem write space
+#endif
+#ifndef QCA_TX_SLOT_SIZE
+#define QCA_TX_SLOT_SIZE 1536       // one Ethernet frame (1514) plus slack
+#endif
+#ifndef QCA_RX_POOL_BUFFERS
+#define QCA_RX_POOL_BUFFERS 4       // RDBUF burst buffers lwIP may still hold frames of
+#endif
+#ifndef QCA_RX_POOL_PBUFS
+#define QCA_RX_POOL_PBUFS 16        // IPv6 frames lent to lwIP at once; beyond that they are copied
+#endif
+
+// === IPv6 / lwIP bridge ===
+#ifndef IPV6_STACK_LWIP
+#define IPV6_STACK_LWIP 1           // 1: IPv6 frames go to lwIP (SDP/HLC socket servers), 0: built-in raw IPv6/TCP stack
+#endif
+#ifndef LWIP_BRIDGE_RX_QUEUE
+#define LWIP_BRIDGE_RX_QUEUE 16     // IPv6 frames waiting for the tcpip thread
+#endif
+#ifndef LWIP_BRIDGE_TX_QUEUE
+#define LWIP_BRIDGE_TX_QUEUE 8      // lwIP frames waiting for a QCA TX slot
+#endif
+
+// === Task layout (period, priority, core, stack bytes) ===
+#ifndef CP_TASK_PERIOD_MS
+#define CP_TASK_PERIOD_MS 20
+#endif
+#ifndef CP_TASK_PRIORITY
+#define CP_TASK_PRIORITY 2
+#endif
+#ifndef CP_TASK_CORE
+#define CP_TASK_CORE 0
+#endif
+#ifndef CP_TASK_STACK
+#define CP_TASK_STACK 3072
+#endif
+#ifndef CAN_TASK_PERIOD_MS
+#define CAN_TASK_PERIOD_MS 20
+#endif
+#ifndef CAN_TASK_PRIORITY
+#define CAN_TASK_PRIORITY 2
+#endif
+#ifndef CAN_TASK_CORE
+#define CAN_TASK_CORE 0
+#endif
+#ifndef CAN_TASK_STACK
+#define CAN_TASK_STACK 3072
+#endif
+#ifndef PROTO_TASK_PERIOD_MS
+#define PROTO_TASK_PERIOD_MS 20     // SLAC/HLC timers, modem bring-up
+#endif
+#ifndef PROTO_TASK_PRIORITY
+#define PROTO_TASK_PRIORITY 3
+#endif
+#ifndef PROTO_TASK_CORE
+#define PROTO_TASK_CORE 1
+#endif
+#ifndef PROTO_TASK_STACK
+#define PROTO_TASK_STACK 6144
+#endif
+#ifndef HLC_SERVER_TASK_PRIORITY
+#define HLC_SERVER_TASK_PRIORITY 5  // plain + TLS HLC sockets, one select() loop
+#endif
+#ifndef HLC_SERVER_TASK_CORE
+#define HLC_SERVER_TASK_CORE 1
+#endif
+#ifndef HLC_SERVER_TASK_STACK
+#define HLC_SERVER_TASK_STACK 8192  // the TLS handshake runs on it
+#endif
+
 #ifndef TCP_PLAIN_PORT
 #define TCP_PLAIN_PORT 15118
 #endif
@@ -84,6 +195,26 @@
 #define TCP_TLS_PORT 15119
 #endif
 
+#ifndef HLC_SEND_TIMEOUT_MS
+#define HLC_SEND_TIMEOUT_MS 1000    // socket send buffer stays full this long: drop the response
+#endif
+
+#ifndef TLS_SESSION_CACHE_ENTRIES
+#define TLS_SESSION_CACHE_ENTRIES 8     // resumable sessions by ID, least recently used goes first
+#endif
+#ifndef TLS_SESSION_BLOB_MAX
+#define TLS_SESSION_BLOB_MAX 2048       // serialised session, EV certificate included
+#endif
+#ifndef TLS_SESSION_TIMEOUT_S
+#define TLS_SESSION_TIMEOUT_S 3600      // a cached session ID resumes for this long
+#endif
+#ifndef TLS_TICKET_ROTATE_S
+#define TLS_TICKET_ROTATE_S 3600        // ticket key lifetime; the previous key is still accepted
+#endif
+#ifndef TLS_ALLOW_STATIC_ECDH
+#define TLS_ALLOW_STATIC_ECDH 1         // TLS_ECDH_ECDSA_WITH_AES_128_CBC_SHA256, mandatory in ISO 15118-2
+#endif
+
 #ifndef EVSE_ID
 #define EVSE_ID "DE*JOULEPOINT*EVSE*0001"
 #endif
@@ -97,6 +228,8 @@
 #define EVSE_ID "ZZ00000"
 #undef EVSE_MAX_VOLTAGE
 #define EVSE_MAX_VOLTAGE 450
+#undef IPV6_STACK_LWIP
+#define IPV6_STACK_LWIP 0           // no lwIP on the host: the tests drive the raw stack
 #endif
 
 // === CAN / Maxwell module configuration ===
@@ -158,6 +291,79 @@
 #define ISO20_TLS_STRATEGY 0  // 0: accept offer, 1: enforce TLS, 2: enforce no TLS
 #endif
 
+#ifndef PERF_PROBES_ENABLE
+#define PERF_PROBES_ENABLE 0        // hot-path latency histograms (diag op "perf")
+#endif
+// === SLAC ===
+#ifndef SLAC_ATTEN_REPORT_TRIMMED
+#define SLAC_ATTEN_REPORT_TRIMMED 0 // 1: ATTEN_CHAR.IND reports each group's mean without its min/max sample
+#endif
+#ifndef NMK_POOL_SIZE
+#define NMK_POOL_SIZE 4             // pre-drawn NMK/NID pairs for key rotation
+#endif
+// === HLC / EXI ===
+#ifndef EXI_PATCH_ENABLE
+#define EXI_PATCH_ENABLE 1          // CurrentDemandRes patched into the last encoded frame
+#endif
+#ifndef EXI_PATCH_CACHE_BYTES
+#define EXI_PATCH_CACHE_BYTES 192   // largest EXI body the patch cache holds
+#endif
+#ifndef V2GTP_RX_RING_BYTES
+#define V2GTP_RX_RING_BYTES 2048    // HLC receive ring, power of two
+#endif
+#ifndef V2GTP_MAX_FRAME_BYTES
+#define V2GTP_MAX_FRAME_BYTES 1536  // largest V2GTP frame reassembled, header included; bigger ones are skipped
+#endif
+#ifndef EXI_TX_BUFFER_BYTES
+#define EXI_TX_BUFFER_BYTES 4096    // largest encoded response body; the V2GTP header goes in front of it
+#endif
+#ifndef EXI_RAM_BUDGET_BYTES
+#define EXI_RAM_BUDGET_BYTES 65536  // static RAM of the EXI documents and TX buffer; checked at compile time
+#endif
+#ifndef TCP_TX_MSS
+#define TCP_TX_MSS 1440             // raw-TCP segment cap, advertised in the SYN-ACK; one QCA frame
+#endif
+#ifndef TCP_DEFAULT_PEER_MSS
+#define TCP_DEFAULT_PEER_MSS 1220   // used when the EV's SYN carries no MSS option (IPv6 minimum)
+#endif
+#ifndef TCP_TX_WINDOW_SEGMENTS
+#define TCP_TX_WINDOW_SEGMENTS 4    // raw-TCP segments in flight; keep below QCA_TX_QUEUE_DEPTH
+#endif
+#ifndef TCP_RTO_INITIAL_MS
+#define TCP_RTO_INITIAL_MS 1000     // retransmit timeout before the first RTT sample
+#endif
+#ifndef TCP_RTO_MIN_MS
+#define TCP_RTO_MIN_MS 200          // PLC round trips are tens of ms; RFC 6298's 1 s floor is far too slow here
+#endif
+#ifndef TCP_RTO_MAX_MS
+#define TCP_RTO_MAX_MS 4000
+#endif
+#ifndef TCP_MAX_RETRANSMIT
+#define TCP_MAX_RETRANSMIT 3        // timeouts in a row without progress before the connection is dropped
+#endif
+// === Deferred PLC/HLC log ===
+#ifndef PLC_LOG_LEVEL
+#define PLC_LOG_LEVEL 3             // 1 error .. 5 verbose; higher levels are compiled out
+#endif
+#ifndef PLC_LOG_ASYNC
+#define PLC_LOG_ASYNC 1             // 0: format in the caller like Serial.printf
+#endif
+#ifndef PLC_LOG_RING_SIZE
+#define PLC_LOG_RING_SIZE 128       // records, power of two
+#endif
+#ifndef PLC_LOG_LINE_MAX
+#define PLC_LOG_LINE_MAX 160
+#endif
+#ifndef PLC_LOG_FLUSH_MS
+#define PLC_LOG_FLUSH_MS 20
+#endif
+#ifndef PLC_LOG_TASK_PRIORITY
+#define PLC_LOG_TASK_PRIORITY 1
+#endif
+#ifndef PLC_LOG_TASK_CORE
+#define PLC_LOG_TASK_CORE 0
+#endif
+
 #ifndef DIAG_AUTH_TOKEN
 #define DIAG_AUTH_TOKEN "changeme"
 #endif
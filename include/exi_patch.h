@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "evse_config.h"
+
+// Re-use of an encoded EXI response whose layout repeats and where only a few
+// values change (CurrentDemandRes). The first response of a layout comes from
+// the real encoder. The cache then learns the bit position of every variable
+// field: it encodes once per field with that field's lowest bit flipped, and
+// verifies the positions by patching two more value sets and comparing them
+// with the encoder's output. The second set flips the top bit of enumerations,
+// so one declared wider than it is encoded does not verify; one declared
+// narrower only ever gets values that fit. Later responses with the same
+// layout, where every field keeps its encoded width, are made by rewriting
+// only those bits. Anything else goes back to the encoder.
+//
+// The same positions serve the receive side: a request the encoder reproduces
+// bit for bit becomes the template, and later requests that equal it outside
+// the fields are read without running the decoder.
+
+enum ExiFieldKind : uint8_t {
+    EXI_FIELD_BOOL = 0,     // 1 bit
+    EXI_FIELD_NBIT,         // n-bit unsigned, enumerations
+    EXI_FIELD_INT,          // sign bit, then 7 bit groups least significant first
+};
+
+struct ExiFieldSpec {
+    uint8_t kind;
+    uint8_t nbits;          // EXI_FIELD_NBIT only
+};
+
+#define EXI_PATCH_MAX_FIELDS 8
+#define EXI_PATCH_MAX_LAYOUT 16
+#define EXI_PATCH_MIN_HITS   8      // matches a template needs before it is replaced
+
+// Encodes the document for values into out, returns the length or -1.
+typedef int (*ExiEncodeFn)(const int32_t *values, uint8_t *out, uint16_t cap);
+
+struct ExiPatchCache {
+    uint8_t bytes[EXI_PATCH_CACHE_BYTES];
+    uint8_t probe[EXI_PATCH_CACHE_BYTES];
+    uint8_t check[EXI_PATCH_CACHE_BYTES];
+    uint16_t len;
+    bool valid;
+    uint8_t nfields;
+    uint8_t layout_len;
+    uint8_t layout[EXI_PATCH_MAX_LAYOUT];
+    uint16_t bit[EXI_PATCH_MAX_FIELDS];
+    int32_t value[EXI_PATCH_MAX_FIELDS];
+    uint32_t patched;       // frames patched or matched through the field positions
+    uint32_t encoded;       // frames that went through the encoder or decoder
+    uint32_t learned;       // layouts whose field positions verified
+    uint32_t rejected;      // layouts that did not verify (codec only)
+    uint32_t hits;          // matches since the template was learned
+    bool frozen;            // receive side: stop learning this layout
+};
+
+void exi_patch_reset(ExiPatchCache *c);
+// layout: everything besides the fields that shapes the encoding (protocol,
+// session id, optional elements). Returns the length of c->bytes or -1.
+int exi_patch_encode(ExiPatchCache *c, const uint8_t *layout, uint8_t layout_len,
+                     const ExiFieldSpec *spec, const int32_t *values, uint8_t n,
+                     ExiEncodeFn encode);
+
+// Receive side. frame was decoded into values by the full decoder; it becomes
+// the template if encode(values) reproduces it and the positions verify. A
+// layout whose template missed before EXI_PATCH_MIN_HITS matches is not
+// learned again. Returns true if the template is now valid.
+bool exi_patch_learn(ExiPatchCache *c, const uint8_t *layout, uint8_t layout_len,
+                     const uint8_t *frame, uint16_t len,
+                     const ExiFieldSpec *spec, const int32_t *values, uint8_t n,
+                     ExiEncodeFn encode);
+// Reads the fields of frame if it equals the template everywhere else, else
+// returns false and the caller decodes it.
+bool exi_patch_match(ExiPatchCache *c, const uint8_t *layout, uint8_t layout_len,
+                     const uint8_t *frame, uint16_t len,
+                     const ExiFieldSpec *spec, int32_t *values);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tls_session_cache.h"
+
+// HLC transport over lwIP: one task serves the plain (TCP_PLAIN_PORT) and
+// TLS (TCP_TLS_PORT) listeners and the EV connection with select(), and feeds
+// the received bytes to tcp_process_socket_payload(). A new connection on
+// either port replaces the current one.
+//
+// A TLS session is resumed by session ID (TlsSessionCache) or by an RFC 5077
+// ticket. The ticket key rotates every TLS_TICKET_ROTATE_S. Handshake
+// latency is counted from accept() to the end of the handshake, so it
+// includes the EV's round trips.
+
+struct HlcTlsStats {
+    uint32_t full;              // handshakes with certificate and key exchange
+    uint32_t resumed;           // abbreviated, by session ID or ticket
+    uint32_t by_ticket;
+    uint32_t failed;
+    uint32_t tickets_rejected;  // unknown or retired key, expired, damaged
+    uint32_t full_last_ms;
+    uint32_t full_avg_ms;
+    uint32_t full_max_ms;
+    uint32_t resumed_last_ms;
+    uint32_t resumed_avg_ms;
+    uint32_t resumed_max_ms;
+    TlsSessionCacheStats cache;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef ESP_PLATFORM
+void hlc_server_start(void);
+// The TLS listener is up, so SDP may offer the TLS endpoint.
+bool hlc_server_tls_ready(void);
+void hlc_server_tls_stats(HlcTlsStats *out);
+#else
+static inline void hlc_server_start(void) {}
+static inline bool hlc_server_tls_ready(void) { return false; }
+static inline void hlc_server_tls_stats(HlcTlsStats *out) { memset(out, 0, sizeof(*out)); }
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -42,6 +42,7 @@
 
 #define MODEM_POWERUP 0
 #define MODEM_WRITESPACE 1
+#define MODEM_SPI_CONFIG 4
 #define MODEM_CM_SET_KEY_REQ 2
 #define MODEM_CM_SET_KEY_CNF 3
 #define MODEM_CONFIGURED 10
@@ -103,10 +104,18 @@
 
 extern uint8_t txbuffer[], rxbuffer[];
 extern uint8_t myMac[];
-extern uint8_t pevMac[];
-extern uint8_t NMK[];
-extern uint8_t NID[];
 extern uint8_t EVCCID[];
 extern uint8_t EVSOC;
-void qcaspi_write_burst(uint8_t *src, uint32_t len);
+void qcaspi_write_burst(const uint8_t *src, uint32_t len);
+uint8_t *qcaspi_tx_reserve(uint16_t len);
+void qcaspi_tx_commit(uint16_t len);
+void qcaspi_tx_cancel(void);
+struct QcaTxStats;
+struct QcaIrqStats;
+void qcaspi_tx_stats(QcaTxStats *out);
+void qcaspi_irq_stats(QcaIrqStats *out);
+void SlacManager(const uint8_t *frame, uint16_t len);
+class SlacSession;
+// The SLAC session whose link carries the HLC (TCP/IPv6) stack.
+SlacSession &slac_primary(void);
 void setMacAt(uint8_t *mac, uint16_t offset);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "evse_config.h"
+
+// Pre-drawn NMK/NID pairs for SLAC key rotation. nmk_pool_refill() tops the
+// pool up from the hardware RNG outside the SLAC path, so a rotation after
+// plug-out only copies 23 bytes. nmk_pool_take() draws a pair inline if the
+// pool ran dry. Callers serialize access (the firmware holds qca_lock).
+
+struct NmkPoolStats {
+    uint8_t level;
+    uint32_t taken;
+    uint32_t drawn;         // pairs generated by refills
+    uint32_t empty;         // takes that had to draw inline
+};
+
+typedef void (*NmkRandomFill)(void *buf, uint32_t len);
+
+void nmk_pool_reset(void);
+void nmk_pool_refill(void);
+void nmk_pool_take(uint8_t nmk[16], uint8_t nid[7]);
+void nmk_pool_stats(NmkPoolStats *out);
+// Host tests only; nullptr restores the default source.
+void nmk_pool_set_source(NmkRandomFill fill);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "evse_config.h"
+
+// Named hot-path probes: cycle-counter timestamps folded into fixed log2
+// histograms. With PERF_PROBES_ENABLE=0 the macros expand to nothing, so the
+// probes can stay in the code.
+
+enum PerfProbeId : uint8_t {
+    PERF_CP_TICK = 0,
+    PERF_DC_CAN_TICK,
+    PERF_QCA_RX_DRAIN,
+    PERF_QCA_TX_FLUSH,
+    PERF_TCP_TICK,
+    PERF_CP_PERIOD,          // start-to-start interval of the periodic tasks
+    PERF_CAN_PERIOD,
+    PERF_PROTO_PERIOD,
+    PERF_PROBE_COUNT
+};
+
+#define PERF_PROBE_BUCKETS 32     // bucket b holds samples in [2^(b-1), 2^b) cycles
+
+struct PerfProbeStats {
+    const char *name;
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t avg_us;
+    uint32_t p50_us;         // upper edge of the bucket holding the percentile
+    uint32_t p99_us;
+};
+
+uint32_t perf_probe_now(void);
+uint32_t perf_probe_cycles_per_us(void);
+void perf_probe_record(uint8_t id, uint32_t cycles);
+// Records the interval since the previous mark of the same probe.
+void perf_probe_mark(uint8_t id);
+void perf_probe_reset(void);
+bool perf_probe_get(uint8_t id, PerfProbeStats *out);
+// Raw histogram counts, PERF_PROBE_BUCKETS entries.
+bool perf_probe_histogram(uint8_t id, uint32_t *buckets);
+int perf_probe_find(const char *name);
+
+#if PERF_PROBES_ENABLE
+#define PERF_PROBE_BEGIN(id) uint32_t perf_t0_##id = perf_probe_now()
+#define PERF_PROBE_END(id) perf_probe_record(id, perf_probe_now() - perf_t0_##id)
+#define PERF_PROBE_MARK(id) perf_probe_mark(id)
+#else
+#define PERF_PROBE_BEGIN(id) do {} while (0)
+#define PERF_PROBE_END(id) do {} while (0)
+#define PERF_PROBE_MARK(id) do {} while (0)
+#endif
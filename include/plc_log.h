@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+#include "evse_config.h"
+
+// Deferred logger for the PLC/HLC hot paths. A call site stores its format
+// string pointer and up to PLC_LOG_MAX_ARGS integer/pointer arguments in a
+// lock-free ring; the PlcLog task formats and prints them later.
+//
+// Arguments are captured by value, so %s only works with strings that outlive
+// the call (literals, static tables). Floating point is rejected at compile time.
+
+#define PLC_LOG_LEVEL_NONE    0
+#define PLC_LOG_LEVEL_ERROR   1
+#define PLC_LOG_LEVEL_WARN    2
+#define PLC_LOG_LEVEL_INFO    3
+#define PLC_LOG_LEVEL_DEBUG   4
+#define PLC_LOG_LEVEL_VERBOSE 5
+
+#define PLC_LOG_MAX_ARGS 6
+
+struct PlcLogStats {
+    uint32_t written;
+    uint32_t dropped;        // ring was full
+    uint32_t flushed;
+    uint16_t high_water;
+};
+
+typedef void (*PlcLogSink)(const char *line, size_t len);
+
+void plc_log_push(uint8_t level, const char *fmt, const uintptr_t *args, uint8_t nargs);
+// Formats and writes out everything queued so far; returns the record count.
+uint32_t plc_log_flush(void);
+// Sync mode formats in the caller (the old Serial.printf behaviour).
+void plc_log_set_sync(bool sync);
+void plc_log_set_sink(PlcLogSink sink);
+void plc_log_stats(PlcLogStats *out);
+void plc_log_reset(void);
+// Starts the low-priority PlcLog flush task (target only).
+void plc_log_start(void);
+
+template <typename T>
+inline uintptr_t plc_log_arg(T value) {
+    static_assert(!std::is_floating_point<T>::value, "plc_log: floating point arguments are not supported");
+    static_assert(std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+                  "plc_log: unsupported argument type");
+    return (uintptr_t)value;
+}
+
+template <typename... Args>
+inline void plc_log(uint8_t level, const char *fmt, Args... args) {
+    static_assert(sizeof...(Args) <= PLC_LOG_MAX_ARGS, "plc_log: too many arguments");
+    const uintptr_t packed[] = {plc_log_arg(args)..., 0};
+    plc_log_push(level, fmt, packed, (uint8_t)sizeof...(Args));
+}
+
+#if PLC_LOG_LEVEL >= PLC_LOG_LEVEL_ERROR
+#define PLC_LOGE(...) plc_log(PLC_LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define PLC_LOGE(...) do {} while (0)
+#endif
+#if PLC_LOG_LEVEL >= PLC_LOG_LEVEL_WARN
+#define PLC_LOGW(...) plc_log(PLC_LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define PLC_LOGW(...) do {} while (0)
+#endif
+#if PLC_LOG_LEVEL >= PLC_LOG_LEVEL_INFO
+#define PLC_LOGI(...) plc_log(PLC_LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define PLC_LOGI(...) do {} while (0)
+#endif
+#if PLC_LOG_LEVEL >= PLC_LOG_LEVEL_DEBUG
+#define PLC_LOGD(...) plc_log(PLC_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define PLC_LOGD(...) do {} while (0)
+#endif
+#if PLC_LOG_LEVEL >= PLC_LOG_LEVEL_VERBOSE
+#define PLC_LOGV(...) plc_log(PLC_LOG_LEVEL_VERBOSE, __VA_ARGS__)
+#else
+#define PLC_LOGV(...) do {} while (0)
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+// QCA7000 SPI read framing. Every frame the modem hands out is wrapped as
+//   [hw length:4][SOF AA AA AA AA][FL:2 LE][RSVD:2][frame: FL bytes][EOF 55 55]
+// and a single RDBUF burst may carry several of them back to back.
+#define QCA_FRAME_HEADER_LEN 12
+#define QCA_FRAME_FOOTER_LEN 2
+#define QCA_FRAME_OVERHEAD (QCA_FRAME_HEADER_LEN + QCA_FRAME_FOOTER_LEN)
+#define QCA_FRAME_MIN_LEN 60
+
+struct QcaFrameView {
+    const uint8_t *data;
+    uint16_t len;
+};
+
+// Walks a burst in place; frames are handed out as views into the burst buffer,
+// so they stay valid until the buffer is refilled.
+struct QcaBurstCursor {
+    const uint8_t *burst;
+    uint32_t len;
+    uint32_t offset;
+    bool error;     // framing lost (bad SOF/EOF or length), rest of the burst is unusable
+};
+
+void qca_burst_begin(QcaBurstCursor *cursor, const uint8_t *burst, uint32_t len);
+bool qca_burst_next(QcaBurstCursor *cursor, QcaFrameView *frame);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "evse_config.h"
+
+// Buffers the SPI task reads RDBUF bursts into. IPv6 frames inside a burst go
+// to lwIP by reference, so a buffer returns to the pool only once the drain
+// and every pbuf pointing into it have let go. Each holder keeps one
+// reference. The pool itself is not locked; callers serialise access.
+
+#define QCA_RX_BUFFER_BYTES 3164    // QCA7K_BUFFER_SIZE rounded up to whole words, for DMA
+
+#if QCA_RX_POOL_BUFFERS < 1 || QCA_RX_POOL_BUFFERS > 32
+#error "QCA_RX_POOL_BUFFERS must be 1..32"
+#endif
+
+struct QcaRxPoolStats {
+    uint32_t taken;
+    uint32_t exhausted;     // take found every buffer still referenced
+    uint8_t in_use;
+    uint8_t high_water;
+};
+
+struct QcaRxPool {
+    alignas(4) uint8_t buf[QCA_RX_POOL_BUFFERS][QCA_RX_BUFFER_BYTES];
+    uint8_t refs[QCA_RX_POOL_BUFFERS];
+    QcaRxPoolStats stats;
+};
+
+void qca_rx_pool_reset(QcaRxPool *pool);
+// A free buffer holding one reference, or nullptr.
+uint8_t *qca_rx_pool_take(QcaRxPool *pool);
+// Index of the buffer that p points into, -1 for memory outside the pool.
+int8_t qca_rx_pool_index(const QcaRxPool *pool, const uint8_t *p);
+void qca_rx_pool_ref(QcaRxPool *pool, int8_t index);
+void qca_rx_pool_unref(QcaRxPool *pool, int8_t index);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "qca_tx_queue.h"
+
+// Transport for the QCA7005 SPI protocol. The SLAC/IPv6 data path only talks
+// to the modem through this table, so the ESP-IDF spi_master driver, the
+// Arduino SPIClass fallback and the host test fake are interchangeable.
+
+struct QcaSpiStats {
+    uint32_t transactions;   // chip-select windows
+    uint32_t bytes;          // bytes clocked, command words included
+    uint32_t busy_us;        // time the driver held the bus
+    uint32_t rx_bursts;
+    uint32_t tx_bursts;
+    uint32_t rx_bounced;     // bursts copied out of the DMA bounce buffer
+    uint32_t tx_copied;      // frames copied into the bounce buffer instead of sent from their slot
+};
+
+// Interrupt causes seen by the SPI task, plus what it did about them.
+struct QcaIrqStats {
+    uint32_t wakeups;          // service passes that read INTR_CAUSE
+    uint32_t pkt_avlbl;
+    uint32_t rdbuf_err;
+    uint32_t wrbuf_err;
+    uint32_t cpu_on;
+    uint32_t addr_err;
+    uint32_t wrbuf_below_wm;
+    uint32_t rdbuf_flushes;    // RDBUF_ERR recovered by discarding the read buffer
+    uint32_t wrbuf_resyncs;    // WRBUF_ERR recovered by re-reading the write space
+    uint32_t resets;           // escalated to ModemReset()
+};
+
+struct QcaSpiBus {
+    const char *name;
+    bool (*init)(void);
+    uint16_t (*read_register)(uint16_t reg);
+    void (*write_register)(uint16_t reg, uint16_t value);
+    // RDBUF_BYTE_AVA, BFR_SIZE and the external read as one bus sequence.
+    // Returns the number of bytes placed in dst, 0 when the modem has nothing.
+    uint32_t (*read_burst)(uint8_t *dst, uint32_t max);
+    // BFR_SIZE and one external write carrying n framed frames; total includes
+    // the SOF/FL/RSVD/EOF framing of every frame, which the slots already hold.
+    void (*write_frames)(const QcaTxSlot *const *frames, uint8_t n, uint16_t total);
+    void (*get_stats)(QcaSpiStats *out);
+};
+
+// Legacy SPIClass driver: manual chip select, one transfer16 per word.
+const QcaSpiBus *qca_spi_arduino_bus(void);
+#if defined(ESP_PLATFORM) && QCA_SPI_DMA_ENABLE
+// spi_master driver: DMA bursts, hardware chip select, bus held across a sequence.
+const QcaSpiBus *qca_spi_dma_bus(void);
+#endif
+// The driver selected by QCA_SPI_DMA_ENABLE.
+const QcaSpiBus *qca_spi_default_bus(void);
+
+// Writes the 8 byte SPI frame header (SOF x4, FL little endian, RSVD) for len.
+void qca_spi_frame_header(uint8_t *hdr, uint16_t len);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "evse_config.h"
+
+// Bounded queue of Ethernet frames waiting for the QCA7005 write buffer.
+// Producers copy their frame into a slot, the SPI task drains the queue in
+// batches. Each slot keeps its frame wrapped for the SPI write
+// ([SOF x4][FL][RSVD] frame [EOF EOF], framed on commit), so the DMA driver
+// can clock slots out as they are. The queue itself is not locked; callers
+// serialise access.
+
+struct QcaTxStats {
+    uint32_t enqueued;
+    uint32_t dropped;        // producer found the queue full (or frame too long)
+    uint32_t stalls;         // flush stopped because the modem had no write space
+    uint32_t batches;        // chip-select windows used
+    uint32_t frames_sent;
+    uint32_t bytes_sent;
+    uint32_t bytes_per_s;    // over the last completed rate window
+    uint8_t depth;
+    uint8_t high_water;
+};
+
+struct QcaTxSlot {
+    alignas(4) uint8_t sof[8];              // SPI frame header
+    uint8_t data[QCA_TX_SLOT_SIZE + 2];     // frame, then the EOF bytes
+    uint16_t len;
+};
+
+struct QcaTxQueue {
+    QcaTxSlot slots[QCA_TX_QUEUE_DEPTH];
+    uint8_t head;
+    uint8_t count;
+    QcaTxStats stats;
+    uint32_t rate_window_start_ms;
+    uint32_t rate_window_bytes;
+};
+
+void qca_tx_queue_reset(QcaTxQueue *q);
+// Returns the next free slot for a frame of len bytes, or nullptr (counted as a drop).
+uint8_t *qca_tx_queue_reserve(QcaTxQueue *q, uint16_t len);
+void qca_tx_queue_commit(QcaTxQueue *q, uint16_t len);
+bool qca_tx_queue_push(QcaTxQueue *q, const uint8_t *frame, uint16_t len);
+// index 0 is the oldest frame.
+const QcaTxSlot *qca_tx_queue_peek(const QcaTxQueue *q, uint8_t index);
+void qca_tx_queue_pop(QcaTxQueue *q, uint8_t frames, uint32_t bytes, uint32_t now_ms);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+// HomePlug AV / ISO 15118-3 frames the EVSE sends during modem setup and SLAC.
+// Each one is a constant template with the fixed header bytes; a builder copies
+// it and patches only the per-session fields (MACs, RunId, NID/NMK, sounds).
+#define SLAC_SET_KEY_REQ_LEN        60
+#define SLAC_GET_SW_REQ_LEN         60
+#define SLAC_FACTORY_DEFAULTS_LEN   60
+#define SLAC_PARAM_CNF_LEN          60
+#define SLAC_ATTEN_CHAR_IND_LEN     130
+#define SLAC_MATCH_CNF_LEN          109
+
+#define SLAC_ATTEN_GROUPS           58
+#define SLAC_MATCH_MVF_LEN          0x003E
+
+// Per-session fields; pointers are read during the build only.
+struct SlacFrameFields {
+    const uint8_t *evse_mac;    // 6 bytes
+    const uint8_t *pev_mac;     // 6 bytes
+    const uint8_t *run_id;      // 8 bytes
+    const uint8_t *nid;         // 7 bytes
+    const uint8_t *nmk;         // 16 bytes
+};
+
+// All builders write the full frame to dst and return its length.
+uint16_t slac_frame_set_key_req(uint8_t *dst, const SlacFrameFields *f);
+uint16_t slac_frame_get_sw_req(uint8_t *dst, const SlacFrameFields *f);
+uint16_t slac_frame_factory_defaults(uint8_t *dst, const SlacFrameFields *f);
+uint16_t slac_frame_param_cnf(uint8_t *dst, const SlacFrameFields *f, uint8_t sound_count, uint8_t timeout_field);
+// atten holds the SLAC_ATTEN_GROUPS averaged attenuation bytes (see atten_engine.h).
+uint16_t slac_frame_atten_char_ind(uint8_t *dst, const SlacFrameFields *f, uint8_t sounds,
+                                   const uint8_t *atten);
+uint16_t slac_frame_match_cnf(uint8_t *dst, const SlacFrameFields *f);
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "atten_engine.h"
+#include "slac_frames.h"
+
+// Where a session's frames go: one port per QCA7005 (chip select).
+struct SlacSessionPort {
+    void (*write)(void *ctx, const uint8_t *frame, uint16_t len);
+    void *ctx;
+};
+
+// SLAC state machine of one outlet: NMK setup of the local modem, the
+// ISO 15118-3 matching exchange with the PEV and the GET_SW link check.
+// rx() takes every HomePlug frame from the session's modem, tick() runs the
+// timers from the protocol task. Sessions share nothing, so a controller can
+// run one per modem; callers serialize access to a single session.
+//
+// State is public for diagnostics and the host tests.
+class SlacSession {
+public:
+    void begin(uint8_t index, const uint8_t *evse_mac, const SlacSessionPort *port);
+    // Back to power-up defaults (keeps index, MAC and port).
+    void reset();
+    void rx(const uint8_t *frame, uint16_t len, unsigned long now);
+    void tick(unsigned long now);
+    // Control pilot opened: drop the measurements and push the next pooled key.
+    void rearm(unsigned long now);
+    // Control pilot closed; starts the plug-in to SLAC_PARAM.CNF measurement.
+    void plugged_in(unsigned long now);
+    void transmit_atten_char_ind(const char *reason, unsigned long now);
+    bool link_ready() const;
+
+    uint8_t index = 0;
+    uint8_t modem_state = 0;
+    uint8_t pev_mac[6] = {0};           // the MAC of the PEV
+    uint8_t pev_modem_mac[6] = {0};     // the PEV's modem (from GET_SW); could identify the EV
+    uint8_t modem_mac[6] = {0};         // our own modem, not used for communication
+    uint8_t run_id[8] = {0};            // from CM_SLAC_PARAM.REQ
+    AttenAccum atten = {};              // CM_ATTEN_PROFILE.IND groups of this sounding
+    AttenStats atten_stats = {};        // as of the last ATTEN_CHAR.IND
+    uint8_t nmk[16] = {0};              // random per session
+    uint8_t nid[7] = {1, 2, 3, 4, 5, 6, 7};   // MSB bits 6 and 7 need to be 0
+
+    unsigned long sounds_timer = 0;
+    unsigned long modem_search_timer = 0;
+    unsigned long atten_char_response_timer = 0;
+    unsigned long slac_match_timer = 0;
+    uint8_t modems_found = 0;
+    uint8_t received_sounds = 0;
+    uint8_t received_profiles = 0;
+
+    uint8_t requested_sound_count = 10;
+    uint8_t negotiated_sound_count = 10;
+    uint8_t negotiated_sound_timeout_field = 0x06;
+    uint32_t sound_window_ms = 600;
+    uint32_t match_window_ms = 2000;
+    uint8_t slac_retries = 0;
+    uint8_t atten_char_retries = 0;
+
+    uint32_t key_rotations = 0;         // SET_KEY.REQ sent
+    uint32_t key_ready_ms = 0;          // last SET_KEY.REQ to SET_KEY.CNF
+    uint32_t plug_to_param_ms = 0;      // last plug-in to SLAC_PARAM.CNF
+    uint32_t plug_to_param_max_ms = 0;
+    uint32_t plugs_before_key = 0;      // plug-ins while the modem still waited for its key
+
+private:
+    void send(const uint8_t *frame, uint16_t len);
+    SlacFrameFields fields() const;
+    void send_set_key(unsigned long now);
+    void refresh_match_window();
+    void clear_measurements();
+    void fail(const char *reason, unsigned long now);
+
+    const uint8_t *evse_mac_ = nullptr;
+    const SlacSessionPort *port_ = nullptr;
+    uint8_t tx_[SLAC_MATCH_CNF_LEN] = {0};
+    uint8_t atten_char_ind_[SLAC_ATTEN_CHAR_IND_LEN] = {0};   // kept for retries
+    uint8_t atten_char_ind_sounds_ = 0;
+    uint8_t atten_char_ind_profiles_ = 0;
+    unsigned long set_key_timer_ = 0;
+    unsigned long plug_timer_ = 0;
+    bool plug_pending_ = false;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+// Per-task execution time and deadline bookkeeping. Each periodic task calls
+// begin/end around one iteration; the diag channel reads the table.
+// Timestamps are microseconds from the caller's clock so the host tests can
+// drive it without FreeRTOS.
+
+#define TASK_MONITOR_MAX 8
+
+struct TaskMonitorStats {
+    const char *name;
+    uint32_t period_ms;      // 0 for event-driven tasks
+    uint32_t budget_us;      // iteration longer than this counts as an overrun
+    uint32_t iterations;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint32_t avg_us;         // exponential average, 1/8 weight per iteration
+    uint32_t overruns;
+    uint32_t late_starts;    // a whole period skipped between two starts
+};
+
+void task_monitor_reset(void);
+// Returns the slot id, or -1 when the table is full.
+int task_monitor_register(const char *name, uint32_t period_ms, uint32_t budget_us);
+void task_monitor_begin(int id, uint32_t now_us);
+void task_monitor_end(int id, uint32_t now_us);
+uint8_t task_monitor_count(void);
+bool task_monitor_get(uint8_t id, TaskMonitorStats *out);
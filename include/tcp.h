@@ -1,4 +1,11 @@
-void evaluateTcpPacket(uint16_t payloadOffset, uint16_t payloadLen);
+#pragma once
+
+#include <stdint.h>
+
+#include "tcp_sender.h"
+#include "v2gtp_framer.h"
+
+void evaluateTcpPacket(const uint8_t *tcp, uint16_t ipPayloadLen);
 void tcp_prepareTcpHeader(uint8_t tcpFlag);
 void tcp_packRequestIntoIp(void);
 void tcp_tick(void);
@@ -8,3 +15,39 @@ void tcp_register_socket_sender(void (*cb)(const uint8_t *, uint16_t));
 void tcp_process_socket_payload(const uint8_t *payload, uint16_t len);
 void tcp_transport_reset(void);
 void tcp_transport_connected(void);
+
+// Per-route counters of the HLC dispatch table. Times need PERF_PROBES_ENABLE.
+struct HlcRouteStats {
+    const char *name;
+    uint8_t protocol;       // 0 DIN 70121, 1 ISO 15118-2
+    uint8_t state;          // FSM state the route is taken in
+    uint32_t calls;
+    uint32_t max_us;
+    uint32_t avg_us;
+};
+
+uint8_t tcp_hlc_route_count(void);
+bool tcp_hlc_route_stats(uint8_t idx, HlcRouteStats *out);
+// Requests without a route, and handlers that left the FSM in a state their
+// route does not allow (the session is reset).
+void tcp_hlc_dispatch_counters(uint32_t *unrouted, uint32_t *bad_transitions);
+// CurrentDemandRes frames built by patching the cached one vs. full encodes,
+// CurrentDemandReq frames read from the learned template vs. full decodes, and
+// for both the session layouts whose field positions did not verify.
+struct HlcCurrentDemandStats {
+    uint32_t res_patched;
+    uint32_t res_encoded;
+    uint32_t res_rejected;
+    uint32_t req_matched;
+    uint32_t req_decoded;
+    uint32_t req_rejected;
+};
+
+void tcp_hlc_current_demand_stats(HlcCurrentDemandStats *out);
+// Receive-side V2GTP reassembly counters (ring high-water mark, wrapped and
+// skipped frames). Not cleared by tcp_hlc_stats_reset().
+void tcp_hlc_rx_stats(V2gtpFramerStats *out);
+// Raw-TCP sender counters and RTT estimate of the current connection (all
+// zero while the lwIP socket path is used).
+void tcp_hlc_tx_stats(TcpSenderStats *out);
+void tcp_hlc_stats_reset(void);
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "evse_config.h"
+
+// Send side of the raw-TCP transport in tcp.cpp, one V2GTP frame at a time.
+// The frame stays in the caller's buffer. tcp_sender_next() hands out peer-MSS
+// segments while the bytes in flight fit both the peer's window and
+// TCP_TX_WINDOW_SEGMENTS. ACKs feed the RFC 6298 RTT estimate, which takes
+// no samples from retransmitted data. Three duplicate ACKs resend the first
+// unacked segment. When the RTO expires, everything from the first unacked
+// byte is resent one segment at a time until an ACK moves, and the RTO doubles.
+
+#define TCP_DUP_ACK_THRESHOLD 3
+
+#if TCP_TX_WINDOW_SEGMENTS < 1 || TCP_TX_WINDOW_SEGMENTS >= QCA_TX_QUEUE_DEPTH
+#error "TCP_TX_WINDOW_SEGMENTS must leave room in the QCA TX queue"
+#endif
+
+struct TcpSegment {
+    uint32_t seq;
+    const uint8_t *data;
+    uint16_t len;
+    bool push;              // last segment of the frame
+};
+
+enum TcpSenderTick : int8_t {
+    TCP_SENDER_IDLE = 0,
+    TCP_SENDER_RETRANSMIT = 1,  // RTO expired; tcp_sender_next() has segments again
+    TCP_SENDER_GIVE_UP = -1,    // TCP_MAX_RETRANSMIT timeouts without progress
+};
+
+struct TcpSenderStats {
+    uint32_t segments;          // handed out, resent ones included
+    uint32_t retransmits;       // resent after a timeout
+    uint32_t fast_retransmits;  // resent after TCP_DUP_ACK_THRESHOLD duplicate ACKs
+    uint32_t timeouts;
+    uint32_t rtt_samples;
+    uint16_t srtt_ms;
+    uint16_t rttvar_ms;
+    uint16_t rto_ms;
+    uint16_t max_inflight;      // bytes
+};
+
+struct TcpSender {
+    const uint8_t *data;
+    uint16_t len;
+    uint32_t seq;           // sequence number of data[0]
+    uint16_t una;           // offsets into data: first unacked byte,
+    uint16_t nxt;           // next byte to send,
+    uint16_t high;          // one past the highest byte sent so far
+    uint16_t mss;
+    uint16_t peer_wnd;
+    uint8_t dup_acks;
+    bool fast_rexmit;       // first unacked segment is due again
+    uint8_t timeouts;       // RTO expiries in a row
+    uint8_t burst;          // segments allowed in flight: 1 after a timeout until new data is acked
+    uint16_t rto_ms;
+    uint32_t srtt8;         // SRTT in ms, times 8
+    uint32_t rttvar4;       // RTTVAR in ms, times 4
+    bool timing;            // one segment is being timed (Karn)
+    uint16_t timed_end;
+    uint32_t timed_at;
+    bool timer_on;
+    uint32_t timer_at;
+    TcpSenderStats stats;
+};
+
+// New connection: forgets the RTT estimate and the stats.
+void tcp_sender_reset(TcpSender *s, uint32_t seq, uint16_t mss, uint16_t peer_wnd);
+// Queues a frame starting at the next sequence number; a frame still in
+// flight is given up.
+void tcp_sender_start(TcpSender *s, const uint8_t *data, uint16_t len);
+bool tcp_sender_busy(const TcpSender *s);
+// pure: the ACK carried no data, so a repeat of it counts as duplicate.
+void tcp_sender_ack(TcpSender *s, uint32_t ack, uint16_t wnd, bool pure, uint32_t now);
+// Next segment to put on the wire, if any. Call until it returns false.
+bool tcp_sender_next(TcpSender *s, uint32_t now, TcpSegment *out);
+TcpSenderTick tcp_sender_tick(TcpSender *s, uint32_t now);
+// One past the highest sequence number sent.
+uint32_t tcp_sender_snd_nxt(const TcpSender *s);
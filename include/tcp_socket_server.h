@@ -1,11 +0,0 @@
-#pragma once
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-void tcp_socket_server_start();
-
-#ifdef __cplusplus
-}
-#endif
@@ -7,13 +7,15 @@ extern "C" {
 #endif
 
 /**
- * @brief Return pointer + size of the SECC default TLS certificate in PEM format.
+ * @brief Return pointer + size of the SECC default TLS certificate in PEM format
+ *        (a self-signed secp256r1 development certificate unless provisioned).
  *        Applications may override these weak definitions to load certs from NVS/FS.
  */
 const unsigned char *evse_tls_server_cert(size_t *len);
 
 /**
- * @brief Return pointer + size of the SECC default TLS private key in PEM format.
+ * @brief Return pointer + size of the SECC TLS private key. The built-in and
+ *        provisioned keys are DER; a weak override may return PEM instead.
  *        Applications may override these weak definitions to load keys securely.
  */
 const unsigned char *evse_tls_server_key(size_t *len);
@@ -23,6 +25,19 @@ const unsigned char *evse_tls_server_key(size_t *len);
  */
 const unsigned char *evse_tls_trusted_ca(size_t *len);
 
+typedef enum {
+    TLS_KEY_OK = 0,
+    TLS_KEY_UNPARSEABLE,    // neither PEM nor DER that mbedTLS can read
+    TLS_KEY_WRONG_CURVE,    // EC, but not the secp256r1 ISO 15118-2 asks for
+    TLS_KEY_STORE_FAILED,
+} tls_key_result_t;
+
+/**
+ * @brief Parse a PEM or DER private key and keep it in the PKI store as DER.
+ *        RSA keys are still accepted for bench setups.
+ */
+tls_key_result_t tls_credentials_set_server_key(const unsigned char *key, size_t len);
+
 void tls_credentials_reload(void);
 
 #ifdef __cplusplus
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "evse_config.h"
+
+// Server-side TLS sessions kept for resumption by session ID. Each entry holds
+// the session serialised by the TLS library, so the cache knows nothing about
+// its layout. A new session reuses the entry of its own ID, a free or expired
+// one, or else evicts the least recently used. Sizes are fixed so the whole
+// cache can be one allocation (PSRAM when the board has it). The cache itself
+// is not locked; callers serialise access.
+
+#define TLS_SESSION_ID_MAX 32
+
+#if TLS_SESSION_CACHE_ENTRIES < 1 || TLS_SESSION_CACHE_ENTRIES > 64
+#error "TLS_SESSION_CACHE_ENTRIES must be 1..64"
+#endif
+
+struct TlsSessionCacheStats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t stored;
+    uint32_t evicted;       // live session pushed out by a new one
+    uint32_t expired;       // older than the timeout when looked up or replaced
+    uint32_t too_big;       // did not serialise into TLS_SESSION_BLOB_MAX
+    uint8_t entries;
+};
+
+struct TlsSessionEntry {
+    uint8_t id[TLS_SESSION_ID_MAX];
+    uint8_t id_len;
+    uint16_t len;           // 0: free
+    uint32_t stored_at;     // seconds
+    uint32_t used_at;
+    uint8_t blob[TLS_SESSION_BLOB_MAX];
+};
+
+struct TlsSessionCache {
+    TlsSessionEntry entries[TLS_SESSION_CACHE_ENTRIES];
+    uint32_t timeout_s;
+    TlsSessionCacheStats stats;
+};
+
+void tls_session_cache_reset(TlsSessionCache *cache, uint32_t timeout_s);
+// Stored session for id, or nullptr. A hit counts as a use for eviction.
+const uint8_t *tls_session_cache_find(TlsSessionCache *cache, const uint8_t *id, uint8_t id_len,
+                                      uint32_t now_s, uint16_t *len);
+// Blob of TLS_SESSION_BLOB_MAX bytes to serialise the session for id into,
+// then tls_session_cache_commit() with the length written, or 0 when it did
+// not fit. Any older copy of id is gone either way. nullptr for a bad id.
+uint8_t *tls_session_cache_reserve(TlsSessionCache *cache, const uint8_t *id, uint8_t id_len, uint32_t now_s);
+void tls_session_cache_commit(TlsSessionCache *cache, uint8_t *blob, uint16_t len);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "evse_config.h"
+
+// V2GTP reassembly for the HLC byte stream. Socket and raw-TCP data go into a
+// ring with v2gtp_framer_write(); v2gtp_framer_next() parses the 8 byte header
+// wherever it sits in the ring and hands out the payload of each complete
+// frame as one contiguous block. A frame lying in one piece is returned in
+// place; only a frame that wraps the end of the ring is copied into `linear`.
+// Nothing is moved when a frame is consumed. Frames larger than
+// V2GTP_MAX_FRAME_BYTES are skipped as they stream in, so the session goes on.
+
+#define V2GTP_HEADER_BYTES 8
+
+#if (V2GTP_RX_RING_BYTES & (V2GTP_RX_RING_BYTES - 1)) != 0
+#error "V2GTP_RX_RING_BYTES must be a power of two"
+#endif
+#if V2GTP_RX_RING_BYTES < V2GTP_MAX_FRAME_BYTES || V2GTP_RX_RING_BYTES > 32768
+#error "V2GTP_RX_RING_BYTES must hold one V2GTP_MAX_FRAME_BYTES frame and fit uint16_t indices"
+#endif
+
+enum V2gtpNext : int8_t {
+    V2GTP_NEED_MORE = 0,
+    V2GTP_FRAME = 1,
+    V2GTP_BAD_HEADER = -1,  // version bytes are not 0x01 0xFE; the stream is lost
+};
+
+struct V2gtpFrame {
+    uint16_t payload_type;
+    const uint8_t *payload;     // valid until v2gtp_framer_release()
+    uint16_t len;
+};
+
+struct V2gtpFramerStats {
+    uint32_t frames;
+    uint32_t linearized;    // frames copied out because they wrapped the ring
+    uint32_t oversize;      // frames skipped for exceeding V2GTP_MAX_FRAME_BYTES
+    uint32_t bad_header;
+    uint16_t max_level;     // ring high-water mark
+};
+
+struct V2gtpFramer {
+    uint8_t ring[V2GTP_RX_RING_BYTES];
+    uint8_t linear[V2GTP_MAX_FRAME_BYTES];
+    uint16_t head;          // first unread byte
+    uint16_t level;         // bytes in the ring
+    uint16_t pending;       // size of the frame handed out, released on the next call
+    uint32_t skip;          // bytes of an oversize frame still to drop
+    V2gtpFramerStats stats;
+};
+
+void v2gtp_framer_reset(V2gtpFramer *f);
+// Drops buffered data and any frame in progress; keeps the stats.
+void v2gtp_framer_flush(V2gtpFramer *f);
+// Copies up to len bytes into the ring, returns how many fit. The ring always
+// has room once every complete frame has been taken with v2gtp_framer_next().
+uint16_t v2gtp_framer_write(V2gtpFramer *f, const uint8_t *data, uint16_t len);
+// Releases the previous frame and returns the next complete one, if any.
+V2gtpNext v2gtp_framer_next(V2gtpFramer *f, V2gtpFrame *out);
+// Drops the frame returned last; optional, v2gtp_framer_next() does it too.
+void v2gtp_framer_release(V2gtpFramer *f);
+uint16_t v2gtp_framer_level(const V2gtpFramer *f);
@@ -0,0 +1,36 @@
+# PlatformIO post-link step: prints the static RAM of the EXI codec state
+# (shared document workspace, streams, TX buffer) from the firmware ELF.
+Import("env")
+
+import subprocess
+
+
+def exi_ram_report(source, target, env):
+    nm = env.subst("$CC").replace("gcc", "nm")
+    elf = str(target[0])
+    try:
+        out = subprocess.run([nm, "-S", "-C", "--size-sort", elf],
+                             stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                             universal_newlines=True, check=True).stdout
+    except (OSError, subprocess.CalledProcessError) as err:
+        print("EXI RAM report skipped: %s" % err)
+        return
+    total = 0
+    rows = []
+    for line in out.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) != 4 or parts[2].lower() not in ("b", "d"):
+            continue
+        name = parts[3]
+        if not (name.startswith("g_exi_") or name.startswith("g_iso2_")):
+            continue
+        size = int(parts[1], 16)
+        total += size
+        rows.append((size, name))
+    print("EXI static RAM:")
+    for size, name in sorted(rows, reverse=True):
+        print("  %-28s %6u" % (name, size))
+    print("  %-28s %6u" % ("total", total))
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", exi_ram_report)
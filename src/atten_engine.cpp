@@ -0,0 +1,74 @@
+#include "atten_engine.h"
+
+#include <string.h>
+
+namespace {
+
+const uint32_t LANE_LO = 0x00FF00FF;
+
+inline uint16_t lane(const uint32_t words[2][ATTEN_WORDS], uint8_t group) {
+    return (uint16_t)(words[group & 1][group >> 2] >> ((group & 2) << 3));
+}
+
+}
+
+void atten_reset(AttenAccum *a) {
+    memset(a, 0, sizeof(*a));
+    memset(a->min, 0xFF, sizeof(a->min));
+}
+
+bool atten_add(AttenAccum *a, const uint8_t *groups) {
+    if (a->samples >= ATTEN_MAX_SAMPLES) return false;
+    // private copy: stores into the accumulator can't alias the frame, and the tail word is zero padded
+    union {
+        uint32_t w[ATTEN_WORDS];
+        uint8_t b[ATTEN_WORDS * 4];
+    } in;
+    in.w[ATTEN_WORDS - 1] = 0;
+    memcpy(in.b, groups, SLAC_ATTEN_GROUPS);
+    for (uint8_t w = 0; w < ATTEN_WORDS; w++) {
+        uint32_t even = in.w[w] & LANE_LO;
+        uint32_t odd = (in.w[w] >> 8) & LANE_LO;
+        a->sum[0][w] += even;
+        a->sum[1][w] += odd;
+    }
+    // squares don't pack into lanes; min/max map to MINU/MAXU on Xtensa
+    for (uint8_t g = 0; g < SLAC_ATTEN_GROUPS; g++) {
+        uint8_t v = in.b[g];
+        a->sq[g] += (uint32_t)v * v;
+        if (v < a->min[g]) a->min[g] = v;
+        if (v > a->max[g]) a->max[g] = v;
+    }
+    a->samples++;
+    return true;
+}
+
+void atten_finish(const AttenAccum *a, AttenStats *out) {
+    uint32_t n = a->samples;
+    out->samples = a->samples;
+    out->max_var = 0;
+    if (n == 0) {
+        memset(out->mean, 0, sizeof(out->mean));
+        memset(out->trimmed, 0, sizeof(out->trimmed));
+        memset(out->var, 0, sizeof(out->var));
+        return;
+    }
+    for (uint8_t g = 0; g < SLAC_ATTEN_GROUPS; g++) {
+        uint32_t s = lane(a->sum, g);
+        uint8_t mean = (uint8_t)(s / n);
+        out->mean[g] = mean;
+        // n * sq <= 255 * 255 * 255^2 still fits 32 bits
+        uint16_t var = (uint16_t)((n * a->sq[g] - s * s) / (n * n));
+        out->var[g] = var;
+        if (var > out->max_var) out->max_var = var;
+        if (n >= 3) {
+            out->trimmed[g] = (uint8_t)((s - a->min[g] - a->max[g]) / (n - 2));
+        } else {
+            out->trimmed[g] = mean;
+        }
+    }
+}
+
+uint16_t atten_group_sum(const AttenAccum *a, uint8_t group) {
+    return lane(a->sum, group);
+}
@@ -0,0 +1,33 @@
+#include "bridge_queue.h"
+
+#include <string.h>
+
+void bridge_queue_init(BridgeQueue *q, uint8_t capacity) {
+    memset(q, 0, sizeof(*q));
+    q->capacity = capacity < BRIDGE_QUEUE_MAX ? capacity : BRIDGE_QUEUE_MAX;
+}
+
+bool bridge_queue_push(BridgeQueue *q, void *item) {
+    if (q->count >= q->capacity) {
+        q->stats.overflow++;
+        return false;
+    }
+    q->items[(q->head + q->count) % q->capacity] = item;
+    q->count++;
+    q->stats.pushed++;
+    if (q->count > q->stats.high_water) q->stats.high_water = q->count;
+    return true;
+}
+
+void *bridge_queue_peek(const BridgeQueue *q) {
+    return q->count ? q->items[q->head] : nullptr;
+}
+
+void *bridge_queue_pop(BridgeQueue *q) {
+    if (!q->count) return nullptr;
+    void *item = q->items[q->head];
+    q->head = (uint8_t)((q->head + 1) % q->capacity);
+    q->count--;
+    q->stats.popped++;
+    return item;
+}
@@ -5,6 +5,7 @@
 #include <limits.h>
 #include <algorithm>
 #include "evse_config.h"
+#include "plc_log.h"
 // Threshold anchors (millivolts)
 static int g_t12 = CP_T12_DEFAULT_MV;
 static int g_t9  = CP_T9_DEFAULT_MV;
@@ -191,7 +192,7 @@ void cp_tick() {
 
     if (new_state != g_last_state) {
         g_last_state = new_state;
-        Serial.printf("[CP] state -> %c (robust=%d mv, peak=%d mv)\n", g_last_state, g_last_cp_mv_robust, g_last_cp_mv_peak);
+        PLC_LOGI("[CP] state -> %c (robust=%d mv, peak=%d mv)\n", g_last_state, g_last_cp_mv_robust, g_last_cp_mv_peak);
     }
 
     if (g_mode == CpMode::Manual) apply_pwm_manual();
@@ -222,7 +223,7 @@ bool cp_contactor_command(bool on) {
     g_contactor_cmd = on;
     g_contactor_fb = hw_contactor_aux();
     if (on && !g_contactor_fb) {
-        Serial.println("[CP] Contactor command failed (no aux confirmation)");
+        PLC_LOGW("[CP] Contactor command failed (no aux confirmation)\n");
         return false;
     }
     if (!on) g_contactor_fb = false;
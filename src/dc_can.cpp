@@ -4,10 +4,23 @@
 #include <SPI.h>
 #include <math.h>
 #include <mcp2515.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include "evse_config.h"
 
 static SPIClass canSPI(CAN_SPI_HOST);
 static MCP2515 g_mcp2515(CAN_CS_PIN, 8000000, &canSPI);
+// The CAN task ticks the ramp while the CP and protocol tasks switch the
+// output; the lock keeps their MCP2515 traffic from interleaving.
+static SemaphoreHandle_t g_dc_lock = nullptr;
+
+static void dc_lock() {
+    if (g_dc_lock) xSemaphoreTakeRecursive(g_dc_lock, portMAX_DELAY);
+}
+
+static void dc_unlock() {
+    if (g_dc_lock) xSemaphoreGiveRecursive(g_dc_lock);
+}
 
 #if MCP2515_CLK_MHZ == 8
 static const CAN_CLOCK kCanClock = MCP_8MHZ;
@@ -199,6 +212,7 @@ static void dc_poll_tick() {
 }
 
 void dc_can_init() {
+    if (!g_dc_lock) g_dc_lock = xSemaphoreCreateRecursiveMutex();
 #if CAN_RST_PIN >= 0
     pinMode(CAN_RST_PIN, OUTPUT);
     digitalWrite(CAN_RST_PIN, LOW);
@@ -225,8 +239,10 @@ void dc_can_init() {
 
 void dc_can_tick() {
     if (!g_can_ok) return;
+    dc_lock();
     dc_ramp_tick();
     dc_poll_tick();
+    dc_unlock();
 }
 
 void dc_enable_output(bool enable) {
@@ -235,6 +251,7 @@ void dc_enable_output(bool enable) {
         return;
     }
     if (enable == g_dc_enabled) return;
+    dc_lock();
     g_dc_enabled = enable;
     if (!enable) {
         g_dc_v_target = 0.0f;
@@ -243,6 +260,7 @@ void dc_enable_output(bool enable) {
         g_dc_i_set = 0.0f;
         dc_apply_setpoints(true);
     }
+    dc_unlock();
 }
 
 bool dc_is_enabled() {
@@ -276,12 +294,14 @@ float dc_get_bus_current() {
 
 void dc_emergency_stop() {
     if (!g_can_ok) return;
+    dc_lock();
     cmd_onoff(0x00, false);
     g_dc_enabled = false;
     g_dc_v_target = 0.0f;
     g_dc_i_target = 0.0f;
     g_dc_v_set = 0.0f;
     g_dc_i_set = 0.0f;
+    dc_unlock();
 }
 
 bool dc_is_available() {
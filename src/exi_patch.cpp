@@ -0,0 +1,308 @@
+#include "exi_patch.h"
+
+#include <string.h>
+
+namespace {
+
+uint32_t magnitude(int32_t v) {
+    return v < 0 ? (uint32_t)(-(v + 1)) : (uint32_t)v;
+}
+
+uint8_t int_octets(uint32_t m) {
+    uint8_t n = 1;
+    while (m >= 0x80) {
+        m >>= 7;
+        n++;
+    }
+    return n;
+}
+
+uint16_t field_width(const ExiFieldSpec &s, int32_t v) {
+    switch (s.kind) {
+    case EXI_FIELD_BOOL: return 1;
+    case EXI_FIELD_NBIT: return s.nbits;
+    default: return (uint16_t)(1 + 8 * int_octets(magnitude(v)));
+    }
+}
+
+// An enumeration value must fit its declared width; write_field() would cut it.
+bool fits(const ExiFieldSpec &s, int32_t v) {
+    return s.kind != EXI_FIELD_NBIT || ((uint32_t)v >> s.nbits) == 0;
+}
+
+// A patch may not move anything behind the field: same width, same sign.
+bool same_shape(const ExiFieldSpec &s, int32_t a, int32_t b) {
+    if (!fits(s, a) || !fits(s, b)) return false;
+    if (s.kind == EXI_FIELD_INT && ((a < 0) != (b < 0))) return false;
+    return field_width(s, a) == field_width(s, b);
+}
+
+// Flips the lowest value bit; probe_offset() is where that bit sits in the field.
+int32_t probe_value(const ExiFieldSpec &s, int32_t v) {
+    switch (s.kind) {
+    case EXI_FIELD_BOOL: return !v;
+    case EXI_FIELD_NBIT: return v ^ 1;
+    default: {
+        uint32_t m = magnitude(v) ^ 1;
+        return v < 0 ? -(int32_t)m - 1 : (int32_t)m;
+    }
+    }
+}
+
+uint8_t probe_offset(const ExiFieldSpec &s) {
+    switch (s.kind) {
+    case EXI_FIELD_BOOL: return 0;
+    case EXI_FIELD_NBIT: return (uint8_t)(s.nbits - 1);
+    default: return 8;      // sign, continuation bit, 6..0 of the first group
+    }
+}
+
+// Flips every magnitude bit below the highest one, so all groups are exercised.
+// Enumerations get their top bit flipped, which catches a declared width that
+// is too wide: the patch then lands in the bits in front of the field. With
+// the top bit clear the value becomes 1 << (nbits - 1), the smallest one an
+// n-bit enumeration must have; with it set, a smaller value.
+int32_t wide_value(const ExiFieldSpec &s, int32_t v) {
+    if (s.kind == EXI_FIELD_NBIT) {
+        const int32_t top = (int32_t)(1u << (s.nbits - 1));
+        return (v & top) ? v ^ top : top;
+    }
+    if (s.kind != EXI_FIELD_INT) return probe_value(s, v);
+    uint32_t m = magnitude(v);
+    uint32_t top = 1;
+    while ((top << 1) <= m) top <<= 1;
+    m = m < 2 ? m ^ 1 : m ^ (top - 1);
+    return v < 0 ? -(int32_t)m - 1 : (int32_t)m;
+}
+
+void put_bits(uint8_t *buf, uint32_t bit, uint8_t width, uint32_t value) {
+    for (uint8_t i = 0; i < width; ++i, ++bit) {
+        uint8_t mask = (uint8_t)(0x80 >> (bit & 7));
+        if ((value >> (width - 1 - i)) & 1) {
+            buf[bit >> 3] |= mask;
+        } else {
+            buf[bit >> 3] &= (uint8_t)~mask;
+        }
+    }
+}
+
+void write_field(uint8_t *buf, uint32_t bit, const ExiFieldSpec &s, int32_t v) {
+    switch (s.kind) {
+    case EXI_FIELD_BOOL:
+        put_bits(buf, bit, 1, v ? 1 : 0);
+        return;
+    case EXI_FIELD_NBIT:
+        put_bits(buf, bit, s.nbits, (uint32_t)v);
+        return;
+    default: {
+        put_bits(buf, bit++, 1, v < 0 ? 1 : 0);
+        uint32_t m = magnitude(v);
+        do {
+            uint8_t octet = m & 0x7F;
+            m >>= 7;
+            if (m) octet |= 0x80;
+            put_bits(buf, bit, 8, octet);
+            bit += 8;
+        } while (m);
+        return;
+    }
+    }
+}
+
+uint32_t get_bits(const uint8_t *buf, uint32_t bit, uint8_t width) {
+    uint32_t v = 0;
+    for (uint8_t i = 0; i < width; ++i, ++bit) {
+        v = (v << 1) | ((buf[bit >> 3] >> (7 - (bit & 7))) & 1);
+    }
+    return v;
+}
+
+// Reads the field at bit; false if it runs past len bytes.
+bool read_field(const uint8_t *buf, uint16_t len, uint32_t bit, const ExiFieldSpec &s, int32_t *v) {
+    const uint32_t end = (uint32_t)len * 8;
+    switch (s.kind) {
+    case EXI_FIELD_BOOL:
+        if (bit + 1 > end) return false;
+        *v = (int32_t)get_bits(buf, bit, 1);
+        return true;
+    case EXI_FIELD_NBIT:
+        if (bit + s.nbits > end) return false;
+        *v = (int32_t)get_bits(buf, bit, s.nbits);
+        return true;
+    default: {
+        if (bit + 1 > end) return false;
+        bool negative = get_bits(buf, bit++, 1) != 0;
+        uint32_t m = 0;
+        for (uint8_t shift = 0; shift < 32; shift += 7) {
+            if (bit + 8 > end) return false;
+            uint8_t octet = (uint8_t)get_bits(buf, bit, 8);
+            bit += 8;
+            m |= (uint32_t)(octet & 0x7F) << shift;
+            if (!(octet & 0x80)) {
+                if (m > 0x7FFFFFFF) return false;
+                *v = negative ? -(int32_t)m - 1 : (int32_t)m;
+                return true;
+            }
+        }
+        return false;
+    }
+    }
+}
+
+bool single_diff_bit(const uint8_t *a, const uint8_t *b, uint16_t len, uint32_t *bit) {
+    bool found = false;
+    for (uint16_t i = 0; i < len; ++i) {
+        uint8_t x = a[i] ^ b[i];
+        if (!x) continue;
+        if (found || (x & (x - 1))) return false;
+        uint8_t pos = 0;
+        while (!(x & 0x80)) {
+            x <<= 1;
+            pos++;
+        }
+        *bit = (uint32_t)i * 8 + pos;
+        found = true;
+    }
+    return found;
+}
+
+bool learn(ExiPatchCache *c, const ExiFieldSpec *spec, ExiEncodeFn encode) {
+    int32_t v[EXI_PATCH_MAX_FIELDS];
+    const uint8_t n = c->nfields;
+    for (uint8_t i = 0; i < n; ++i) {
+        if (!fits(spec[i], c->value[i])) return false;
+        memcpy(v, c->value, n * sizeof(v[0]));
+        v[i] = probe_value(spec[i], c->value[i]);
+        if (encode(v, c->probe, sizeof(c->probe)) != c->len) return false;
+        uint32_t bit;
+        if (!single_diff_bit(c->bytes, c->probe, c->len, &bit)) return false;
+        if (bit < probe_offset(spec[i])) return false;
+        bit -= probe_offset(spec[i]);
+        if (bit + field_width(spec[i], c->value[i]) > (uint32_t)c->len * 8) return false;
+        c->bit[i] = (uint16_t)bit;
+    }
+    for (uint8_t pass = 0; pass < 2; ++pass) {
+        for (uint8_t i = 0; i < n; ++i) {
+            v[i] = pass ? wide_value(spec[i], c->value[i]) : probe_value(spec[i], c->value[i]);
+        }
+        if (encode(v, c->check, sizeof(c->check)) != c->len) return false;
+        memcpy(c->probe, c->bytes, c->len);
+        for (uint8_t i = 0; i < n; ++i) write_field(c->probe, c->bit[i], spec[i], v[i]);
+        if (memcmp(c->probe, c->check, c->len) != 0) return false;
+    }
+    return true;
+}
+
+bool same_layout(const ExiPatchCache *c, const uint8_t *layout, uint8_t layout_len, uint8_t n) {
+    return c->nfields == n && c->layout_len == layout_len && memcmp(c->layout, layout, layout_len) == 0;
+}
+
+} // namespace
+
+void exi_patch_reset(ExiPatchCache *c) {
+    memset(c, 0, sizeof(*c));
+}
+
+int exi_patch_encode(ExiPatchCache *c, const uint8_t *layout, uint8_t layout_len,
+                     const ExiFieldSpec *spec, const int32_t *values, uint8_t n,
+                     ExiEncodeFn encode) {
+    if (n > EXI_PATCH_MAX_FIELDS || layout_len > EXI_PATCH_MAX_LAYOUT) {
+        c->valid = false;
+        c->encoded++;
+        return encode(values, c->bytes, sizeof(c->bytes));
+    }
+    if (c->valid && same_layout(c, layout, layout_len, n)) {
+        bool fits = true;
+        for (uint8_t i = 0; i < n && fits; ++i) fits = same_shape(spec[i], c->value[i], values[i]);
+        if (fits) {
+            for (uint8_t i = 0; i < n; ++i) {
+                if (values[i] == c->value[i]) continue;
+                write_field(c->bytes, c->bit[i], spec[i], values[i]);
+                c->value[i] = values[i];
+            }
+            c->patched++;
+            return c->len;
+        }
+    }
+
+    c->valid = false;
+    c->encoded++;
+    int len = encode(values, c->bytes, sizeof(c->bytes));
+    if (len <= 0) return -1;
+    c->len = (uint16_t)len;
+    c->nfields = n;
+    c->layout_len = layout_len;
+    memcpy(c->layout, layout, layout_len);
+    memcpy(c->value, values, n * sizeof(values[0]));
+    if (learn(c, spec, encode)) {
+        c->valid = true;
+        c->learned++;
+    } else {
+        c->rejected++;
+    }
+    return len;
+}
+
+bool exi_patch_learn(ExiPatchCache *c, const uint8_t *layout, uint8_t layout_len,
+                     const uint8_t *frame, uint16_t len,
+                     const ExiFieldSpec *spec, const int32_t *values, uint8_t n,
+                     ExiEncodeFn encode) {
+    if (n > EXI_PATCH_MAX_FIELDS || layout_len > EXI_PATCH_MAX_LAYOUT || len > sizeof(c->bytes)) return false;
+    if (same_layout(c, layout, layout_len, n)) {
+        // A template that did not pay for itself is not learned again.
+        if (c->frozen || c->hits < EXI_PATCH_MIN_HITS) {
+            c->valid = false;
+            c->frozen = true;
+            return false;
+        }
+    } else {
+        c->frozen = false;
+    }
+    c->valid = false;
+    c->hits = 0;
+    c->nfields = n;
+    c->layout_len = layout_len;
+    memcpy(c->layout, layout, layout_len);
+    int enc = encode(values, c->bytes, sizeof(c->bytes));
+    if (enc != (int)len || memcmp(c->bytes, frame, len) != 0) {
+        c->rejected++;
+        return false;
+    }
+    c->len = len;
+    memcpy(c->value, values, n * sizeof(values[0]));
+    if (!learn(c, spec, encode)) {
+        c->rejected++;
+        return false;
+    }
+    c->valid = true;
+    c->learned++;
+    return true;
+}
+
+bool exi_patch_match(ExiPatchCache *c, const uint8_t *layout, uint8_t layout_len,
+                     const uint8_t *frame, uint16_t len,
+                     const ExiFieldSpec *spec, int32_t *values) {
+    if (!c->valid || len != c->len || !same_layout(c, layout, layout_len, c->nfields)) {
+        c->encoded++;
+        return false;
+    }
+    const uint8_t n = c->nfields;
+    int32_t v[EXI_PATCH_MAX_FIELDS];
+    for (uint8_t i = 0; i < n; ++i) {
+        if (!read_field(frame, len, c->bit[i], spec[i], &v[i]) || !same_shape(spec[i], c->value[i], v[i])) {
+            c->encoded++;
+            return false;
+        }
+    }
+    // Outside the fields the frame must be the template, bit for bit.
+    memcpy(c->check, frame, len);
+    for (uint8_t i = 0; i < n; ++i) write_field(c->check, c->bit[i], spec[i], c->value[i]);
+    if (memcmp(c->check, c->bytes, len) != 0) {
+        c->encoded++;
+        return false;
+    }
+    memcpy(values, v, n * sizeof(v[0]));
+    c->patched++;
+    c->hits++;
+    return true;
+}
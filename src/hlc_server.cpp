@@ -0,0 +1,477 @@
+#include "hlc_server.h"
+
+#ifdef ESP_PLATFORM
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+
+#include <Arduino.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/inet.h"
+#include "lwip/sockets.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/ecp.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_ticket.h"
+#include "mbedtls/x509_crt.h"
+
+#include "evse_config.h"
+#include "lwip_bridge.h"
+#include "tcp.h"
+#include "tls_credentials.h"
+#include "tls_session_cache.h"
+
+static const char *kTag = "hlc15118";
+
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_TICKET_C)
+#define HLC_TLS_TICKETS 1
+#else
+#define HLC_TLS_TICKETS 0
+#endif
+
+namespace {
+enum ClientState : uint8_t {
+    CLIENT_NONE,
+    CLIENT_PLAIN,
+    CLIENT_HANDSHAKE,       // TLS accepted, handshake not done yet
+    CLIENT_TLS,
+};
+
+enum Resumption : uint8_t {
+    RESUMED_NONE,
+    RESUMED_BY_ID,
+    RESUMED_BY_TICKET,
+};
+
+// ISO 15118-2 [V2G2-602] suites for the secp256r1 SECC certificate, forward
+// secret ones first.
+const int kEcdsaSuites[] = {
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256,
+#if TLS_ALLOW_STATIC_ECDH
+    MBEDTLS_TLS_ECDH_ECDSA_WITH_AES_128_CBC_SHA256,
+#endif
+    0,
+};
+const mbedtls_ecp_group_id kCurves[] = {MBEDTLS_ECP_DP_SECP256R1, MBEDTLS_ECP_DP_NONE};
+const int kSigHashes[] = {MBEDTLS_MD_SHA256, MBEDTLS_MD_NONE};
+
+int s_plain_listen = -1;
+int s_tls_listen = -1;
+bool s_tls_ready = false;
+
+mbedtls_entropy_context s_entropy;
+mbedtls_ctr_drbg_context s_drbg;
+mbedtls_x509_crt s_cert;
+mbedtls_x509_crt s_ca;
+mbedtls_pk_context s_key;
+mbedtls_ssl_config s_conf;
+TlsSessionCache *s_cache = nullptr;
+#if HLC_TLS_TICKETS
+mbedtls_ssl_ticket_context s_ticket;
+#endif
+
+int s_client = -1;
+ClientState s_state = CLIENT_NONE;
+bool s_want_write = false;  // TLS is waiting for send buffer space
+mbedtls_net_context s_net;
+mbedtls_ssl_context s_ssl;
+uint8_t s_rx[1024];
+uint32_t s_accepted_at = 0;
+Resumption s_resumed = RESUMED_NONE;
+
+// Written by this task, read by diag.
+portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+HlcTlsStats s_stats{};
+uint32_t s_full_total_ms = 0;
+uint32_t s_resumed_total_ms = 0;
+
+int listen_on(uint16_t port) {
+    int sock = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) {
+        ESP_LOGE(kTag, "socket() failed: %d", errno);
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in6 addr{};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons(port);
+    addr.sin6_addr = in6addr_any;
+    if (bind(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 || listen(sock, 1) < 0) {
+        ESP_LOGE(kTag, "bind/listen on %u failed: %d", port, errno);
+        close(sock);
+        return -1;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    return sock;
+}
+
+uint32_t now_s() {
+    return millis() / 1000;
+}
+
+int session_cache_get(void *data, mbedtls_ssl_session *session) {
+    TlsSessionCache *cache = static_cast<TlsSessionCache *>(data);
+    uint16_t len = 0;
+    const uint8_t *blob = tls_session_cache_find(cache, session->id, static_cast<uint8_t>(session->id_len), now_s(), &len);
+    if (!blob || mbedtls_ssl_session_load(session, blob, len) != 0) return 1;
+    s_resumed = RESUMED_BY_ID;
+    return 0;
+}
+
+// Serialises straight into the cache entry; the EV certificate goes along, so
+// a resumed session still knows who it talks to.
+int session_cache_set(void *data, const mbedtls_ssl_session *session) {
+    TlsSessionCache *cache = static_cast<TlsSessionCache *>(data);
+    uint8_t *blob = tls_session_cache_reserve(cache, session->id, static_cast<uint8_t>(session->id_len), now_s());
+    if (!blob) return 1;
+    size_t len = 0;
+    int ret = mbedtls_ssl_session_save(session, blob, TLS_SESSION_BLOB_MAX, &len);
+    tls_session_cache_commit(cache, blob, ret == 0 ? static_cast<uint16_t>(len) : 0);
+    return ret == 0 ? 0 : 1;
+}
+
+#if HLC_TLS_TICKETS
+int ticket_parse(void *p_ticket, mbedtls_ssl_session *session, unsigned char *buf, size_t len) {
+    int ret = mbedtls_ssl_ticket_parse(p_ticket, session, buf, len);
+    if (ret == 0) {
+        s_resumed = RESUMED_BY_TICKET;
+    } else {
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.tickets_rejected++;
+        portEXIT_CRITICAL(&s_stats_lock);
+    }
+    return ret;
+}
+#endif
+
+// PSRAM when the board has it; the cache is only touched by this task and
+// only during handshakes.
+void session_cache_setup() {
+    void *mem = heap_caps_malloc(sizeof(TlsSessionCache), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!mem) mem = heap_caps_malloc(sizeof(TlsSessionCache), MALLOC_CAP_8BIT);
+    if (!mem) {
+        ESP_LOGW(kTag, "no memory for the TLS session cache (%u bytes)", (unsigned)sizeof(TlsSessionCache));
+        return;
+    }
+    s_cache = static_cast<TlsSessionCache *>(mem);
+    tls_session_cache_reset(s_cache, TLS_SESSION_TIMEOUT_S);
+    mbedtls_ssl_conf_session_cache(&s_conf, s_cache, session_cache_get, session_cache_set);
+}
+
+uint32_t handshake_done(bool ok) {
+    uint32_t ms = millis() - s_accepted_at;
+    portENTER_CRITICAL(&s_stats_lock);
+    if (!ok) {
+        s_stats.failed++;
+    } else if (s_resumed != RESUMED_NONE) {
+        s_stats.resumed++;
+        if (s_resumed == RESUMED_BY_TICKET) s_stats.by_ticket++;
+        s_stats.resumed_last_ms = ms;
+        if (ms > s_stats.resumed_max_ms) s_stats.resumed_max_ms = ms;
+        s_resumed_total_ms += ms;
+    } else {
+        s_stats.full++;
+        s_stats.full_last_ms = ms;
+        if (ms > s_stats.full_max_ms) s_stats.full_max_ms = ms;
+        s_full_total_ms += ms;
+    }
+    if (s_cache) s_stats.cache = s_cache->stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+    return ms;
+}
+
+// The certificate accessors return NUL-terminated PEM; mbedTLS wants the NUL
+// counted in the length. The key is DER unless a weak override hands out PEM.
+bool tls_setup() {
+    size_t cert_len = 0;
+    size_t key_len = 0;
+    size_t ca_len = 0;
+    const unsigned char *cert = evse_tls_server_cert(&cert_len);
+    const unsigned char *key = evse_tls_server_key(&key_len);
+    const unsigned char *ca = evse_tls_trusted_ca(&ca_len);
+    if (!cert || !key || cert_len == 0 || key_len == 0) {
+        ESP_LOGE(kTag, "TLS credentials missing");
+        return false;
+    }
+
+    mbedtls_entropy_init(&s_entropy);
+    mbedtls_ctr_drbg_init(&s_drbg);
+    mbedtls_x509_crt_init(&s_cert);
+    mbedtls_x509_crt_init(&s_ca);
+    mbedtls_pk_init(&s_key);
+    mbedtls_ssl_config_init(&s_conf);
+#if HLC_TLS_TICKETS
+    mbedtls_ssl_ticket_init(&s_ticket);
+#endif
+
+    int ret = mbedtls_ctr_drbg_seed(&s_drbg, mbedtls_entropy_func, &s_entropy,
+                                    reinterpret_cast<const unsigned char *>(kTag), strlen(kTag));
+    if (ret == 0) ret = mbedtls_x509_crt_parse(&s_cert, cert, cert_len + 1);
+    if (ret == 0) ret = mbedtls_pk_parse_key(&s_key, key, key[0] == 0x30 ? key_len : key_len + 1, nullptr, 0);
+    if (ret == 0 && ca && ca_len) ret = mbedtls_x509_crt_parse(&s_ca, ca, ca_len + 1);
+    if (ret == 0) {
+        ret = mbedtls_ssl_config_defaults(&s_conf, MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT);
+    }
+    if (ret == 0) ret = mbedtls_ssl_conf_own_cert(&s_conf, &s_cert, &s_key);
+    if (ret != 0) {
+        ESP_LOGE(kTag, "TLS setup failed (-0x%04x)", -ret);
+        return false;
+    }
+    if (mbedtls_pk_can_do(&s_key, MBEDTLS_PK_ECKEY)) {
+        if (mbedtls_pk_ec(s_key)->grp.id != MBEDTLS_ECP_DP_SECP256R1) {
+            ESP_LOGE(kTag, "TLS key is not secp256r1");
+            return false;
+        }
+        mbedtls_ssl_conf_ciphersuites(&s_conf, kEcdsaSuites);
+        mbedtls_ssl_conf_curves(&s_conf, kCurves);
+        mbedtls_ssl_conf_sig_hashes(&s_conf, kSigHashes);
+    } else {
+        ESP_LOGW(kTag, "RSA TLS key: ISO 15118-2 EVs expect an ECDSA P-256 SECC certificate");
+    }
+    mbedtls_ssl_conf_min_version(&s_conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+    mbedtls_ssl_conf_rng(&s_conf, mbedtls_ctr_drbg_random, &s_drbg);
+    if (ca && ca_len) {
+        mbedtls_ssl_conf_ca_chain(&s_conf, &s_ca, nullptr);
+        mbedtls_ssl_conf_authmode(&s_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    } else {
+        mbedtls_ssl_conf_authmode(&s_conf, MBEDTLS_SSL_VERIFY_NONE);
+    }
+    session_cache_setup();
+#if HLC_TLS_TICKETS
+    // mbedTLS moves to a fresh key every TLS_TICKET_ROTATE_S and still
+    // accepts tickets sealed with the one before.
+    ret = mbedtls_ssl_ticket_setup(&s_ticket, mbedtls_ctr_drbg_random, &s_drbg, MBEDTLS_CIPHER_AES_256_GCM,
+                                   TLS_TICKET_ROTATE_S);
+    if (ret == 0) {
+        mbedtls_ssl_conf_session_tickets_cb(&s_conf, mbedtls_ssl_ticket_write, ticket_parse, &s_ticket);
+    } else {
+        ESP_LOGW(kTag, "session tickets disabled (-0x%04x)", -ret);
+    }
+#endif
+    return true;
+}
+
+// Blocks until the socket can take more data, at most HLC_SEND_TIMEOUT_MS.
+bool wait_socket(int sock, bool write) {
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+    struct timeval tv;
+    tv.tv_sec = HLC_SEND_TIMEOUT_MS / 1000;
+    tv.tv_usec = (HLC_SEND_TIMEOUT_MS % 1000) * 1000;
+    return select(sock + 1, write ? nullptr : &fds, write ? &fds : nullptr, nullptr, &tv) > 0;
+}
+
+void plain_send_cb(const uint8_t *data, uint16_t len) {
+    size_t offset = 0;
+    while (s_client >= 0 && offset < len) {
+        int written = send(s_client, data + offset, len - offset, 0);
+        if (written > 0) {
+            offset += written;
+            continue;
+        }
+        if (written < 0 && errno == EINTR) continue;
+        if (written < 0 && errno == EAGAIN && wait_socket(s_client, true)) continue;
+        ESP_LOGE(kTag, "send failed (%d), %u of %u bytes sent", errno, (unsigned)offset, len);
+        break;
+    }
+}
+
+void tls_send_cb(const uint8_t *data, uint16_t len) {
+    size_t offset = 0;
+    while (s_state == CLIENT_TLS && offset < len) {
+        int written = mbedtls_ssl_write(&s_ssl, data + offset, len - offset);
+        if (written > 0) {
+            offset += written;
+            continue;
+        }
+        if (written == MBEDTLS_ERR_SSL_WANT_WRITE && wait_socket(s_client, true)) continue;
+        if (written == MBEDTLS_ERR_SSL_WANT_READ && wait_socket(s_client, false)) continue;
+        ESP_LOGE(kTag, "TLS write failed (-0x%04x)", -written);
+        break;
+    }
+}
+
+void client_close() {
+    if (s_state == CLIENT_NONE) return;
+    if (s_state == CLIENT_TLS) mbedtls_ssl_close_notify(&s_ssl);   // best effort, never waits
+    if (s_state == CLIENT_TLS || s_state == CLIENT_HANDSHAKE) mbedtls_ssl_free(&s_ssl);
+    close(s_client);
+    s_client = -1;
+    s_state = CLIENT_NONE;
+    s_want_write = false;
+    tcp_register_socket_sender(nullptr);
+    tcp_transport_reset();
+    ESP_LOGI(kTag, "client disconnected");
+}
+
+// Reads until the socket runs dry. A TLS record larger than s_rx stays
+// buffered inside mbedTLS where select() cannot see it, so TLS reads go on
+// until mbedTLS itself asks for more bytes.
+void client_read() {
+    for (;;) {
+        int received;
+        if (s_state == CLIENT_PLAIN) {
+            received = recv(s_client, s_rx, sizeof(s_rx), 0);
+            if (received < 0 && (errno == EAGAIN || errno == EINTR)) return;
+        } else {
+            received = mbedtls_ssl_read(&s_ssl, s_rx, sizeof(s_rx));
+            if (received == MBEDTLS_ERR_SSL_WANT_READ) return;
+            if (received == MBEDTLS_ERR_SSL_WANT_WRITE) {
+                s_want_write = true;
+                return;
+            }
+        }
+        if (received <= 0) {
+            client_close();
+            return;
+        }
+        tcp_process_socket_payload(s_rx, static_cast<uint16_t>(received));
+        if (s_state == CLIENT_NONE) return;
+    }
+}
+
+void tls_handshake_step() {
+    s_want_write = false;
+    int ret = mbedtls_ssl_handshake(&s_ssl);
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ) return;
+    if (ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        s_want_write = true;
+        return;
+    }
+    if (ret != 0) {
+        ESP_LOGE(kTag, "TLS handshake failed (-0x%04x)", -ret);
+        handshake_done(false);
+        client_close();
+        return;
+    }
+    uint32_t ms = handshake_done(true);
+    ESP_LOGI(kTag, "TLS session up (%s, %s, %u ms)", mbedtls_ssl_get_ciphersuite(&s_ssl),
+             s_resumed == RESUMED_BY_TICKET ? "ticket" : s_resumed == RESUMED_BY_ID ? "resumed" : "full",
+             (unsigned)ms);
+    s_state = CLIENT_TLS;
+    tcp_register_socket_sender(tls_send_cb);
+    tcp_transport_connected();
+    client_read();      // the first request may have come with the Finished flight
+}
+
+void client_accept(int listen_sock, bool tls) {
+    struct sockaddr_in6 addr{};
+    socklen_t addrlen = sizeof(addr);
+    int sock = accept(listen_sock, reinterpret_cast<struct sockaddr *>(&addr), &addrlen);
+    if (sock < 0) return;
+    // tcp.cpp runs a single HLC session: the newest connection wins.
+    client_close();
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    int opt = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    s_client = sock;
+    tcp_transport_reset();
+    if (!tls) {
+        ESP_LOGI(kTag, "plain client connected");
+        s_state = CLIENT_PLAIN;
+        tcp_register_socket_sender(plain_send_cb);
+        tcp_transport_connected();
+        return;
+    }
+    ESP_LOGI(kTag, "TLS client connected");
+    s_state = CLIENT_HANDSHAKE;
+    s_accepted_at = millis();
+    s_resumed = RESUMED_NONE;
+    mbedtls_ssl_init(&s_ssl);
+    int ret = mbedtls_ssl_setup(&s_ssl, &s_conf);
+    if (ret != 0) {
+        ESP_LOGE(kTag, "mbedtls_ssl_setup failed (-0x%04x)", -ret);
+        client_close();
+        return;
+    }
+    s_net.fd = sock;
+    mbedtls_ssl_set_bio(&s_ssl, &s_net, mbedtls_net_send, mbedtls_net_recv, nullptr);
+    tls_handshake_step();
+}
+
+void hlc_server_task(void *) {
+    bool tls = tls_setup();
+    if (!tls) ESP_LOGE(kTag, "TLS endpoint disabled (bad configuration)");
+
+    while (!lwip_bridge_ready()) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+
+    s_plain_listen = listen_on(TCP_PLAIN_PORT);
+    if (tls) s_tls_listen = listen_on(TCP_TLS_PORT);
+    if (s_plain_listen < 0 && s_tls_listen < 0) {
+        vTaskDelete(nullptr);
+        return;
+    }
+    s_tls_ready = s_tls_listen >= 0;
+    ESP_LOGI(kTag, "HLC server listening on %d (plain) and %d (TLS)",
+             s_plain_listen >= 0 ? TCP_PLAIN_PORT : -1, s_tls_listen >= 0 ? TCP_TLS_PORT : -1);
+
+    while (true) {
+        fd_set rd;
+        fd_set wr;
+        FD_ZERO(&rd);
+        FD_ZERO(&wr);
+        if (s_plain_listen >= 0) FD_SET(s_plain_listen, &rd);
+        if (s_tls_listen >= 0) FD_SET(s_tls_listen, &rd);
+        int max_fd = s_plain_listen > s_tls_listen ? s_plain_listen : s_tls_listen;
+        if (s_client >= 0) {
+            FD_SET(s_client, s_want_write ? &wr : &rd);
+            if (s_client > max_fd) max_fd = s_client;
+        }
+        // Nothing runs on a timer here, so wait for the sockets alone.
+        if (select(max_fd + 1, &rd, &wr, nullptr, nullptr) < 0) {
+            if (errno != EINTR) {
+                ESP_LOGE(kTag, "select() failed: %d", errno);
+                vTaskDelay(pdMS_TO_TICKS(10));
+            }
+            continue;
+        }
+        if (s_client >= 0 && (FD_ISSET(s_client, &rd) || FD_ISSET(s_client, &wr))) {
+            if (s_state == CLIENT_HANDSHAKE) {
+                tls_handshake_step();
+            } else {
+                s_want_write = false;
+                client_read();
+            }
+        }
+        if (s_plain_listen >= 0 && FD_ISSET(s_plain_listen, &rd)) client_accept(s_plain_listen, false);
+        if (s_tls_listen >= 0 && FD_ISSET(s_tls_listen, &rd)) client_accept(s_tls_listen, true);
+    }
+}
+}  // namespace
+
+void hlc_server_start(void) {
+    static bool started = false;
+    if (started) return;
+    started = true;
+    xTaskCreatePinnedToCore(hlc_server_task, "hlc15118", HLC_SERVER_TASK_STACK, nullptr,
+                            HLC_SERVER_TASK_PRIORITY, nullptr, HLC_SERVER_TASK_CORE);
+}
+
+bool hlc_server_tls_ready(void) {
+    return s_tls_ready;
+}
+
+void hlc_server_tls_stats(HlcTlsStats *out) {
+    portENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    out->full_avg_ms = s_stats.full ? s_full_total_ms / s_stats.full : 0;
+    out->resumed_avg_ms = s_stats.resumed ? s_resumed_total_ms / s_stats.resumed : 0;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+#endif  // ESP_PLATFORM
@@ -3,7 +3,8 @@
 #include "main.h"
 #include "tcp.h"
 #include "evse_config.h"
-#include "tls_server.h"
+#include "hlc_server.h"
+#include "plc_log.h"
 
 const uint8_t broadcastIPv6[16] = { 0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
 /* our link-local IPv6 address. Based on myMac, but with 0xFFFE in the middle, and bit 1 of MSB inverted */
@@ -63,6 +64,9 @@ static const uint16_t IPV6_PAYLOAD_OFFSET = IPV6_HEADER_OFFSET + IPV6_FIXED_HEAD
 #define PLC_TRACE_IPV6 0
 #endif
 
+// Frame currently being handled by IPv6Manager (a view into the QCA RX burst).
+static const uint8_t *s_rxFrame = nullptr;
+
 static bool isIpv6ExtensionHeader(uint8_t nextHeader) {
     switch (nextHeader) {
         case 0:   // Hop-by-hop
@@ -82,21 +86,21 @@ static bool computeIpv6PayloadMetadata(uint16_t rxbytes, uint8_t *nextHeader, ui
     if (rxbytes < IPV6_PAYLOAD_OFFSET) {
         return false;
     }
-    uint16_t ipv6PayloadLen = (rxbuffer[IPV6_HEADER_OFFSET + 4] << 8) | rxbuffer[IPV6_HEADER_OFFSET + 5];
+    uint16_t ipv6PayloadLen = (s_rxFrame[IPV6_HEADER_OFFSET + 4] << 8) | s_rxFrame[IPV6_HEADER_OFFSET + 5];
     if (rxbytes < IPV6_PAYLOAD_OFFSET + ipv6PayloadLen) {
         return false;
     }
 
     uint16_t offset = IPV6_PAYLOAD_OFFSET;
     uint16_t consumed = 0;
-    uint8_t currentHeader = rxbuffer[IPV6_HEADER_OFFSET + 6];
+    uint8_t currentHeader = s_rxFrame[IPV6_HEADER_OFFSET + 6];
 
     while (isIpv6ExtensionHeader(currentHeader)) {
         if (offset + 2 > IPV6_PAYLOAD_OFFSET + ipv6PayloadLen) {
             return false;
         }
-        uint8_t next = rxbuffer[offset];
-        uint8_t hdrLenUnits = rxbuffer[offset + 1];
+        uint8_t next = s_rxFrame[offset];
+        uint8_t hdrLenUnits = s_rxFrame[offset + 1];
         uint16_t headerBytes = (uint16_t)(hdrLenUnits + 1) * 8;
         if (offset + headerBytes > IPV6_PAYLOAD_OFFSET + ipv6PayloadLen) {
             return false;
@@ -180,7 +184,7 @@ void packResponseIntoEthernet() {
                                                 //  6 bytes source MAC
                                                 //  2 bytes EtherType
     for (i=0; i<6; i++) {       // fill the destination MAC with the source MAC of the received package
-        txbuffer[i] = rxbuffer[6+i];
+        txbuffer[i] = s_rxFrame[6+i];
     }    
     setMacAt(myMac,6); // bytes 6 to 11 are the source MAC
     txbuffer[12] = 0x86; // 86dd is IPv6
@@ -202,7 +206,7 @@ void packResponseIntoIp(void) {
                                               //  #   2 bytes length (incl checksum)
                                               //  #   2 bytes checksum
   if (IpResponseLen > IP_RESPONSE_LEN) {
-      Serial.printf("Error: IPv6 response too large (%u bytes)\n", IpResponseLen);
+      PLC_LOGE("Error: IPv6 response too large (%u bytes)\n", IpResponseLen);
       return;
   }
   IpResponse[0] = 0x60; // # traffic class, flow
@@ -237,7 +241,7 @@ void packResponseIntoUdp(void) {
                                         //           #   2 bytes length (incl checksum)
                                         //           #   2 bytes checksum
     if (UdpResponseLen > UDP_RESPONSE_LEN) {
-        Serial.printf("Error: UDP response too large (%u bytes)\n", UdpResponseLen);
+        PLC_LOGE("Error: UDP response too large (%u bytes)\n", UdpResponseLen);
         return;
     }
     UdpResponse[0] = 15118 >> 8;
@@ -264,7 +268,7 @@ uint16_t buildSdpResponseFrame(uint8_t *out, uint16_t maxLen) {
     const uint16_t payloadLen = 20;
     const uint16_t totalLen = payloadLen + V2GTP_HEADER_SIZE;
     if (maxLen < totalLen) {
-        Serial.printf("Error: SDP payload does not fit in buffer (%u)\n", maxLen);
+        PLC_LOGE("Error: SDP payload does not fit in buffer (%u)\n", maxLen);
         return 0;
     }
 
@@ -292,19 +296,19 @@ bool handleSdpRequestBuffer(const uint8_t *payload, uint16_t len, const uint8_t
     DiscoveryReqTransportProtocol = payload[1];
 
     if (DiscoveryReqTransportProtocol != kSdpTransportTcp) {
-        Serial.printf("DiscoveryReqTransportProtocol %u is not supported\n", DiscoveryReqTransportProtocol);
+        PLC_LOGW("DiscoveryReqTransportProtocol %u is not supported\n", DiscoveryReqTransportProtocol);
         return false;
     }
 
     const bool tlsRequested = (DiscoveryReqSecurity == kSdpSecurityTls);
     const bool plainRequested = (DiscoveryReqSecurity == kSdpSecurityNoTls);
     if (!tlsRequested && !plainRequested) {
-        Serial.printf("DiscoveryReqSecurity %u is not supported\n", DiscoveryReqSecurity);
+        PLC_LOGW("DiscoveryReqSecurity %u is not supported\n", DiscoveryReqSecurity);
         return false;
     }
 
-    if (tlsRequested && !tls_server_ready()) {
-        Serial.println("SDP request asked for TLS but TLS server is not ready yet");
+    if (tlsRequested && !hlc_server_tls_ready()) {
+        PLC_LOGW("SDP request asked for TLS but TLS server is not ready yet\n");
         return false;
     }
 
@@ -313,7 +317,7 @@ bool handleSdpRequestBuffer(const uint8_t *payload, uint16_t len, const uint8_t
     g_activeSeccPort = tlsRequested ? TCP_TLS_PORT : TCP_PLAIN_PORT;
     seccPort = g_activeSeccPort;
 
-    Serial.printf("Ok, SDP request accepted. Selected %s endpoint on port %u\n",
+    PLC_LOGI("Ok, SDP request accepted. Selected %s endpoint on port %u\n",
                   tlsRequested ? "TLS" : "TCP", g_activeSeccPort);
     memcpy(EvccIp, srcIp, 16);
     evccPort = srcPort;
@@ -333,32 +337,32 @@ void evaluateUdpPayload(uint16_t payloadOffset, uint16_t payloadLen) {
     uint32_t v2gptPayloadLen;
 
     if (payloadLen < 8) {
-        Serial.printf("Ignoring UDP frame: payload too short (%u)\n", payloadLen);
+        PLC_LOGW("Ignoring UDP frame: payload too short (%u)\n", payloadLen);
         return;
     }
 
-    sourceport = (rxbuffer[payloadOffset] << 8) | rxbuffer[payloadOffset + 1];
-    destinationport = (rxbuffer[payloadOffset + 2] << 8) | rxbuffer[payloadOffset + 3];
-    udplen = (rxbuffer[payloadOffset + 4] << 8) | rxbuffer[payloadOffset + 5];
-    udpsum = (rxbuffer[payloadOffset + 6] << 8) | rxbuffer[payloadOffset + 7];
+    sourceport = (s_rxFrame[payloadOffset] << 8) | s_rxFrame[payloadOffset + 1];
+    destinationport = (s_rxFrame[payloadOffset + 2] << 8) | s_rxFrame[payloadOffset + 3];
+    udplen = (s_rxFrame[payloadOffset + 4] << 8) | s_rxFrame[payloadOffset + 5];
+    udpsum = (s_rxFrame[payloadOffset + 6] << 8) | s_rxFrame[payloadOffset + 7];
 
     if (udplen > payloadLen) {
-        Serial.printf("Ignoring UDP frame: length mismatch (%u > %u)\n", udplen, payloadLen);
+        PLC_LOGW("Ignoring UDP frame: length mismatch (%u > %u)\n", udplen, payloadLen);
         return;
     }
 
     if (udplen < 8) {
-        Serial.printf("Ignoring UDP frame: invalid header length\n");
+        PLC_LOGW("Ignoring UDP frame: invalid header length\n");
         return;
     }
 
     udpPayloadLen = udplen - 8;
     if (udpPayloadLen > UDP_PAYLOAD_LEN) {
-        Serial.printf("Ignoring UDP payload: %u exceeds buffer\n", udpPayloadLen);
+        PLC_LOGW("Ignoring UDP payload: %u exceeds buffer\n", udpPayloadLen);
         return;
     }
 
-    memcpy(udpPayload, rxbuffer + payloadOffset + 8, udpPayloadLen);
+    memcpy(udpPayload, s_rxFrame + payloadOffset + 8, udpPayloadLen);
 
     if (destinationport == 15118) { // port for the SECC
         if ((udpPayloadLen >= 2) && (udpPayload[0] == 0x01) && (udpPayload[1] == 0xFE)) { //# protocol version 1 and inverted
@@ -368,14 +372,14 @@ void evaluateUdpPayload(uint16_t payloadOffset, uint16_t payloadLen) {
                               (((uint32_t)udpPayload[6])<<8) +
                               udpPayload[7];
             if (v2gptPayloadType == 0x9000) {
-                Serial.printf("it is a SDP request from the car to the charger\n");
+                PLC_LOGD("it is a SDP request from the car to the charger\n");
                 if (handleSdpRequestBuffer(udpPayload+8, v2gptPayloadLen, sourceIp, sourceport)) {
                     sendSdpResponse();
                 } else {
-                    Serial.printf("SDP request ignored\n");
+                    PLC_LOGW("SDP request ignored\n");
                 }
             } else {    
-                Serial.printf("v2gptPayloadType %04x not supported\n", v2gptPayloadType);
+                PLC_LOGW("v2gptPayloadType %04x not supported\n", v2gptPayloadType);
             }                  
         }
     }
@@ -415,9 +419,9 @@ void evaluateNeighborSolicitation(void) {
         by the SDP. */
         
     /* save the requesters IP. The requesters IP is the source IP on IPv6 level, at byte 22. */
-    memcpy(NeighborsIp, rxbuffer+22, 16);
+    memcpy(NeighborsIp, s_rxFrame+22, 16);
     /* save the requesters MAC. The requesters MAC is the source MAC on Eth level, at byte 6. */
-    memcpy(NeighborsMac, rxbuffer+6, 6);
+    memcpy(NeighborsMac, s_rxFrame+6, 6);
     
     /* send a NeighborAdvertisement as response. */
     // destination MAC = neighbors MAC
@@ -461,42 +465,44 @@ void evaluateNeighborSolicitation(void) {
     txbuffer[56] = checksum >> 8;
     txbuffer[57] = checksum & 0xFF;
     
-    Serial.printf("transmitting Neighbor Advertisement\n");
+    PLC_LOGD("transmitting Neighbor Advertisement\n");
     /* Length of the NeighborAdvertisement = 86*/
     qcaspi_write_burst(txbuffer, 86);
 }
 
 
-void IPv6Manager(uint16_t rxbytes) {
+void IPv6Manager(const uint8_t *frame, uint16_t rxbytes) {
     uint16_t payloadOffset;
     uint16_t payloadLen;
     uint8_t nextheader; 
     uint8_t icmpv6type; 
 
+    s_rxFrame = frame;
+
 #if PLC_TRACE_IPV6
     Serial.printf("\n[RX] ");
-    for (uint16_t x=0; x<rxbytes; x++) Serial.printf("%02x",rxbuffer[x]);
+    for (uint16_t x=0; x<rxbytes; x++) Serial.printf("%02x",s_rxFrame[x]);
     Serial.printf("\n");
 #endif
 
     if (!computeIpv6PayloadMetadata(rxbytes, &nextheader, &payloadOffset, &payloadLen)) {
-        Serial.printf("Ignoring malformed IPv6 frame (len=%u)\n", rxbytes);
+        PLC_LOGW("Ignoring malformed IPv6 frame (len=%u)\n", rxbytes);
         return;
     }
 
-    memcpy(sourceIp, rxbuffer+IPV6_HEADER_OFFSET+8, 16);
+    memcpy(sourceIp, s_rxFrame+IPV6_HEADER_OFFSET+8, 16);
 
     if (nextheader == NEXT_UDP) {
         evaluateUdpPayload(payloadOffset, payloadLen);
     } else if (nextheader == 0x06) {
-        Serial.printf("TCP received\n");
-        evaluateTcpPacket(payloadOffset, payloadLen);
+        PLC_LOGD("TCP received\n");
+        evaluateTcpPacket(s_rxFrame + payloadOffset, payloadLen);
     } else if (nextheader == NEXT_ICMPv6) {
-        Serial.printf("ICMPv6 received\n");
+        PLC_LOGD("ICMPv6 received\n");
         if (payloadLen == 0) return;
-        icmpv6type = rxbuffer[payloadOffset];
+        icmpv6type = s_rxFrame[payloadOffset];
         if (icmpv6type == 0x87 && payloadOffset == IPV6_PAYLOAD_OFFSET) {
-            Serial.printf("Neighbor Solicitation received\n");
+            PLC_LOGD("Neighbor Solicitation received\n");
             evaluateNeighborSolicitation();
         }
     }
@@ -3,12 +3,14 @@
 #include <Arduino.h>
 #include <string.h>
 
+#include "evse_config.h"
 #include "main.h"
 
 static bool s_bridge_ready = false;
 
 #ifdef ESP_PLATFORM
 #include "esp_netif.h"
+#include "freertos/FreeRTOS.h"
 #include "lwip/netif.h"
 #include "lwip/tcpip.h"
 #include "lwip/pbuf.h"
@@ -16,21 +18,186 @@ static bool s_bridge_ready = false;
 #include "lwip/etharp.h"
 #include "lwip/ethip6.h"
 
+#include "bridge_queue.h"
+#include "qca_rx_pool.h"
+
+#if !LWIP_SUPPORT_CUSTOM_PBUF
+#error "lwip_bridge lends RX frames to lwIP as custom pbufs"
+#endif
+
+static_assert(QCA_RX_BUFFER_BYTES >= QCA7K_BUFFER_SIZE, "a pool buffer must hold a full RDBUF burst");
+
+// RX: the SPI task wraps each IPv6 frame in a pbuf and queues it; at the end
+// of a burst one tcpip_try_callback() hands the whole batch to the tcpip
+// thread, which feeds it to ethernet_input(). TX: lwIP output goes straight
+// into a QCA TX slot, or waits in the TX queue (holding a pbuf reference)
+// while the slots are full until lwip_bridge_poll() schedules a retry.
+//
+// A frame lent to lwIP is freed by whichever task drops the last reference
+// (tcpip thread or a socket reader), hence the spinlock around the pool, the
+// wrappers and the queues.
+struct RxPbuf {
+    struct pbuf_custom pc;      // first: lwIP hands back the struct pbuf
+    int8_t buffer;              // pool index, -1 while the wrapper is free
+};
+
+struct RateWindow {
+    uint32_t start_ms;
+    uint32_t bytes;
+};
+
 static struct netif s_qca_netif;
 static bool s_tcpip_started = false;
+static QcaRxPool s_rx_pool;
+static RxPbuf s_rx_pbufs[QCA_RX_POOL_PBUFS];
+static portMUX_TYPE s_rx_lock = portMUX_INITIALIZER_UNLOCKED;
+static LwipBridgeStats s_stats;
+static RateWindow s_rx_rate;
+static RateWindow s_tx_rate;
+static BridgeQueue s_rx_queue;
+static BridgeQueue s_tx_queue;
+static bool s_rx_posted = false;    // an rx_pump() call is waiting in the tcpip mailbox
+static bool s_tx_posted = false;
 
-static err_t qca_linkoutput(struct netif *netif, struct pbuf *p) {
+static void rate_add(RateWindow *w, uint32_t *bytes_per_s, uint32_t len) {
+    uint32_t now = millis();
+    if (w->start_ms == 0) w->start_ms = now;
+    w->bytes += len;
+    uint32_t elapsed = now - w->start_ms;
+    if (elapsed >= 1000) {
+        *bytes_per_s = (uint32_t)(((uint64_t)w->bytes * 1000u) / elapsed);
+        w->start_ms = now;
+        w->bytes = 0;
+    }
+}
+
+static void rx_pbuf_free(struct pbuf *p) {
+    RxPbuf *r = reinterpret_cast<RxPbuf *>(p);
+    portENTER_CRITICAL(&s_rx_lock);
+    qca_rx_pool_unref(&s_rx_pool, r->buffer);
+    r->buffer = -1;
+    s_stats.pbufs_in_use--;
+    portEXIT_CRITICAL(&s_rx_lock);
+}
+
+// Wraps a frame lying in a pool buffer; nullptr when it does not, or when
+// every wrapper is lent out already.
+static struct pbuf *rx_pbuf_lend(const uint8_t *frame, uint16_t len) {
+    int8_t buffer = qca_rx_pool_index(&s_rx_pool, frame);
+    if (buffer < 0) return nullptr;
+    RxPbuf *r = nullptr;
+    portENTER_CRITICAL(&s_rx_lock);
+    for (uint8_t i = 0; i < QCA_RX_POOL_PBUFS && !r; i++) {
+        if (s_rx_pbufs[i].buffer < 0) r = &s_rx_pbufs[i];
+    }
+    if (r) {
+        r->buffer = buffer;
+        qca_rx_pool_ref(&s_rx_pool, buffer);
+        s_stats.pbufs_in_use++;
+    }
+    portEXIT_CRITICAL(&s_rx_lock);
+    if (!r) return nullptr;
+    r->pc.custom_free_function = rx_pbuf_free;
+    // PBUF_REF: lwIP works on the frame where it is. Header handling and IPv6
+    // reassembly write into it, but only within these len bytes, which nothing
+    // else touches until the pool buffer's last reference is dropped.
+    return pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &r->pc, const_cast<uint8_t *>(frame), len);
+}
+
+// Copies a frame into a QCA TX slot: the only copy on the way out, the SPI
+// driver clocks the slot out in place.
+static bool tx_to_slot(struct pbuf *p) {
     uint16_t len = p->tot_len;
-    if (len > QCA7K_BUFFER_SIZE) {
-        return ERR_MEM;
+    uint8_t *slot = qcaspi_tx_reserve(len);
+    if (!slot) return false;
+    if (pbuf_copy_partial(p, slot, len, 0) != len) {
+        qcaspi_tx_cancel();
+        return false;
     }
-    if (pbuf_copy_partial(p, txbuffer, len, 0) != len) {
-        return ERR_BUF;
+    qcaspi_tx_commit(len);
+    s_stats.tx_frames++;
+    s_stats.tx_bytes += len;
+    rate_add(&s_tx_rate, &s_stats.tx_bytes_per_s, len);
+    return true;
+}
+
+// tcpip thread. Frames already waiting keep their place ahead of new ones.
+static err_t qca_linkoutput(struct netif *netif, struct pbuf *p) {
+    (void)netif;
+    portENTER_CRITICAL(&s_rx_lock);
+    bool backlog = s_tx_queue.count != 0;
+    portEXIT_CRITICAL(&s_rx_lock);
+    if (!backlog && tx_to_slot(p)) return ERR_OK;
+    // TCP leaves a segment that is still referenced here alone until it is sent.
+    pbuf_ref(p);
+    portENTER_CRITICAL(&s_rx_lock);
+    bool queued = bridge_queue_push(&s_tx_queue, p);
+    portEXIT_CRITICAL(&s_rx_lock);
+    if (!queued) {
+        pbuf_free(p);
+        return ERR_MEM;
     }
-    qcaspi_write_burst(txbuffer, len);
+    s_stats.tx_queued++;
     return ERR_OK;
 }
 
+// tcpip thread: moves queued output into TX slots while they last.
+static void tx_pump(void *ctx) {
+    (void)ctx;
+    portENTER_CRITICAL(&s_rx_lock);
+    s_tx_posted = false;
+    portEXIT_CRITICAL(&s_rx_lock);
+    for (;;) {
+        portENTER_CRITICAL(&s_rx_lock);
+        struct pbuf *p = static_cast<struct pbuf *>(bridge_queue_peek(&s_tx_queue));
+        portEXIT_CRITICAL(&s_rx_lock);
+        if (!p || !tx_to_slot(p)) return;
+        portENTER_CRITICAL(&s_rx_lock);
+        bridge_queue_pop(&s_tx_queue);
+        portEXIT_CRITICAL(&s_rx_lock);
+        pbuf_free(p);
+    }
+}
+
+// tcpip thread: one call per burst feeds every queued frame to ethernet_input().
+static void rx_pump(void *ctx) {
+    (void)ctx;
+    uint8_t batch = 0;
+    portENTER_CRITICAL(&s_rx_lock);
+    s_rx_posted = false;
+    portEXIT_CRITICAL(&s_rx_lock);
+    for (;;) {
+        portENTER_CRITICAL(&s_rx_lock);
+        struct pbuf *p = static_cast<struct pbuf *>(bridge_queue_pop(&s_rx_queue));
+        portEXIT_CRITICAL(&s_rx_lock);
+        if (!p) break;
+        batch++;
+        if (s_qca_netif.input(p, &s_qca_netif) != ERR_OK) {
+            pbuf_free(p);
+            portENTER_CRITICAL(&s_rx_lock);
+            s_stats.rx_dropped++;
+            portEXIT_CRITICAL(&s_rx_lock);
+        }
+    }
+    if (!batch) return;
+    s_stats.rx_handoffs++;
+    if (batch > s_stats.rx_max_batch) s_stats.rx_max_batch = batch;
+}
+
+// Schedules pump() on the tcpip thread when q has work and no call is
+// pending. A full tcpip mailbox leaves the work for the next poll.
+static void bridge_handoff(BridgeQueue *q, bool *posted, tcpip_callback_fn pump) {
+    portENTER_CRITICAL(&s_rx_lock);
+    bool post = q->count && !*posted;
+    if (post) *posted = true;
+    portEXIT_CRITICAL(&s_rx_lock);
+    if (!post || tcpip_try_callback(pump, nullptr) == ERR_OK) return;
+    portENTER_CRITICAL(&s_rx_lock);
+    *posted = false;
+    s_stats.handoff_failed++;
+    portEXIT_CRITICAL(&s_rx_lock);
+}
+
 static err_t qca_netif_init(struct netif *netif) {
     netif->hwaddr_len = 6;
     memcpy(netif->hwaddr, myMac, 6);
@@ -52,7 +219,12 @@ void lwip_bridge_init() {
         tcpip_init(nullptr, nullptr);
         s_tcpip_started = true;
     }
-    netif_add(&s_qca_netif, nullptr, nullptr, nullptr, nullptr, qca_netif_init, tcpip_input);
+    qca_rx_pool_reset(&s_rx_pool);
+    for (uint8_t i = 0; i < QCA_RX_POOL_PBUFS; i++) s_rx_pbufs[i].buffer = -1;
+    bridge_queue_init(&s_rx_queue, LWIP_BRIDGE_RX_QUEUE);
+    bridge_queue_init(&s_tx_queue, LWIP_BRIDGE_TX_QUEUE);
+    // Frames reach the netif from rx_pump(), already on the tcpip thread.
+    netif_add(&s_qca_netif, nullptr, nullptr, nullptr, nullptr, qca_netif_init, ethernet_input);
     netif_set_default(&s_qca_netif);
     netif_set_up(&s_qca_netif);
     netif_set_link_up(&s_qca_netif);
@@ -64,27 +236,89 @@ void lwip_bridge_init() {
 }
 
 void lwip_bridge_poll() {
-    // Placeholder for future TX/RX queue handling.
+#ifdef ESP_PLATFORM
+    if (!s_bridge_ready) return;
+    bridge_handoff(&s_rx_queue, &s_rx_posted, rx_pump);
+    bridge_handoff(&s_tx_queue, &s_tx_posted, tx_pump);
+#endif
 }
 
 bool lwip_bridge_ready() {
     return s_bridge_ready;
 }
 
+uint8_t *lwip_bridge_rx_begin() {
+#if defined(ESP_PLATFORM) && IPV6_STACK_LWIP
+    if (!s_bridge_ready) return nullptr;
+    portENTER_CRITICAL(&s_rx_lock);
+    uint8_t *burst = qca_rx_pool_take(&s_rx_pool);
+    portEXIT_CRITICAL(&s_rx_lock);
+    return burst;
+#else
+    return nullptr;
+#endif
+}
+
+void lwip_bridge_rx_end(uint8_t *burst) {
+#ifdef ESP_PLATFORM
+    if (!s_bridge_ready) return;
+    bridge_handoff(&s_rx_queue, &s_rx_posted, rx_pump);
+    int8_t buffer = qca_rx_pool_index(&s_rx_pool, burst);
+    if (buffer < 0) return;
+    portENTER_CRITICAL(&s_rx_lock);
+    qca_rx_pool_unref(&s_rx_pool, buffer);
+    portEXIT_CRITICAL(&s_rx_lock);
+#else
+    (void)burst;
+#endif
+}
+
 void lwip_bridge_on_frame(const uint8_t *frame, uint16_t len) {
 #ifdef ESP_PLATFORM
     if (!s_bridge_ready || !frame || len == 0) return;
-    struct pbuf *p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
-    if (!p) return;
-    if (pbuf_take(p, frame, len) != ERR_OK) {
-        pbuf_free(p);
-        return;
-    }
-    if (s_qca_netif.input(p, &s_qca_netif) != ERR_OK) {
-        pbuf_free(p);
+    s_stats.rx_frames++;
+    s_stats.rx_bytes += len;
+    rate_add(&s_rx_rate, &s_stats.rx_bytes_per_s, len);
+    struct pbuf *p = rx_pbuf_lend(frame, len);
+    if (p) {
+        s_stats.rx_by_ref++;
+    } else {
+        p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+        if (p && pbuf_take(p, frame, len) != ERR_OK) {
+            pbuf_free(p);
+            p = nullptr;
+        }
+        if (!p) {
+            portENTER_CRITICAL(&s_rx_lock);
+            s_stats.rx_dropped++;
+            portEXIT_CRITICAL(&s_rx_lock);
+            return;
+        }
+        s_stats.rx_copied++;
     }
+    portENTER_CRITICAL(&s_rx_lock);
+    bool queued = bridge_queue_push(&s_rx_queue, p);
+    portEXIT_CRITICAL(&s_rx_lock);
+    if (!queued) pbuf_free(p);     // counted as rx_overflow
 #else
     (void)frame;
     (void)len;
 #endif
 }
+
+void lwip_bridge_stats(LwipBridgeStats *out) {
+#ifdef ESP_PLATFORM
+    portENTER_CRITICAL(&s_rx_lock);
+    *out = s_stats;
+    out->pool_exhausted = s_rx_pool.stats.exhausted;
+    out->pool_in_use = s_rx_pool.stats.in_use;
+    out->pool_high_water = s_rx_pool.stats.high_water;
+    out->rx_overflow = s_rx_queue.stats.overflow;
+    out->rx_queue_high_water = s_rx_queue.stats.high_water;
+    out->tx_overflow = s_tx_queue.stats.overflow;
+    out->tx_queue_high_water = s_tx_queue.stats.high_water;
+    portEXIT_CRITICAL(&s_rx_lock);
+#else
+    memset(out, 0, sizeof(*out));
+#endif
+}
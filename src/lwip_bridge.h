@@ -4,25 +4,70 @@
 #include <stdint.h>
 
 /**
- * Lightweight scaffold for the eventual QCA700x ↔ lwIP integration.
- * For now, the functions are stubs so that the rest of the firmware can
- * start invoking them without impacting current behavior.
+ * QCA700x ↔ lwIP glue. IPv6 frames from the modem reach lwIP as custom pbufs
+ * that point into the RDBUF burst buffer they were read into, so ingress
+ * costs no copy. They are queued by the SPI task and handed to the tcpip
+ * thread once per burst, so the modem is never kept waiting on lwIP. Frames
+ * lwIP sends are copied once, into a TX queue slot that the SPI driver clocks
+ * out as it is; while the slots are full they wait in a bounded TX queue.
+ * With IPV6_STACK_LWIP the frames go to lwIP only, otherwise to the raw
+ * IPv6Manager() stack only.
  */
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+struct LwipBridgeStats {
+    uint32_t rx_frames;
+    uint32_t rx_by_ref;         // handed to lwIP in place, no copy
+    uint32_t rx_copied;         // copied into a PBUF_POOL pbuf (no pool buffer or wrapper free)
+    uint32_t rx_dropped;        // no pbuf, or lwIP refused the frame
+    uint32_t rx_overflow;       // RX queue full
+    uint32_t rx_handoffs;       // batches passed to the tcpip thread
+    uint32_t rx_bytes;
+    uint32_t rx_bytes_per_s;
+    uint32_t tx_frames;
+    uint32_t tx_bytes;
+    uint32_t tx_bytes_per_s;
+    uint32_t tx_queued;         // waited in the TX queue for a QCA slot
+    uint32_t tx_overflow;       // TX queue full as well: ERR_MEM to lwIP
+    uint32_t handoff_failed;    // tcpip mailbox full; retried by lwip_bridge_poll()
+    uint8_t rx_max_batch;
+    uint8_t rx_queue_high_water;
+    uint8_t tx_queue_high_water;
+    uint32_t pool_exhausted;    // RDBUF reads that found no free pool buffer and used rxbuffer
+    uint8_t pool_in_use;
+    uint8_t pool_high_water;
+    uint8_t pbufs_in_use;       // frames lwIP still holds by reference
+};
+
 /** Initialize lwIP/QCA bridge. Safe to call even if lwIP is not yet enabled. */
 void lwip_bridge_init();
 
-/** Poll routine to be called from the 20 ms task once lwIP is enabled. */
+/**
+ * Hands queued RX frames and TX backlog to the tcpip thread when no call is
+ * pending. Called by the protocol task and after every SPI TX flush.
+ */
 void lwip_bridge_poll();
 
 /** Returns true once the lwIP bridge has brought up the IPv6 netif. */
 bool lwip_bridge_ready();
+
+/**
+ * Burst buffer for the next RDBUF read, or nullptr when every pool buffer is
+ * still referenced by lwIP (read into rxbuffer then; its frames get copied)
+ * or IPv6 goes to the raw stack. Pair with lwip_bridge_rx_end() once the
+ * frames of the burst are dispatched; it hands them to the tcpip thread.
+ */
+uint8_t *lwip_bridge_rx_begin();
+void lwip_bridge_rx_end(uint8_t *burst);
+
+/** Queues an IPv6 frame for lwIP: by reference when it lies in a pool buffer. */
 void lwip_bridge_on_frame(const uint8_t *frame, uint16_t len);
 
+void lwip_bridge_stats(LwipBridgeStats *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,7 +30,6 @@
 
 
 #include <Arduino.h>
-#include <SPI.h>
 #ifndef UNIT_TEST
 #include <ArduinoJson.h>
 #include <mbedtls/base64.h>
@@ -43,6 +42,7 @@
 #if __has_include("freertos/FreeRTOS.h")
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #endif
 
 #include "main.h"
@@ -53,32 +53,25 @@
 #include "dc_can.h"
 #include "lwip_bridge.h"
 #include "sdp_server.h"
-#include "tcp_socket_server.h"
 #include "pki_store.h"
-#include "tls_server.h"
+#include "hlc_server.h"
 #include "tls_credentials.h"
 #include "iso15118_dc.h"
 #include "diag_auth.h"
 #include "iso_watchdog.h"
+#include "qca_frame.h"
+#include "qca_spi.h"
+#include "perf_probe.h"
+#include "qca_tx_queue.h"
+#include "task_monitor.h"
+#include "plc_log.h"
+#include "nmk_pool.h"
+#include "slac_frames.h"
+#include "slac_session.h"
 
 
 uint8_t txbuffer[3164], rxbuffer[3164];
-uint8_t modem_state;
 uint8_t myMac[6]; // the MAC of the EVSE (derived from the ESP32's MAC).
-uint8_t pevMac[6]; // the MAC of the PEV.
-uint8_t myModemMac[6]; // our own modem's MAC (this is different from myMAC !). Unused.
-uint8_t pevModemMac[6]; // the MAC of the PEV's modem (obtained with GetSwReq). Could this be used to identify the EV?
-uint8_t pevRunId[8]; // pev RunId. Received from the PEV in the CM_SLAC_PARAM.REQ message.
-uint16_t AvgACVar[58]; // Average AC Variable Field. (used in CM_ATTEN_PROFILE.IND)
-uint8_t NMK[16]; // Network Key. Will be initialized with a random key on each session.
-uint8_t NID[] = {1, 2, 3, 4, 5, 6, 7}; // a default network ID. MSB bits 6 and 7 need to be 0.
-unsigned long SoundsTimer = 0;
-unsigned long ModemSearchTimer = 0;
-unsigned long AttenCharResponseTimer = 0;
-unsigned long SlacMatchTimer = 0;
-uint8_t ModemsFound = 0;
-uint8_t ReceivedSounds = 0;
-uint8_t ReceivedProfiles = 0;
 uint8_t EVCCID[6];  // Mac address or ID from the PEV, used in V2G communication
 uint8_t EVSOC = 0;  // State Of Charge of the EV, obtained from the 'ContractAuthenticationRequest' message
 
@@ -90,162 +83,159 @@ static bool cli_decode_base64(const String &src, std::string &out);
 static bool cli_encode_base64(const std::string &src, std::string &out);
 #endif
 
-const uint8_t MAX_SUPPORTED_SOUND_COUNT = 20;
-const uint8_t SLAC_MAX_RETRIES = 3;
-const uint8_t ATTEN_CHAR_MAX_RETRIES = 3;
-const uint16_t ATTEN_CHAR_IND_FRAME_LEN = 130;
-const uint32_t ATTEN_CHAR_RESPONSE_TIMEOUT_MS = 500;
-const uint32_t DEFAULT_SLAC_MATCH_TIMEOUT_MS = 2000;
-const uint32_t SLAC_MATCH_TIMEOUT_MARGIN_MS = 1000;
-const uint32_t MIN_SOUND_WINDOW_MS = 200;
-const uint32_t SOUND_TIMEOUT_UNIT_MS = 100;
-const uint16_t EXPECTED_MATCH_MVF_LEN = 0x003E;
 const uint8_t INVALID_FRAME_THRESHOLD = 3;
 
-uint8_t requestedSoundCount = 10;
-uint8_t negotiatedSoundCount = 10;
-uint8_t negotiatedSoundTimeoutField = 0x06;
-uint32_t currentSoundWindowMs = 600;
-uint32_t currentMatchWindowMs = DEFAULT_SLAC_MATCH_TIMEOUT_MS;
-uint8_t slacRetryCounter = 0;
-uint8_t attenCharRetryCounter = 0;
 uint8_t invalidFrameCounter = 0;
-bool pendingSessionKeyRotation = false;
 bool lastCpConnected = false;
+const uint8_t QCA_RX_MAX_BURSTS_PER_SERVICE = 4;
+const uint16_t QCA_TX_FRAME_OVERHEAD = 10;   // SOF, FL, RSVD, EOF around each written frame
+
+// The QcaSpi task owns the modem data path: it drains the read buffer and
+// flushes the TX queue. With QCA_RX_IRQ_ENABLE=1 the PIN_QCA700X_INT edge
+// wakes it, otherwise the protocol task kicks it every tick (legacy polling cadence).
+static bool g_qca_rx_irq_mode = QCA_RX_IRQ_ENABLE;
+static TaskHandle_t g_qca_spi_task = nullptr;
+static SemaphoreHandle_t g_qca_lock = nullptr;   // SPI bus + SLAC/legacy TCP state
+static SemaphoreHandle_t g_qca_tx_lock = nullptr; // TX queue only, never held across SPI
+static unsigned long g_qca_rx_last_service = 0;
+static int g_qca_spi_monitor = -1;
+static QcaTxQueue g_qca_tx;
+static const QcaSpiBus *g_qca_bus = qca_spi_default_bus();
+static uint16_t g_qca_wrbuf_space = 0;           // last known modem write space
+static uint16_t g_qca_intr_mask = 0;             // INTR_ENABLE value while the task is idle
+static bool g_qca_tx_wait_wm = false;            // TX stalled, WRBUF_BELOW_WM armed
+static uint8_t g_qca_buf_err_streak = 0;
+static QcaIrqStats g_qca_irq_stats;
+
+// SLAC session of the outlet behind this QCA7005; its frames go through the TX queue.
+static void slac_port_write(void *ctx, const uint8_t *frame, uint16_t len) {
+    (void)ctx;
+    qcaspi_write_burst(frame, len);
+}
+static const SlacSessionPort g_slac_port = {slac_port_write, nullptr};
+static SlacSession g_slac;
 #ifdef UNIT_TEST
 static void (*g_slac_test_tx_hook)(const uint8_t *, uint32_t) = nullptr;
+static uint32_t (*g_slac_test_rx_hook)(uint8_t *, uint32_t) = nullptr;
 #endif
 
+static void qca_lock() {
+    if (g_qca_lock) xSemaphoreTakeRecursive(g_qca_lock, portMAX_DELAY);
+}
 
-void SPI_InterruptHandler() { // Interrupt handler is currently unused
-
-    volatile uint16_t rx_data;
-
-    // Write zero into the SPI_REG_INTR_ENABLE register
-    digitalWrite(PIN_QCA700X_CS, LOW);
-    SPI.transfer16(QCA7K_SPI_WRITE | QCA7K_SPI_INTERNAL | SPI_REG_INTR_ENABLE);
-    SPI.transfer16(0);                  // write the value to the bus
-    digitalWrite(PIN_QCA700X_CS, HIGH);
-    // Read the Interrupt Cause register
-    digitalWrite(PIN_QCA700X_CS, LOW);
-    SPI.transfer16(QCA7K_SPI_READ | QCA7K_SPI_INTERNAL | SPI_REG_INTR_CAUSE);
-    rx_data = SPI.transfer16(0x0000);   // read the reason of the interrrupt
-    digitalWrite(PIN_QCA700X_CS, HIGH);
-    // Write contents back to Interrupt Cause register
-    digitalWrite(PIN_QCA700X_CS, LOW);
-    SPI.transfer16(QCA7K_SPI_WRITE | QCA7K_SPI_INTERNAL | SPI_REG_INTR_CAUSE);
-    SPI.transfer16(rx_data);   
-    digitalWrite(PIN_QCA700X_CS, HIGH);
-
-    
+static void qca_unlock() {
+    if (g_qca_lock) xSemaphoreGiveRecursive(g_qca_lock);
+}
 
+static void qca_tx_lock() {
+    if (g_qca_tx_lock) xSemaphoreTake(g_qca_tx_lock, portMAX_DELAY);
+}
 
-    // Re-enable Packet Available interrupt
-    digitalWrite(PIN_QCA700X_CS, LOW);
-    SPI.transfer16(QCA7K_SPI_WRITE | QCA7K_SPI_INTERNAL | SPI_REG_INTR_ENABLE);
-    SPI.transfer16(SPI_INT_PKT_AVLBL);   
-    digitalWrite(PIN_QCA700X_CS, HIGH);
+static void qca_tx_unlock() {
+    if (g_qca_tx_lock) xSemaphoreGive(g_qca_tx_lock);
+}
 
+static void qca_spi_kick() {
+    if (g_qca_spi_task) xTaskNotifyGive(g_qca_spi_task);
 }
 
 uint16_t qcaspi_read_register16(uint16_t reg) {
-    uint16_t tx_data;
-    uint16_t rx_data;
-
-    tx_data = QCA7K_SPI_READ | QCA7K_SPI_INTERNAL | reg;
-    
-    digitalWrite(PIN_QCA700X_CS, LOW);
-    SPI.transfer16(tx_data);                // send the command to read the internal register
-    rx_data = SPI.transfer16(0x0000);       // read the data on the bus
-    digitalWrite(PIN_QCA700X_CS, HIGH);
-
-    return rx_data;
+    return g_qca_bus->read_register(reg);
 }
 
 void qcaspi_write_register(uint16_t reg, uint16_t value) {
-    uint16_t tx_data;
+    g_qca_bus->write_register(reg, value);
+}
 
-    tx_data = QCA7K_SPI_WRITE | QCA7K_SPI_INTERNAL | reg;
+// Producer side of the TX queue. reserve() keeps the queue locked until the
+// matching commit()/cancel(), so the caller can fill the slot in place.
+uint8_t *qcaspi_tx_reserve(uint16_t len) {
+    qca_tx_lock();
+    uint8_t *slot = qca_tx_queue_reserve(&g_qca_tx, len);
+    if (!slot) qca_tx_unlock();
+    return slot;
+}
 
-    digitalWrite(PIN_QCA700X_CS, LOW);
-    SPI.transfer16(tx_data);                // send the command to write the internal register
-    SPI.transfer16(value);                  // write the value to the bus
-    digitalWrite(PIN_QCA700X_CS, HIGH);
+void qcaspi_tx_commit(uint16_t len) {
+    qca_tx_queue_commit(&g_qca_tx, len);
+    qca_tx_unlock();
+    qca_spi_kick();
+}
 
+void qcaspi_tx_cancel(void) {
+    qca_tx_unlock();
 }
 
-void qcaspi_write_burst(uint8_t *src, uint32_t len) {
+void qcaspi_tx_stats(QcaTxStats *out) {
+    qca_tx_lock();
+    *out = g_qca_tx.stats;
+    qca_tx_unlock();
+}
+
+void qcaspi_write_burst(const uint8_t *src, uint32_t len) {
 #ifdef UNIT_TEST
     if (g_slac_test_tx_hook) {
         g_slac_test_tx_hook(src, len);
         return;
     }
 #endif
-    uint16_t total_len;
-    uint8_t buf[10];
-
-    buf[0] = 0xAA;
-	  buf[1] = 0xAA;
-	  buf[2] = 0xAA;
-	  buf[3] = 0xAA;
-	  buf[4] = (uint8_t)((len >> 0) & 0xFF);
-	  buf[5] = (uint8_t)((len >> 8) & 0xFF);
-	  buf[6] = 0;
-	  buf[7] = 0;
-
-    total_len = len + 10;
-    // Write nr of bytes to write to SPI_REG_BFR_SIZE
-    qcaspi_write_register(SPI_REG_BFR_SIZE, total_len);
-    //Serial.printf("Write buffer bytes sent: %u\n", total_len);
-
-//    Serial.print("[TX] ");
-//    for(int x=0; x< len; x++) Serial.printf("%02x ",src[x]);
-//    Serial.printf("\n");
-    
-    digitalWrite(PIN_QCA700X_CS, LOW);
-    SPI.transfer16(QCA7K_SPI_WRITE | QCA7K_SPI_EXTERNAL);      // Write External
-    SPI.transfer(buf, 8);     // Header
-    SPI.transfer(src, len);   // Data
-    SPI.transfer16(0x5555);   // Footer
-    digitalWrite(PIN_QCA700X_CS, HIGH);
+    uint8_t *slot = qcaspi_tx_reserve((uint16_t)len);
+    if (!slot) {
+        PLC_LOGW("QCA TX queue full, dropping %u byte frame\n", (unsigned)len);
+        return;
+    }
+    memcpy(slot, src, len);
+    qcaspi_tx_commit((uint16_t)len);
 }
 
-uint32_t qcaspi_read_burst(uint8_t *dst) {
-    uint16_t available;
-
-    available = qcaspi_read_register16(SPI_REG_RDBUF_BYTE_AVA);
-
-    if (available && available <= QCA7K_BUFFER_SIZE) {    // prevent buffer overflow
-        // Write nr of bytes to read to SPI_REG_BFR_SIZE
-        qcaspi_write_register(SPI_REG_BFR_SIZE, available);
-        
-        digitalWrite(PIN_QCA700X_CS, LOW);
-        SPI.transfer16(QCA7K_SPI_READ | QCA7K_SPI_EXTERNAL);
-        SPI.transfer(dst, available);
-        digitalWrite(PIN_QCA700X_CS, HIGH);
+// Consumer side, SPI task only: moves queued frames into the modem write buffer.
+// Back-to-back frames share one chip-select window while the write space allows.
+static void qca_tx_flush() {
+    const QcaTxSlot *batch[QCA_TX_QUEUE_DEPTH];
+
+    while (1) {
+        qca_tx_lock();
+        uint8_t pending = g_qca_tx.count;
+        for (uint8_t i=0; i<pending; i++) batch[i] = qca_tx_queue_peek(&g_qca_tx, i);
+        qca_tx_unlock();
+        if (!pending) return;
+
+        uint16_t need = batch[0]->len + QCA_TX_FRAME_OVERHEAD;
+        if (g_qca_wrbuf_space < need) {
+            g_qca_wrbuf_space = qcaspi_read_register16(SPI_REG_WRBUF_SPC_AVA);
+            if (g_qca_wrbuf_space < need) {
+                // modem still busy with earlier frames: wait for WRBUF_BELOW_WM
+                // (IRQ mode) or the next protocol task tick.
+                qca_tx_lock();
+                g_qca_tx.stats.stalls++;
+                qca_tx_unlock();
+                g_qca_tx_wait_wm = true;
+                return;
+            }
+        }
 
-        return available;   // return nr of bytes in the rxbuffer
-    }
-    return 0;
-}
+        uint8_t frames = 0;
+        uint16_t total = 0;
+        uint32_t payload = 0;
+        while (frames < pending && total + batch[frames]->len + QCA_TX_FRAME_OVERHEAD <= g_qca_wrbuf_space) {
+            total += batch[frames]->len + QCA_TX_FRAME_OVERHEAD;
+            payload += batch[frames]->len;
+            frames++;
+        }
+        g_qca_bus->write_frames(batch, frames, total);
+        g_qca_wrbuf_space -= total;
 
-void randomizeNmk() {
-    // randomize the Network Membership Key (NMK)
-    for (uint8_t i=0; i<16; i++) NMK[i] = random(256); // NMK
-    for (uint8_t i=0; i<7; i++) {
-        NID[i] = NMK[i];
+        qca_tx_lock();
+        qca_tx_queue_pop(&g_qca_tx, frames, payload, millis());
+        qca_tx_unlock();
     }
-    NID[0] &= 0x3F; // ensure upper two bits are zero
 }
 
-void setNmkAt(uint16_t index) {
-    // sets the Network Membership Key (NMK) at a certain position in the transmit buffer
-    for (uint8_t i=0; i<16; i++) txbuffer[index+i] = NMK[i]; // NMK 
-}
-
-void setNidAt(uint16_t index) {
-    // copies the network ID (NID, 7 bytes) into the wished position in the transmit buffer
-    for (uint8_t i=0; i<7; i++) txbuffer[index+i] = NID[i];
+uint32_t qcaspi_read_burst(uint8_t *dst) {
+#ifdef UNIT_TEST
+    if (g_slac_test_rx_hook) return g_slac_test_rx_hook(dst, QCA7K_BUFFER_SIZE);
+#endif
+    return g_qca_bus->read_burst(dst, QCA7K_BUFFER_SIZE);
 }
 
 void setMacAt(uint8_t *mac, uint16_t offset) {
@@ -254,555 +244,387 @@ void setMacAt(uint8_t *mac, uint16_t offset) {
     for (uint8_t i=0; i<6; i++) txbuffer[offset+i]=mac[i];
 }
 
-void setRunId(uint16_t offset) {
-    // at the given offset in the transmit buffer, fill the 8-bytes-RunId.
-    for (uint8_t i=0; i<8; i++) txbuffer[offset+i]=pevRunId[i];
-}
-
-void setACVarField(uint16_t offset, uint8_t samples) {
-    uint8_t divisor = samples ? samples : 1;
-    for (uint8_t i=0; i<58; i++) {
-        txbuffer[offset+i] = (uint8_t)(AvgACVar[i] / divisor);
-    }
-}
-
-static uint32_t computeSoundWindowMs(uint8_t timeoutField) {
-    uint8_t effectiveField = timeoutField ? timeoutField : 0x06;
-    uint32_t window = (uint32_t)effectiveField * SOUND_TIMEOUT_UNIT_MS;
-    if (window < MIN_SOUND_WINDOW_MS) window = MIN_SOUND_WINDOW_MS;
-    return window;
-}
-
-static void refreshMatchWindowFromSound() {
-    uint32_t candidate = currentSoundWindowMs + SLAC_MATCH_TIMEOUT_MARGIN_MS;
-    if (candidate < DEFAULT_SLAC_MATCH_TIMEOUT_MS) candidate = DEFAULT_SLAC_MATCH_TIMEOUT_MS;
-    currentMatchWindowMs = candidate;
-}
-
-static void clearSlacMeasurements() {
-    ReceivedSounds = 0;
-    ReceivedProfiles = 0;
-    AttenCharResponseTimer = 0;
-    SlacMatchTimer = 0;
-    memset(AvgACVar, 0x00, sizeof(AvgACVar));
-}
-
-static void scheduleSessionKeyRotation() {
-    pendingSessionKeyRotation = true;
-}
-
-uint16_t getManagementMessageType() {
-    // calculates the MMTYPE (base value + lower two bits), see Table 11-2 of homeplug spec
-    return rxbuffer[16]*256 + rxbuffer[15];
-}
-
-uint16_t getFrameType() {
+uint16_t getFrameType(const uint8_t *frame) {
     // returns the Ethernet Frame type
     // 88E1 = HomeplugAV 
     // 86DD = IPv6
-    return rxbuffer[12]*256 + rxbuffer[13];
+    return frame[12]*256 + frame[13];
 }
 
 
 
 void ModemReset() {
     uint16_t reg16;
-    Serial.printf("Reset QCA700X Modem. ");
+    PLC_LOGI("Reset QCA700X Modem. ");
     reg16 = qcaspi_read_register16(SPI_REG_SPI_CONFIG);
     reg16 = reg16 | SPI_INT_CPU_ON;     // Reset QCA700X
     qcaspi_write_register(SPI_REG_SPI_CONFIG, reg16);
 }
 
-
-void composeSetKey() {
-    
-    memset(txbuffer, 0x00, 60);  // clear buffer
-    txbuffer[0]=0x00; // Destination MAC
-    txbuffer[1]=0xB0;
-    txbuffer[2]=0x52;
-    txbuffer[3]=0x00;
-    txbuffer[4]=0x00;
-    txbuffer[5]=0x01;                
-    setMacAt(myMac, 6);  // Source MAC         
-    txbuffer[12]=0x88; // Protocol HomeplugAV
-    txbuffer[13]=0xE1;
-    txbuffer[14]=0x01; // version
-    txbuffer[15]=0x08; // CM_SET_KEY.REQ
-    txbuffer[16]=0x60; 
-    txbuffer[17]=0x00; // frag_index
-    txbuffer[18]=0x00; // frag_seqnum
-    txbuffer[19]=0x01; // 0 key info type
-                     // 20-23 my nonce (0x00 in spec!)
-                     // 24-27 your nonce
-    txbuffer[28]=0x04; // 9 nw info pid
-        
-    txbuffer[29]=0x00; // 10 info prn
-    txbuffer[30]=0x00; // 11
-    txbuffer[31]=0x00; // 12 pmn
-    txbuffer[32]=0x00; // 13 CCo capability
-    setNidAt(33);    // 14-20 nid  7 bytes from 33 to 39
-                     // Network ID to be associated with the key distributed herein.
-                     // The 54 LSBs of this field contain the NID (refer to Section 3.4.3.1). The
-                     // two MSBs shall be set to 0b00.
-    txbuffer[40]=0x01; // NewEKS. Table A.8 01 is NMK.
-    setNmkAt(41); 
+void qcaspi_irq_stats(QcaIrqStats *out) {
+    qca_lock();
+    *out = g_qca_irq_stats;
+    qca_unlock();
 }
 
-void composeGetSwReq() {
-		// GET_SW.REQ request
-    memset(txbuffer, 0x00, 60);  // clear buffer
-    txbuffer[0]=0xff;  // Destination MAC Broadcast
-    txbuffer[1]=0xff;
-    txbuffer[2]=0xff;
-    txbuffer[3]=0xff;
-    txbuffer[4]=0xff;
-    txbuffer[5]=0xff;                
-    setMacAt(myMac, 6);  // Source MAC         
-    txbuffer[12]=0x88; // Protocol HomeplugAV
-    txbuffer[13]=0xE1;
-    txbuffer[14]=0x00; // version
-    txbuffer[15]=0x00; // GET_SW.REQ
-    txbuffer[16]=0xA0;  
-    txbuffer[17]=0x00; // Vendor OUI
-    txbuffer[18]=0xB0;  
-    txbuffer[19]=0x52;  
-}
 
-void composeSlacParamCnf() {
-
-    memset(txbuffer, 0x00, 60);  // clear txbuffer
-    setMacAt(pevMac, 0);  // Destination MAC
-    setMacAt(myMac, 6);  // Source MAC
-    txbuffer[12]=0x88; // Protocol HomeplugAV
-    txbuffer[13]=0xE1;
-    txbuffer[14]=0x01; // version
-    txbuffer[15]=0x65; // SLAC_PARAM.CNF
-    txbuffer[16]=0x60; // 
-    txbuffer[17]=0x00; // 2 bytes fragmentation information. 0000 means: unfragmented.
-    txbuffer[18]=0x00; // 
-    txbuffer[19]=0xff; // 19-24 sound target
-    txbuffer[20]=0xff; 
-    txbuffer[21]=0xff; 
-    txbuffer[22]=0xff; 
-    txbuffer[23]=0xff; 
-    txbuffer[24]=0xff; 
-    txbuffer[25]=negotiatedSoundCount; // negotiated sound count
-    txbuffer[26]=negotiatedSoundTimeoutField; // timeout (EV requested or fallback)
-    txbuffer[27]=0x01; // resptype
-    setMacAt(pevMac, 28);  // forwarding_sta, same as PEV MAC, plus 2 bytes 00 00
-    txbuffer[34]=0x00; // 
-    txbuffer[35]=0x00; // 
-    setRunId(36);  // 36 to 43 runid 8 bytes 
-    // rest is 00
+void composeFactoryDefaults() {
+    SlacFrameFields f = {myMac, nullptr, nullptr, nullptr, nullptr};
+    slac_frame_factory_defaults(txbuffer, &f);
 }
 
-void composeAttenCharInd() {
-    
-    memset(txbuffer, 0x00, 130);  // clear txbuffer
-    setMacAt(pevMac, 0);  // Destination MAC
-    setMacAt(myMac, 6);  // Source MAC
-    txbuffer[12]=0x88; // Protocol HomeplugAV
-    txbuffer[13]=0xE1;
-    txbuffer[14]=0x01; // version
-    txbuffer[15]=0x6E; // ATTEN_CHAR.IND
-    txbuffer[16]=0x60;  
-    txbuffer[17]=0x00; // 2 bytes fragmentation information. 0000 means: unfragmented.
-    txbuffer[18]=0x00; // 
-    txbuffer[19]=0x00; // apptype
-    txbuffer[20]=0x00; // security
-    setMacAt(pevMac, 21); // Mac address of the EV Host which initiates the SLAC process
-    setRunId(27); // RunId 8 bytes 
-    txbuffer[35]=0x00; // 35 - 51 source_id, 17 bytes 0x00 (defined in ISO15118-3 table A.4)
-        
-    txbuffer[52]=0x00; // 52 - 68 response_id, 17 bytes 0x00. (defined in ISO15118-3 table A.4)
-    
-    uint8_t reportedSounds = ReceivedSounds ? ReceivedSounds : ReceivedProfiles;
-    if (reportedSounds > negotiatedSoundCount) reportedSounds = negotiatedSoundCount;
-    uint8_t samplesForAverage = ReceivedProfiles ? ReceivedProfiles : (reportedSounds ? reportedSounds : 1);
-    txbuffer[69]=reportedSounds; // Number of sounds reported back to the EV.
-    txbuffer[70]=0x3A; // Number of groups = 58. (defined in ISO15118-3 table A.4)
-    setACVarField(71, samplesForAverage); // 71 to 128: The group attenuation for the 58 announced groups.
- }
-
-
-void transmitAttenCharInd(const char *reason) {
-    composeAttenCharInd();
-    qcaspi_write_burst(txbuffer, ATTEN_CHAR_IND_FRAME_LEN);
-    modem_state = ATTEN_CHAR_IND;
-    AttenCharResponseTimer = millis();
-    if (attenCharRetryCounter < 255) attenCharRetryCounter++;
-    Serial.printf("transmitting CM_ATTEN_CHAR.IND (%s) attempt %u/%u\n",
-                  reason ? reason : "start",
-                  attenCharRetryCounter,
-                  ATTEN_CHAR_MAX_RETRIES);
+// HomePlug frames from the modem go to its SLAC session.
+void SlacManager(const uint8_t *frame, uint16_t rxbytes) {
+    g_slac.rx(frame, rxbytes, millis());
 }
 
+SlacSession &slac_primary(void) {
+    return g_slac;
+}
 
-void composeSlacMatchCnf() {
-    
-    memset(txbuffer, 0x00, 109);  // clear txbuffer
-    setMacAt(pevMac, 0);  // Destination MAC
-    setMacAt(myMac, 6);  // Source MAC
-    txbuffer[12]=0x88; // Protocol HomeplugAV
-    txbuffer[13]=0xE1;
-    txbuffer[14]=0x01; // version
-    txbuffer[15]=0x7D; // SLAC_MATCH.CNF
-    txbuffer[16]=0x60; // 
-    txbuffer[17]=0x00; // 2 bytes fragmentation information. 0000 means: unfragmented.
-    txbuffer[18]=0x00; // 
-    txbuffer[19]=0x00; // apptype
-    txbuffer[20]=0x00; // security
-    txbuffer[21]=(uint8_t)(EXPECTED_MATCH_MVF_LEN & 0xFF); // MVF length LSB
-    txbuffer[22]=(uint8_t)(EXPECTED_MATCH_MVF_LEN >> 8);  
-                          // 23 - 39: pev_id 17 bytes. All zero.
-    setMacAt(pevMac, 40); // Pev Mac address
-                          // 46 - 62: evse_id 17 bytes. All zero.
-    setMacAt(myMac, 63);  // 63 - 68 evse_mac 
-    setRunId(69);         // runid 8 bytes 69-76 run_id.
-                          // 77 to 84 reserved 0
-    setNidAt(85);         // 85-91 NID. We can nearly freely choose this, but the upper two bits need to be zero
-                          // 92 reserved 0                                 
-    setNmkAt(93);         // 93 to 108 NMK. We can freely choose this. Normally we should use a random number. 
-}        
+// Reads every burst the modem has buffered and dispatches the contained frames.
+// Called from the SPI task with the QCA lock held.
+static void qca_rx_drain() {
+    uint32_t reg16;
+    uint16_t FrameType;
+    uint8_t bursts = 0;
+
+    g_qca_rx_last_service = millis();
+    while (bursts++ < QCA_RX_MAX_BURSTS_PER_SERVICE) {
+        // A pool buffer lets lwIP keep IPv6 frames in place after this burst;
+        // without one the burst lands in rxbuffer and the bridge copies them.
+        uint8_t *burst = lwip_bridge_rx_begin();
+        if (!burst) burst = rxbuffer;
+        reg16 = qcaspi_read_burst(burst);
+        if (!reg16) {
+            lwip_bridge_rx_end(burst);
+            break;
+        }
+        QcaBurstCursor cursor;
+        QcaFrameView frame;
+        // frames are handled in place; nothing below writes the burst until the next read.
+        qca_burst_begin(&cursor, burst, reg16);
+        while (qca_burst_next(&cursor, &frame)) {
+            invalidFrameCounter = 0;
+            FrameType = getFrameType(frame.data);
+            if (FrameType == FRAME_HOMEPLUG) SlacManager(frame.data, frame.len);
+            else if (FrameType == FRAME_IPV6) {
+#if IPV6_STACK_LWIP
+                lwip_bridge_on_frame(frame.data, frame.len);
+#else
+                IPv6Manager(frame.data, frame.len);
+#endif
+            }
+        }
+        lwip_bridge_rx_end(burst);
+        if (cursor.error) {
+            // framing is lost, the rest of this burst is dropped
+            invalidFrameCounter++;
+            PLC_LOGW("Invalid data! (%u/%u)\n", invalidFrameCounter, INVALID_FRAME_THRESHOLD);
+            if (invalidFrameCounter >= INVALID_FRAME_THRESHOLD) {
+                PLC_LOGE("Resetting modem due to repeated invalid frames\n");
+                ModemReset();
+                g_slac.modem_state = MODEM_POWERUP;
+                invalidFrameCounter = 0;
+                return;
+            }
+        }
+    }
+}
 
-void composeFactoryDefaults() {
+// MODEM_SPI_CONFIG: the modem only raises PIN_QCA700X_INT once its SPI slave
+// is up, so watermarks and the interrupt mask are programmed after the write
+// space check and again after every reset or CPU_ON.
+static void qca_spi_configure() {
+    if (QCA_RDBUF_WATERMARK) qcaspi_write_register(SPI_REG_RDBUF_WATERMARK, QCA_RDBUF_WATERMARK);
+    if (QCA_WRBUF_WATERMARK) qcaspi_write_register(SPI_REG_WRBUF_WATERMARK, QCA_WRBUF_WATERMARK);
+    uint16_t cause = qcaspi_read_register16(SPI_REG_INTR_CAUSE);
+    qcaspi_write_register(SPI_REG_INTR_CAUSE, cause);   // drop stale causes (CPU_ON after boot)
+    g_qca_intr_mask = g_qca_rx_irq_mode ? QCA_INTR_ENABLE_MASK : 0;
+    g_qca_tx_wait_wm = false;
+    g_qca_buf_err_streak = 0;
+    qcaspi_write_register(SPI_REG_INTR_ENABLE, g_qca_intr_mask);
+}
 
-    memset(txbuffer, 0x00, 60);  // clear buffer
-    txbuffer[0]=0x00; // Destination MAC
-    txbuffer[1]=0xB0;
-    txbuffer[2]=0x52;
-    txbuffer[3]=0x00;
-    txbuffer[4]=0x00;
-    txbuffer[5]=0x01;                
-    setMacAt(myMac, 6); // Source MAC         
-    txbuffer[12]=0x88; // Protocol HomeplugAV
-    txbuffer[13]=0xE1;
-    txbuffer[14]=0x00; // version
-    txbuffer[15]=0x7C; // Load modem Factory Defaults (same as holding GPIO3 low for 15 secs)
-    txbuffer[16]=0xA0; 
-    txbuffer[17]=0x00; 
-    txbuffer[18]=0xB0; 
-    txbuffer[19]=0x52; 
+static bool qca_link_up() {
+    return g_slac.modem_state != MODEM_POWERUP && g_slac.modem_state != MODEM_WRITESPACE && g_slac.modem_state != MODEM_SPI_CONFIG;
 }
 
-void handleSlacFailure(const char *reason) {
-    Serial.printf("SLAC failure: %s (attempt %u/%u)\n",
-                  reason ? reason : "unknown",
-                  slacRetryCounter + 1,
-                  SLAC_MAX_RETRIES);
-    if (slacRetryCounter < SLAC_MAX_RETRIES) {
-        slacRetryCounter++;
+// Handles the error/status causes of one wake-up. Returns false when the
+// regular RX/TX work must be skipped for this pass.
+static bool qca_handle_causes(uint16_t cause) {
+    bool buf_err = false;
+
+    g_qca_irq_stats.wakeups++;
+    if (cause & SPI_INT_PKT_AVLBL) g_qca_irq_stats.pkt_avlbl++;
+    if (cause & SPI_INT_ADDR_ERR) g_qca_irq_stats.addr_err++;
+    if (cause & SPI_INT_WRBUF_BELOW_WM) {
+        g_qca_irq_stats.wrbuf_below_wm++;
+        g_qca_tx_wait_wm = false;
+    }
+    if (cause & SPI_INT_CPU_ON) {
+        // modem rebooted on its own: SPI config and NMK are gone, redo both.
+        g_qca_irq_stats.cpu_on++;
+        PLC_LOGI("QCA700X restarted, reconfiguring\n");
+        g_qca_wrbuf_space = 0;
+        g_slac.modem_state = MODEM_WRITESPACE;
+        return false;
     }
-    attenCharRetryCounter = 0;
-    clearSlacMeasurements();
-    modem_state = MODEM_CONFIGURED;
-    scheduleSessionKeyRotation();
+    if (cause & SPI_INT_RDBUF_ERR) {
+        // read buffer is out of sync: throw away what is buffered, keep the link.
+        g_qca_irq_stats.rdbuf_err++;
+        g_qca_irq_stats.rdbuf_flushes++;
+        for (uint8_t i=0; i<QCA_RX_MAX_BURSTS_PER_SERVICE && g_qca_bus->read_burst(rxbuffer, QCA7K_BUFFER_SIZE); i++) {}
+        buf_err = true;
+    }
+    if (cause & SPI_INT_WRBUF_ERR) {
+        // our write space estimate was wrong; re-read it before the next write.
+        g_qca_irq_stats.wrbuf_err++;
+        g_qca_irq_stats.wrbuf_resyncs++;
+        g_qca_wrbuf_space = 0;
+        buf_err = true;
+    }
+    if (!buf_err) {
+        g_qca_buf_err_streak = 0;
+        return true;
+    }
+    if (++g_qca_buf_err_streak >= QCA_BUF_ERR_RESET_THRESHOLD) {
+        PLC_LOGE("Resetting modem due to repeated SPI buffer errors\n");
+        g_qca_irq_stats.resets++;
+        g_qca_buf_err_streak = 0;
+        ModemReset();
+        g_slac.modem_state = MODEM_POWERUP;
+        return false;
+    }
+    return !(cause & SPI_INT_RDBUF_ERR);
 }
 
-// Received SLAC messages from the PEV are handled here
-void SlacManager(uint16_t rxbytes) {
-    uint16_t mnt, x;
-
-    mnt = getManagementMessageType();
-  
-  //  Serial.print("[RX] ");
-  //  for (x=0; x<rxbytes; x++) Serial.printf("%02x ",rxbuffer[x]);
-  //  Serial.printf("\n");
-
-    if (mnt == (CM_SET_KEY + MMTYPE_CNF)) {
-        Serial.printf("received SET_KEY.CNF\n");
-        if (rxbuffer[19] == 0x01) {
-            modem_state = MODEM_CONFIGURED;
-            // copy MAC from the EVSE modem to myModemMac. This MAC is not used for communication.
-            memcpy(myModemMac, rxbuffer+6, 6);
-            Serial.printf("NMK set\n");
-        } else Serial.printf("NMK -NOT- set\n");
-
-    } else if (mnt == (CM_SLAC_PARAM + MMTYPE_REQ)) {
-        Serial.printf("received CM_SLAC_PARAM.REQ\n");
-        // We received a SLAC_PARAM request from the PEV. This is the initiation of a SLAC procedure.
-        // We extract the pev MAC from it.
-        memcpy(pevMac, rxbuffer+6, 6);
-        // extract the RunId from the SlacParamReq, and store it for later use
-        memcpy(pevRunId, rxbuffer+21, 8);
-        if (rxbytes > 26) {
-            requestedSoundCount = rxbuffer[25];
-            negotiatedSoundCount = requestedSoundCount;
-            if (negotiatedSoundCount == 0) negotiatedSoundCount = 1;
-            if (negotiatedSoundCount > MAX_SUPPORTED_SOUND_COUNT) negotiatedSoundCount = MAX_SUPPORTED_SOUND_COUNT;
-            negotiatedSoundTimeoutField = rxbuffer[26] ? rxbuffer[26] : 0x06;
-        } else {
-            negotiatedSoundCount = 10;
-            negotiatedSoundTimeoutField = 0x06;
-        }
-        currentSoundWindowMs = computeSoundWindowMs(negotiatedSoundTimeoutField);
-        refreshMatchWindowFromSound();
-        slacRetryCounter = 0;
-        attenCharRetryCounter = 0;
-        ReceivedSounds = 0;
-        ReceivedProfiles = 0;
-        Serial.printf("Negotiated %u sounds, timeout field %u (~%lums)\n",
-                      negotiatedSoundCount,
-                      negotiatedSoundTimeoutField,
-                      (unsigned long)currentSoundWindowMs);
-        // We are EVSE, we want to answer.
-        composeSlacParamCnf();
-        qcaspi_write_burst(txbuffer, 60); // Send data to modem
-        modem_state = SLAC_PARAM_CNF;
-        Serial.printf("transmitting CM_SLAC_PARAM.CNF\n");
-
-    } else if (mnt == (CM_START_ATTEN_CHAR + MMTYPE_IND) && modem_state == SLAC_PARAM_CNF) {
-        Serial.printf("received CM_START_ATTEN_CHAR.IND\n");
-        bool updatedParameters = false;
-        if (rxbytes > 21 && rxbuffer[21] != 0x00) {
-            negotiatedSoundCount = rxbuffer[21];
-            if (negotiatedSoundCount == 0) negotiatedSoundCount = 1;
-            if (negotiatedSoundCount > MAX_SUPPORTED_SOUND_COUNT) negotiatedSoundCount = MAX_SUPPORTED_SOUND_COUNT;
-            updatedParameters = true;
-        }
-        if (rxbytes > 22 && rxbuffer[22] != 0x00) {
-            negotiatedSoundTimeoutField = rxbuffer[22];
-            updatedParameters = true;
-        }
-        currentSoundWindowMs = computeSoundWindowMs(negotiatedSoundTimeoutField);
-        refreshMatchWindowFromSound();
-        if (updatedParameters) {
-            Serial.printf("Updated sounding window to %lums (%u sounds), match window %lums\n",
-                          (unsigned long)currentSoundWindowMs,
-                          negotiatedSoundCount,
-                          (unsigned long)currentMatchWindowMs);
-        }
-        SoundsTimer = millis(); // start timer
-        memset(AvgACVar, 0x00, sizeof(AvgACVar)); // reset averages.
-        ReceivedSounds = 0;
-        ReceivedProfiles = 0;
-        attenCharRetryCounter = 0;
-        modem_state = MNBC_SOUND;
-
-    } else if (mnt == (CM_MNBC_SOUND + MMTYPE_IND) && modem_state == MNBC_SOUND) { 
-        Serial.printf("received CM_MNBC_SOUND.IND\n");
-        if (ReceivedSounds < 255) ReceivedSounds++;
-
-    } else if (mnt == (CM_ATTEN_PROFILE + MMTYPE_IND) && modem_state == MNBC_SOUND) { 
-        Serial.printf("received CM_ATTEN_PROFILE.IND\n");
-        if (rxbytes < 85) {
-            Serial.printf("Invalid ATTEN_PROFILE length\n");
-            return;
-        }
-        if (ReceivedProfiles < negotiatedSoundCount) {
-            for (x=0; x<58; x++) AvgACVar[x] += rxbuffer[27+x];
-            ReceivedProfiles++;
-            if (ReceivedProfiles >= negotiatedSoundCount && negotiatedSoundCount > 0) {
-                transmitAttenCharInd("sounds complete");
-            }
-        }
-
-    } else if (mnt == (CM_ATTEN_CHAR + MMTYPE_RSP) && modem_state == ATTEN_CHAR_IND) { 
-        Serial.printf("received CM_ATTEN_CHAR.RSP\n");
-        // verify pevMac, RunID, and succesful Slac fields
-        if (memcmp(pevMac, rxbuffer+21, 6) == 0 && memcmp(pevRunId, rxbuffer+27, 8) == 0 && rxbuffer[69] == 0) {
-            Serial.printf("Successful SLAC process\n");
-            modem_state = ATTEN_CHAR_RSP;
-            SlacMatchTimer = millis();
-            refreshMatchWindowFromSound();
-            attenCharRetryCounter = 0;
-        } else {
-            Serial.printf("ATTEN_CHAR.RSP validation failed (status=0x%02x)\n", rxbuffer[69]);
-            if (attenCharRetryCounter < ATTEN_CHAR_MAX_RETRIES) {
-                transmitAttenCharInd("RSP mismatch");
-            } else {
-                handleSlacFailure("ATTEN_CHAR.RSP invalid");
+static void qca_spi_service() {
+    qca_lock();
+    if (qca_link_up()) {
+        // mask the interrupt while we work, then handle every latched cause in one pass;
+        // anything arriving meanwhile is picked up by the drain below or re-raises the line.
+        if (g_qca_rx_irq_mode) qcaspi_write_register(SPI_REG_INTR_ENABLE, 0);
+        uint16_t cause = qcaspi_read_register16(SPI_REG_INTR_CAUSE);
+        if (cause) qcaspi_write_register(SPI_REG_INTR_CAUSE, cause);
+        if (qca_handle_causes(cause)) {
+            // drain even without PKT_AVLBL: frames that arrived while masked raise no new edge.
+            PERF_PROBE_BEGIN(PERF_QCA_RX_DRAIN);
+            qca_rx_drain();
+            PERF_PROBE_END(PERF_QCA_RX_DRAIN);
+            // responses queued while handling RX go out in the same wake-up.
+            if (g_slac.modem_state != MODEM_POWERUP) {
+                PERF_PROBE_BEGIN(PERF_QCA_TX_FLUSH);
+                qca_tx_flush();
+                PERF_PROBE_END(PERF_QCA_TX_FLUSH);
+                lwip_bridge_poll();     // lwIP output that waited for the slots just freed
             }
         }
-
-    } else if (mnt == (CM_SLAC_MATCH + MMTYPE_REQ) && modem_state == ATTEN_CHAR_RSP) { 
-        Serial.printf("received CM_SLAC_MATCH.REQ\n"); 
-        // Verify pevMac, RunID and MVFLength fields
-        uint16_t mvfLength = rxbuffer[21] + (rxbuffer[22] << 8);
-        if (memcmp(pevMac, rxbuffer+40, 6) == 0 && memcmp(pevRunId, rxbuffer+69, 8) == 0 && mvfLength == EXPECTED_MATCH_MVF_LEN) {
-            composeSlacMatchCnf();
-            qcaspi_write_burst(txbuffer, 109); // Send data to modem
-            Serial.printf("transmitting CM_SLAC_MATCH.CNF\n");
-            modem_state = MODEM_GET_SW_REQ;
-            attenCharRetryCounter = 0;
-            SlacMatchTimer = 0;
-        } else {
-            handleSlacFailure("SLAC_MATCH verification failed");
-        }
-
-    } else if (mnt == (CM_GET_SW + MMTYPE_CNF) && modem_state == MODEM_WAIT_SW) { 
-        // Both the local and Pev modem will send their software version.
-        // check if the MAC of the modem is the same as our local modem.
-        if (memcmp(rxbuffer+6, myModemMac, 6) != 0) { 
-            // Store the Pev modem MAC, as long as it is not random, we can use it for identifying the EV (Autocharge / Plug N Charge)
-            memcpy(pevModemMac, rxbuffer+6, 6);
+        if (g_qca_rx_irq_mode && qca_link_up()) {
+            uint16_t mask = g_qca_intr_mask;
+            if (g_qca_tx_wait_wm) mask |= SPI_INT_WRBUF_BELOW_WM;
+            qcaspi_write_register(SPI_REG_INTR_ENABLE, mask);
         }
-        Serial.printf("received GET_SW.CNF\n");
-        ModemsFound++;
     }
+    qca_unlock();
 }
 
+static void IRAM_ATTR qca_rx_isr() {
+    BaseType_t woken = pdFALSE;
+    if (g_qca_spi_task) vTaskNotifyGiveFromISR(g_qca_spi_task, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
 
-
+static bool qca_spi_task_step(TickType_t wait) {
+    if (ulTaskNotifyTake(pdTRUE, wait) == 0) return false;
+    task_monitor_begin(g_qca_spi_monitor, micros());
+    qca_spi_service();
+    task_monitor_end(g_qca_spi_monitor, micros());
+    return true;
+}
 
 // Task
-// 
-// called every 20ms
 //
-void Timer20ms(void * parameter) {
+// Woken by the QCA7005 interrupt, a queued TX frame or the protocol task; sole owner of
+// the modem read/write buffers.
+//
+void QcaSpiTask(void *) {
+    while(1) {
+        qca_spi_task_step(portMAX_DELAY);
+    }
+}
 
-    uint16_t reg16, rxbytes, x;
-    uint16_t FrameType;
-    
-    while(1)  // infinite loop
-    {
-        cp_tick();
-        bool cpConnected = cp_is_connected();
-        if (!cpConnected) {
-            if (cp_is_contactor_commanded()) cp_contactor_command(false);
-            if (dc_is_enabled()) dc_enable_output(false);
-        }
-        if (!cpConnected && lastCpConnected) {
-            Serial.printf("Control pilot opened, rearming SLAC session\n");
-            clearSlacMeasurements();
-            modem_state = MODEM_CONFIGURED;
-            scheduleSessionKeyRotation();
-        }
-        lastCpConnected = cpConnected;
-        dc_can_tick();
-        lwip_bridge_poll();
-
-        switch(modem_state) {
-          
-            case MODEM_POWERUP:
-                Serial.printf("Searching for local modem.. ");
-                reg16 = qcaspi_read_register16(SPI_REG_SIGNATURE);
-                if (reg16 == QCASPI_GOOD_SIGNATURE) {
-                    Serial.printf("QCA700X modem found\n");
-                    modem_state = MODEM_WRITESPACE;
-                }    
-                break;
-
-            case MODEM_WRITESPACE:
-                reg16 = qcaspi_read_register16(SPI_REG_WRBUF_SPC_AVA);
-                if (reg16 == QCA7K_BUFFER_SIZE) {
-                    Serial.printf("QCA700X write space ok\n"); 
-                    modem_state = MODEM_CM_SET_KEY_REQ;
-                }  
-                break;
-
-            case MODEM_CM_SET_KEY_REQ:
-                randomizeNmk();       // randomize Nmk, so we start with a new key.
-                composeSetKey();      // set up buffer with CM_SET_KEY.REQ request data
-                qcaspi_write_burst(txbuffer, 60);    // write minimal 60 bytes according to an4_rev5.pdf
-                Serial.printf("transmitting SET_KEY.REQ, to configure the EVSE modem with random NMK\n"); 
-                modem_state = MODEM_CM_SET_KEY_CNF;
-                break;
-
-            case MODEM_GET_SW_REQ:
-                composeGetSwReq();
-                qcaspi_write_burst(txbuffer, 60); // Send data to modem
-                Serial.printf("Modem Search..\n");
-                ModemsFound = 0; 
-                ModemSearchTimer = millis();        // start timer
-                modem_state = MODEM_WAIT_SW;
-                break;
-
-            default:
-                // poll modem for data
-                reg16 = qcaspi_read_burst(rxbuffer);
-
-                while (reg16) {
-                    // we received data, read the length of the first packet.
-                    rxbytes = rxbuffer[8] + (rxbuffer[9] << 8);
-                    
-                    // check if the header exists and a minimum of 60 bytes are available
-                    if (rxbuffer[4] == 0xaa && rxbuffer[5] == 0xaa && rxbuffer[6] == 0xaa && rxbuffer[7] == 0xaa && rxbytes >= 60) {
-                        invalidFrameCounter = 0;
-                        // now remove the header, and footer.
-                        memcpy(rxbuffer, rxbuffer+12, reg16-14);
-                        //Serial.printf("available: %u rxbuffer bytes: %u\n",reg16, rxbytes);
-                    
-                        FrameType = getFrameType();
-                        if (FrameType == FRAME_HOMEPLUG) SlacManager(rxbytes);
-                        else if (FrameType == FRAME_IPV6) {
-                            lwip_bridge_on_frame(rxbuffer, rxbytes);
-                            IPv6Manager(rxbytes);
-                        }
-
-                        // there might be more data still in the buffer. Check if there is another packet.
-                        if ((int16_t)reg16-rxbytes-14 >= 74) {
-                            reg16 = reg16-rxbytes-14;
-                            // move data forward.
-                            memcpy(rxbuffer, rxbuffer+2+rxbytes, reg16);
-                        } else reg16 = 0;
-                      
-                    } else {
-                        invalidFrameCounter++;
-                        Serial.printf("Invalid data! (%u/%u)\n", invalidFrameCounter, INVALID_FRAME_THRESHOLD);
-                        if (invalidFrameCounter >= INVALID_FRAME_THRESHOLD) {
-                            Serial.printf("Resetting modem due to repeated invalid frames\n");
-                            ModemReset();
-                            modem_state = MODEM_POWERUP;
-                            invalidFrameCounter = 0;
-                        }
-                    }  
-                }
-                break;
-        }
+static void qca_spi_start() {
+    if (!g_qca_lock) g_qca_lock = xSemaphoreCreateRecursiveMutex();
+    if (!g_qca_tx_lock) g_qca_tx_lock = xSemaphoreCreateMutex();
+    if (g_qca_spi_task) return;
+    g_qca_spi_monitor = task_monitor_register("plc", 0, QCA_SPI_TASK_BUDGET_US);
+    xTaskCreatePinnedToCore(
+        QcaSpiTask,
+        "QcaSpi",
+        QCA_SPI_TASK_STACK,
+        NULL,
+        QCA_SPI_TASK_PRIORITY,
+        &g_qca_spi_task,
+        QCA_SPI_TASK_CORE
+    );
+}
 
-        // Did the Sound timer expire or did we receive enough samples?
-        if (modem_state == MNBC_SOUND) {
-            bool soundsComplete = (negotiatedSoundCount > 0) && (ReceivedProfiles >= negotiatedSoundCount);
-            bool timerExpired = (SoundsTimer + currentSoundWindowMs) < millis();
-            if (soundsComplete || timerExpired) {
-                transmitAttenCharInd(soundsComplete ? "sounds complete" : "timeout");
-            }
-        }
 
-        if (modem_state == ATTEN_CHAR_IND && (AttenCharResponseTimer + ATTEN_CHAR_RESPONSE_TIMEOUT_MS) < millis()) {
-            if (attenCharRetryCounter < ATTEN_CHAR_MAX_RETRIES) {
-                transmitAttenCharInd("waiting for RSP");
-            } else {
-                handleSlacFailure("ATTEN_CHAR.RSP timeout");
-            }
-        }
+// CP task: ADC burst, state classification and the safety reaction to an
+// unplug. Runs on its own so a slow burst never holds up SLAC or HLC.
+static void cp_task_step() {
+    PERF_PROBE_BEGIN(PERF_CP_TICK);
+    cp_tick();
+    PERF_PROBE_END(PERF_CP_TICK);
+    bool cpConnected = cp_is_connected();
+    if (!cpConnected) {
+        if (cp_is_contactor_commanded()) cp_contactor_command(false);
+        if (dc_is_enabled()) dc_enable_output(false);
+    }
+    qca_lock();
+    if (!cpConnected && lastCpConnected) {
+        PLC_LOGI("Control pilot opened, rearming SLAC session\n");
+        g_slac.rearm(millis());
+    } else if (cpConnected && !lastCpConnected) {
+        g_slac.plugged_in(millis());
+    }
+    lastCpConnected = cpConnected;
+    qca_unlock();
+}
 
-        if (modem_state == ATTEN_CHAR_RSP && (SlacMatchTimer + currentMatchWindowMs) < millis()) {
-            handleSlacFailure("SLAC_MATCH timeout");
-        }
+// CAN task: power module ramp and status polling.
+static void can_task_step() {
+    PERF_PROBE_BEGIN(PERF_DC_CAN_TICK);
+    dc_can_tick();
+    PERF_PROBE_END(PERF_DC_CAN_TICK);
+}
 
-        if (modem_state == MODEM_WAIT_SW && (ModemSearchTimer + 1000) < millis() ) {
-            Serial.printf("MODEM timer expired. ");
-            if (ModemsFound >= 2) {
-                Serial.printf("Found %u modems. Private network between EVSE and PEV established\n", ModemsFound); 
-                
-                Serial.printf("PEV MAC: ");
-                for(x=0; x<6 ;x++) Serial.printf("%02x", pevMac[x]);
-                Serial.printf(" PEV modem MAC: ");
-                for(x=0; x<6 ;x++) Serial.printf("%02x", pevModemMac[x]);
-                Serial.printf("\n");
-
-                modem_state = MODEM_LINK_READY;
-            } else {
-                Serial.printf("(re)transmitting MODEM_GET_SW.REQ\n");
-                modem_state = MODEM_GET_SW_REQ;
-            } 
-        }
+// Protocol task: modem bring-up, SLAC/HLC timers and the SPI task safety kicks.
+static void proto_task_step() {
 
+    uint16_t reg16;
 
-        if (pendingSessionKeyRotation && modem_state == MODEM_CONFIGURED) {
-            pendingSessionKeyRotation = false;
-            modem_state = MODEM_CM_SET_KEY_REQ;
-        }
+    lwip_bridge_poll();
+
+    qca_lock();
+    // key setup, GET_SW search and the SLAC timers; runs before the bring-up
+    // below so SET_KEY.REQ still goes out one step after SPI configuration
+    g_slac.tick(millis());
+
+    switch(g_slac.modem_state) {
+      
+        case MODEM_POWERUP:
+            PLC_LOGI("Searching for local modem.. ");
+            reg16 = qcaspi_read_register16(SPI_REG_SIGNATURE);
+            if (reg16 == QCASPI_GOOD_SIGNATURE) {
+                PLC_LOGI("QCA700X modem found\n");
+                g_slac.modem_state = MODEM_WRITESPACE;
+            }    
+            break;
+
+        case MODEM_WRITESPACE:
+            reg16 = qcaspi_read_register16(SPI_REG_WRBUF_SPC_AVA);
+            if (reg16 == QCA7K_BUFFER_SIZE) {
+                PLC_LOGI("QCA700X write space ok\n"); 
+                g_slac.modem_state = MODEM_SPI_CONFIG;
+                g_qca_wrbuf_space = reg16;
+            }  
+            break;
+
+        case MODEM_SPI_CONFIG:
+            qca_spi_configure();
+            g_slac.modem_state = MODEM_CM_SET_KEY_REQ;
+            if (g_qca_rx_irq_mode) qca_spi_kick();
+            break;
+
+        case MODEM_CM_SET_KEY_REQ:
+        case MODEM_GET_SW_REQ:
+            break;      // sent by the session
+
+        default:
+            if (!g_qca_rx_irq_mode) {
+                // poll modem for data
+                qca_spi_kick();
+            } else if (QCA_RX_FALLBACK_POLL_MS && (millis() - g_qca_rx_last_service) >= QCA_RX_FALLBACK_POLL_MS) {
+                // no edge for a while; let the SPI task check the modem in case one got lost.
+                g_qca_rx_last_service = millis();
+                qca_spi_kick();
+            } else if (g_qca_tx.count && !g_qca_tx_wait_wm) {
+                // queued frames without a pending WRBUF_BELOW_WM to flush them
+                qca_spi_kick();
+            }
+            break;
+    }
 
-        tcp_tick();
+    PERF_PROBE_BEGIN(PERF_TCP_TICK);
+    tcp_tick();
+    PERF_PROBE_END(PERF_TCP_TICK);
+    // replace the key a rotation took, well before the next plug-out
+    nmk_pool_refill();
+    qca_unlock();
+}
 
-        // Pause the task for 20ms
-        vTaskDelay(20 / portTICK_PERIOD_MS);
+#ifdef UNIT_TEST
+// What the single Timer20ms task used to do in one pass; the host tests step it.
+static void timer20ms_step() {
+    cp_task_step();
+    can_task_step();
+    proto_task_step();
+}
+#endif
 
-    } // while(1)
-}    
+#ifndef APP_NO_MAIN
+struct PeriodicTask {
+    const char *name;
+    void (*step)(void);
+    uint32_t period_ms;
+    uint32_t stack;
+    UBaseType_t priority;
+    BaseType_t core;
+    uint8_t period_probe;
+    int monitor;
+};
+
+static PeriodicTask g_periodic_tasks[] = {
+    {"cp",    cp_task_step,    CP_TASK_PERIOD_MS,    CP_TASK_STACK,    CP_TASK_PRIORITY,    CP_TASK_CORE,    PERF_CP_PERIOD,    -1},
+    {"can",   can_task_step,   CAN_TASK_PERIOD_MS,   CAN_TASK_STACK,   CAN_TASK_PRIORITY,   CAN_TASK_CORE,   PERF_CAN_PERIOD,   -1},
+    {"proto", proto_task_step, PROTO_TASK_PERIOD_MS, PROTO_TASK_STACK, PROTO_TASK_PRIORITY, PROTO_TASK_CORE, PERF_PROTO_PERIOD, -1},
+};
+
+// Task
+//
+// Runs one PeriodicTask entry at a fixed cadence and records each iteration.
+//
+void PeriodicTaskLoop(void * parameter) {
+    PeriodicTask *task = (PeriodicTask *)parameter;
+    TickType_t wake = xTaskGetTickCount();
+
+    while(1) {
+        PERF_PROBE_MARK(task->period_probe);
+        task_monitor_begin(task->monitor, micros());
+        task->step();
+        task_monitor_end(task->monitor, micros());
+        // fixed cadence; an overrun makes the next iteration start immediately
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(task->period_ms));
+    }
+}
+
+static void periodic_tasks_start() {
+    for (PeriodicTask &task : g_periodic_tasks) {
+        task.monitor = task_monitor_register(task.name, task.period_ms, task.period_ms * 1000u);
+        xTaskCreatePinnedToCore(
+            PeriodicTaskLoop,
+            task.name,
+            task.stack,
+            &task,
+            task.priority,
+            NULL,
+            task.core
+        );
+    }
+}
+#endif
 
 
 #ifndef UNIT_TEST
@@ -855,7 +677,7 @@ static bool cli_process_json(const String &line) {
     const char *type = doc["type"] | "";
     if (!strcmp(type, "diag")) {
         const char *op = doc["op"] | "";
-        StaticJsonDocument<256> res;
+        StaticJsonDocument<1536> res;
         res["type"] = "diag.res";
         res["op"] = op;
         auto emit = [&]() {
@@ -874,6 +696,258 @@ static bool cli_process_json(const String &line) {
             }
             return true;
         }
+        if (!strcmp(op, "tasks")) {
+            res["ok"] = true;
+            JsonArray arr = res.createNestedArray("tasks");
+            TaskMonitorStats t;
+            for (uint8_t i = 0; i < task_monitor_count(); ++i) {
+                if (!task_monitor_get(i, &t)) continue;
+                JsonObject o = arr.createNestedObject();
+                o["name"] = t.name;
+                o["period_ms"] = t.period_ms;
+                o["runs"] = t.iterations;
+                o["last_us"] = t.last_us;
+                o["avg_us"] = t.avg_us;
+                o["max_us"] = t.max_us;
+                o["overruns"] = t.overruns;
+                o["late"] = t.late_starts;
+            }
+            emit();
+            return true;
+        }
+        if (!strcmp(op, "perf")) {
+#if PERF_PROBES_ENABLE
+            PerfProbeStats p;
+            const char *probe = doc["probe"] | "";
+            if (doc["reset"] | false) perf_probe_reset();
+            res["ok"] = true;
+            if (*probe) {
+                // one probe with its raw log2 histogram
+                int id = perf_probe_find(probe);
+                if (id < 0) {
+                    res["ok"] = false;
+                    res["error"] = "unknown_probe";
+                    emit();
+                    return true;
+                }
+                uint32_t buckets[PERF_PROBE_BUCKETS];
+                perf_probe_get((uint8_t)id, &p);
+                perf_probe_histogram((uint8_t)id, buckets);
+                res["name"] = p.name;
+                res["n"] = p.count;
+                res["cycles_per_us"] = perf_probe_cycles_per_us();
+                JsonArray hist = res.createNestedArray("hist");
+                for (uint8_t b = 0; b < PERF_PROBE_BUCKETS; ++b) hist.add(buckets[b]);
+            } else {
+                JsonArray arr = res.createNestedArray("probes");
+                for (uint8_t i = 0; i < PERF_PROBE_COUNT; ++i) {
+                    perf_probe_get(i, &p);
+                    JsonObject o = arr.createNestedObject();
+                    o["name"] = p.name;
+                    o["n"] = p.count;
+                    o["min_us"] = p.min_us;
+                    o["avg_us"] = p.avg_us;
+                    o["max_us"] = p.max_us;
+                    o["p99_us"] = p.p99_us;
+                }
+            }
+#else
+            res["ok"] = false;
+            res["error"] = "perf_disabled";
+#endif
+            emit();
+            return true;
+        }
+        if (!strcmp(op, "log")) {
+            // {"op":"log","sync":true} switches back to formatting in the caller
+            if (doc.containsKey("sync")) plc_log_set_sync(doc["sync"] | false);
+            PlcLogStats st;
+            plc_log_stats(&st);
+            res["ok"] = true;
+            res["level"] = PLC_LOG_LEVEL;
+            res["written"] = st.written;
+            res["dropped"] = st.dropped;
+            res["flushed"] = st.flushed;
+            res["high_water"] = st.high_water;
+            emit();
+            return true;
+        }
+        if (!strcmp(op, "slac")) {
+            NmkPoolStats pool;
+            qca_lock();
+            nmk_pool_stats(&pool);
+            res["ok"] = true;
+            res["state"] = g_slac.modem_state;
+            res["key_rotations"] = g_slac.key_rotations;
+            res["key_ready_ms"] = g_slac.key_ready_ms;
+            res["plug_to_param_ms"] = g_slac.plug_to_param_ms;
+            res["plug_to_param_max_ms"] = g_slac.plug_to_param_max_ms;
+            res["plugs_before_key"] = g_slac.plugs_before_key;
+            res["atten_max_var"] = g_slac.atten_stats.max_var;
+            qca_unlock();
+            JsonObject p = res.createNestedObject("nmk_pool");
+            p["level"] = pool.level;
+            p["taken"] = pool.taken;
+            p["empty"] = pool.empty;
+            emit();
+            return true;
+        }
+        if (!strcmp(op, "hlc")) {
+            if (doc["reset"] | false) tcp_hlc_stats_reset();
+            // Sized for every route, so a full DIN + ISO-2 session still fits.
+            const uint8_t routes = tcp_hlc_route_count();
+            const size_t capacity = JSON_OBJECT_SIZE(9) + JSON_OBJECT_SIZE(6) + JSON_OBJECT_SIZE(5) +
+                                    JSON_OBJECT_SIZE(8) + JSON_ARRAY_SIZE(routes) + routes * JSON_OBJECT_SIZE(6);
+            DynamicJsonDocument out(capacity);
+            out["type"] = "diag.res";
+            out["op"] = op;
+            uint32_t unrouted = 0, bad = 0;
+            tcp_hlc_dispatch_counters(&unrouted, &bad);
+            out["ok"] = true;
+            out["unrouted"] = unrouted;
+            out["bad_transitions"] = bad;
+            HlcCurrentDemandStats cds;
+            tcp_hlc_current_demand_stats(&cds);
+            JsonObject cd = out.createNestedObject("current_demand");
+            cd["patched"] = cds.res_patched;
+            cd["encoded"] = cds.res_encoded;
+            cd["rejected"] = cds.res_rejected;
+            cd["req_matched"] = cds.req_matched;
+            cd["req_decoded"] = cds.req_decoded;
+            cd["req_rejected"] = cds.req_rejected;
+            V2gtpFramerStats rx;
+            tcp_hlc_rx_stats(&rx);
+            JsonObject v = out.createNestedObject("v2gtp");
+            v["frames"] = rx.frames;
+            v["linearized"] = rx.linearized;
+            v["oversize"] = rx.oversize;
+            v["bad_header"] = rx.bad_header;
+            v["max_level"] = rx.max_level;
+            TcpSenderStats tx;
+            tcp_hlc_tx_stats(&tx);
+            JsonObject t = out.createNestedObject("tcp");
+            t["segments"] = tx.segments;
+            t["retransmits"] = tx.retransmits;
+            t["fast_retransmits"] = tx.fast_retransmits;
+            t["timeouts"] = tx.timeouts;
+            t["srtt_ms"] = tx.srtt_ms;
+            t["rttvar_ms"] = tx.rttvar_ms;
+            t["rto_ms"] = tx.rto_ms;
+            t["max_inflight"] = tx.max_inflight;
+            JsonArray arr = out.createNestedArray("routes");
+            HlcRouteStats r;
+            for (uint8_t i = 0; i < routes; ++i) {
+                tcp_hlc_route_stats(i, &r);
+                if (!r.calls) continue;
+                JsonObject o = arr.createNestedObject();
+                o["name"] = r.name;
+                o["proto"] = r.protocol ? "iso2" : "din";
+                o["state"] = r.state;
+                o["n"] = r.calls;
+                o["avg_us"] = r.avg_us;
+                o["max_us"] = r.max_us;
+            }
+            if (out.overflowed()) {
+                res["ok"] = false;
+                res["error"] = "reply_overflow";
+                emit();
+                return true;
+            }
+            serializeJson(out, Serial);
+            Serial.print('\n');
+            return true;
+        }
+        if (!strcmp(op, "tls")) {
+            HlcTlsStats tls;
+            hlc_server_tls_stats(&tls);
+            res["ok"] = true;
+            res["full"] = tls.full;
+            res["resumed"] = tls.resumed;
+            res["by_ticket"] = tls.by_ticket;
+            res["failed"] = tls.failed;
+            res["tickets_rejected"] = tls.tickets_rejected;
+            res["full_last_ms"] = tls.full_last_ms;
+            res["full_avg_ms"] = tls.full_avg_ms;
+            res["full_max_ms"] = tls.full_max_ms;
+            res["resumed_last_ms"] = tls.resumed_last_ms;
+            res["resumed_avg_ms"] = tls.resumed_avg_ms;
+            res["resumed_max_ms"] = tls.resumed_max_ms;
+            JsonObject c = res.createNestedObject("cache");
+            c["entries"] = tls.cache.entries;
+            c["stored"] = tls.cache.stored;
+            c["hits"] = tls.cache.hits;
+            c["misses"] = tls.cache.misses;
+            c["evicted"] = tls.cache.evicted;
+            c["expired"] = tls.cache.expired;
+            c["too_big"] = tls.cache.too_big;
+            emit();
+            return true;
+        }
+        if (!strcmp(op, "qca")) {
+            QcaTxStats tx;
+            qcaspi_tx_stats(&tx);
+            res["ok"] = true;
+            JsonObject t = res.createNestedObject("tx");
+            t["depth"] = tx.depth;
+            t["high_water"] = tx.high_water;
+            t["enqueued"] = tx.enqueued;
+            t["dropped"] = tx.dropped;
+            t["stalls"] = tx.stalls;
+            t["batches"] = tx.batches;
+            t["frames"] = tx.frames_sent;
+            t["bytes"] = tx.bytes_sent;
+            t["bytes_per_s"] = tx.bytes_per_s;
+            QcaSpiStats bus;
+            g_qca_bus->get_stats(&bus);
+            JsonObject b = res.createNestedObject("spi");
+            b["driver"] = g_qca_bus->name;
+            b["transactions"] = bus.transactions;
+            b["bytes"] = bus.bytes;
+            b["busy_us"] = bus.busy_us;
+            b["rx_bursts"] = bus.rx_bursts;
+            b["tx_bursts"] = bus.tx_bursts;
+            b["rx_bounced"] = bus.rx_bounced;
+            b["tx_copied"] = bus.tx_copied;
+            LwipBridgeStats br;
+            lwip_bridge_stats(&br);
+            JsonObject l = res.createNestedObject("lwip");
+            l["rx_frames"] = br.rx_frames;
+            l["rx_by_ref"] = br.rx_by_ref;
+            l["rx_copied"] = br.rx_copied;
+            l["rx_dropped"] = br.rx_dropped;
+            l["rx_overflow"] = br.rx_overflow;
+            l["rx_handoffs"] = br.rx_handoffs;
+            l["rx_max_batch"] = br.rx_max_batch;
+            l["rx_queue_high_water"] = br.rx_queue_high_water;
+            l["rx_bytes"] = br.rx_bytes;
+            l["rx_bytes_per_s"] = br.rx_bytes_per_s;
+            l["tx_frames"] = br.tx_frames;
+            l["tx_bytes"] = br.tx_bytes;
+            l["tx_bytes_per_s"] = br.tx_bytes_per_s;
+            l["tx_queued"] = br.tx_queued;
+            l["tx_overflow"] = br.tx_overflow;
+            l["tx_queue_high_water"] = br.tx_queue_high_water;
+            l["handoff_failed"] = br.handoff_failed;
+            l["pool_in_use"] = br.pool_in_use;
+            l["pool_high_water"] = br.pool_high_water;
+            l["pool_exhausted"] = br.pool_exhausted;
+            l["pbufs_in_use"] = br.pbufs_in_use;
+            QcaIrqStats irq;
+            qcaspi_irq_stats(&irq);
+            JsonObject q = res.createNestedObject("irq");
+            q["wakeups"] = irq.wakeups;
+            q["pkt_avlbl"] = irq.pkt_avlbl;
+            q["rdbuf_err"] = irq.rdbuf_err;
+            q["wrbuf_err"] = irq.wrbuf_err;
+            q["cpu_on"] = irq.cpu_on;
+            q["addr_err"] = irq.addr_err;
+            q["wrbuf_below_wm"] = irq.wrbuf_below_wm;
+            q["rdbuf_flushes"] = irq.rdbuf_flushes;
+            q["wrbuf_resyncs"] = irq.wrbuf_resyncs;
+            q["resets"] = irq.resets;
+            emit();
+            return true;
+        }
         res["ok"] = false;
         res["error"] = "unknown_op";
         emit();
@@ -896,7 +970,7 @@ static bool cli_process_json(const String &line) {
     }
     const char *op = doc["op"] | "";
     const char *target = doc["target"] | "";
-    StaticJsonDocument<768> res;
+    StaticJsonDocument<1536> res;
     res["type"] = "pki.res";
     res["op"] = op;
     res["target"] = target;
@@ -928,9 +1002,19 @@ static bool cli_process_json(const String &line) {
         }
         bool ok = false;
         if (targetStr.equalsIgnoreCase("cert")) ok = pki_store_set_server_cert(decoded);
-        else if (targetStr.equalsIgnoreCase("key")) ok = pki_store_set_server_key(decoded);
-        else if (targetStr.equalsIgnoreCase("ca")) ok = pki_store_set_root_ca(decoded);
-        else {
+        else if (targetStr.equalsIgnoreCase("key")) {
+            tls_key_result_t kr = tls_credentials_set_server_key(
+                reinterpret_cast<const unsigned char *>(decoded.data()), decoded.size());
+            if (kr == TLS_KEY_UNPARSEABLE || kr == TLS_KEY_WRONG_CURVE) {
+                res["ok"] = false;
+                res["error"] = kr == TLS_KEY_WRONG_CURVE ? "key_not_p256" : "bad_key";
+                emit();
+                return true;
+            }
+            ok = kr == TLS_KEY_OK;
+        } else if (targetStr.equalsIgnoreCase("ca")) {
+            ok = pki_store_set_root_ca(decoded);
+        } else {
             res["ok"] = false;
             res["error"] = "unknown_target";
             emit();
@@ -1023,7 +1107,14 @@ static void cli_process_line(const String &line) {
         if (target.equalsIgnoreCase("cert")) {
             ok = pki_store_set_server_cert(decoded);
         } else if (target.equalsIgnoreCase("key")) {
-            ok = pki_store_set_server_key(decoded);
+            tls_key_result_t kr = tls_credentials_set_server_key(
+                reinterpret_cast<const unsigned char *>(decoded.data()), decoded.size());
+            if (kr == TLS_KEY_UNPARSEABLE || kr == TLS_KEY_WRONG_CURVE) {
+                Serial.println(kr == TLS_KEY_WRONG_CURVE ? "[PKI] EC key is not secp256r1 (P-256)"
+                                                         : "[PKI] Key is neither PEM nor DER");
+                return;
+            }
+            ok = kr == TLS_KEY_OK;
         } else if (target.equalsIgnoreCase("ca")) {
             ok = pki_store_set_root_ca(decoded);
         } else {
@@ -1089,74 +1180,79 @@ extern "C" void slac_test_set_tx_hook(void (*hook)(const uint8_t *, uint32_t)) {
     g_slac_test_tx_hook = hook;
 }
 
+extern "C" void slac_test_set_rx_hook(uint32_t (*hook)(uint8_t *, uint32_t)) {
+    g_slac_test_rx_hook = hook;
+}
+
+extern "C" void slac_test_set_rx_irq_mode(bool enabled) {
+    g_qca_rx_irq_mode = enabled;
+    qca_spi_start();
+}
+
+extern "C" void slac_test_set_qca_bus(const QcaSpiBus *bus) {
+    g_qca_bus = bus ? bus : qca_spi_default_bus();
+}
+
+extern "C" void slac_test_qca_irq(void) {
+    qca_rx_isr();
+}
+
+extern "C" bool slac_test_run_spi_task(void) {
+    return qca_spi_task_step(0);
+}
+
+extern "C" void slac_test_timer_tick(void) {
+    timer20ms_step();
+}
+
 extern "C" void slac_test_reset_state(void) {
     memset(txbuffer, 0, sizeof(txbuffer));
     memset(rxbuffer, 0, sizeof(rxbuffer));
-    memset(pevMac, 0, sizeof(pevMac));
-    memset(myModemMac, 0, sizeof(myModemMac));
-    memset(pevModemMac, 0, sizeof(pevModemMac));
-    memset(pevRunId, 0, sizeof(pevRunId));
-    memset(AvgACVar, 0, sizeof(AvgACVar));
-    memset(NMK, 0, sizeof(NMK));
-    uint8_t defaultNid[7] = {1, 2, 3, 4, 5, 6, 7};
-    memcpy(NID, defaultNid, sizeof(NID));
-    SoundsTimer = 0;
-    ModemSearchTimer = 0;
-    AttenCharResponseTimer = 0;
-    SlacMatchTimer = 0;
-    ModemsFound = 0;
-    ReceivedSounds = 0;
-    ReceivedProfiles = 0;
+    nmk_pool_reset();
+    g_slac.begin(0, myMac, &g_slac_port);
+    g_slac.modem_state = MODEM_CONFIGURED;
     memset(EVCCID, 0, sizeof(EVCCID));
     EVSOC = 0;
-    requestedSoundCount = 10;
-    negotiatedSoundCount = 10;
-    negotiatedSoundTimeoutField = 0x06;
-    currentSoundWindowMs = 600;
-    currentMatchWindowMs = DEFAULT_SLAC_MATCH_TIMEOUT_MS;
-    slacRetryCounter = 0;
-    attenCharRetryCounter = 0;
     invalidFrameCounter = 0;
-    pendingSessionKeyRotation = false;
     lastCpConnected = false;
-    modem_state = MODEM_CONFIGURED;
     g_slac_test_tx_hook = nullptr;
+    g_slac_test_rx_hook = nullptr;
+    g_qca_rx_irq_mode = QCA_RX_IRQ_ENABLE;
+    g_qca_rx_last_service = 0;
+    g_qca_wrbuf_space = 0;
+    g_qca_intr_mask = 0;
+    g_qca_tx_wait_wm = false;
+    g_qca_buf_err_streak = 0;
+    memset(&g_qca_irq_stats, 0, sizeof(g_qca_irq_stats));
+    g_qca_bus = qca_spi_default_bus();
+    qca_tx_queue_reset(&g_qca_tx);
+    plc_log_flush();
+    while (ulTaskNotifyTake(pdTRUE, 0)) {}
 }
 #endif
 
 #ifndef APP_NO_MAIN
 void setup() {
 
-    pinMode(PIN_QCA700X_CS, OUTPUT);           // SPI_CS QCA7005 
     pinMode(PIN_QCA700X_INT, INPUT);           // SPI_INT QCA7005 
-    pinMode(SPI_SCK, OUTPUT);     
-    pinMode(SPI_MISO, INPUT);     
-    pinMode(SPI_MOSI, OUTPUT);     
-
-    digitalWrite(PIN_QCA700X_CS, HIGH); 
 
-    // configure SPI connection to QCA modem
-    SPI.begin(SPI_SCK, SPI_MISO, SPI_MOSI, PIN_QCA700X_CS);
-    // SPI mode is MODE3 (Idle = HIGH, clock in on rising edge), we use a 10Mhz SPI clock
-    SPI.beginTransaction(SPISettings(10000000, MSBFIRST, SPI_MODE3));
-    //attachInterrupt(digitalPinToInterrupt(PIN_QCA700X_INT), SPI_InterruptHandler, RISING);
+    // configure SPI connection to QCA modem (pins, MODE3, QCA_SPI_CLOCK_HZ)
+    g_qca_bus->init();
 
     Serial.begin();
     Serial.printf("\npowerup\n");
+    plc_log_reset();
+    plc_log_start();
     diag_auth_init(DIAG_AUTH_TOKEN, DIAG_AUTH_WINDOW_MS);
     iso_watchdog_configure(ISO_STATE_TIMEOUT_MS, ISO_STATE_WATCHDOG_MAX_RETRIES);
 
-    // Create Task 20ms Timer
-    xTaskCreate(
-        Timer20ms,      // Function that should be called
-        "Timer20ms",    // Name of the task (for debugging)
-        3072,           // Stack size (bytes)                              
-        NULL,           // Parameter to pass
-        1,              // Task priority
-        NULL            // Task handle
-    );
+    nmk_pool_reset();
+    nmk_pool_refill();
+    g_slac.begin(0, myMac, &g_slac_port);     // starts in MODEM_POWERUP
+
+    // SPI task first: it creates the locks the periodic tasks rely on.
+    qca_spi_start();
 
-    
     esp_read_mac(myMac, ESP_MAC_ETH); // select the Ethernet MAC     
     setSeccIp();  // use myMac to create link-local IPv6 address.
 
@@ -1166,14 +1262,19 @@ void setup() {
     if (!pki_store_init()) {
         Serial.println("[PKI] Failed to initialize PKI store, using embedded credentials");
     }
-#ifdef ESP_PLATFORM
+
+    // CP, CAN and protocol timer tasks (formerly the single Timer20ms task).
+    // They run above setup() on both cores, so they start only once the MAC,
+    // CP PWM/ADC, CAN and lwIP bridge are set up.
+    if (g_qca_rx_irq_mode) {
+        attachInterrupt(digitalPinToInterrupt(PIN_QCA700X_INT), qca_rx_isr, RISING);
+    }
+    periodic_tasks_start();
+#if defined(ESP_PLATFORM) && IPV6_STACK_LWIP
     sdp_server_start();
-    tcp_socket_server_start();
-    tls_server_start();
+    hlc_server_start();
 #endif
     iso20_init();
-
-    modem_state = MODEM_POWERUP;
    
 }
 
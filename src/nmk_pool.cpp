@@ -0,0 +1,83 @@
+#include "nmk_pool.h"
+
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_system.h"
+#else
+#include <Arduino.h>
+#endif
+
+namespace {
+struct NmkKey {
+    uint8_t nmk[16];
+    uint8_t nid[7];
+};
+
+NmkKey g_pool[NMK_POOL_SIZE];
+uint8_t g_head = 0;     // next key to hand out
+uint8_t g_level = 0;
+uint32_t g_taken = 0;
+uint32_t g_drawn = 0;
+uint32_t g_empty = 0;
+NmkRandomFill g_fill = nullptr;
+
+void default_fill(void *buf, uint32_t len) {
+#ifdef ESP_PLATFORM
+    esp_fill_random(buf, len);
+#else
+    uint8_t *p = (uint8_t *)buf;
+    for (uint32_t i = 0; i < len; i++) p[i] = (uint8_t)random(256);
+#endif
+}
+
+void draw(NmkKey *k) {
+    (g_fill ? g_fill : default_fill)(k->nmk, sizeof(k->nmk));
+    memcpy(k->nid, k->nmk, sizeof(k->nid));
+    k->nid[0] &= 0x3F;  // ensure upper two bits are zero
+}
+}
+
+void nmk_pool_reset(void) {
+    memset(g_pool, 0, sizeof(g_pool));
+    g_head = 0;
+    g_level = 0;
+    g_taken = 0;
+    g_drawn = 0;
+    g_empty = 0;
+}
+
+void nmk_pool_refill(void) {
+    while (g_level < NMK_POOL_SIZE) {
+        draw(&g_pool[(g_head + g_level) % NMK_POOL_SIZE]);
+        g_level++;
+        g_drawn++;
+    }
+}
+
+void nmk_pool_take(uint8_t nmk[16], uint8_t nid[7]) {
+    NmkKey k;
+    if (g_level) {
+        k = g_pool[g_head];
+        memset(&g_pool[g_head], 0, sizeof(NmkKey));
+        g_head = (uint8_t)((g_head + 1) % NMK_POOL_SIZE);
+        g_level--;
+    } else {
+        draw(&k);
+        g_empty++;
+    }
+    memcpy(nmk, k.nmk, sizeof(k.nmk));
+    memcpy(nid, k.nid, sizeof(k.nid));
+    g_taken++;
+}
+
+void nmk_pool_stats(NmkPoolStats *out) {
+    out->level = g_level;
+    out->taken = g_taken;
+    out->drawn = g_drawn;
+    out->empty = g_empty;
+}
+
+void nmk_pool_set_source(NmkRandomFill fill) {
+    g_fill = fill;
+}
@@ -0,0 +1,131 @@
+#include "perf_probe.h"
+
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+namespace {
+struct PerfProbe {
+    uint32_t count;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint64_t sum_cycles;
+    uint32_t last_mark;
+    bool marked;
+    uint32_t buckets[PERF_PROBE_BUCKETS];
+};
+
+const char *const kProbeNames[PERF_PROBE_COUNT] = {
+    "cp_tick",
+    "dc_can_tick",
+    "qca_rx_drain",
+    "qca_tx_flush",
+    "tcp_tick",
+    "cp_period",
+    "can_period",
+    "proto_period",
+};
+
+PerfProbe g_probes[PERF_PROBE_COUNT];
+
+uint8_t bucket_of(uint32_t cycles) {
+    uint8_t b = 0;
+    while (cycles && b < PERF_PROBE_BUCKETS - 1) {
+        cycles >>= 1;
+        b++;
+    }
+    return b;
+}
+
+uint32_t bucket_edge_us(uint8_t b) {
+    return (uint32_t)(((1ull << b) - 1) / perf_probe_cycles_per_us());
+}
+
+uint32_t percentile_us(const PerfProbe &p, uint32_t permille) {
+    uint64_t target = ((uint64_t)p.count * permille + 999) / 1000;
+    uint64_t seen = 0;
+    for (uint8_t b = 0; b < PERF_PROBE_BUCKETS; ++b) {
+        seen += p.buckets[b];
+        if (seen >= target) {
+            uint32_t edge = bucket_edge_us(b);
+            uint32_t max_us = p.max_cycles / perf_probe_cycles_per_us();
+            return edge < max_us ? edge : max_us;
+        }
+    }
+    return p.max_cycles / perf_probe_cycles_per_us();
+}
+}
+
+uint32_t perf_probe_now(void) {
+#ifdef ESP_PLATFORM
+    return ESP.getCycleCount();
+#else
+    // host: nanoseconds stand in for cycles of a 1 GHz core
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+uint32_t perf_probe_cycles_per_us(void) {
+#ifdef ESP_PLATFORM
+    static uint32_t mhz = 0;
+    if (!mhz) mhz = getCpuFrequencyMhz();
+    return mhz ? mhz : 240;
+#else
+    return 1000;
+#endif
+}
+
+void perf_probe_record(uint8_t id, uint32_t cycles) {
+    if (id >= PERF_PROBE_COUNT) return;
+    PerfProbe &p = g_probes[id];
+    if (p.count == 0 || cycles < p.min_cycles) p.min_cycles = cycles;
+    if (cycles > p.max_cycles) p.max_cycles = cycles;
+    p.sum_cycles += cycles;
+    p.count++;
+    p.buckets[bucket_of(cycles)]++;
+}
+
+void perf_probe_mark(uint8_t id) {
+    if (id >= PERF_PROBE_COUNT) return;
+    PerfProbe &p = g_probes[id];
+    uint32_t now = perf_probe_now();
+    if (p.marked) perf_probe_record(id, now - p.last_mark);
+    p.last_mark = now;
+    p.marked = true;
+}
+
+void perf_probe_reset(void) {
+    memset(g_probes, 0, sizeof(g_probes));
+}
+
+bool perf_probe_get(uint8_t id, PerfProbeStats *out) {
+    if (id >= PERF_PROBE_COUNT) return false;
+    const PerfProbe &p = g_probes[id];
+    uint32_t cpu = perf_probe_cycles_per_us();
+    out->name = kProbeNames[id];
+    out->count = p.count;
+    out->min_us = p.min_cycles / cpu;
+    out->max_us = p.max_cycles / cpu;
+    out->avg_us = p.count ? (uint32_t)(p.sum_cycles / p.count / cpu) : 0;
+    out->p50_us = p.count ? percentile_us(p, 500) : 0;
+    out->p99_us = p.count ? percentile_us(p, 990) : 0;
+    return true;
+}
+
+bool perf_probe_histogram(uint8_t id, uint32_t *buckets) {
+    if (id >= PERF_PROBE_COUNT) return false;
+    memcpy(buckets, g_probes[id].buckets, sizeof(g_probes[id].buckets));
+    return true;
+}
+
+int perf_probe_find(const char *name) {
+    for (uint8_t i = 0; i < PERF_PROBE_COUNT; ++i) {
+        if (!strcmp(kProbeNames[i], name)) return i;
+    }
+    return -1;
+}
@@ -13,7 +13,8 @@ Preferences g_pki_prefs;
 bool g_pki_ready = false;
 constexpr const char *kNamespace = "pki";
 constexpr const char *kServerCertKey = "srv_cert";
-constexpr const char *kServerKeyKey = "srv_key";
+constexpr const char *kServerKeyKey = "srv_key";      // PEM, before keys moved to DER
+constexpr const char *kServerKeyDerKey = "srv_key_der";
 constexpr const char *kRootKey = "root_ca";
 
 bool ensure_ready() {
@@ -34,6 +35,19 @@ bool write_pref(const char *key, const std::string &data) {
     if (!ensure_ready()) return false;
     return g_pki_prefs.putString(key, data.c_str()) > 0;
 }
+
+bool read_blob(const char *key, std::string &out) {
+    if (!ensure_ready() || !g_pki_prefs.isKey(key)) return false;
+    size_t len = g_pki_prefs.getBytesLength(key);
+    if (!len) return false;
+    out.resize(len);
+    return g_pki_prefs.getBytes(key, &out[0], len) == len;
+}
+
+bool write_blob(const char *key, const std::string &data) {
+    if (!ensure_ready() || data.empty()) return false;
+    return g_pki_prefs.putBytes(key, data.data(), data.size()) == data.size();
+}
 }  // namespace
 
 bool pki_store_init() {
@@ -49,11 +63,13 @@ bool pki_store_set_server_cert(const std::string &pem) {
 }
 
 bool pki_store_get_server_key(std::string &out) {
-    return read_pref(kServerKeyKey, out);
+    return read_blob(kServerKeyDerKey, out) || read_pref(kServerKeyKey, out);
 }
 
-bool pki_store_set_server_key(const std::string &pem) {
-    return write_pref(kServerKeyKey, pem);
+bool pki_store_set_server_key(const std::string &der) {
+    if (!write_blob(kServerKeyDerKey, der)) return false;
+    if (g_pki_prefs.isKey(kServerKeyKey)) g_pki_prefs.remove(kServerKeyKey);
+    return true;
 }
 
 bool pki_store_get_root_ca(std::string &out) {
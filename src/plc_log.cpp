@@ -0,0 +1,168 @@
+#include "plc_log.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+// Bounded MPSC ring (per-slot sequence numbers): producers claim a slot with a
+// CAS on head and publish it by bumping the slot sequence; the single consumer
+// (PlcLog task or an explicit flush) frees it the same way.
+
+static_assert((PLC_LOG_RING_SIZE & (PLC_LOG_RING_SIZE - 1)) == 0, "PLC_LOG_RING_SIZE must be a power of two");
+
+namespace {
+struct PlcLogRecord {
+    std::atomic<uint32_t> seq;
+    const char *fmt;
+    uint8_t level;
+    uint8_t nargs;
+    uintptr_t args[PLC_LOG_MAX_ARGS];
+};
+
+PlcLogRecord g_ring[PLC_LOG_RING_SIZE];
+std::atomic<uint32_t> g_head{0};
+uint32_t g_tail = 0;
+std::atomic<bool> g_ring_ready{false};
+std::atomic<bool> g_flushing{false};
+bool g_sync = !PLC_LOG_ASYNC;
+PlcLogSink g_sink = nullptr;
+
+std::atomic<uint32_t> g_written{0};
+std::atomic<uint32_t> g_dropped{0};
+uint32_t g_flushed = 0;
+uint16_t g_high_water = 0;
+
+void init_ring() {
+    for (uint32_t i = 0; i < PLC_LOG_RING_SIZE; ++i) g_ring[i].seq.store(i, std::memory_order_relaxed);
+    g_head.store(0, std::memory_order_relaxed);
+    g_tail = 0;
+    g_ring_ready.store(true, std::memory_order_release);
+}
+
+void emit(const char *fmt, const uintptr_t *a) {
+    char line[PLC_LOG_LINE_MAX];
+    int n = snprintf(line, sizeof(line), fmt, a[0], a[1], a[2], a[3], a[4], a[5]);
+    if (n < 0) return;
+    size_t len = (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1;
+    if (g_sink) {
+        g_sink(line, len);
+        return;
+    }
+#ifdef ESP_PLATFORM
+    Serial.write((const uint8_t *)line, len);
+#else
+    fwrite(line, 1, len, stdout);
+#endif
+}
+}
+
+void plc_log_push(uint8_t level, const char *fmt, const uintptr_t *args, uint8_t nargs) {
+    uintptr_t a[PLC_LOG_MAX_ARGS] = {0};
+    if (nargs > PLC_LOG_MAX_ARGS) nargs = PLC_LOG_MAX_ARGS;
+    memcpy(a, args, nargs * sizeof(uintptr_t));
+
+    if (g_sync) {
+        emit(fmt, a);
+        g_written.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (!g_ring_ready.load(std::memory_order_acquire)) init_ring();
+
+    uint32_t pos = g_head.load(std::memory_order_relaxed);
+    PlcLogRecord *rec;
+    while (1) {
+        rec = &g_ring[pos & (PLC_LOG_RING_SIZE - 1)];
+        uint32_t seq = rec->seq.load(std::memory_order_acquire);
+        int32_t dif = (int32_t)(seq - pos);
+        if (dif == 0) {
+            if (g_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (dif < 0) {
+            g_dropped.fetch_add(1, std::memory_order_relaxed);   // full: never block a hot path
+            return;
+        } else {
+            pos = g_head.load(std::memory_order_relaxed);
+        }
+    }
+    rec->fmt = fmt;
+    rec->level = level;
+    rec->nargs = nargs;
+    memcpy(rec->args, a, sizeof(a));
+    rec->seq.store(pos + 1, std::memory_order_release);
+    g_written.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t plc_log_flush(void) {
+    if (!g_ring_ready.load(std::memory_order_acquire)) return 0;
+    // one consumer at a time; a concurrent caller just leaves the work to the other
+    bool expected = false;
+    if (!g_flushing.compare_exchange_strong(expected, true, std::memory_order_acquire)) return 0;
+
+    uint32_t count = 0;
+    uint32_t depth = g_head.load(std::memory_order_relaxed) - g_tail;
+    if (depth > g_high_water) g_high_water = (uint16_t)depth;
+    while (1) {
+        PlcLogRecord *rec = &g_ring[g_tail & (PLC_LOG_RING_SIZE - 1)];
+        if (rec->seq.load(std::memory_order_acquire) != g_tail + 1) break;
+        emit(rec->fmt, rec->args);
+        rec->seq.store(g_tail + PLC_LOG_RING_SIZE, std::memory_order_release);
+        g_tail++;
+        count++;
+    }
+    g_flushed += count;
+    g_flushing.store(false, std::memory_order_release);
+    return count;
+}
+
+void plc_log_set_sync(bool sync) {
+    if (sync) plc_log_flush();   // keep ordering when switching over
+    g_sync = sync;
+}
+
+void plc_log_set_sink(PlcLogSink sink) {
+    g_sink = sink;
+}
+
+void plc_log_stats(PlcLogStats *out) {
+    out->written = g_written.load(std::memory_order_relaxed);
+    out->dropped = g_dropped.load(std::memory_order_relaxed);
+    out->flushed = g_flushed;
+    out->high_water = g_high_water;
+}
+
+void plc_log_reset(void) {
+    init_ring();
+    g_sync = !PLC_LOG_ASYNC;
+    g_sink = nullptr;
+    g_written.store(0, std::memory_order_relaxed);
+    g_dropped.store(0, std::memory_order_relaxed);
+    g_flushed = 0;
+    g_high_water = 0;
+}
+
+#ifdef ESP_PLATFORM
+// Task
+//
+// Lowest useful priority: formats and prints whatever the hot paths queued.
+//
+static void PlcLogTask(void *) {
+    while (1) {
+        plc_log_flush();
+        vTaskDelay(pdMS_TO_TICKS(PLC_LOG_FLUSH_MS));
+    }
+}
+
+void plc_log_start(void) {
+    static bool started = false;
+    if (started) return;
+    started = true;
+    xTaskCreatePinnedToCore(PlcLogTask, "PlcLog", 3072, nullptr, PLC_LOG_TASK_PRIORITY, nullptr, PLC_LOG_TASK_CORE);
+}
+#else
+void plc_log_start(void) {}
+#endif
@@ -0,0 +1,33 @@
+#include "qca_frame.h"
+
+void qca_burst_begin(QcaBurstCursor *cursor, const uint8_t *burst, uint32_t len) {
+    cursor->burst = burst;
+    cursor->len = len;
+    cursor->offset = 0;
+    cursor->error = false;
+}
+
+bool qca_burst_next(QcaBurstCursor *cursor, QcaFrameView *frame) {
+    if (cursor->error) return false;
+    uint32_t remaining = cursor->len - cursor->offset;
+    // anything shorter than a minimum frame plus framing is padding, not a frame
+    if (remaining < QCA_FRAME_OVERHEAD + QCA_FRAME_MIN_LEN) return false;
+
+    const uint8_t *p = cursor->burst + cursor->offset;
+    uint16_t frameLen = p[8] | (p[9] << 8);
+    if (p[4] != 0xAA || p[5] != 0xAA || p[6] != 0xAA || p[7] != 0xAA ||
+        frameLen < QCA_FRAME_MIN_LEN || (uint32_t)frameLen + QCA_FRAME_OVERHEAD > remaining) {
+        cursor->error = true;
+        return false;
+    }
+    const uint8_t *footer = p + QCA_FRAME_HEADER_LEN + frameLen;
+    if (footer[0] != 0x55 || footer[1] != 0x55) {
+        cursor->error = true;
+        return false;
+    }
+
+    frame->data = p + QCA_FRAME_HEADER_LEN;
+    frame->len = frameLen;
+    cursor->offset += frameLen + QCA_FRAME_OVERHEAD;
+    return true;
+}
@@ -0,0 +1,36 @@
+#include "qca_rx_pool.h"
+
+#include <string.h>
+
+void qca_rx_pool_reset(QcaRxPool *pool) {
+    memset(pool->refs, 0, sizeof(pool->refs));
+    memset(&pool->stats, 0, sizeof(pool->stats));
+}
+
+uint8_t *qca_rx_pool_take(QcaRxPool *pool) {
+    for (int8_t i = 0; i < QCA_RX_POOL_BUFFERS; i++) {
+        if (pool->refs[i]) continue;
+        pool->refs[i] = 1;
+        pool->stats.taken++;
+        pool->stats.in_use++;
+        if (pool->stats.in_use > pool->stats.high_water) pool->stats.high_water = pool->stats.in_use;
+        return pool->buf[i];
+    }
+    pool->stats.exhausted++;
+    return nullptr;
+}
+
+int8_t qca_rx_pool_index(const QcaRxPool *pool, const uint8_t *p) {
+    uintptr_t off = (uintptr_t)p - (uintptr_t)pool->buf[0];
+    if (off >= sizeof(pool->buf)) return -1;
+    return (int8_t)(off / QCA_RX_BUFFER_BYTES);
+}
+
+void qca_rx_pool_ref(QcaRxPool *pool, int8_t index) {
+    pool->refs[index]++;
+}
+
+void qca_rx_pool_unref(QcaRxPool *pool, int8_t index) {
+    if (!pool->refs[index]) return;
+    if (--pool->refs[index] == 0) pool->stats.in_use--;
+}
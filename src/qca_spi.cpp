@@ -0,0 +1,342 @@
+#include "qca_spi.h"
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <string.h>
+
+#include "main.h"
+
+#if defined(ESP_PLATFORM) && QCA_SPI_DMA_ENABLE
+#include "driver/spi_master.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#if __has_include("esp_memory_utils.h")
+#include "esp_memory_utils.h"
+#else
+#include "soc/soc_memory_layout.h"
+#endif
+#endif
+
+void qca_spi_frame_header(uint8_t *hdr, uint16_t len) {
+    hdr[0] = 0xAA;
+    hdr[1] = 0xAA;
+    hdr[2] = 0xAA;
+    hdr[3] = 0xAA;
+    hdr[4] = (uint8_t)((len >> 0) & 0xFF);
+    hdr[5] = (uint8_t)((len >> 8) & 0xFF);
+    hdr[6] = 0;
+    hdr[7] = 0;
+}
+
+// --- Arduino SPIClass driver ------------------------------------------------
+
+static QcaSpiStats s_arduino_stats;
+
+static bool arduino_init() {
+    pinMode(PIN_QCA700X_CS, OUTPUT);
+    digitalWrite(PIN_QCA700X_CS, HIGH);
+    SPI.begin(SPI_SCK, SPI_MISO, SPI_MOSI, PIN_QCA700X_CS);
+    // SPI mode is MODE3 (Idle = HIGH, clock in on rising edge)
+    SPI.beginTransaction(SPISettings(QCA_SPI_CLOCK_HZ, MSBFIRST, SPI_MODE3));
+    return true;
+}
+
+static uint16_t arduino_read_register(uint16_t reg) {
+    uint32_t t0 = micros();
+    digitalWrite(PIN_QCA700X_CS, LOW);
+    SPI.transfer16(QCA7K_SPI_READ | QCA7K_SPI_INTERNAL | reg);  // send the command to read the internal register
+    uint16_t value = SPI.transfer16(0x0000);                    // read the data on the bus
+    digitalWrite(PIN_QCA700X_CS, HIGH);
+    s_arduino_stats.transactions++;
+    s_arduino_stats.bytes += 4;
+    s_arduino_stats.busy_us += micros() - t0;
+    return value;
+}
+
+static void arduino_write_register(uint16_t reg, uint16_t value) {
+    uint32_t t0 = micros();
+    digitalWrite(PIN_QCA700X_CS, LOW);
+    SPI.transfer16(QCA7K_SPI_WRITE | QCA7K_SPI_INTERNAL | reg); // send the command to write the internal register
+    SPI.transfer16(value);                                      // write the value to the bus
+    digitalWrite(PIN_QCA700X_CS, HIGH);
+    s_arduino_stats.transactions++;
+    s_arduino_stats.bytes += 4;
+    s_arduino_stats.busy_us += micros() - t0;
+}
+
+static uint32_t arduino_read_burst(uint8_t *dst, uint32_t max) {
+    uint16_t available = arduino_read_register(SPI_REG_RDBUF_BYTE_AVA);
+    if (!available || available > max) return 0;    // prevent buffer overflow
+
+    // Write nr of bytes to read to SPI_REG_BFR_SIZE
+    arduino_write_register(SPI_REG_BFR_SIZE, available);
+
+    uint32_t t0 = micros();
+    digitalWrite(PIN_QCA700X_CS, LOW);
+    SPI.transfer16(QCA7K_SPI_READ | QCA7K_SPI_EXTERNAL);
+    SPI.transfer(dst, available);
+    digitalWrite(PIN_QCA700X_CS, HIGH);
+    s_arduino_stats.transactions++;
+    s_arduino_stats.bytes += 2 + available;
+    s_arduino_stats.busy_us += micros() - t0;
+    s_arduino_stats.rx_bursts++;
+    return available;
+}
+
+static void arduino_write_frames(const QcaTxSlot *const *frames, uint8_t n, uint16_t total) {
+    // Write nr of bytes to write to SPI_REG_BFR_SIZE
+    arduino_write_register(SPI_REG_BFR_SIZE, total);
+
+    uint32_t t0 = micros();
+    digitalWrite(PIN_QCA700X_CS, LOW);
+    SPI.transfer16(QCA7K_SPI_WRITE | QCA7K_SPI_EXTERNAL);      // Write External
+    for (uint8_t i=0; i<n; i++) {
+        SPI.writeBytes(frames[i]->sof, frames[i]->len + 10);    // Header, data, footer
+    }
+    digitalWrite(PIN_QCA700X_CS, HIGH);
+    s_arduino_stats.transactions++;
+    s_arduino_stats.bytes += 2 + total;
+    s_arduino_stats.busy_us += micros() - t0;
+    s_arduino_stats.tx_bursts++;
+}
+
+static void arduino_get_stats(QcaSpiStats *out) {
+    *out = s_arduino_stats;
+}
+
+static const QcaSpiBus s_arduino_bus = {
+    "arduino",
+    arduino_init,
+    arduino_read_register,
+    arduino_write_register,
+    arduino_read_burst,
+    arduino_write_frames,
+    arduino_get_stats,
+};
+
+const QcaSpiBus *qca_spi_arduino_bus(void) {
+    return &s_arduino_bus;
+}
+
+// --- ESP-IDF spi_master driver ----------------------------------------------
+//
+// Half-duplex device with a 16 bit command phase, which is exactly the QCA7005
+// command word. Register accesses are short polling transactions; bursts go
+// through the DMA queue so the SPI task sleeps while the data is clocked. Each
+// sequence (e.g. avail + size + read) holds the bus from start to end so no
+// other device or task can slip in between its chip-select windows.
+
+#if defined(ESP_PLATFORM) && QCA_SPI_DMA_ENABLE
+
+static const uint32_t DMA_BUF_SIZE = (QCA7K_BUFFER_SIZE + 3) & ~3u;
+
+static spi_device_handle_t s_dma_dev = nullptr;
+static uint8_t *s_dma_rx = nullptr;      // DMA capable, word aligned bounce buffers
+static uint8_t *s_dma_tx = nullptr;
+static QcaSpiStats s_dma_stats;
+
+static bool dma_init() {
+    if (s_dma_dev) return true;
+
+    spi_bus_config_t bus = {};
+    bus.mosi_io_num = SPI_MOSI;
+    bus.miso_io_num = SPI_MISO;
+    bus.sclk_io_num = SPI_SCK;
+    bus.quadwp_io_num = -1;
+    bus.quadhd_io_num = -1;
+    bus.max_transfer_sz = DMA_BUF_SIZE;
+    if (spi_bus_initialize(QCA_SPI_HOST, &bus, SPI_DMA_CH_AUTO) != ESP_OK) {
+        Serial.printf("QCA SPI: bus init failed\n");
+        return false;
+    }
+
+    spi_device_interface_config_t dev = {};
+    dev.command_bits = 16;
+    dev.mode = 3;                        // Idle = HIGH, clock in on rising edge
+    dev.clock_speed_hz = QCA_SPI_CLOCK_HZ;
+    dev.spics_io_num = PIN_QCA700X_CS;
+    dev.cs_ena_pretrans = 1;
+    dev.cs_ena_posttrans = 1;
+    dev.flags = SPI_DEVICE_HALFDUPLEX;
+    dev.queue_size = 2;
+    if (spi_bus_add_device(QCA_SPI_HOST, &dev, &s_dma_dev) != ESP_OK) {
+        Serial.printf("QCA SPI: add device failed\n");
+        spi_bus_free(QCA_SPI_HOST);
+        return false;
+    }
+
+    s_dma_rx = (uint8_t *)heap_caps_malloc(DMA_BUF_SIZE, MALLOC_CAP_DMA);
+    s_dma_tx = (uint8_t *)heap_caps_malloc(DMA_BUF_SIZE, MALLOC_CAP_DMA);
+    if (!s_dma_rx || !s_dma_tx) {
+        Serial.printf("QCA SPI: no DMA memory\n");
+        return false;
+    }
+    return true;
+}
+
+static uint16_t dma_register_xfer(uint16_t cmd, uint16_t value, bool read) {
+    spi_transaction_t t = {};
+    t.cmd = cmd;
+    if (read) {
+        t.flags = SPI_TRANS_USE_RXDATA;
+        t.rxlength = 16;
+    } else {
+        t.flags = SPI_TRANS_USE_TXDATA;
+        t.length = 16;
+        t.tx_data[0] = (uint8_t)(value >> 8);
+        t.tx_data[1] = (uint8_t)(value & 0xFF);
+    }
+    spi_device_polling_transmit(s_dma_dev, &t);
+    s_dma_stats.transactions++;
+    s_dma_stats.bytes += 4;
+    return read ? (uint16_t)((t.rx_data[0] << 8) | t.rx_data[1]) : 0;
+}
+
+static void dma_burst(uint16_t cmd, const uint8_t *tx, uint8_t *rx, uint32_t len) {
+    spi_transaction_t t = {};
+    spi_transaction_t *done;
+    t.cmd = cmd;
+    if (rx) {
+        t.rxlength = len * 8;
+        t.rx_buffer = rx;
+    } else {
+        t.length = len * 8;
+        t.tx_buffer = tx;
+    }
+    spi_device_queue_trans(s_dma_dev, &t, portMAX_DELAY);
+    spi_device_get_trans_result(s_dma_dev, &done, portMAX_DELAY);
+    s_dma_stats.transactions++;
+    s_dma_stats.bytes += 2 + len;
+}
+
+static uint16_t dma_read_register(uint16_t reg) {
+    int64_t t0 = esp_timer_get_time();
+    spi_device_acquire_bus(s_dma_dev, portMAX_DELAY);
+    uint16_t value = dma_register_xfer(QCA7K_SPI_READ | QCA7K_SPI_INTERNAL | reg, 0, true);
+    spi_device_release_bus(s_dma_dev);
+    s_dma_stats.busy_us += (uint32_t)(esp_timer_get_time() - t0);
+    return value;
+}
+
+static void dma_write_register(uint16_t reg, uint16_t value) {
+    int64_t t0 = esp_timer_get_time();
+    spi_device_acquire_bus(s_dma_dev, portMAX_DELAY);
+    dma_register_xfer(QCA7K_SPI_WRITE | QCA7K_SPI_INTERNAL | reg, value, false);
+    spi_device_release_bus(s_dma_dev);
+    s_dma_stats.busy_us += (uint32_t)(esp_timer_get_time() - t0);
+}
+
+static uint32_t dma_read_burst(uint8_t *dst, uint32_t max) {
+    int64_t t0 = esp_timer_get_time();
+    spi_device_acquire_bus(s_dma_dev, portMAX_DELAY);
+    uint16_t available = dma_register_xfer(QCA7K_SPI_READ | QCA7K_SPI_INTERNAL | SPI_REG_RDBUF_BYTE_AVA, 0, true);
+    if (available && available <= max && available <= QCA7K_BUFFER_SIZE) {
+        dma_register_xfer(QCA7K_SPI_WRITE | QCA7K_SPI_INTERNAL | SPI_REG_BFR_SIZE, available, false);
+        // DMA straight into dst when it is usable, otherwise through the bounce buffer.
+        bool direct = esp_ptr_dma_capable(dst) && (((uintptr_t)dst & 3) == 0) && (available & 3) == 0;
+        dma_burst(QCA7K_SPI_READ | QCA7K_SPI_EXTERNAL, nullptr, direct ? dst : s_dma_rx, available);
+        if (!direct) {
+            memcpy(dst, s_dma_rx, available);
+            s_dma_stats.rx_bounced++;
+        }
+        s_dma_stats.rx_bursts++;
+    } else {
+        available = 0;
+    }
+    spi_device_release_bus(s_dma_dev);
+    s_dma_stats.busy_us += (uint32_t)(esp_timer_get_time() - t0);
+    return available;
+}
+
+// Slots can be clocked straight from the TX queue when the driver can hold
+// chip select across transactions and the slots sit in DMA capable memory.
+static bool dma_can_stream(const QcaTxSlot *const *frames, uint8_t n) {
+#ifdef SPI_TRANS_CS_KEEP_ACTIVE
+    for (uint8_t i=0; i<n; i++) {
+        if (!esp_ptr_dma_capable(frames[i]->sof)) return false;
+    }
+    return true;
+#else
+    (void)frames;
+    (void)n;
+    return false;
+#endif
+}
+
+// One transaction per frame with chip select held across them, so the modem
+// still sees a single external write. Only the first carries the command word.
+static void dma_stream_frames(const QcaTxSlot *const *frames, uint8_t n, uint16_t total) {
+#ifdef SPI_TRANS_CS_KEEP_ACTIVE
+    for (uint8_t i=0; i<n; i++) {
+        spi_transaction_ext_t t = {};
+        spi_transaction_t *done;
+        t.base.cmd = QCA7K_SPI_WRITE | QCA7K_SPI_EXTERNAL;
+        if (i) t.base.flags |= SPI_TRANS_VARIABLE_CMD;      // command_bits = 0
+        if (i + 1 < n) t.base.flags |= SPI_TRANS_CS_KEEP_ACTIVE;
+        t.base.length = (frames[i]->len + 10) * 8;
+        t.base.tx_buffer = frames[i]->sof;
+        spi_device_queue_trans(s_dma_dev, &t.base, portMAX_DELAY);
+        spi_device_get_trans_result(s_dma_dev, &done, portMAX_DELAY);
+    }
+    s_dma_stats.transactions++;
+    s_dma_stats.bytes += 2 + total;
+#else
+    (void)frames;
+    (void)n;
+    (void)total;
+#endif
+}
+
+static void dma_write_frames(const QcaTxSlot *const *frames, uint8_t n, uint16_t total) {
+    bool stream = dma_can_stream(frames, n);
+    if (!stream && total > DMA_BUF_SIZE) return;
+
+    int64_t t0 = esp_timer_get_time();
+    spi_device_acquire_bus(s_dma_dev, portMAX_DELAY);
+    dma_register_xfer(QCA7K_SPI_WRITE | QCA7K_SPI_INTERNAL | SPI_REG_BFR_SIZE, total, false);
+    if (stream) {
+        dma_stream_frames(frames, n, total);
+    } else {
+        // assemble the whole burst so it goes out as one DMA descriptor chain
+        uint8_t *p = s_dma_tx;
+        for (uint8_t i=0; i<n; i++) {
+            memcpy(p, frames[i]->sof, frames[i]->len + 10);
+            p += frames[i]->len + 10;
+        }
+        s_dma_stats.tx_copied += n;
+        dma_burst(QCA7K_SPI_WRITE | QCA7K_SPI_EXTERNAL, s_dma_tx, nullptr, total);
+    }
+    spi_device_release_bus(s_dma_dev);
+    s_dma_stats.busy_us += (uint32_t)(esp_timer_get_time() - t0);
+    s_dma_stats.tx_bursts++;
+}
+
+static void dma_get_stats(QcaSpiStats *out) {
+    *out = s_dma_stats;
+}
+
+static const QcaSpiBus s_dma_bus = {
+    "spi_master",
+    dma_init,
+    dma_read_register,
+    dma_write_register,
+    dma_read_burst,
+    dma_write_frames,
+    dma_get_stats,
+};
+
+const QcaSpiBus *qca_spi_dma_bus(void) {
+    return &s_dma_bus;
+}
+
+const QcaSpiBus *qca_spi_default_bus(void) {
+    return &s_dma_bus;
+}
+
+#else
+
+const QcaSpiBus *qca_spi_default_bus(void) {
+    return &s_arduino_bus;
+}
+
+#endif
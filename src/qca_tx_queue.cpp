@@ -0,0 +1,69 @@
+#include "qca_tx_queue.h"
+
+#include <string.h>
+
+#include "qca_spi.h"
+
+static const uint32_t RATE_WINDOW_MS = 1000;
+
+void qca_tx_queue_reset(QcaTxQueue *q) {
+    q->head = 0;
+    q->count = 0;
+    memset(&q->stats, 0, sizeof(q->stats));
+    q->rate_window_start_ms = 0;
+    q->rate_window_bytes = 0;
+}
+
+uint8_t *qca_tx_queue_reserve(QcaTxQueue *q, uint16_t len) {
+    if (len == 0 || len > QCA_TX_SLOT_SIZE || q->count >= QCA_TX_QUEUE_DEPTH) {
+        q->stats.dropped++;
+        return nullptr;
+    }
+    uint8_t tail = (uint8_t)((q->head + q->count) % QCA_TX_QUEUE_DEPTH);
+    return q->slots[tail].data;
+}
+
+void qca_tx_queue_commit(QcaTxQueue *q, uint16_t len) {
+    uint8_t tail = (uint8_t)((q->head + q->count) % QCA_TX_QUEUE_DEPTH);
+    QcaTxSlot *slot = &q->slots[tail];
+    slot->len = len;
+    qca_spi_frame_header(slot->sof, len);
+    slot->data[len] = 0x55;
+    slot->data[len + 1] = 0x55;
+    q->count++;
+    q->stats.enqueued++;
+    q->stats.depth = q->count;
+    if (q->count > q->stats.high_water) q->stats.high_water = q->count;
+}
+
+bool qca_tx_queue_push(QcaTxQueue *q, const uint8_t *frame, uint16_t len) {
+    uint8_t *slot = qca_tx_queue_reserve(q, len);
+    if (!slot) return false;
+    memcpy(slot, frame, len);
+    qca_tx_queue_commit(q, len);
+    return true;
+}
+
+const QcaTxSlot *qca_tx_queue_peek(const QcaTxQueue *q, uint8_t index) {
+    if (index >= q->count) return nullptr;
+    return &q->slots[(q->head + index) % QCA_TX_QUEUE_DEPTH];
+}
+
+void qca_tx_queue_pop(QcaTxQueue *q, uint8_t frames, uint32_t bytes, uint32_t now_ms) {
+    if (frames > q->count) frames = q->count;
+    q->head = (uint8_t)((q->head + frames) % QCA_TX_QUEUE_DEPTH);
+    q->count -= frames;
+    q->stats.depth = q->count;
+    q->stats.batches++;
+    q->stats.frames_sent += frames;
+    q->stats.bytes_sent += bytes;
+
+    if (q->rate_window_start_ms == 0) q->rate_window_start_ms = now_ms;
+    q->rate_window_bytes += bytes;
+    uint32_t elapsed = now_ms - q->rate_window_start_ms;
+    if (elapsed >= RATE_WINDOW_MS) {
+        q->stats.bytes_per_s = (uint32_t)(((uint64_t)q->rate_window_bytes * 1000u) / elapsed);
+        q->rate_window_start_ms = now_ms;
+        q->rate_window_bytes = 0;
+    }
+}
@@ -0,0 +1,152 @@
+#include "slac_frames.h"
+
+#include <string.h>
+
+// Offsets in the ethernet frame
+#define OFS_DST_MAC 0
+#define OFS_SRC_MAC 6
+
+namespace {
+
+// CM_SET_KEY.REQ to the local modem (00:B0:52:00:00:01)
+constexpr uint8_t kSetKeyReq[SLAC_SET_KEY_REQ_LEN] = {
+    0x00, 0xB0, 0x52, 0x00, 0x00, 0x01,     // destination MAC
+    0, 0, 0, 0, 0, 0,                       // source MAC
+    0x88, 0xE1,                             // HomePlug AV
+    0x01,                                   // version
+    0x08, 0x60,                             // CM_SET_KEY.REQ
+    0x00, 0x00,                             // fragmentation
+    0x01,                                   // key info type
+    0, 0, 0, 0,                             // my nonce (0x00 in spec!)
+    0, 0, 0, 0,                             // your nonce
+    0x04,                                   // nw info pid
+    0x00, 0x00,                             // prn
+    0x00,                                   // pmn
+    0x00,                                   // CCo capability
+    0, 0, 0, 0, 0, 0, 0,                    // 33-39 NID
+    0x01,                                   // NewEKS, Table A.8 01 is NMK
+    // 41-56 NMK, rest 00
+};
+
+// GET_SW.REQ, broadcast, Qualcomm vendor OUI
+constexpr uint8_t kGetSwReq[SLAC_GET_SW_REQ_LEN] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0, 0, 0, 0, 0, 0,
+    0x88, 0xE1,
+    0x00,
+    0x00, 0xA0,                             // GET_SW.REQ
+    0x00, 0xB0, 0x52,                       // vendor OUI
+};
+
+// Load modem factory defaults (same as holding GPIO3 low for 15 secs)
+constexpr uint8_t kFactoryDefaults[SLAC_FACTORY_DEFAULTS_LEN] = {
+    0x00, 0xB0, 0x52, 0x00, 0x00, 0x01,
+    0, 0, 0, 0, 0, 0,
+    0x88, 0xE1,
+    0x00,
+    0x7C, 0xA0,
+    0x00, 0xB0, 0x52,
+};
+
+constexpr uint8_t kSlacParamCnf[SLAC_PARAM_CNF_LEN] = {
+    0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0,
+    0x88, 0xE1,
+    0x01,
+    0x65, 0x60,                             // CM_SLAC_PARAM.CNF
+    0x00, 0x00,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,     // 19-24 sound target
+    0x00,                                   // 25 sound count
+    0x00,                                   // 26 timeout
+    0x01,                                   // resptype
+    // 28-33 forwarding_sta (PEV MAC), 34-35 00, 36-43 RunId, rest 00
+};
+
+constexpr uint8_t kAttenCharInd[SLAC_ATTEN_CHAR_IND_LEN] = {
+    0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0,
+    0x88, 0xE1,
+    0x01,
+    0x6E, 0x60,                             // CM_ATTEN_CHAR.IND
+    0x00, 0x00,
+    0x00,                                   // apptype
+    0x00,                                   // security
+    // 21-26 PEV MAC, 27-34 RunId, 35-51 source_id and 52-68 response_id
+    // (17 bytes 0x00 each, ISO15118-3 table A.4), 69 sounds, 70 groups, 71-128 ATTEN
+};
+
+constexpr uint8_t kSlacMatchCnf[SLAC_MATCH_CNF_LEN] = {
+    0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0,
+    0x88, 0xE1,
+    0x01,
+    0x7D, 0x60,                             // CM_SLAC_MATCH.CNF
+    0x00, 0x00,
+    0x00,                                   // apptype
+    0x00,                                   // security
+    (uint8_t)(SLAC_MATCH_MVF_LEN & 0xFF), (uint8_t)(SLAC_MATCH_MVF_LEN >> 8),
+    // 23-39 pev_id (zero), 40-45 PEV MAC, 46-62 evse_id (zero), 63-68 EVSE MAC,
+    // 69-76 RunId, 77-84 reserved, 85-91 NID, 92 reserved, 93-108 NMK
+};
+
+inline void put(uint8_t *dst, uint16_t offset, const uint8_t *src, uint8_t len) {
+    memcpy(dst + offset, src, len);
+}
+
+}
+
+uint16_t slac_frame_set_key_req(uint8_t *dst, const SlacFrameFields *f) {
+    memcpy(dst, kSetKeyReq, sizeof(kSetKeyReq));
+    put(dst, OFS_SRC_MAC, f->evse_mac, 6);
+    put(dst, 33, f->nid, 7);
+    put(dst, 41, f->nmk, 16);
+    return sizeof(kSetKeyReq);
+}
+
+uint16_t slac_frame_get_sw_req(uint8_t *dst, const SlacFrameFields *f) {
+    memcpy(dst, kGetSwReq, sizeof(kGetSwReq));
+    put(dst, OFS_SRC_MAC, f->evse_mac, 6);
+    return sizeof(kGetSwReq);
+}
+
+uint16_t slac_frame_factory_defaults(uint8_t *dst, const SlacFrameFields *f) {
+    memcpy(dst, kFactoryDefaults, sizeof(kFactoryDefaults));
+    put(dst, OFS_SRC_MAC, f->evse_mac, 6);
+    return sizeof(kFactoryDefaults);
+}
+
+uint16_t slac_frame_param_cnf(uint8_t *dst, const SlacFrameFields *f, uint8_t sound_count, uint8_t timeout_field) {
+    memcpy(dst, kSlacParamCnf, sizeof(kSlacParamCnf));
+    put(dst, OFS_DST_MAC, f->pev_mac, 6);
+    put(dst, OFS_SRC_MAC, f->evse_mac, 6);
+    dst[25] = sound_count;
+    dst[26] = timeout_field;
+    put(dst, 28, f->pev_mac, 6);
+    put(dst, 36, f->run_id, 8);
+    return sizeof(kSlacParamCnf);
+}
+
+uint16_t slac_frame_atten_char_ind(uint8_t *dst, const SlacFrameFields *f, uint8_t sounds,
+                                   const uint8_t *atten) {
+    memcpy(dst, kAttenCharInd, sizeof(kAttenCharInd));
+    put(dst, OFS_DST_MAC, f->pev_mac, 6);
+    put(dst, OFS_SRC_MAC, f->evse_mac, 6);
+    put(dst, 21, f->pev_mac, 6);
+    put(dst, 27, f->run_id, 8);
+    dst[69] = sounds;
+    dst[70] = SLAC_ATTEN_GROUPS;
+    put(dst, 71, atten, SLAC_ATTEN_GROUPS);
+    return sizeof(kAttenCharInd);
+}
+
+uint16_t slac_frame_match_cnf(uint8_t *dst, const SlacFrameFields *f) {
+    memcpy(dst, kSlacMatchCnf, sizeof(kSlacMatchCnf));
+    put(dst, OFS_DST_MAC, f->pev_mac, 6);
+    put(dst, OFS_SRC_MAC, f->evse_mac, 6);
+    put(dst, 40, f->pev_mac, 6);
+    put(dst, 63, f->evse_mac, 6);
+    put(dst, 69, f->run_id, 8);
+    put(dst, 85, f->nid, 7);
+    put(dst, 93, f->nmk, 16);
+    return sizeof(kSlacMatchCnf);
+}
@@ -0,0 +1,359 @@
+#include "slac_session.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+#include "evse_config.h"
+#include "main.h"
+#include "nmk_pool.h"
+#include "plc_log.h"
+
+namespace {
+const uint8_t MAX_SUPPORTED_SOUND_COUNT = 20;
+const uint8_t SLAC_MAX_RETRIES = 3;
+const uint8_t ATTEN_CHAR_MAX_RETRIES = 3;
+const uint32_t ATTEN_CHAR_RESPONSE_TIMEOUT_MS = 500;
+const uint32_t DEFAULT_SLAC_MATCH_TIMEOUT_MS = 2000;
+const uint32_t SLAC_MATCH_TIMEOUT_MARGIN_MS = 1000;
+const uint32_t MIN_SOUND_WINDOW_MS = 200;
+const uint32_t SOUND_TIMEOUT_UNIT_MS = 100;
+const uint32_t MODEM_SEARCH_TIMEOUT_MS = 1000;
+
+uint16_t management_message_type(const uint8_t *frame) {
+    // calculates the MMTYPE (base value + lower two bits), see Table 11-2 of homeplug spec
+    return frame[16]*256 + frame[15];
+}
+
+uint32_t compute_sound_window_ms(uint8_t timeoutField) {
+    uint8_t effectiveField = timeoutField ? timeoutField : 0x06;
+    uint32_t window = (uint32_t)effectiveField * SOUND_TIMEOUT_UNIT_MS;
+    if (window < MIN_SOUND_WINDOW_MS) window = MIN_SOUND_WINDOW_MS;
+    return window;
+}
+}
+
+void SlacSession::begin(uint8_t idx, const uint8_t *evse_mac, const SlacSessionPort *port) {
+    index = idx;
+    evse_mac_ = evse_mac;
+    port_ = port;
+    reset();
+}
+
+void SlacSession::reset() {
+    static const uint8_t defaultNid[7] = {1, 2, 3, 4, 5, 6, 7};
+    modem_state = MODEM_POWERUP;
+    memset(pev_mac, 0, sizeof(pev_mac));
+    memset(pev_modem_mac, 0, sizeof(pev_modem_mac));
+    memset(modem_mac, 0, sizeof(modem_mac));
+    memset(run_id, 0, sizeof(run_id));
+    atten_reset(&atten);
+    memset(&atten_stats, 0, sizeof(atten_stats));
+    memset(nmk, 0, sizeof(nmk));
+    memcpy(nid, defaultNid, sizeof(nid));
+    sounds_timer = 0;
+    modem_search_timer = 0;
+    atten_char_response_timer = 0;
+    slac_match_timer = 0;
+    modems_found = 0;
+    received_sounds = 0;
+    received_profiles = 0;
+    requested_sound_count = 10;
+    negotiated_sound_count = 10;
+    negotiated_sound_timeout_field = 0x06;
+    sound_window_ms = 600;
+    match_window_ms = DEFAULT_SLAC_MATCH_TIMEOUT_MS;
+    slac_retries = 0;
+    atten_char_retries = 0;
+    key_rotations = 0;
+    key_ready_ms = 0;
+    plug_to_param_ms = 0;
+    plug_to_param_max_ms = 0;
+    plugs_before_key = 0;
+    set_key_timer_ = 0;
+    plug_timer_ = 0;
+    plug_pending_ = false;
+    memset(tx_, 0, sizeof(tx_));
+    memset(atten_char_ind_, 0, sizeof(atten_char_ind_));
+    atten_char_ind_sounds_ = 0;
+    atten_char_ind_profiles_ = 0;
+}
+
+bool SlacSession::link_ready() const {
+    return modem_state == MODEM_LINK_READY;
+}
+
+void SlacSession::send(const uint8_t *frame, uint16_t len) {
+    if (port_ && port_->write) port_->write(port_->ctx, frame, len);
+}
+
+SlacFrameFields SlacSession::fields() const {
+    return SlacFrameFields{evse_mac_, pev_mac, run_id, nid, nmk};
+}
+
+// Next pre-drawn NMK/NID straight to the local modem
+void SlacSession::send_set_key(unsigned long now) {
+    SlacFrameFields f = fields();
+    nmk_pool_take(nmk, nid);
+    send(tx_, slac_frame_set_key_req(tx_, &f));   // minimal 60 bytes according to an4_rev5.pdf
+    PLC_LOGI("transmitting SET_KEY.REQ, to configure the EVSE modem with random NMK\n");
+    set_key_timer_ = now;
+    key_rotations++;
+    modem_state = MODEM_CM_SET_KEY_CNF;
+}
+
+void SlacSession::refresh_match_window() {
+    uint32_t candidate = sound_window_ms + SLAC_MATCH_TIMEOUT_MARGIN_MS;
+    if (candidate < DEFAULT_SLAC_MATCH_TIMEOUT_MS) candidate = DEFAULT_SLAC_MATCH_TIMEOUT_MS;
+    match_window_ms = candidate;
+}
+
+void SlacSession::clear_measurements() {
+    received_sounds = 0;
+    received_profiles = 0;
+    atten_char_response_timer = 0;
+    slac_match_timer = 0;
+    atten_reset(&atten);
+}
+
+void SlacSession::rearm(unsigned long now) {
+    clear_measurements();
+    // during bring-up the first key follows MODEM_SPI_CONFIG anyway
+    if (modem_state == MODEM_POWERUP || modem_state == MODEM_WRITESPACE || modem_state == MODEM_SPI_CONFIG) return;
+    send_set_key(now);
+}
+
+void SlacSession::plugged_in(unsigned long now) {
+    plug_timer_ = now;
+    plug_pending_ = true;
+    if (modem_state == MODEM_CM_SET_KEY_REQ || modem_state == MODEM_CM_SET_KEY_CNF) plugs_before_key++;
+}
+
+void SlacSession::fail(const char *reason, unsigned long now) {
+    PLC_LOGW("SLAC failure: %s (attempt %u/%u)\n",
+                  reason ? reason : "unknown",
+                  slac_retries + 1,
+                  SLAC_MAX_RETRIES);
+    if (slac_retries < SLAC_MAX_RETRIES) {
+        slac_retries++;
+    }
+    atten_char_retries = 0;
+    rearm(now);
+}
+
+void SlacSession::transmit_atten_char_ind(const char *reason, unsigned long now) {
+    // a retry with unchanged measurements resends the frame built for the first attempt
+    if (modem_state != ATTEN_CHAR_IND || atten_char_ind_sounds_ != received_sounds ||
+        atten_char_ind_profiles_ != received_profiles) {
+        SlacFrameFields f = fields();
+        uint8_t reportedSounds = received_sounds ? received_sounds : received_profiles;
+        if (reportedSounds > negotiated_sound_count) reportedSounds = negotiated_sound_count;
+        atten_finish(&atten, &atten_stats);
+        PLC_LOGD("attenuation over %u profiles, max group variance %u\n", atten_stats.samples, atten_stats.max_var);
+        slac_frame_atten_char_ind(atten_char_ind_, &f, reportedSounds,
+                                  SLAC_ATTEN_REPORT_TRIMMED ? atten_stats.trimmed : atten_stats.mean);
+        atten_char_ind_sounds_ = received_sounds;
+        atten_char_ind_profiles_ = received_profiles;
+    }
+    send(atten_char_ind_, SLAC_ATTEN_CHAR_IND_LEN);
+    modem_state = ATTEN_CHAR_IND;
+    atten_char_response_timer = now;
+    if (atten_char_retries < 255) atten_char_retries++;
+    PLC_LOGI("transmitting CM_ATTEN_CHAR.IND (%s) attempt %u/%u\n",
+                  reason ? reason : "start",
+                  atten_char_retries,
+                  ATTEN_CHAR_MAX_RETRIES);
+}
+
+// Received SLAC messages from the PEV are handled here
+void SlacSession::rx(const uint8_t *frame, uint16_t rxbytes, unsigned long now) {
+    uint16_t mnt = management_message_type(frame);
+    SlacFrameFields f = fields();
+
+    if (mnt == (CM_SET_KEY + MMTYPE_CNF)) {
+        PLC_LOGI("received SET_KEY.CNF\n");
+        if (frame[19] == 0x01) {
+            modem_state = MODEM_CONFIGURED;
+            key_ready_ms = now - set_key_timer_;
+            // copy MAC from the EVSE modem. This MAC is not used for communication.
+            memcpy(modem_mac, frame+6, 6);
+            PLC_LOGI("NMK set\n");
+        } else PLC_LOGW("NMK -NOT- set\n");
+
+    } else if (mnt == (CM_SLAC_PARAM + MMTYPE_REQ)) {
+        PLC_LOGI("received CM_SLAC_PARAM.REQ\n");
+        // We received a SLAC_PARAM request from the PEV. This is the initiation of a SLAC procedure.
+        // We extract the pev MAC from it.
+        memcpy(pev_mac, frame+6, 6);
+        // extract the RunId from the SlacParamReq, and store it for later use
+        memcpy(run_id, frame+21, 8);
+        if (rxbytes > 26) {
+            requested_sound_count = frame[25];
+            negotiated_sound_count = requested_sound_count;
+            if (negotiated_sound_count == 0) negotiated_sound_count = 1;
+            if (negotiated_sound_count > MAX_SUPPORTED_SOUND_COUNT) negotiated_sound_count = MAX_SUPPORTED_SOUND_COUNT;
+            negotiated_sound_timeout_field = frame[26] ? frame[26] : 0x06;
+        } else {
+            negotiated_sound_count = 10;
+            negotiated_sound_timeout_field = 0x06;
+        }
+        sound_window_ms = compute_sound_window_ms(negotiated_sound_timeout_field);
+        refresh_match_window();
+        slac_retries = 0;
+        atten_char_retries = 0;
+        received_sounds = 0;
+        received_profiles = 0;
+        PLC_LOGI("Negotiated %u sounds, timeout field %u (~%lums)\n",
+                      negotiated_sound_count,
+                      negotiated_sound_timeout_field,
+                      (unsigned long)sound_window_ms);
+        // We are EVSE, we want to answer.
+        send(tx_, slac_frame_param_cnf(tx_, &f, negotiated_sound_count, negotiated_sound_timeout_field));
+        modem_state = SLAC_PARAM_CNF;
+        PLC_LOGI("transmitting CM_SLAC_PARAM.CNF\n");
+        if (plug_pending_) {
+            plug_pending_ = false;
+            plug_to_param_ms = now - plug_timer_;
+            if (plug_to_param_ms > plug_to_param_max_ms) plug_to_param_max_ms = plug_to_param_ms;
+        }
+
+    } else if (mnt == (CM_START_ATTEN_CHAR + MMTYPE_IND) && modem_state == SLAC_PARAM_CNF) {
+        PLC_LOGI("received CM_START_ATTEN_CHAR.IND\n");
+        bool updatedParameters = false;
+        if (rxbytes > 21 && frame[21] != 0x00) {
+            negotiated_sound_count = frame[21];
+            if (negotiated_sound_count == 0) negotiated_sound_count = 1;
+            if (negotiated_sound_count > MAX_SUPPORTED_SOUND_COUNT) negotiated_sound_count = MAX_SUPPORTED_SOUND_COUNT;
+            updatedParameters = true;
+        }
+        if (rxbytes > 22 && frame[22] != 0x00) {
+            negotiated_sound_timeout_field = frame[22];
+            updatedParameters = true;
+        }
+        sound_window_ms = compute_sound_window_ms(negotiated_sound_timeout_field);
+        refresh_match_window();
+        if (updatedParameters) {
+            PLC_LOGI("Updated sounding window to %lums (%u sounds), match window %lums\n",
+                          (unsigned long)sound_window_ms,
+                          negotiated_sound_count,
+                          (unsigned long)match_window_ms);
+        }
+        sounds_timer = now; // start timer
+        atten_reset(&atten); // reset averages.
+        received_sounds = 0;
+        received_profiles = 0;
+        atten_char_retries = 0;
+        modem_state = MNBC_SOUND;
+
+    } else if (mnt == (CM_MNBC_SOUND + MMTYPE_IND) && modem_state == MNBC_SOUND) {
+        PLC_LOGI("received CM_MNBC_SOUND.IND\n");
+        if (received_sounds < 255) received_sounds++;
+
+    } else if (mnt == (CM_ATTEN_PROFILE + MMTYPE_IND) && modem_state == MNBC_SOUND) {
+        PLC_LOGI("received CM_ATTEN_PROFILE.IND\n");
+        if (rxbytes < 85) {
+            PLC_LOGW("Invalid ATTEN_PROFILE length\n");
+            return;
+        }
+        if (received_profiles < negotiated_sound_count) {
+            atten_add(&atten, frame+27);
+            received_profiles++;
+            if (received_profiles >= negotiated_sound_count && negotiated_sound_count > 0) {
+                transmit_atten_char_ind("sounds complete", now);
+            }
+        }
+
+    } else if (mnt == (CM_ATTEN_CHAR + MMTYPE_RSP) && modem_state == ATTEN_CHAR_IND) {
+        PLC_LOGI("received CM_ATTEN_CHAR.RSP\n");
+        // verify pevMac, RunID, and succesful Slac fields
+        if (memcmp(pev_mac, frame+21, 6) == 0 && memcmp(run_id, frame+27, 8) == 0 && frame[69] == 0) {
+            PLC_LOGI("Successful SLAC process\n");
+            modem_state = ATTEN_CHAR_RSP;
+            slac_match_timer = now;
+            refresh_match_window();
+            atten_char_retries = 0;
+        } else {
+            PLC_LOGW("ATTEN_CHAR.RSP validation failed (status=0x%02x)\n", frame[69]);
+            if (atten_char_retries < ATTEN_CHAR_MAX_RETRIES) {
+                transmit_atten_char_ind("RSP mismatch", now);
+            } else {
+                fail("ATTEN_CHAR.RSP invalid", now);
+            }
+        }
+
+    } else if (mnt == (CM_SLAC_MATCH + MMTYPE_REQ) && modem_state == ATTEN_CHAR_RSP) {
+        PLC_LOGI("received CM_SLAC_MATCH.REQ\n");
+        // Verify pevMac, RunID and MVFLength fields
+        uint16_t mvfLength = frame[21] + (frame[22] << 8);
+        if (memcmp(pev_mac, frame+40, 6) == 0 && memcmp(run_id, frame+69, 8) == 0 && mvfLength == SLAC_MATCH_MVF_LEN) {
+            send(tx_, slac_frame_match_cnf(tx_, &f));
+            PLC_LOGI("transmitting CM_SLAC_MATCH.CNF\n");
+            modem_state = MODEM_GET_SW_REQ;
+            atten_char_retries = 0;
+            slac_match_timer = 0;
+        } else {
+            fail("SLAC_MATCH verification failed", now);
+        }
+
+    } else if (mnt == (CM_GET_SW + MMTYPE_CNF) && modem_state == MODEM_WAIT_SW) {
+        // Both the local and Pev modem will send their software version.
+        // check if the MAC of the modem is the same as our local modem.
+        if (memcmp(frame+6, modem_mac, 6) != 0) {
+            // Store the Pev modem MAC, as long as it is not random, we can use it for identifying the EV (Autocharge / Plug N Charge)
+            memcpy(pev_modem_mac, frame+6, 6);
+        }
+        PLC_LOGI("received GET_SW.CNF\n");
+        modems_found++;
+    }
+}
+
+// Key setup, GET_SW search and the SLAC timers. Modem bring-up before
+// MODEM_CM_SET_KEY_REQ belongs to the SPI driver that owns the chip select.
+void SlacSession::tick(unsigned long now) {
+    SlacFrameFields f = fields();
+
+    if (modem_state == MODEM_CM_SET_KEY_REQ) {
+        send_set_key(now);
+    } else if (modem_state == MODEM_GET_SW_REQ) {
+        send(tx_, slac_frame_get_sw_req(tx_, &f));
+        PLC_LOGI("Modem Search..\n");
+        modems_found = 0;
+        modem_search_timer = now;        // start timer
+        modem_state = MODEM_WAIT_SW;
+    }
+
+    // Did the Sound timer expire or did we receive enough samples?
+    if (modem_state == MNBC_SOUND) {
+        bool soundsComplete = (negotiated_sound_count > 0) && (received_profiles >= negotiated_sound_count);
+        bool timerExpired = (sounds_timer + sound_window_ms) < now;
+        if (soundsComplete || timerExpired) {
+            transmit_atten_char_ind(soundsComplete ? "sounds complete" : "timeout", now);
+        }
+    }
+
+    if (modem_state == ATTEN_CHAR_IND && (atten_char_response_timer + ATTEN_CHAR_RESPONSE_TIMEOUT_MS) < now) {
+        if (atten_char_retries < ATTEN_CHAR_MAX_RETRIES) {
+            transmit_atten_char_ind("waiting for RSP", now);
+        } else {
+            fail("ATTEN_CHAR.RSP timeout", now);
+        }
+    }
+
+    if (modem_state == ATTEN_CHAR_RSP && (slac_match_timer + match_window_ms) < now) {
+        fail("SLAC_MATCH timeout", now);
+    }
+
+    if (modem_state == MODEM_WAIT_SW && (modem_search_timer + MODEM_SEARCH_TIMEOUT_MS) < now) {
+        PLC_LOGI("MODEM timer expired. ");
+        if (modems_found >= 2) {
+            PLC_LOGI("Found %u modems. Private network between EVSE and PEV established\n", modems_found);
+            PLC_LOGI("PEV MAC: %02x%02x%02x%02x%02x%02x",
+                     pev_mac[0], pev_mac[1], pev_mac[2], pev_mac[3], pev_mac[4], pev_mac[5]);
+            PLC_LOGI(" PEV modem MAC: %02x%02x%02x%02x%02x%02x\n",
+                     pev_modem_mac[0], pev_modem_mac[1], pev_modem_mac[2], pev_modem_mac[3], pev_modem_mac[4], pev_modem_mac[5]);
+            modem_state = MODEM_LINK_READY;
+        } else {
+            PLC_LOGI("(re)transmitting MODEM_GET_SW.REQ\n");
+            modem_state = MODEM_GET_SW_REQ;
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#include "task_monitor.h"
+
+namespace {
+struct TaskMonitorSlot {
+    TaskMonitorStats stats;
+    uint32_t start_us;
+    uint32_t prev_start_us;
+    bool started;
+};
+
+TaskMonitorSlot g_slots[TASK_MONITOR_MAX];
+uint8_t g_count = 0;
+}
+
+void task_monitor_reset(void) {
+    for (uint8_t i = 0; i < TASK_MONITOR_MAX; ++i) g_slots[i] = TaskMonitorSlot();
+    g_count = 0;
+}
+
+int task_monitor_register(const char *name, uint32_t period_ms, uint32_t budget_us) {
+    if (g_count >= TASK_MONITOR_MAX) return -1;
+    TaskMonitorSlot &slot = g_slots[g_count];
+    slot = TaskMonitorSlot();
+    slot.stats.name = name;
+    slot.stats.period_ms = period_ms;
+    slot.stats.budget_us = budget_us;
+    return g_count++;
+}
+
+void task_monitor_begin(int id, uint32_t now_us) {
+    if (id < 0 || id >= g_count) return;
+    TaskMonitorSlot &slot = g_slots[id];
+    if (slot.started && slot.stats.period_ms) {
+        // a little jitter is normal; only a whole missed period counts
+        if (now_us - slot.prev_start_us > 2 * slot.stats.period_ms * 1000u) slot.stats.late_starts++;
+    }
+    slot.prev_start_us = now_us;
+    slot.start_us = now_us;
+    slot.started = true;
+}
+
+void task_monitor_end(int id, uint32_t now_us) {
+    if (id < 0 || id >= g_count) return;
+    TaskMonitorSlot &slot = g_slots[id];
+    TaskMonitorStats &s = slot.stats;
+    uint32_t elapsed = now_us - slot.start_us;
+    s.iterations++;
+    s.last_us = elapsed;
+    if (elapsed > s.max_us) s.max_us = elapsed;
+    s.avg_us = (s.iterations == 1) ? elapsed : s.avg_us - (s.avg_us >> 3) + (elapsed >> 3);
+    if (s.budget_us && elapsed > s.budget_us) s.overruns++;
+}
+
+uint8_t task_monitor_count(void) {
+    return g_count;
+}
+
+bool task_monitor_get(uint8_t id, TaskMonitorStats *out) {
+    if (id >= g_count) return false;
+    *out = g_slots[id].stats;
+    return true;
+}
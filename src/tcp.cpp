@@ -8,7 +8,13 @@
 #include "cp_control.h"
 #include "dc_can.h"
 #include "evse_config.h"
+#include "exi_patch.h"
 #include "iso_watchdog.h"
+#include "perf_probe.h"
+#include "plc_log.h"
+#include "slac_session.h"
+#include "tcp_sender.h"
+#include "v2gtp_framer.h"
 #ifdef ESP_PLATFORM
 #include "esp_system.h"
 #include "esp_timer.h"
@@ -27,8 +33,6 @@ extern "C" {
 #include "cbv2g/iso_2/iso2_msgDefEncoder.h"
 }
 
-/* Todo: implement a retry strategy, to cover the situation that single packets are lost on the way. */
-
 #define NEXT_TCP 0x06  // the next protocol is TCP
 
 #define TCP_FLAG_FIN 0x01
@@ -37,7 +41,6 @@ extern "C" {
 #define TCP_FLAG_PSH 0x08
 #define TCP_FLAG_ACK 0x10
 
-#define EXI_BUFFER_SIZE 1024
 #define SESSIONID_LEN 8
 
 enum class HlcProtocol : uint8_t {
@@ -46,43 +49,38 @@ enum class HlcProtocol : uint8_t {
 };
 
 uint8_t tcpHeaderLen;
-#define TCP_PAYLOAD_LEN 200
-uint8_t tcpPayloadLen;
-uint8_t tcpPayload[TCP_PAYLOAD_LEN];
+uint16_t tcpPayloadLen;
 
 
 #define TCP_ACTIVITY_TIMER_START (5*33) /* 5 seconds */
 uint16_t tcpActivityTimer;
 
-#define TCP_TRANSMIT_PACKET_LEN 200
-uint8_t TcpTransmitPacketLen;
-uint8_t TcpTransmitPacket[TCP_TRANSMIT_PACKET_LEN];
-
-#define TCPIP_TRANSMIT_PACKET_LEN 200
-uint8_t TcpIpRequestLen;
-uint8_t TcpIpRequest[TCPIP_TRANSMIT_PACKET_LEN];
+// Outgoing segments are built in place in txbuffer (Ethernet, IPv6 and TCP
+// headers, then the payload) and handed to qcaspi_write_burst() from there.
+#define ETH_HEADER_LEN 14
+#define IP6_HEADER_LEN 40
+uint16_t TcpTransmitPacketLen;
+uint8_t *const TcpTransmitPacket = txbuffer + ETH_HEADER_LEN + IP6_HEADER_LEN;
+uint16_t TcpIpRequestLen;
+uint8_t *const TcpIpRequest = txbuffer + ETH_HEADER_LEN;
+static_assert(ETH_HEADER_LEN + IP6_HEADER_LEN + 24 + TCP_TX_MSS <= QCA_TX_SLOT_SIZE,
+              "TCP_TX_MSS segments must fit one QCA TX slot");
 
 #define TCP_STATE_CLOSED 0
 #define TCP_STATE_SYN_ACK 1
 #define TCP_STATE_ESTABLISHED 2
-#define TCP_RECEIVE_WINDOW 1000 /* number of octets we are able to receive */
 
 uint8_t tcpState = TCP_STATE_CLOSED;
 uint32_t TcpSeqNr;
 uint32_t TcpAckNr;
 
-#define TCP_RX_DATA_LEN 1000
-uint8_t tcp_rxdataLen=0;
-uint8_t tcp_rxdata[TCP_RX_DATA_LEN];
-uint32_t expectedTcpAckNr = 0;
-bool tcpAwaitingAck = false;
-uint8_t lastTcpPayload[TCP_PAYLOAD_LEN];
-uint8_t lastTcpPayloadLen = 0;
-uint32_t lastTcpTxTimestamp = 0;
-uint8_t tcpRetransmitAttempts = 0;
+V2gtpFramer g_v2gtp_rx;
+V2gtpFrame g_rx_frame;     // frame being decoded; len 0 once consumed
+// Raw-TCP send side. The V2GTP frame in flight stays where it was built
+// (g_exi_tx_frame) until the EV has acked all of it.
+TcpSender g_tcp_tx;
+uint16_t tcpPeerMss = TCP_DEFAULT_PEER_MSS;
 unsigned long tcpLastActivity = 0;
-const uint32_t TCP_RETRANSMIT_TIMEOUT_MS = 1000;
-const uint8_t TCP_MAX_RETRANSMIT = 3;
 const uint32_t TCP_IDLE_TIMEOUT_MS = 5000;
 
 #define stateWaitForSupportedApplicationProtocolRequest 0
@@ -99,19 +97,45 @@ const uint32_t TCP_IDLE_TIMEOUT_MS = 5000;
 
 uint8_t fsmState = stateWaitForSupportedApplicationProtocolRequest;
 
-static struct din_exiDocument dinDocEnc;
-static struct din_exiDocument dinDocDec;
-static struct appHand_exiDocument appHandDoc;
+// EXI documents. A session speaks one protocol, so the handshake, DIN and
+// ISO-2 documents share one decode and one encode slot instead of five
+// separate statics; the decoders and prepare_*_message() initialise the member
+// they use. scripts/exi_ram_report.py prints the size after each link.
+union HlcExiDocument {
+    struct appHand_exiDocument appHand;
+    struct din_exiDocument din;
+    struct iso2_exiDocument iso2;
+};
+
+struct HlcExiWorkspace {
+    HlcExiDocument dec;
+    HlcExiDocument enc;
+};
+
+static HlcExiWorkspace g_exi_workspace;
+
+static struct din_exiDocument &dinDocEnc = g_exi_workspace.enc.din;
+static struct din_exiDocument &dinDocDec = g_exi_workspace.dec.din;
+static struct appHand_exiDocument &appHandDoc = g_exi_workspace.dec.appHand;
+static struct iso2_exiDocument &iso2DocEnc = g_exi_workspace.enc.iso2;
+static struct iso2_exiDocument &iso2DocDec = g_exi_workspace.dec.iso2;
 static exi_bitstream_t g_exi_encode_stream;
 static exi_bitstream_t g_exi_decode_stream;
-static uint8_t g_exi_tx_buffer[EXI_BUFFER_SIZE];
+// Responses are encoded behind V2GTP_HEADER_BYTES of headroom, so the header
+// is written in front of the body and the frame goes out without a copy.
+static uint8_t g_exi_tx_frame[V2GTP_HEADER_BYTES + EXI_TX_BUFFER_BYTES];
+static uint8_t *const g_exi_tx_buffer = g_exi_tx_frame + V2GTP_HEADER_BYTES;
+static_assert(sizeof(g_exi_workspace) + sizeof(g_exi_tx_frame) <= EXI_RAM_BUDGET_BYTES,
+              "EXI documents and TX buffer exceed EXI_RAM_BUDGET_BYTES");
 static int g_exi_err = 0;
 static uint8_t sessionId[SESSIONID_LEN];
 static uint8_t sessionIdLen = 0;
-static struct iso2_exiDocument iso2DocEnc;
-static struct iso2_exiDocument iso2DocDec;
 static exi_bitstream_t g_iso2_encode_stream;
 static exi_bitstream_t g_iso2_decode_stream;
+#if EXI_PATCH_ENABLE
+static ExiPatchCache g_current_demand_cache;
+static ExiPatchCache g_current_demand_req_cache;
+#endif
 
 #ifdef UNIT_TEST
 static const uint8_t kUnitTestSessionId[SESSIONID_LEN] = {0x01, 0x02, 0x03, 0x04,
@@ -219,19 +243,18 @@ void tcp_register_socket_sender(socket_send_cb_t cb) {
 }
 
 static void tcp_bufferPayload(const uint8_t *payload, uint16_t len, bool fromSocket);
-void tcp_retransmitPendingPayload(void);
+static void tcp_sendPending(void);
 void tcp_tick(void);
 void resetHlcSession(void);
 static void setPhysicalValue(dinPhysicalValueType *value, dinunitSymbolType unit, int16_t magnitude, int8_t multiplier, bool includeUnit = true);
 static void populateDcEvseStatus(dinDC_EVSEStatusType *status, dinDC_EVSEStatusCodeType code);
 static void populateAcEvseStatus(dinAC_EVSEStatusType *status);
-static bool handleMeteringReceipt(void);
+static void handleMeteringReceipt(void);
 static void iso_set_physical_value(iso2_PhysicalValueType *value, iso2_unitSymbolType unit, float magnitude);
-static float iso_decode_physical_value(const iso2_PhysicalValueType &value);
 static void iso_populate_dc_evse_status(iso2_DC_EVSEStatusType *status, iso2_DC_EVSEStatusCodeType code);
 static iso2_DC_EVSEStatusCodeType iso_current_evse_status_code(void);
 static void iso_set_evse_id(char *buffer, uint16_t &len, size_t maxLen);
-static bool handle_iso_metering_receipt(void);
+static void handle_iso_metering_receipt(void);
 static void stop_evse_power_output(void);
 static bool decode_iso2_message(void);
 static void prepare_iso2_message(void);
@@ -249,11 +272,6 @@ const int16_t EVSE_PRESENT_VOLTAGE = 400;
 const int16_t EVSE_PRESENT_CURRENT = 0;
 bool chargingActive = false;
 
-static float decodePhysicalValue(const dinPhysicalValueType &value) {
-    float scale = powf(10.0f, (float)value.Multiplier);
-    return (float)value.Value * scale;
-}
-
 static void encodePhysicalValue(dinPhysicalValueType *dst, dinunitSymbolType unit, float val) {
     init_dinPhysicalValueType(dst);
     dst->Unit = unit;
@@ -276,12 +294,12 @@ static dinDC_EVSEStatusCodeType currentEvseStatusCode() {
 
 
 void routeDecoderInputData(void) {
-    if (tcp_rxdataLen <= V2GTP_HEADER_SIZE) {
+    if (!g_rx_frame.len) {
         g_exi_err = -1;
         return;
     }
-    uint8_t *payload = tcp_rxdata + V2GTP_HEADER_SIZE;
-    size_t payloadLen = tcp_rxdataLen - V2GTP_HEADER_SIZE;
+    uint8_t *payload = const_cast<uint8_t *>(g_rx_frame.payload);
+    size_t payloadLen = g_rx_frame.len;
     if (fsmState == stateWaitForSupportedApplicationProtocolRequest) {
         exi_bitstream_init(&g_exi_decode_stream, payload, payloadLen, 0, nullptr);
         return;
@@ -305,14 +323,18 @@ static void setPhysicalValue(dinPhysicalValueType *value, dinunitSymbolType unit
     value->Value = magnitude;
 }
 
-static void populateDcEvseStatus(dinDC_EVSEStatusType *status, dinDC_EVSEStatusCodeType code) {
-    init_dinDC_EVSEStatusType(status);
-    bool isolationUsed = false;
+static bool din_isolation_used(void) {
 #ifdef UNIT_TEST
     if (g_test_iso_override) {
-        isolationUsed = (g_test_iso_used != 0);
+        return g_test_iso_used != 0;
     }
 #endif
+    return false;
+}
+
+static void populateDcEvseStatus(dinDC_EVSEStatusType *status, dinDC_EVSEStatusCodeType code) {
+    init_dinDC_EVSEStatusType(status);
+    bool isolationUsed = din_isolation_used();
     status->EVSEIsolationStatus_isUsed = isolationUsed ? 1 : 0;
     if (isolationUsed) {
         status->EVSEIsolationStatus = dinisolationLevelType_Valid;
@@ -330,17 +352,16 @@ static void populateAcEvseStatus(dinAC_EVSEStatusType *status) {
     status->EVSENotification = dinEVSENotificationType_None;
 }
 
+static int16_t iso_physical_value_raw(float magnitude) {
+    return (int16_t)lroundf(magnitude * 10.0f);   // Multiplier -1
+}
+
 static void iso_set_physical_value(iso2_PhysicalValueType *value, iso2_unitSymbolType unit, float magnitude) {
     if (!value) return;
     init_iso2PhysicalValueType(value);
     value->Unit = unit;
     value->Multiplier = -1;
-    value->Value = (int16_t)lroundf(magnitude * 10.0f);
-}
-
-static float iso_decode_physical_value(const iso2_PhysicalValueType &value) {
-    float scale = powf(10.0f, (float)value.Multiplier);
-    return (float)value.Value * scale;
+    value->Value = iso_physical_value_raw(magnitude);
 }
 
 static void iso_populate_dc_evse_status(iso2_DC_EVSEStatusType *status, iso2_DC_EVSEStatusCodeType code) {
@@ -418,7 +439,7 @@ static bool decode_iso2_message() {
     exi_bitstream_reset(&g_iso2_decode_stream);
     g_exi_err = decode_iso2_exiDocument(&g_iso2_decode_stream, &iso2DocDec);
     if (g_exi_err != 0) {
-        Serial.printf("[EXI] ISO-2 decode failed (%d)\n", g_exi_err);
+        PLC_LOGE("[EXI] ISO-2 decode failed (%d)\n", g_exi_err);
         return false;
     }
     return true;
@@ -437,18 +458,19 @@ static void prepare_iso2_message(void) {
     }
 }
 
-static bool send_iso2_message(void) {
-    exi_bitstream_init(&g_iso2_encode_stream, g_exi_tx_buffer, sizeof(g_exi_tx_buffer), 0, nullptr);
+static int encode_iso2_message(uint8_t *out, uint16_t cap) {
+    exi_bitstream_init(&g_iso2_encode_stream, out, cap, 0, nullptr);
     g_exi_err = encode_iso2_exiDocument(&g_iso2_encode_stream, &iso2DocEnc);
     if (g_exi_err != 0) {
-        Serial.printf("[EXI] ISO-2 encode failed (%d)\n", g_exi_err);
-        return false;
-    }
-    size_t exiLen = exi_bitstream_get_length(&g_iso2_encode_stream);
-    if (exiLen > UINT16_MAX) {
-        Serial.println("[EXI] ISO-2 frame too large");
-        return false;
+        PLC_LOGE("[EXI] ISO-2 encode failed (%d)\n", g_exi_err);
+        return -1;
     }
+    return static_cast<int>(exi_bitstream_get_length(&g_iso2_encode_stream));
+}
+
+static bool send_iso2_message(void) {
+    int exiLen = encode_iso2_message(g_exi_tx_buffer, EXI_TX_BUFFER_BYTES);
+    if (exiLen < 0) return false;
     addV2GTPHeaderAndTransmit(g_exi_tx_buffer, static_cast<uint16_t>(exiLen));
     return true;
 }
@@ -458,7 +480,7 @@ static bool decode_handshake_message() {
     exi_bitstream_reset(&g_exi_decode_stream);
     g_exi_err = decode_appHand_exiDocument(&g_exi_decode_stream, &appHandDoc);
     if (g_exi_err != 0) {
-        Serial.printf("[EXI] Handshake decode failed (%d)\n", g_exi_err);
+        PLC_LOGE("[EXI] Handshake decode failed (%d)\n", g_exi_err);
         return false;
     }
     return true;
@@ -468,7 +490,7 @@ static bool decode_din_message() {
     exi_bitstream_reset(&g_exi_decode_stream);
     g_exi_err = decode_din_exiDocument(&g_exi_decode_stream, &dinDocDec);
     if (g_exi_err != 0) {
-        Serial.printf("[EXI] DIN decode failed (%d)\n", g_exi_err);
+        PLC_LOGE("[EXI] DIN decode failed (%d)\n", g_exi_err);
         return false;
     }
     return true;
@@ -487,34 +509,35 @@ static void prepare_din_message(void) {
     }
 }
 
-static bool send_din_message(void) {
-    exi_bitstream_init(&g_exi_encode_stream, g_exi_tx_buffer, sizeof(g_exi_tx_buffer), 0, nullptr);
+static int encode_din_message(uint8_t *out, uint16_t cap) {
+    exi_bitstream_init(&g_exi_encode_stream, out, cap, 0, nullptr);
     g_exi_err = encode_din_exiDocument(&g_exi_encode_stream, &dinDocEnc);
     if (g_exi_err != 0) {
-        Serial.printf("[EXI] DIN encode failed (%d)\n", g_exi_err);
-        return false;
-    }
-    size_t exiLen = exi_bitstream_get_length(&g_exi_encode_stream);
-    if (exiLen > UINT16_MAX) {
-        Serial.println("[EXI] Encoded DIN frame too large");
-        return false;
+        PLC_LOGE("[EXI] DIN encode failed (%d)\n", g_exi_err);
+        return -1;
     }
+    return static_cast<int>(exi_bitstream_get_length(&g_exi_encode_stream));
+}
+
+static bool send_din_message(void) {
+    int exiLen = encode_din_message(g_exi_tx_buffer, EXI_TX_BUFFER_BYTES);
+    if (exiLen < 0) return false;
     addV2GTPHeaderAndTransmit(g_exi_tx_buffer, static_cast<uint16_t>(exiLen));
     return true;
 }
 
 static bool send_supported_app_protocol_response(uint8_t schemaId) {
-    struct appHand_exiDocument resp;
+    struct appHand_exiDocument &resp = g_exi_workspace.enc.appHand;
     init_appHand_exiDocument(&resp);
     resp.supportedAppProtocolRes_isUsed = 1;
     init_appHand_supportedAppProtocolRes(&resp.supportedAppProtocolRes);
     resp.supportedAppProtocolRes.ResponseCode = appHand_responseCodeType_OK_SuccessfulNegotiation;
     resp.supportedAppProtocolRes.SchemaID = schemaId;
     resp.supportedAppProtocolRes.SchemaID_isUsed = 1;
-    exi_bitstream_init(&g_exi_encode_stream, g_exi_tx_buffer, sizeof(g_exi_tx_buffer), 0, nullptr);
+    exi_bitstream_init(&g_exi_encode_stream, g_exi_tx_buffer, EXI_TX_BUFFER_BYTES, 0, nullptr);
     g_exi_err = encode_appHand_exiDocument(&g_exi_encode_stream, &resp);
     if (g_exi_err != 0) {
-        Serial.printf("[EXI] Handshake encode failed (%d)\n", g_exi_err);
+        PLC_LOGE("[EXI] Handshake encode failed (%d)\n", g_exi_err);
         return false;
     }
     size_t exiLen = exi_bitstream_get_length(&g_exi_encode_stream);
@@ -522,23 +545,16 @@ static bool send_supported_app_protocol_response(uint8_t schemaId) {
     return true;
 }
 
-static bool handleMeteringReceipt(void) {
-    if (!dinDocDec.V2G_Message.Body.MeteringReceiptReq_isUsed) {
-        return false;
-    }
+static void handleMeteringReceipt(void) {
     prepare_din_message();
     dinDocEnc.V2G_Message.Body.MeteringReceiptRes_isUsed = 1;
     init_dinMeteringReceiptResType(&dinDocEnc.V2G_Message.Body.MeteringReceiptRes);
     dinDocEnc.V2G_Message.Body.MeteringReceiptRes.ResponseCode = dinresponseCodeType_OK;
     populateAcEvseStatus(&dinDocEnc.V2G_Message.Body.MeteringReceiptRes.AC_EVSEStatus);
     send_din_message();
-    return true;
 }
 
-static bool handle_iso_metering_receipt(void) {
-    if (!iso2DocDec.V2G_Message.Body.MeteringReceiptReq_isUsed) {
-        return false;
-    }
+static void handle_iso_metering_receipt(void) {
     prepare_iso2_message();
     iso2DocEnc.V2G_Message.Body.MeteringReceiptRes_isUsed = 1;
     init_iso2MeteringReceiptResType(&iso2DocEnc.V2G_Message.Body.MeteringReceiptRes);
@@ -548,71 +564,51 @@ static bool handle_iso_metering_receipt(void) {
     res.DC_EVSEStatus_isUsed = 1;
     iso_populate_dc_evse_status(&res.DC_EVSEStatus, iso_current_evse_status_code());
     send_iso2_message();
-    return true;
 }
 
 void resetHlcSession(void) {
     fsmState = stateWaitForSupportedApplicationProtocolRequest;
     stop_evse_power_output();
-    tcpAwaitingAck = false;
-    lastTcpPayloadLen = 0;
-    expectedTcpAckNr = 0;
-    tcpRetransmitAttempts = 0;
-    tcp_rxdataLen = 0;
+    tcp_sender_start(&g_tcp_tx, nullptr, 0);   // drops the frame in flight
+    v2gtp_framer_flush(&g_v2gtp_rx);
+    g_rx_frame.len = 0;
     tcpLastActivity = 0;
     g_hlc_protocol = HlcProtocol::Din;
     g_iso_expect_payment_details = false;
     g_iso_payment_details_done = false;
+#if EXI_PATCH_ENABLE
+    g_current_demand_cache.valid = false;  // counters survive for diag "hlc"
+    g_current_demand_req_cache.valid = false;
+#endif
     iso_watchdog_clear();
 }
 
 static void tcp_bufferPayload(const uint8_t *payload, uint16_t len, bool fromSocket) {
-    if (!len) return;
-    if ((tcp_rxdataLen + len) > TCP_RX_DATA_LEN) {
-        Serial.printf("TCP RX buffer overflow (%u)\n", tcp_rxdataLen + len);
-        tcp_rxdataLen = 0;
-        resetHlcSession();
-        return;
-    }
-    memcpy(tcp_rxdata + tcp_rxdataLen, payload, len);
-    tcp_rxdataLen += len;
-
-    while (tcp_rxdataLen >= V2GTP_HEADER_SIZE) {
-        if (tcp_rxdata[0] != 0x01 || tcp_rxdata[1] != 0xFE) {
-            Serial.printf("Invalid V2GTP header\n");
-            tcp_rxdataLen = 0;
-            resetHlcSession();
-            return;
-        }
-        uint16_t payloadType = (tcp_rxdata[2] << 8) | tcp_rxdata[3];
-        uint32_t payloadLen = ((uint32_t)tcp_rxdata[4] << 24) |
-                              ((uint32_t)tcp_rxdata[5] << 16) |
-                              ((uint32_t)tcp_rxdata[6] << 8) |
-                              (uint32_t)tcp_rxdata[7];
-        uint32_t frameLen = V2GTP_HEADER_SIZE + payloadLen;
-        if (frameLen > TCP_RX_DATA_LEN) {
-            Serial.printf("V2GTP frame too large (%u)\n", (unsigned int)frameLen);
-            tcp_rxdataLen = 0;
+    while (len) {
+        uint16_t n = v2gtp_framer_write(&g_v2gtp_rx, payload, len);
+        if (!n) {
+            PLC_LOGE("V2GTP RX ring full (%u)\n", v2gtp_framer_level(&g_v2gtp_rx));
             resetHlcSession();
             return;
         }
-        if (tcp_rxdataLen < frameLen) {
-            break; // wait for more data
+        payload += n;
+        len = static_cast<uint16_t>(len - n);
+
+        V2gtpFrame frame;
+        V2gtpNext next;
+        while ((next = v2gtp_framer_next(&g_v2gtp_rx, &frame)) == V2GTP_FRAME) {
+            if (frame.payload_type != 0x8001) {
+                PLC_LOGW("Unsupported V2GTP payload type 0x%04x\n", frame.payload_type);
+                continue;
+            }
+            g_rx_frame = frame;
+            decodeV2GTP();
         }
-        if (payloadType != 0x8001) {
-            Serial.printf("Unsupported V2GTP payload type 0x%04x\n", payloadType);
-            tcp_rxdataLen = 0;
+        if (next == V2GTP_BAD_HEADER) {
+            PLC_LOGW("Invalid V2GTP header\n");
             resetHlcSession();
             return;
         }
-        uint16_t frameLen16 = (uint16_t)frameLen;
-        uint16_t remainderLen = tcp_rxdataLen - frameLen16;
-        tcp_rxdataLen = frameLen16;
-        decodeV2GTP();
-        if (remainderLen) {
-            memmove(tcp_rxdata, tcp_rxdata + frameLen16, remainderLen);
-        }
-        tcp_rxdataLen = remainderLen;
     }
 }
 
@@ -631,77 +627,68 @@ void tcp_transport_connected(void) {
     tcpLastActivity = millis();
 }
 
-void tcp_retransmitPendingPayload(void) {
-    if (!tcpAwaitingAck || lastTcpPayloadLen == 0) return;
-    if ((lastTcpPayloadLen + 20) >= TCP_TRANSMIT_PACKET_LEN) return;
-    tcpHeaderLen = 20;
-    tcpPayloadLen = lastTcpPayloadLen;
-    memcpy(tcpPayload, lastTcpPayload, lastTcpPayloadLen);
-    memcpy(&TcpTransmitPacket[tcpHeaderLen], tcpPayload, tcpPayloadLen);
-    tcp_prepareTcpHeader(TCP_FLAG_PSH | TCP_FLAG_ACK);
-    tcp_packRequestIntoIp();
-    lastTcpTxTimestamp = millis();
-}
-
 void tcp_tick(void) {
     unsigned long now = millis();
     if (tcpState == TCP_STATE_ESTABLISHED) {
-        if (tcpAwaitingAck && lastTcpPayloadLen > 0 &&
-            (now - lastTcpTxTimestamp) > TCP_RETRANSMIT_TIMEOUT_MS) {
-            if (tcpRetransmitAttempts < TCP_MAX_RETRANSMIT) {
-                tcpRetransmitAttempts++;
-                Serial.printf("TCP retransmit attempt %u\n", tcpRetransmitAttempts);
-                tcp_retransmitPendingPayload();
-            } else {
-                Serial.printf("TCP retransmit limit reached\n");
-                tcpState = TCP_STATE_CLOSED;
-                tcpAwaitingAck = false;
-                resetHlcSession();
-            }
+        TcpSenderTick rto = tcp_sender_tick(&g_tcp_tx, now);
+        if (rto == TCP_SENDER_RETRANSMIT) {
+            PLC_LOGW("TCP retransmit attempt %u (RTO %u ms)\n", g_tcp_tx.timeouts, g_tcp_tx.rto_ms);
+            tcp_sendPending();
+        } else if (rto == TCP_SENDER_GIVE_UP) {
+            PLC_LOGW("TCP retransmit limit reached\n");
+            tcpState = TCP_STATE_CLOSED;
+            resetHlcSession();
         }
         if (tcpLastActivity && (now - tcpLastActivity) > TCP_IDLE_TIMEOUT_MS) {
-            Serial.printf("TCP idle timeout\n");
+            PLC_LOGW("TCP idle timeout\n");
             tcpState = TCP_STATE_CLOSED;
-            tcpAwaitingAck = false;
             resetHlcSession();
         }
     }
     uint8_t watchdogState = 0;
     IsoWatchdogResult wd = iso_watchdog_check(now, &watchdogState);
     if (wd == IsoWatchdogResult::Timeout) {
-        Serial.printf("[ISO-2] State %u watchdog timeout\n", watchdogState);
+        PLC_LOGW("[ISO-2] State %u watchdog timeout\n", watchdogState);
         resetHlcSession();
     } else if (wd == IsoWatchdogResult::Fatal) {
-        Serial.printf("[ISO-2] State %u watchdog fatal\n", watchdogState);
+        PLC_LOGE("[ISO-2] State %u watchdog fatal\n", watchdogState);
         resetHlcSession();
         tcp_transport_reset();
     }
 }
 
 
-void tcp_transmit(void) {
-  //showAsHex(tcpPayload, tcpPayloadLen, "tcp_transmit");
-  if (tcpState == TCP_STATE_ESTABLISHED) {  
-    //addToTrace("[TCP] sending data");
+// One data segment of the frame in flight, PSH on the last one.
+static void tcp_sendSegment(const TcpSegment &seg) {
+    TcpSeqNr = seg.seq;
     tcpHeaderLen = 20; /* 20 bytes normal header, no options */
-    if (tcpPayloadLen+tcpHeaderLen < TCP_TRANSMIT_PACKET_LEN) {    
-      memcpy(&TcpTransmitPacket[tcpHeaderLen], tcpPayload, tcpPayloadLen);
-      tcp_prepareTcpHeader(TCP_FLAG_PSH + TCP_FLAG_ACK); /* data packets are always sent with flags PUSH and ACK. */
-      tcp_packRequestIntoIp();
-      if (tcpPayloadLen > 0) {
-        memcpy(lastTcpPayload, tcpPayload, tcpPayloadLen);
-        lastTcpPayloadLen = tcpPayloadLen;
-        expectedTcpAckNr = TcpSeqNr + tcpPayloadLen;
-        tcpAwaitingAck = true;
-        tcpRetransmitAttempts = 0;
-        lastTcpTxTimestamp = millis();
-      }
-    } else {
-      Serial.printf("Error: tcpPayload and header do not fit into TcpTransmitPacket.\n");
-    }      
-  }  
+    tcpPayloadLen = seg.len;
+    memcpy(&TcpTransmitPacket[tcpHeaderLen], seg.data, seg.len);
+    tcp_prepareTcpHeader(seg.push ? (TCP_FLAG_PSH | TCP_FLAG_ACK) : TCP_FLAG_ACK);
+    tcp_packRequestIntoIp();
+}
+
+// Puts whatever the window allows on the wire. TcpSeqNr ends up after the
+// highest byte sent, which is where pure ACKs and the next frame start.
+static void tcp_sendPending(void) {
+    TcpSegment seg;
+    uint32_t now = millis();
+    while (tcp_sender_next(&g_tcp_tx, now, &seg)) tcp_sendSegment(seg);
+    TcpSeqNr = tcp_sender_snd_nxt(&g_tcp_tx);
 }
 
+// Hands a V2GTP frame to the raw-TCP path. The frame must stay valid until it
+// is acked; a frame still in flight is given up.
+static void tcp_transmit(const uint8_t *frame, uint16_t len) {
+    if (tcpState != TCP_STATE_ESTABLISHED || !len) return;
+    tcp_sender_start(&g_tcp_tx, frame, len);
+    tcp_sendPending();
+}
+
+// What we can take: the free part of the V2GTP receive ring.
+static uint16_t tcp_receiveWindow(void) {
+    return V2GTP_RX_RING_BYTES - v2gtp_framer_level(&g_v2gtp_rx);
+}
 
 void addV2GTPHeaderAndTransmit(const uint8_t *exiBuffer, uint16_t exiBufferLen) {
     // takes the bytearray with exidata, and adds a header to it, according to the Vehicle-to-Grid-Transport-Protocol
@@ -710,757 +697,1147 @@ void addV2GTPHeaderAndTransmit(const uint8_t *exiBuffer, uint16_t exiBufferLen)
     // 1 byte protocol version inverted
     // 2 bytes payload type
     // 4 byte payload length
-    tcpPayload[0] = 0x01; // version
-    tcpPayload[1] = 0xfe; // version inverted
-    tcpPayload[2] = 0x80; // payload type. 0x8001 means "EXI data"
-    tcpPayload[3] = 0x01; // 
-    tcpPayload[4] = (uint8_t)(exiBufferLen >> 24); // length 4 byte.
-    tcpPayload[5] = (uint8_t)(exiBufferLen >> 16);
-    tcpPayload[6] = (uint8_t)(exiBufferLen >> 8);
-    tcpPayload[7] = (uint8_t)exiBufferLen;
-    if (exiBufferLen + 8 < TCP_PAYLOAD_LEN) {
-        memcpy(tcpPayload+8, exiBuffer, exiBufferLen);
-        tcpPayloadLen = 8 + exiBufferLen; /* 8 byte V2GTP header, plus the EXI data */
-        //log_v("Step3 %d", tcpPayloadLen);
-        //showAsHex(tcpPayload, tcpPayloadLen, "tcpPayload");
-        if (g_socketSendCb) {
-            g_socketSendCb(tcpPayload, tcpPayloadLen);
-        } else {
-            tcp_transmit();
-        }
+    if (exiBufferLen > EXI_TX_BUFFER_BYTES) {
+        PLC_LOGE("Error: EXI (%u) does not fit into the TX buffer.\n", exiBufferLen);
+        return;
+    }
+    // Encoders write into g_exi_tx_buffer already; the CurrentDemandRes cache
+    // is the only caller with its own bytes.
+    if (exiBuffer != g_exi_tx_buffer) memcpy(g_exi_tx_buffer, exiBuffer, exiBufferLen);
+    uint8_t *frame = g_exi_tx_frame;
+    frame[0] = 0x01; // version
+    frame[1] = 0xfe; // version inverted
+    frame[2] = 0x80; // payload type. 0x8001 means "EXI data"
+    frame[3] = 0x01; // 
+    frame[4] = (uint8_t)(exiBufferLen >> 24); // length 4 byte.
+    frame[5] = (uint8_t)(exiBufferLen >> 16);
+    frame[6] = (uint8_t)(exiBufferLen >> 8);
+    frame[7] = (uint8_t)exiBufferLen;
+    uint16_t frameLen = V2GTP_HEADER_BYTES + exiBufferLen;
+    if (g_socketSendCb) {
+        g_socketSendCb(frame, frameLen);
     } else {
-        Serial.printf("Error: EXI does not fit into tcpPayload.\n");
+        tcp_transmit(frame, frameLen);
     }
 }
 
 
-void decodeV2GTP(void) {
+// CurrentDemandRes fast path. Within one session only the status code, the
+// present voltage/current and (ISO-2) the limit flags change from one response
+// to the next, so the encoded frame is kept in g_current_demand_cache and
+// those fields are rewritten in place (exi_patch.h). Protocol, session id and
+// optional elements form the layout; a change there re-encodes.
+enum CurrentDemandField : uint8_t {
+    CD_STATUS = 0,
+    CD_VOLTAGE,
+    CD_CURRENT,
+    CD_DIN_FIELDS,
+    CD_CURRENT_LIMIT = CD_DIN_FIELDS,
+    CD_VOLTAGE_LIMIT,
+    CD_POWER_LIMIT,
+    CD_ISO_FIELDS
+};
 
-    uint16_t arrayLen, i;
-    uint8_t strNamespace[50];
-    uint8_t SchemaID, n;
-    uint16_t NamespaceLen;
+static const ExiFieldSpec kCurrentDemandFields[CD_ISO_FIELDS] = {
+    {EXI_FIELD_NBIT, 4},    // DC_EVSEStatus.EVSEStatusCode
+    {EXI_FIELD_INT, 0},     // EVSEPresentVoltage.Value
+    {EXI_FIELD_INT, 0},     // EVSEPresentCurrent.Value
+    {EXI_FIELD_BOOL, 0},    // EVSECurrentLimitAchieved
+    {EXI_FIELD_BOOL, 0},    // EVSEVoltageLimitAchieved
+    {EXI_FIELD_BOOL, 0},    // EVSEPowerLimitAchieved
+};
 
+static int din_encode_current_demand_res(const int32_t *v, uint8_t *out, uint16_t cap) {
+    prepare_din_message();
+    dinDocEnc.V2G_Message.Body.CurrentDemandRes_isUsed = 1;
+    init_dinCurrentDemandResType(&dinDocEnc.V2G_Message.Body.CurrentDemandRes);
+    auto &res = dinDocEnc.V2G_Message.Body.CurrentDemandRes;
+    res.ResponseCode = dinresponseCodeType_OK;
+    populateDcEvseStatus(&res.DC_EVSEStatus, static_cast<dinDC_EVSEStatusCodeType>(v[CD_STATUS]));
+    setPhysicalValue(&res.EVSEPresentVoltage, dinunitSymbolType_V, static_cast<int16_t>(v[CD_VOLTAGE]), 0, true);
+    setPhysicalValue(&res.EVSEPresentCurrent, dinunitSymbolType_A, static_cast<int16_t>(v[CD_CURRENT]), 0, true);
+    res.EVSECurrentLimitAchieved = 1;
+    res.EVSEVoltageLimitAchieved = 0;
+    res.EVSEPowerLimitAchieved = 0;
+    res.EVSEMaximumVoltageLimit_isUsed = 0;
+    res.EVSEMaximumCurrentLimit_isUsed = 0;
+    res.EVSEMaximumPowerLimit_isUsed = 0;
+    return encode_din_message(out, cap);
+}
 
-    routeDecoderInputData();
-    bool decodeOk = false;
-    if (fsmState == stateWaitForSupportedApplicationProtocolRequest) {
-        decodeOk = decode_handshake_message();
-    } else if (g_hlc_protocol == HlcProtocol::Iso2) {
-        decodeOk = decode_iso2_message();
-    } else {
-        decodeOk = decode_din_message();
-    }
-    if (!decodeOk) {
-        tcp_rxdataLen = 0;
+static int iso_encode_current_demand_res(const int32_t *v, uint8_t *out, uint16_t cap) {
+    prepare_iso2_message();
+    iso2DocEnc.V2G_Message.Body.CurrentDemandRes_isUsed = 1;
+    init_iso2CurrentDemandResType(&iso2DocEnc.V2G_Message.Body.CurrentDemandRes);
+    auto &res = iso2DocEnc.V2G_Message.Body.CurrentDemandRes;
+    res.ResponseCode = iso2_responseCodeType_OK;
+    iso_populate_dc_evse_status(&res.DC_EVSEStatus, static_cast<iso2_DC_EVSEStatusCodeType>(v[CD_STATUS]));
+    iso_set_physical_value(&res.EVSEPresentVoltage, iso2_unitSymbolType_V, 0.0f);
+    res.EVSEPresentVoltage.Value = static_cast<int16_t>(v[CD_VOLTAGE]);
+    iso_set_physical_value(&res.EVSEPresentCurrent, iso2_unitSymbolType_A, 0.0f);
+    res.EVSEPresentCurrent.Value = static_cast<int16_t>(v[CD_CURRENT]);
+    res.EVSECurrentLimitAchieved = v[CD_CURRENT_LIMIT];
+    res.EVSEVoltageLimitAchieved = v[CD_VOLTAGE_LIMIT];
+    res.EVSEPowerLimitAchieved = v[CD_POWER_LIMIT];
+    iso_set_physical_value(&res.EVSEMaximumVoltageLimit, iso2_unitSymbolType_V, EVSE_MAX_VOLTAGE);
+    res.EVSEMaximumVoltageLimit_isUsed = 1;
+    iso_set_physical_value(&res.EVSEMaximumCurrentLimit, iso2_unitSymbolType_A, EVSE_MAX_CURRENT);
+    res.EVSEMaximumCurrentLimit_isUsed = 1;
+    iso_set_physical_value(&res.EVSEMaximumPowerLimit, iso2_unitSymbolType_W,
+                           EVSE_MAX_POWER_KW * 1000.0f);
+    res.EVSEMaximumPowerLimit_isUsed = 1;
+    iso_set_evse_id(res.EVSEID.characters, res.EVSEID.charactersLen, iso2_EVSEID_CHARACTER_SIZE);
+    res.SAScheduleTupleID = kDefaultSasTupleId;
+    res.MeterInfo_isUsed = 0;
+    res.ReceiptRequired_isUsed = 0;
+    return encode_iso2_message(out, cap);
+}
+
+#define HLC_LAYOUT_LEN (3 + SESSIONID_LEN)
+
+static void hlc_session_layout(uint8_t *layout, uint8_t variant) {
+    layout[0] = static_cast<uint8_t>(g_hlc_protocol);
+    layout[1] = variant;
+    layout[2] = sessionIdLen;
+    memcpy(layout + 3, sessionId, SESSIONID_LEN);
+}
+
+static void send_current_demand_res(const int32_t *values, uint8_t n, ExiEncodeFn encode, uint8_t variant) {
+#if EXI_PATCH_ENABLE
+    uint8_t layout[HLC_LAYOUT_LEN];
+    hlc_session_layout(layout, variant);
+    int len = exi_patch_encode(&g_current_demand_cache, layout, sizeof(layout), kCurrentDemandFields,
+                               values, n, encode);
+    if (len > 0) {
+        addV2GTPHeaderAndTransmit(g_current_demand_cache.bytes, static_cast<uint16_t>(len));
         return;
     }
-    tcp_rxdataLen = 0; /* mark the input data as "consumed" */
+    // Larger than EXI_PATCH_CACHE_BYTES: encode into the TX buffer as before.
+#else
+    (void)variant;
+#endif
+    int full = encode(values, g_exi_tx_buffer, EXI_TX_BUFFER_BYTES);
+    if (full > 0) addV2GTPHeaderAndTransmit(g_exi_tx_buffer, static_cast<uint16_t>(full));
+}
 
-    if (fsmState == stateWaitForSupportedApplicationProtocolRequest) {
+// CurrentDemandReq fast path. The EV repeats the same request every loop with
+// new targets, SoC and flags. The first one of a session is decoded in full,
+// and if encoding it again gives the received bytes it becomes the template of
+// g_current_demand_req_cache. Later requests that equal the template outside
+// the fields below are read from the frame without running the decoder (the
+// body type is part of the compared bits). The handlers only read g_cd_req.
+// PowerDeliveryReq has no template: it comes once at the start and once at the
+// end of power delivery, so a learned frame would serve at most one request,
+// and an ISO-2 request may carry a ChargingProfile of any length.
+enum CurrentDemandReqField : uint8_t {
+    CDQ_EV_READY = 0,
+    CDQ_EV_ERROR,
+    CDQ_SOC,
+    CDQ_VOLTAGE_MULT,       // multiplier + 3
+    CDQ_VOLTAGE,
+    CDQ_CURRENT_MULT,       // multiplier + 3
+    CDQ_CURRENT,
+    CDQ_COMPLETE,
+    CDQ_FIELDS
+};
 
-        // Check if we have received the correct message
-        if (appHandDoc.supportedAppProtocolReq_isUsed) {
-        
-            Serial.printf("SupportedApplicationProtocolRequest\n");
-            // process data when no errors occured during decoding
-            if (g_exi_err == 0) {
-                arrayLen = appHandDoc.supportedAppProtocolReq.AppProtocol.arrayLen;
-                Serial.printf("The car supports %u schemas.\n", arrayLen);
-            
-                // check all schemas for DIN
-                for(n=0; n<arrayLen; n++) {
-                    memset(strNamespace, 0, sizeof(strNamespace));
-                    NamespaceLen = appHandDoc.supportedAppProtocolReq.AppProtocol.array[n].ProtocolNamespace.charactersLen;
-                    SchemaID = appHandDoc.supportedAppProtocolReq.AppProtocol.array[n].SchemaID;
-                    for (i=0; i< NamespaceLen; i++) {
-                        strNamespace[i] = appHandDoc.supportedAppProtocolReq.AppProtocol.array[n].ProtocolNamespace.characters[i];    
-                    }
-                    Serial.printf("strNameSpace %s SchemaID: %u\n", strNamespace, SchemaID);
-
-                    if (strstr((const char*)strNamespace, ":din:70121:") != NULL) {
-                        Serial.printf("Detected DIN\n");
-                        g_hlc_protocol = HlcProtocol::Din;
-                        if (send_supported_app_protocol_response(SchemaID)) {
-                            fsmState = stateWaitForSessionSetupRequest;
-                            iso_watchdog_start_state(stateWaitForSessionSetupRequest);
-                        }
-                    } else if (strstr((const char*)strNamespace, ":iso:15118:2") != NULL) {
-                        Serial.printf("Detected ISO 15118-2\n");
-                        g_hlc_protocol = HlcProtocol::Iso2;
-                        if (send_supported_app_protocol_response(SchemaID)) {
-                            fsmState = stateWaitForSessionSetupRequest;
-                            iso_watchdog_start_state(stateWaitForSessionSetupRequest);
-                        }
-                    }
+static const ExiFieldSpec kCurrentDemandReqFields[CDQ_FIELDS] = {
+    {EXI_FIELD_BOOL, 0},    // DC_EVStatus.EVReady
+    {EXI_FIELD_NBIT, 4},    // DC_EVStatus.EVErrorCode
+    {EXI_FIELD_NBIT, 7},    // DC_EVStatus.EVRESSSOC, 0..100
+    {EXI_FIELD_NBIT, 3},    // EVTargetVoltage.Multiplier, -3..3
+    {EXI_FIELD_INT, 0},     // EVTargetVoltage.Value
+    {EXI_FIELD_NBIT, 3},    // EVTargetCurrent.Multiplier
+    {EXI_FIELD_INT, 0},     // EVTargetCurrent.Value
+    {EXI_FIELD_BOOL, 0},    // ChargingComplete
+};
+
+static int32_t g_cd_req[CDQ_FIELDS];
+static bool g_cd_req_enc_ready = false;
+
+static float cd_req_physical(uint8_t multiplier, uint8_t value) {
+    return (float)g_cd_req[value] * powf(10.0f, (float)(g_cd_req[multiplier] - 3));
+}
+
+template <typename Req>
+static void read_current_demand_req(const Req &req, int32_t *v) {
+    v[CDQ_EV_READY] = req.DC_EVStatus.EVReady;
+    v[CDQ_EV_ERROR] = req.DC_EVStatus.EVErrorCode;
+    v[CDQ_SOC] = req.DC_EVStatus.EVRESSSOC;
+    v[CDQ_VOLTAGE_MULT] = req.EVTargetVoltage.Multiplier + 3;
+    v[CDQ_VOLTAGE] = req.EVTargetVoltage.Value;
+    v[CDQ_CURRENT_MULT] = req.EVTargetCurrent.Multiplier + 3;
+    v[CDQ_CURRENT] = req.EVTargetCurrent.Value;
+    v[CDQ_COMPLETE] = req.ChargingComplete;
+}
+
+template <typename Req>
+static void write_current_demand_req(const int32_t *v, Req &req) {
+    req.DC_EVStatus.EVReady = v[CDQ_EV_READY];
+    req.DC_EVStatus.EVErrorCode = static_cast<decltype(req.DC_EVStatus.EVErrorCode)>(v[CDQ_EV_ERROR]);
+    req.DC_EVStatus.EVRESSSOC = static_cast<int8_t>(v[CDQ_SOC]);
+    req.EVTargetVoltage.Multiplier = static_cast<int8_t>(v[CDQ_VOLTAGE_MULT] - 3);
+    req.EVTargetVoltage.Value = static_cast<int16_t>(v[CDQ_VOLTAGE]);
+    req.EVTargetCurrent.Multiplier = static_cast<int8_t>(v[CDQ_CURRENT_MULT] - 3);
+    req.EVTargetCurrent.Value = static_cast<int16_t>(v[CDQ_CURRENT]);
+    req.ChargingComplete = v[CDQ_COMPLETE];
+}
+
+// Encode callbacks for learning: the decoded request is copied to the encode
+// slot on the first call only, a frozen layout never gets that far.
+static int din_encode_current_demand_req(const int32_t *v, uint8_t *out, uint16_t cap) {
+    if (!g_cd_req_enc_ready) {
+        dinDocEnc = dinDocDec;
+        g_cd_req_enc_ready = true;
+    }
+    write_current_demand_req(v, dinDocEnc.V2G_Message.Body.CurrentDemandReq);
+    return encode_din_message(out, cap);
+}
+
+static int iso_encode_current_demand_req(const int32_t *v, uint8_t *out, uint16_t cap) {
+    if (!g_cd_req_enc_ready) {
+        iso2DocEnc = iso2DocDec;
+        g_cd_req_enc_ready = true;
+    }
+    write_current_demand_req(v, iso2DocEnc.V2G_Message.Body.CurrentDemandReq);
+    return encode_iso2_message(out, cap);
+}
+
+static bool hlc_rx_payload(const uint8_t **payload, uint16_t *len) {
+    if (!g_rx_frame.len) return false;
+    *payload = g_rx_frame.payload;
+    *len = g_rx_frame.len;
+    return true;
+}
+
+// Fully decoded CurrentDemandReq: fill g_cd_req and (re)learn the template.
+static void hlc_take_current_demand_req(void) {
+    if (g_hlc_protocol == HlcProtocol::Iso2) {
+        read_current_demand_req(iso2DocDec.V2G_Message.Body.CurrentDemandReq, g_cd_req);
+    } else {
+        read_current_demand_req(dinDocDec.V2G_Message.Body.CurrentDemandReq, g_cd_req);
+    }
+#if EXI_PATCH_ENABLE
+    const uint8_t *payload;
+    uint16_t len;
+    if (!hlc_rx_payload(&payload, &len)) return;
+    uint8_t layout[HLC_LAYOUT_LEN];
+    hlc_session_layout(layout, 0);
+    g_cd_req_enc_ready = false;
+    exi_patch_learn(&g_current_demand_req_cache, layout, sizeof(layout), payload, len, kCurrentDemandReqFields,
+                    g_cd_req, CDQ_FIELDS,
+                    g_hlc_protocol == HlcProtocol::Iso2 ? iso_encode_current_demand_req
+                                                       : din_encode_current_demand_req);
+#endif
+}
+
+static bool hlc_match_current_demand_req(void) {
+#if EXI_PATCH_ENABLE
+    const uint8_t *payload;
+    uint16_t len;
+    if (!hlc_rx_payload(&payload, &len)) return false;
+    uint8_t layout[HLC_LAYOUT_LEN];
+    hlc_session_layout(layout, 0);
+    return exi_patch_match(&g_current_demand_req_cache, layout, sizeof(layout), payload, len,
+                           kCurrentDemandReqFields, g_cd_req);
+#else
+    return false;
+#endif
+}
+
+static void hlc_app_protocol(void) {
+    uint16_t arrayLen, i;
+    uint8_t strNamespace[50];
+    uint8_t SchemaID, n;
+    uint16_t NamespaceLen;
+
+    PLC_LOGI("SupportedApplicationProtocolRequest\n");
+    // process data when no errors occured during decoding
+    if (g_exi_err == 0) {
+        arrayLen = appHandDoc.supportedAppProtocolReq.AppProtocol.arrayLen;
+        PLC_LOGI("The car supports %u schemas.\n", arrayLen);
+
+        // check all schemas for DIN
+        for(n=0; n<arrayLen; n++) {
+            memset(strNamespace, 0, sizeof(strNamespace));
+            NamespaceLen = appHandDoc.supportedAppProtocolReq.AppProtocol.array[n].ProtocolNamespace.charactersLen;
+            SchemaID = appHandDoc.supportedAppProtocolReq.AppProtocol.array[n].SchemaID;
+            for (i=0; i< NamespaceLen; i++) {
+                strNamespace[i] = appHandDoc.supportedAppProtocolReq.AppProtocol.array[n].ProtocolNamespace.characters[i];
+            }
+            Serial.printf("strNameSpace %s SchemaID: %u\n", strNamespace, SchemaID);
+
+            if (strstr((const char*)strNamespace, ":din:70121:") != NULL) {
+                PLC_LOGI("Detected DIN\n");
+                g_hlc_protocol = HlcProtocol::Din;
+                if (send_supported_app_protocol_response(SchemaID)) {
+                    fsmState = stateWaitForSessionSetupRequest;
+                    iso_watchdog_start_state(stateWaitForSessionSetupRequest);
+                }
+            } else if (strstr((const char*)strNamespace, ":iso:15118:2") != NULL) {
+                PLC_LOGI("Detected ISO 15118-2\n");
+                g_hlc_protocol = HlcProtocol::Iso2;
+                if (send_supported_app_protocol_response(SchemaID)) {
+                    fsmState = stateWaitForSessionSetupRequest;
+                    iso_watchdog_start_state(stateWaitForSessionSetupRequest);
                 }
             }
         }
+    }
+}
 
-    } else if (fsmState == stateWaitForSessionSetupRequest) {
-        
-        if (g_hlc_protocol == HlcProtocol::Iso2) {
-            if (iso2DocDec.V2G_Message.Body.SessionSetupReq_isUsed) {
-                Serial.printf("ISO SessionSetupReq\n");
+static void iso_session_setup(void) {
+    PLC_LOGI("ISO SessionSetupReq\n");
 
-                sessionIdLen = SESSIONID_LEN;
+    sessionIdLen = SESSIONID_LEN;
 #ifdef UNIT_TEST
-                memcpy(sessionId, kUnitTestSessionId, SESSIONID_LEN);
+    memcpy(sessionId, kUnitTestSessionId, SESSIONID_LEN);
 #else
-                for (i = 0; i < sessionIdLen; ++i) {
-                    sessionId[i] = (uint8_t)random(256);
-                }
+    for (uint8_t i = 0; i < sessionIdLen; ++i) {
+        sessionId[i] = (uint8_t)random(256);
+    }
 #endif
 
-                prepare_iso2_message();
-                iso2DocEnc.V2G_Message.Body.SessionSetupRes_isUsed = 1;
-                init_iso2SessionSetupResType(&iso2DocEnc.V2G_Message.Body.SessionSetupRes);
-                iso2DocEnc.V2G_Message.Body.SessionSetupRes.ResponseCode = iso2_responseCodeType_OK_NewSessionEstablished;
-                const char *evseId = EVSE_ID;
-                size_t idLen = strnlen(evseId, iso2_EVSEID_CHARACTER_SIZE - 1);
-                memcpy(iso2DocEnc.V2G_Message.Body.SessionSetupRes.EVSEID.characters, evseId, idLen);
-                iso2DocEnc.V2G_Message.Body.SessionSetupRes.EVSEID.charactersLen = idLen;
-                iso2DocEnc.V2G_Message.Body.SessionSetupRes.EVSETimeStamp_isUsed = 0;
-                send_iso2_message();
-                fsmState = stateWaitForServiceDiscoveryRequest;
-                iso_watchdog_start_state(stateWaitForServiceDiscoveryRequest);
-                return;
-            }
-        }
+    prepare_iso2_message();
+    iso2DocEnc.V2G_Message.Body.SessionSetupRes_isUsed = 1;
+    init_iso2SessionSetupResType(&iso2DocEnc.V2G_Message.Body.SessionSetupRes);
+    iso2DocEnc.V2G_Message.Body.SessionSetupRes.ResponseCode = iso2_responseCodeType_OK_NewSessionEstablished;
+    const char *evseId = EVSE_ID;
+    size_t idLen = strnlen(evseId, iso2_EVSEID_CHARACTER_SIZE - 1);
+    memcpy(iso2DocEnc.V2G_Message.Body.SessionSetupRes.EVSEID.characters, evseId, idLen);
+    iso2DocEnc.V2G_Message.Body.SessionSetupRes.EVSEID.charactersLen = idLen;
+    iso2DocEnc.V2G_Message.Body.SessionSetupRes.EVSETimeStamp_isUsed = 0;
+    send_iso2_message();
+    fsmState = stateWaitForServiceDiscoveryRequest;
+    iso_watchdog_start_state(stateWaitForServiceDiscoveryRequest);
+}
 
-        // Check if we have received the correct message
-        if (dinDocDec.V2G_Message.Body.SessionSetupReq_isUsed) {
-
-            Serial.printf("SessionSetupReqest\n");
-
-            //n = dinDocDec.V2G_Message.Header.SessionID.bytesLen;
-            //for (i=0; i< n; i++) {
-            //    Serial.printf("%02x", dinDocDec.V2G_Message.Header.SessionID.bytes[i] );
-            //}
-            n = dinDocDec.V2G_Message.Body.SessionSetupReq.EVCCID.bytesLen;
-            if (n>6) n=6;       // out of range check
-            Serial.printf("EVCCID=");
-            for (i=0; i<n; i++) {
-                EVCCID[i]= dinDocDec.V2G_Message.Body.SessionSetupReq.EVCCID.bytes[i];
-                Serial.printf("%02x", EVCCID[i] );
-            }
-            Serial.printf("\n");
-            
-            sessionIdLen = SESSIONID_LEN;
+static void din_session_setup(void) {
+    uint8_t n;
+    uint16_t i;
+
+    PLC_LOGI("SessionSetupReqest\n");
+
+    //n = dinDocDec.V2G_Message.Header.SessionID.bytesLen;
+    //for (i=0; i< n; i++) {
+    //    Serial.printf("%02x", dinDocDec.V2G_Message.Header.SessionID.bytes[i] );
+    //}
+    n = dinDocDec.V2G_Message.Body.SessionSetupReq.EVCCID.bytesLen;
+    if (n>6) n=6;       // out of range check
+    for (i=0; i<n; i++) {
+        EVCCID[i]= dinDocDec.V2G_Message.Body.SessionSetupReq.EVCCID.bytes[i];
+    }
+    PLC_LOGI("EVCCID=%02x%02x%02x%02x%02x%02x\n",
+             EVCCID[0], EVCCID[1], EVCCID[2], EVCCID[3], EVCCID[4], EVCCID[5]);
+
+    sessionIdLen = SESSIONID_LEN;
 #ifdef UNIT_TEST
-            memcpy(sessionId, kUnitTestSessionId, SESSIONID_LEN);
+    memcpy(sessionId, kUnitTestSessionId, SESSIONID_LEN);
 #else
-            for (i=0; i<sessionIdLen; i++) {
-                sessionId[i] = (uint8_t)random(256);
-            }
+    for (i=0; i<sessionIdLen; i++) {
+        sessionId[i] = (uint8_t)random(256);
+    }
 #endif
 
-            // Now prepare the 'SessionSetupResponse' message to send back to the EV
-            prepare_din_message();
-            
-            dinDocEnc.V2G_Message.Body.SessionSetupRes_isUsed = 1;
-            init_dinSessionSetupResType(&dinDocEnc.V2G_Message.Body.SessionSetupRes);
-            dinDocEnc.V2G_Message.Body.SessionSetupRes.ResponseCode = dinresponseCodeType_OK_NewSessionEstablished;
-            const char *evseId = EVSE_ID;
-            size_t idLen = strnlen(evseId, sizeof(dinDocEnc.V2G_Message.Body.SessionSetupRes.EVSEID.bytes));
-            memcpy(dinDocEnc.V2G_Message.Body.SessionSetupRes.EVSEID.bytes, evseId, idLen);
-            dinDocEnc.V2G_Message.Body.SessionSetupRes.EVSEID.bytesLen = idLen;
-
-            // Send SessionSetupResponse to EV
-            send_din_message();
-            fsmState = stateWaitForServiceDiscoveryRequest;
-        }    
-        
-    } else if (fsmState == stateWaitForServiceDiscoveryRequest) {
-
-
-        if (g_hlc_protocol == HlcProtocol::Iso2) {
-            if (iso2DocDec.V2G_Message.Body.ServiceDiscoveryReq_isUsed) {
-                Serial.printf("ISO ServiceDiscoveryReqest\n");
-                prepare_iso2_message();
-                iso2DocEnc.V2G_Message.Body.ServiceDiscoveryRes_isUsed = 1;
-                init_iso2ServiceDiscoveryResType(&iso2DocEnc.V2G_Message.Body.ServiceDiscoveryRes);
-                auto &res = iso2DocEnc.V2G_Message.Body.ServiceDiscoveryRes;
-                res.ResponseCode = iso2_responseCodeType_OK;
-                res.PaymentOptionList.PaymentOption.arrayLen = 1;
-                res.PaymentOptionList.PaymentOption.array[0] = iso2_paymentOptionType_ExternalPayment;
-                res.ChargeService.ServiceID = 1;
-                res.ChargeService.ServiceCategory = iso2_serviceCategoryType_EVCharging;
-                res.ChargeService.FreeService = 0;
-                res.ChargeService.ServiceName_isUsed = 0;
-                res.ChargeService.ServiceScope_isUsed = 0;
-                res.ChargeService.SupportedEnergyTransferMode.EnergyTransferMode.arrayLen = 1;
-                res.ChargeService.SupportedEnergyTransferMode.EnergyTransferMode.array[0] = iso2_EnergyTransferModeType_DC_extended;
-                res.ServiceList_isUsed = 0;
-                const char *svc = EVSE_SERVICE_NAME;
-                size_t svcLen = strnlen(svc, iso2_ServiceName_CHARACTER_SIZE - 1);
-                if (svcLen) {
-                    memcpy(res.ChargeService.ServiceName.characters, svc, svcLen);
-                    res.ChargeService.ServiceName.charactersLen = svcLen;
-                    res.ChargeService.ServiceName_isUsed = 1;
-                }
-                send_iso2_message();
-                fsmState = stateWaitForServicePaymentSelectionRequest;
-                iso_watchdog_start_state(stateWaitForServicePaymentSelectionRequest);
-                return;
-            }
-        }
+    // Now prepare the 'SessionSetupResponse' message to send back to the EV
+    prepare_din_message();
 
-        // Check if we have received the correct message
-        if (dinDocDec.V2G_Message.Body.ServiceDiscoveryReq_isUsed) {
-
-            Serial.printf("ServiceDiscoveryReqest\n");
-            n = dinDocDec.V2G_Message.Header.SessionID.bytesLen;
-            Serial.printf("SessionID:");
-            for (i=0; i<n; i++) Serial.printf("%02x", dinDocDec.V2G_Message.Header.SessionID.bytes[i] );
-            Serial.printf("\n");
-            
-            // Now prepare the 'ServiceDiscoveryResponse' message to send back to the EV
-            prepare_din_message();
-            
-            dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes_isUsed = 1;
-            init_dinServiceDiscoveryResType(&dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes);
-            dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ResponseCode = dinresponseCodeType_OK;
-            /* the mandatory fields in the ISO are PaymentOptionList and ChargeService.
-            But in the DIN, this is different, we find PaymentOptions, ChargeService and optional ServiceList */
-            dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.PaymentOptions.PaymentOption.array[0] = dinpaymentOptionType_ExternalPayment; /* EVSE handles the payment */
-            dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.PaymentOptions.PaymentOption.arrayLen = 1; /* just one single payment option in the table */
-            dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.ServiceTag.ServiceID = 1; /* todo: not clear what this means  */
-            //dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.ServiceTag.ServiceName
-            //dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.ServiceTag.ServiceName_isUsed
-            dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.ServiceTag.ServiceCategory = dinserviceCategoryType_EVCharging;
-            //dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.ServiceTag.ServiceScope
-            //dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.ServiceTag.ServiceScope_isUsed
-            dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.FreeService = 0; /* what ever this means. Just from example. */
-            /* dinEVSESupportedEnergyTransferType, e.g.
-            dinEVSESupportedEnergyTransferType_DC_combo_core or
-            dinEVSESupportedEnergyTransferType_DC_core or
-            dinEVSESupportedEnergyTransferType_DC_extended
-            dinEVSESupportedEnergyTransferType_AC_single_phase_core.
-            DC_extended means "extended pins of an IEC 62196-3 Configuration FF connector", which is
-            the normal CCS connector https://en.wikipedia.org/wiki/IEC_62196#FF) */
-            dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.EnergyTransferType = dinEVSESupportedEnergyTransferType_DC_extended;
-            
-            // Send ServiceDiscoveryResponse to EV
-            send_din_message();
-            fsmState = stateWaitForServicePaymentSelectionRequest;
-
-        }    
- 
-    } else if (fsmState == stateWaitForServicePaymentSelectionRequest) {
-
-        if (g_hlc_protocol == HlcProtocol::Iso2) {
-            if (iso2DocDec.V2G_Message.Body.PaymentServiceSelectionReq_isUsed) {
-                Serial.printf("ISO PaymentServiceSelectionReqest\n");
-                auto selected = iso2DocDec.V2G_Message.Body.PaymentServiceSelectionReq.SelectedPaymentOption;
-                prepare_iso2_message();
-                iso2DocEnc.V2G_Message.Body.PaymentServiceSelectionRes_isUsed = 1;
-                init_iso2PaymentServiceSelectionResType(&iso2DocEnc.V2G_Message.Body.PaymentServiceSelectionRes);
-                bool supported = (selected == iso2_paymentOptionType_ExternalPayment ||
-                                  selected == iso2_paymentOptionType_Contract);
-                iso2DocEnc.V2G_Message.Body.PaymentServiceSelectionRes.ResponseCode =
-                    supported ? iso2_responseCodeType_OK : iso2_responseCodeType_FAILED_ServiceSelectionInvalid;
-                send_iso2_message();
-                if (!supported) {
-                    Serial.println("[ISO-2] Unsupported payment option, terminating session");
-                    resetHlcSession();
-                    return;
-                }
-                g_iso_selected_payment_option = selected;
-                g_iso_expect_payment_details = (selected == iso2_paymentOptionType_Contract);
-                g_iso_payment_details_done = !g_iso_expect_payment_details;
-                fsmState = stateWaitForContractAuthenticationRequest;
-                iso_watchdog_start_state(stateWaitForContractAuthenticationRequest);
-                return;
-            }
-        }
+    dinDocEnc.V2G_Message.Body.SessionSetupRes_isUsed = 1;
+    init_dinSessionSetupResType(&dinDocEnc.V2G_Message.Body.SessionSetupRes);
+    dinDocEnc.V2G_Message.Body.SessionSetupRes.ResponseCode = dinresponseCodeType_OK_NewSessionEstablished;
+    const char *evseId = EVSE_ID;
+    size_t idLen = strnlen(evseId, sizeof(dinDocEnc.V2G_Message.Body.SessionSetupRes.EVSEID.bytes));
+    memcpy(dinDocEnc.V2G_Message.Body.SessionSetupRes.EVSEID.bytes, evseId, idLen);
+    dinDocEnc.V2G_Message.Body.SessionSetupRes.EVSEID.bytesLen = idLen;
+
+    // Send SessionSetupResponse to EV
+    send_din_message();
+    fsmState = stateWaitForServiceDiscoveryRequest;
+}
 
-        // Check if we have received the correct message
-        if (dinDocDec.V2G_Message.Body.ServicePaymentSelectionReq_isUsed) {
+static void iso_service_discovery(void) {
+    PLC_LOGI("ISO ServiceDiscoveryReqest\n");
+    prepare_iso2_message();
+    iso2DocEnc.V2G_Message.Body.ServiceDiscoveryRes_isUsed = 1;
+    init_iso2ServiceDiscoveryResType(&iso2DocEnc.V2G_Message.Body.ServiceDiscoveryRes);
+    auto &res = iso2DocEnc.V2G_Message.Body.ServiceDiscoveryRes;
+    res.ResponseCode = iso2_responseCodeType_OK;
+    res.PaymentOptionList.PaymentOption.arrayLen = 1;
+    res.PaymentOptionList.PaymentOption.array[0] = iso2_paymentOptionType_ExternalPayment;
+    res.ChargeService.ServiceID = 1;
+    res.ChargeService.ServiceCategory = iso2_serviceCategoryType_EVCharging;
+    res.ChargeService.FreeService = 0;
+    res.ChargeService.ServiceName_isUsed = 0;
+    res.ChargeService.ServiceScope_isUsed = 0;
+    res.ChargeService.SupportedEnergyTransferMode.EnergyTransferMode.arrayLen = 1;
+    res.ChargeService.SupportedEnergyTransferMode.EnergyTransferMode.array[0] = iso2_EnergyTransferModeType_DC_extended;
+    res.ServiceList_isUsed = 0;
+    const char *svc = EVSE_SERVICE_NAME;
+    size_t svcLen = strnlen(svc, iso2_ServiceName_CHARACTER_SIZE - 1);
+    if (svcLen) {
+        memcpy(res.ChargeService.ServiceName.characters, svc, svcLen);
+        res.ChargeService.ServiceName.charactersLen = svcLen;
+        res.ChargeService.ServiceName_isUsed = 1;
+    }
+    send_iso2_message();
+    fsmState = stateWaitForServicePaymentSelectionRequest;
+    iso_watchdog_start_state(stateWaitForServicePaymentSelectionRequest);
+}
 
-            Serial.printf("ServicePaymentSelectionReqest\n");
+static void din_service_discovery(void) {
+    uint8_t n;
+    uint16_t i;
 
-            if (dinDocDec.V2G_Message.Body.ServicePaymentSelectionReq.SelectedPaymentOption == dinpaymentOptionType_ExternalPayment) {
-                Serial.printf("OK. External Payment Selected\n");
+    PLC_LOGI("ServiceDiscoveryReqest\n");
+    n = dinDocDec.V2G_Message.Header.SessionID.bytesLen;
+    {
+        // up to 8 bytes, logged as two big-endian words
+        uint32_t sid[2] = {0, 0};
+        for (i=0; i<n && i<8; i++) sid[i >> 2] |= (uint32_t)dinDocDec.V2G_Message.Header.SessionID.bytes[i] << (24 - 8 * (i & 3));
+        PLC_LOGI("SessionID:%08x%08x\n", sid[0], sid[1]);
+    }
 
-                // Now prepare the 'ServicePaymentSelectionResponse' message to send back to the EV
-                prepare_din_message();
-                 
-                dinDocEnc.V2G_Message.Body.ServicePaymentSelectionRes_isUsed = 1;
-                init_dinServicePaymentSelectionResType(&dinDocEnc.V2G_Message.Body.ServicePaymentSelectionRes);
+    // Now prepare the 'ServiceDiscoveryResponse' message to send back to the EV
+    prepare_din_message();
 
-                dinDocEnc.V2G_Message.Body.ServicePaymentSelectionRes.ResponseCode = dinresponseCodeType_OK;
-                
-                // Send response to EV
-                send_din_message();
-                fsmState = stateWaitForContractAuthenticationRequest;
-            }
-        }
-    } else if (fsmState == stateWaitForContractAuthenticationRequest) {
-        if (g_hlc_protocol == HlcProtocol::Iso2) {
-            if (iso2DocDec.V2G_Message.Body.PaymentDetailsReq_isUsed) {
-                Serial.println("[ISO-2] PaymentDetailsReq");
-                prepare_iso2_message();
-                iso2DocEnc.V2G_Message.Body.PaymentDetailsRes_isUsed = 1;
-                init_iso2PaymentDetailsResType(&iso2DocEnc.V2G_Message.Body.PaymentDetailsRes);
-                auto &res = iso2DocEnc.V2G_Message.Body.PaymentDetailsRes;
-                res.ResponseCode = iso2_responseCodeType_OK;
-                uint16_t challengeLen =
-                    (uint16_t)std::min<size_t>(iso2_genChallengeType_BYTES_SIZE, static_cast<size_t>(16));
-                res.GenChallenge.bytesLen = challengeLen;
-                for (uint16_t i = 0; i < challengeLen; ++i) {
+    dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes_isUsed = 1;
+    init_dinServiceDiscoveryResType(&dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes);
+    dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ResponseCode = dinresponseCodeType_OK;
+    /* the mandatory fields in the ISO are PaymentOptionList and ChargeService.
+    But in the DIN, this is different, we find PaymentOptions, ChargeService and optional ServiceList */
+    dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.PaymentOptions.PaymentOption.array[0] = dinpaymentOptionType_ExternalPayment; /* EVSE handles the payment */
+    dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.PaymentOptions.PaymentOption.arrayLen = 1; /* just one single payment option in the table */
+    dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.ServiceTag.ServiceID = 1; /* todo: not clear what this means  */
+    //dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.ServiceTag.ServiceName
+    //dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.ServiceTag.ServiceName_isUsed
+    dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.ServiceTag.ServiceCategory = dinserviceCategoryType_EVCharging;
+    //dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.ServiceTag.ServiceScope
+    //dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.ServiceTag.ServiceScope_isUsed
+    dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.FreeService = 0; /* what ever this means. Just from example. */
+    /* dinEVSESupportedEnergyTransferType, e.g.
+    dinEVSESupportedEnergyTransferType_DC_combo_core or
+    dinEVSESupportedEnergyTransferType_DC_core or
+    dinEVSESupportedEnergyTransferType_DC_extended
+    dinEVSESupportedEnergyTransferType_AC_single_phase_core.
+    DC_extended means "extended pins of an IEC 62196-3 Configuration FF connector", which is
+    the normal CCS connector https://en.wikipedia.org/wiki/IEC_62196#FF) */
+    dinDocEnc.V2G_Message.Body.ServiceDiscoveryRes.ChargeService.EnergyTransferType = dinEVSESupportedEnergyTransferType_DC_extended;
+
+    // Send ServiceDiscoveryResponse to EV
+    send_din_message();
+    fsmState = stateWaitForServicePaymentSelectionRequest;
+}
+
+static void iso_payment_selection(void) {
+    PLC_LOGI("ISO PaymentServiceSelectionReqest\n");
+    auto selected = iso2DocDec.V2G_Message.Body.PaymentServiceSelectionReq.SelectedPaymentOption;
+    prepare_iso2_message();
+    iso2DocEnc.V2G_Message.Body.PaymentServiceSelectionRes_isUsed = 1;
+    init_iso2PaymentServiceSelectionResType(&iso2DocEnc.V2G_Message.Body.PaymentServiceSelectionRes);
+    bool supported = (selected == iso2_paymentOptionType_ExternalPayment ||
+                      selected == iso2_paymentOptionType_Contract);
+    iso2DocEnc.V2G_Message.Body.PaymentServiceSelectionRes.ResponseCode =
+        supported ? iso2_responseCodeType_OK : iso2_responseCodeType_FAILED_ServiceSelectionInvalid;
+    send_iso2_message();
+    if (!supported) {
+        PLC_LOGW("[ISO-2] Unsupported payment option, terminating session\n");
+        resetHlcSession();
+        return;
+    }
+    g_iso_selected_payment_option = selected;
+    g_iso_expect_payment_details = (selected == iso2_paymentOptionType_Contract);
+    g_iso_payment_details_done = !g_iso_expect_payment_details;
+    fsmState = stateWaitForContractAuthenticationRequest;
+    iso_watchdog_start_state(stateWaitForContractAuthenticationRequest);
+}
+
+static void din_payment_selection(void) {
+    PLC_LOGI("ServicePaymentSelectionReqest\n");
+
+    if (dinDocDec.V2G_Message.Body.ServicePaymentSelectionReq.SelectedPaymentOption == dinpaymentOptionType_ExternalPayment) {
+        PLC_LOGI("OK. External Payment Selected\n");
+
+        // Now prepare the 'ServicePaymentSelectionResponse' message to send back to the EV
+        prepare_din_message();
+
+        dinDocEnc.V2G_Message.Body.ServicePaymentSelectionRes_isUsed = 1;
+        init_dinServicePaymentSelectionResType(&dinDocEnc.V2G_Message.Body.ServicePaymentSelectionRes);
+
+        dinDocEnc.V2G_Message.Body.ServicePaymentSelectionRes.ResponseCode = dinresponseCodeType_OK;
+
+        // Send response to EV
+        send_din_message();
+        fsmState = stateWaitForContractAuthenticationRequest;
+    }
+}
+
+static void iso_payment_details(void) {
+    PLC_LOGI("[ISO-2] PaymentDetailsReq\n");
+    prepare_iso2_message();
+    iso2DocEnc.V2G_Message.Body.PaymentDetailsRes_isUsed = 1;
+    init_iso2PaymentDetailsResType(&iso2DocEnc.V2G_Message.Body.PaymentDetailsRes);
+    auto &res = iso2DocEnc.V2G_Message.Body.PaymentDetailsRes;
+    res.ResponseCode = iso2_responseCodeType_OK;
+    uint16_t challengeLen =
+        (uint16_t)std::min<size_t>(iso2_genChallengeType_BYTES_SIZE, static_cast<size_t>(16));
+    res.GenChallenge.bytesLen = challengeLen;
+    for (uint16_t i = 0; i < challengeLen; ++i) {
 #ifdef ESP_PLATFORM
-                    uint32_t r = esp_random();
+        uint32_t r = esp_random();
 #else
-                    uint32_t r = (uint32_t)random(0, 0x7FFFFFFF);
+        uint32_t r = (uint32_t)random(0, 0x7FFFFFFF);
 #endif
-                    res.GenChallenge.bytes[i] = (uint8_t)(r & 0xFF);
-                }
+        res.GenChallenge.bytes[i] = (uint8_t)(r & 0xFF);
+    }
 #ifdef ESP_PLATFORM
-                res.EVSETimeStamp = esp_timer_get_time() / 1000;
+    res.EVSETimeStamp = esp_timer_get_time() / 1000;
 #else
-                res.EVSETimeStamp = millis();
+    res.EVSETimeStamp = millis();
 #endif
-                send_iso2_message();
-                g_iso_payment_details_done = true;
-                g_iso_expect_payment_details = false;
-                return;
-            }
-            if (iso2DocDec.V2G_Message.Body.AuthorizationReq_isUsed) {
-                Serial.println("[ISO-2] AuthorizationReq");
-                prepare_iso2_message();
-                iso2DocEnc.V2G_Message.Body.AuthorizationRes_isUsed = 1;
-                init_iso2AuthorizationResType(&iso2DocEnc.V2G_Message.Body.AuthorizationRes);
-                auto &res = iso2DocEnc.V2G_Message.Body.AuthorizationRes;
-                if (g_iso_expect_payment_details && !g_iso_payment_details_done) {
-                    res.ResponseCode = iso2_responseCodeType_FAILED_SequenceError;
-                    res.EVSEProcessing = iso2_EVSEProcessingType_Finished;
-                    send_iso2_message();
-                    Serial.println("[ISO-2] Authorization before PaymentDetails; sequence error");
-                    return;
-                }
-                res.ResponseCode = iso2_responseCodeType_OK;
-                res.EVSEProcessing = iso2_EVSEProcessingType_Finished;
-                send_iso2_message();
-                fsmState = stateWaitForChargeParameterDiscoveryRequest;
-                iso_watchdog_start_state(stateWaitForChargeParameterDiscoveryRequest);
-                return;
-            }
-        }
+    send_iso2_message();
+    g_iso_payment_details_done = true;
+    g_iso_expect_payment_details = false;
+}
 
-        // Check if we have received the correct message
-        if (dinDocDec.V2G_Message.Body.ContractAuthenticationReq_isUsed) {
-
-            Serial.printf("ContractAuthenticationRequest\n");
-
-            // Now prepare the 'ContractAuthenticationResponse' message to send back to the EV
-            prepare_din_message();
-                        
-            dinDocEnc.V2G_Message.Body.ContractAuthenticationRes_isUsed = 1;
-            // Set Authorisation immediately to 'Finished'.
-            dinDocEnc.V2G_Message.Body.ContractAuthenticationRes.EVSEProcessing = dinEVSEProcessingType_Finished;
-            init_dinContractAuthenticationResType(&dinDocEnc.V2G_Message.Body.ContractAuthenticationRes);
-            
-            // Send response to EV
-            send_din_message();
-            fsmState = stateWaitForChargeParameterDiscoveryRequest;
-        }    
-
-    } else if (fsmState == stateWaitForChargeParameterDiscoveryRequest) {
-
-        if (g_hlc_protocol == HlcProtocol::Iso2) {
-            if (iso2DocDec.V2G_Message.Body.ChargeParameterDiscoveryReq_isUsed) {
-                Serial.println("[ISO-2] ChargeParameterDiscoveryReq");
-                if (iso2DocDec.V2G_Message.Body.ChargeParameterDiscoveryReq.DC_EVChargeParameter_isUsed) {
-                    EVSOC = iso2DocDec.V2G_Message.Body.ChargeParameterDiscoveryReq.DC_EVChargeParameter.DC_EVStatus.EVRESSSOC;
-                }
-                prepare_iso2_message();
-                iso2DocEnc.V2G_Message.Body.ChargeParameterDiscoveryRes_isUsed = 1;
-                init_iso2ChargeParameterDiscoveryResType(&iso2DocEnc.V2G_Message.Body.ChargeParameterDiscoveryRes);
-                auto &res = iso2DocEnc.V2G_Message.Body.ChargeParameterDiscoveryRes;
-                res.ResponseCode = iso2_responseCodeType_OK;
-                res.EVSEProcessing = iso2_EVSEProcessingType_Finished;
-                res.SAScheduleList_isUsed = 0;
-                res.SASchedules_isUsed = 0;
-                res.AC_EVSEChargeParameter_isUsed = 0;
-                res.EVSEChargeParameter_isUsed = 0;
-                res.DC_EVSEChargeParameter_isUsed = 1;
-                init_iso2DC_EVSEChargeParameterType(&res.DC_EVSEChargeParameter);
-                iso_populate_dc_evse_status(&res.DC_EVSEChargeParameter.DC_EVSEStatus, iso_current_evse_status_code());
-                iso_set_physical_value(&res.DC_EVSEChargeParameter.EVSEMaximumVoltageLimit,
-                                       iso2_unitSymbolType_V, EVSE_MAX_VOLTAGE);
-                iso_set_physical_value(&res.DC_EVSEChargeParameter.EVSEMinimumVoltageLimit,
-                                       iso2_unitSymbolType_V, 0.0f);
-                iso_set_physical_value(&res.DC_EVSEChargeParameter.EVSEMaximumCurrentLimit,
-                                       iso2_unitSymbolType_A, EVSE_MAX_CURRENT);
-                iso_set_physical_value(&res.DC_EVSEChargeParameter.EVSEMinimumCurrentLimit,
-                                       iso2_unitSymbolType_A, 0.0f);
-                iso_set_physical_value(&res.DC_EVSEChargeParameter.EVSEMaximumPowerLimit,
-                                       iso2_unitSymbolType_W, EVSE_MAX_POWER_KW * 1000.0f);
-                iso_set_physical_value(&res.DC_EVSEChargeParameter.EVSEPeakCurrentRipple,
-                                       iso2_unitSymbolType_A, 2.0f);
-                res.DC_EVSEChargeParameter.EVSECurrentRegulationTolerance_isUsed = 0;
-                res.DC_EVSEChargeParameter.EVSEEnergyToBeDelivered_isUsed = 0;
-                send_iso2_message();
-                fsmState = stateWaitForCableCheckRequest;
-                iso_watchdog_start_state(stateWaitForCableCheckRequest);
-                return;
-            }
-        }
+static void iso_authorization(void) {
+    PLC_LOGI("[ISO-2] AuthorizationReq\n");
+    prepare_iso2_message();
+    iso2DocEnc.V2G_Message.Body.AuthorizationRes_isUsed = 1;
+    init_iso2AuthorizationResType(&iso2DocEnc.V2G_Message.Body.AuthorizationRes);
+    auto &res = iso2DocEnc.V2G_Message.Body.AuthorizationRes;
+    if (g_iso_expect_payment_details && !g_iso_payment_details_done) {
+        res.ResponseCode = iso2_responseCodeType_FAILED_SequenceError;
+        res.EVSEProcessing = iso2_EVSEProcessingType_Finished;
+        send_iso2_message();
+        PLC_LOGW("[ISO-2] Authorization before PaymentDetails; sequence error\n");
+        return;
+    }
+    res.ResponseCode = iso2_responseCodeType_OK;
+    res.EVSEProcessing = iso2_EVSEProcessingType_Finished;
+    send_iso2_message();
+    fsmState = stateWaitForChargeParameterDiscoveryRequest;
+    iso_watchdog_start_state(stateWaitForChargeParameterDiscoveryRequest);
+}
 
-        // Check if we have received the correct message
-        if (dinDocDec.V2G_Message.Body.ChargeParameterDiscoveryReq_isUsed) {
-
-            Serial.printf("ChargeParameterDiscoveryRequest\n");
-
-            // Read the SOC from the EVRESSOC data
-            EVSOC = dinDocDec.V2G_Message.Body.ChargeParameterDiscoveryReq.DC_EVChargeParameter.DC_EVStatus.EVRESSSOC;
-
-            Serial.printf("Current SoC %d%%\n", EVSOC);
-
-            // Now prepare the 'ChargeParameterDiscoveryResponse' message to send back to the EV
-            prepare_din_message();
-            
-            dinDocEnc.V2G_Message.Body.ChargeParameterDiscoveryRes_isUsed = 1;   
-            init_dinChargeParameterDiscoveryResType(&dinDocEnc.V2G_Message.Body.ChargeParameterDiscoveryRes);
-            auto &res = dinDocEnc.V2G_Message.Body.ChargeParameterDiscoveryRes;
-            res.ResponseCode = dinresponseCodeType_OK;
-            res.EVSEProcessing = dinEVSEProcessingType_Finished;
-            res.SASchedules_isUsed = 0;
-            res.SAScheduleList_isUsed = 0;
-            res.EVSEChargeParameter_isUsed = 0;
-            res.AC_EVSEChargeParameter_isUsed = 0;
-            res.DC_EVSEChargeParameter_isUsed = 1;
-            init_din_DC_EVSEChargeParameterType(&res.DC_EVSEChargeParameter);
-            populateDcEvseStatus(&res.DC_EVSEChargeParameter.DC_EVSEStatus, currentEvseStatusCode());
-            setPhysicalValue(&res.DC_EVSEChargeParameter.EVSEMaximumVoltageLimit, dinunitSymbolType_V,
-                             static_cast<int16_t>(EVSE_MAX_VOLTAGE), 0, false);
-            setPhysicalValue(&res.DC_EVSEChargeParameter.EVSEMinimumVoltageLimit, dinunitSymbolType_V, 200, 0, false);
-            setPhysicalValue(&res.DC_EVSEChargeParameter.EVSEMaximumCurrentLimit, dinunitSymbolType_A,
-                             static_cast<int16_t>(EVSE_MAX_CURRENT), 0, false);
-            setPhysicalValue(&res.DC_EVSEChargeParameter.EVSEMinimumCurrentLimit, dinunitSymbolType_A, 1, 0, false);
-            const int16_t powerMagnitude = 10;
-            setPhysicalValue(&res.DC_EVSEChargeParameter.EVSEMaximumPowerLimit, dinunitSymbolType_W,
-                             powerMagnitude, 3, false);
-            res.DC_EVSEChargeParameter.EVSEMaximumPowerLimit_isUsed = 1;
-            setPhysicalValue(&res.DC_EVSEChargeParameter.EVSEPeakCurrentRipple, dinunitSymbolType_A, 5, 0, false);
-            res.DC_EVSEChargeParameter.EVSECurrentRegulationTolerance_isUsed = 1;
-            setPhysicalValue(&res.DC_EVSEChargeParameter.EVSECurrentRegulationTolerance, dinunitSymbolType_A, 5, 0, false);
-            res.DC_EVSEChargeParameter.EVSEEnergyToBeDelivered_isUsed = 0;
-            
-            // Send response to EV
-            send_din_message();
-            fsmState = stateWaitForCableCheckRequest;
-
-        }    
-
-    } else if (fsmState == stateWaitForCableCheckRequest) {
-
-        if (g_hlc_protocol == HlcProtocol::Iso2) {
-            if (iso2DocDec.V2G_Message.Body.CableCheckReq_isUsed) {
-                Serial.println("[ISO-2] CableCheckReq");
-                prepare_iso2_message();
-                iso2DocEnc.V2G_Message.Body.CableCheckRes_isUsed = 1;
-                init_iso2CableCheckResType(&iso2DocEnc.V2G_Message.Body.CableCheckRes);
-                auto &res = iso2DocEnc.V2G_Message.Body.CableCheckRes;
-                res.ResponseCode = iso2_responseCodeType_OK;
-                iso_populate_dc_evse_status(&res.DC_EVSEStatus, iso_current_evse_status_code());
-                res.EVSEProcessing = iso2_EVSEProcessingType_Finished;
-                send_iso2_message();
-                fsmState = stateWaitForPreChargeRequest;
-                iso_watchdog_start_state(stateWaitForPreChargeRequest);
-                return;
-            }
-        }
+static void din_contract_authentication(void) {
+    PLC_LOGI("ContractAuthenticationRequest\n");
 
-        if (dinDocDec.V2G_Message.Body.CableCheckReq_isUsed) {
-            prepare_din_message();
-            dinDocEnc.V2G_Message.Body.CableCheckRes_isUsed = 1;
-            init_dinCableCheckResType(&dinDocEnc.V2G_Message.Body.CableCheckRes);
-            dinDocEnc.V2G_Message.Body.CableCheckRes.ResponseCode = dinresponseCodeType_OK;
-            populateDcEvseStatus(&dinDocEnc.V2G_Message.Body.CableCheckRes.DC_EVSEStatus, currentEvseStatusCode());
-            dinDocEnc.V2G_Message.Body.CableCheckRes.EVSEProcessing = dinEVSEProcessingType_Finished;
+    // Now prepare the 'ContractAuthenticationResponse' message to send back to the EV
+    prepare_din_message();
 
-            send_din_message();
-            fsmState = stateWaitForPreChargeRequest;
-        }
+    dinDocEnc.V2G_Message.Body.ContractAuthenticationRes_isUsed = 1;
+    // Set Authorisation immediately to 'Finished'.
+    dinDocEnc.V2G_Message.Body.ContractAuthenticationRes.EVSEProcessing = dinEVSEProcessingType_Finished;
+    init_dinContractAuthenticationResType(&dinDocEnc.V2G_Message.Body.ContractAuthenticationRes);
 
-    } else if (fsmState == stateWaitForPreChargeRequest) {
-
-        if (g_hlc_protocol == HlcProtocol::Iso2) {
-            if (iso2DocDec.V2G_Message.Body.PreChargeReq_isUsed) {
-                Serial.println("[ISO-2] PreChargeReq");
-                prepare_iso2_message();
-                iso2DocEnc.V2G_Message.Body.PreChargeRes_isUsed = 1;
-                init_iso2PreChargeResType(&iso2DocEnc.V2G_Message.Body.PreChargeRes);
-                auto &res = iso2DocEnc.V2G_Message.Body.PreChargeRes;
-                res.ResponseCode = iso2_responseCodeType_OK;
-                iso_populate_dc_evse_status(&res.DC_EVSEStatus, iso_current_evse_status_code());
-                iso_set_physical_value(&res.EVSEPresentVoltage, iso2_unitSymbolType_V, dc_get_bus_voltage());
-                send_iso2_message();
-                fsmState = stateWaitForPowerDeliveryRequest;
-                iso_watchdog_start_state(stateWaitForPowerDeliveryRequest);
-                return;
-            }
-        }
+    // Send response to EV
+    send_din_message();
+    fsmState = stateWaitForChargeParameterDiscoveryRequest;
+}
 
-        if (dinDocDec.V2G_Message.Body.PreChargeReq_isUsed) {
-            send_precharge_response(true);
-        }
+static void iso_charge_parameter_discovery(void) {
+    PLC_LOGI("[ISO-2] ChargeParameterDiscoveryReq\n");
+    if (iso2DocDec.V2G_Message.Body.ChargeParameterDiscoveryReq.DC_EVChargeParameter_isUsed) {
+        EVSOC = iso2DocDec.V2G_Message.Body.ChargeParameterDiscoveryReq.DC_EVChargeParameter.DC_EVStatus.EVRESSSOC;
+    }
+    prepare_iso2_message();
+    iso2DocEnc.V2G_Message.Body.ChargeParameterDiscoveryRes_isUsed = 1;
+    init_iso2ChargeParameterDiscoveryResType(&iso2DocEnc.V2G_Message.Body.ChargeParameterDiscoveryRes);
+    auto &res = iso2DocEnc.V2G_Message.Body.ChargeParameterDiscoveryRes;
+    res.ResponseCode = iso2_responseCodeType_OK;
+    res.EVSEProcessing = iso2_EVSEProcessingType_Finished;
+    res.SAScheduleList_isUsed = 0;
+    res.SASchedules_isUsed = 0;
+    res.AC_EVSEChargeParameter_isUsed = 0;
+    res.EVSEChargeParameter_isUsed = 0;
+    res.DC_EVSEChargeParameter_isUsed = 1;
+    init_iso2DC_EVSEChargeParameterType(&res.DC_EVSEChargeParameter);
+    iso_populate_dc_evse_status(&res.DC_EVSEChargeParameter.DC_EVSEStatus, iso_current_evse_status_code());
+    iso_set_physical_value(&res.DC_EVSEChargeParameter.EVSEMaximumVoltageLimit,
+                           iso2_unitSymbolType_V, EVSE_MAX_VOLTAGE);
+    iso_set_physical_value(&res.DC_EVSEChargeParameter.EVSEMinimumVoltageLimit,
+                           iso2_unitSymbolType_V, 0.0f);
+    iso_set_physical_value(&res.DC_EVSEChargeParameter.EVSEMaximumCurrentLimit,
+                           iso2_unitSymbolType_A, EVSE_MAX_CURRENT);
+    iso_set_physical_value(&res.DC_EVSEChargeParameter.EVSEMinimumCurrentLimit,
+                           iso2_unitSymbolType_A, 0.0f);
+    iso_set_physical_value(&res.DC_EVSEChargeParameter.EVSEMaximumPowerLimit,
+                           iso2_unitSymbolType_W, EVSE_MAX_POWER_KW * 1000.0f);
+    iso_set_physical_value(&res.DC_EVSEChargeParameter.EVSEPeakCurrentRipple,
+                           iso2_unitSymbolType_A, 2.0f);
+    res.DC_EVSEChargeParameter.EVSECurrentRegulationTolerance_isUsed = 0;
+    res.DC_EVSEChargeParameter.EVSEEnergyToBeDelivered_isUsed = 0;
+    send_iso2_message();
+    fsmState = stateWaitForCableCheckRequest;
+    iso_watchdog_start_state(stateWaitForCableCheckRequest);
+}
 
-    } else if (fsmState == stateWaitForPowerDeliveryRequest) {
-
-        if (g_hlc_protocol == HlcProtocol::Iso2) {
-            if (iso2DocDec.V2G_Message.Body.PowerDeliveryReq_isUsed) {
-                auto progress = iso2DocDec.V2G_Message.Body.PowerDeliveryReq.ChargeProgress;
-                uint8_t nextState = stateWaitForSessionStopRequest;
-                bool contactorOk = true;
-                iso2_responseCodeType resp = iso_process_power_delivery(progress, contactorOk, nextState);
-                prepare_iso2_message();
-                iso2DocEnc.V2G_Message.Body.PowerDeliveryRes_isUsed = 1;
-                init_iso2PowerDeliveryResType(&iso2DocEnc.V2G_Message.Body.PowerDeliveryRes);
-                auto &res = iso2DocEnc.V2G_Message.Body.PowerDeliveryRes;
-                res.ResponseCode = resp;
-                res.AC_EVSEStatus_isUsed = 0;
-                res.EVSEStatus_isUsed = 0;
-                res.DC_EVSEStatus_isUsed = 1;
-                iso_populate_dc_evse_status(&res.DC_EVSEStatus, iso_current_evse_status_code());
-                send_iso2_message();
-                fsmState = nextState;
-                iso_watchdog_start_state(nextState);
-                return;
-            }
-        }
+static void din_charge_parameter_discovery(void) {
+    PLC_LOGI("ChargeParameterDiscoveryRequest\n");
 
-        if (dinDocDec.V2G_Message.Body.PreChargeReq_isUsed) {
-            send_precharge_response(false);
-            return;
-        }
+    // Read the SOC from the EVRESSOC data
+    EVSOC = dinDocDec.V2G_Message.Body.ChargeParameterDiscoveryReq.DC_EVChargeParameter.DC_EVStatus.EVRESSSOC;
 
-        if (dinDocDec.V2G_Message.Body.PowerDeliveryReq_isUsed) {
-            bool ready = dinDocDec.V2G_Message.Body.PowerDeliveryReq.ReadyToChargeState != 0;
-            bool contactorOk = true;
-            if (ready) {
-                contactorOk = cp_contactor_command(true);
-                if (contactorOk) {
-                    chargingActive = true;
-                    dc_enable_output(true);
-                } else {
-                    chargingActive = false;
-                    dc_enable_output(false);
-                }
-            } else {
-                chargingActive = false;
-                dc_enable_output(false);
-                cp_contactor_command(false);
-            }
+    PLC_LOGI("Current SoC %d%%\n", EVSOC);
 
-            prepare_din_message();
-            dinDocEnc.V2G_Message.Body.PowerDeliveryRes_isUsed = 1;
-            init_dinPowerDeliveryResType(&dinDocEnc.V2G_Message.Body.PowerDeliveryRes);
-            dinDocEnc.V2G_Message.Body.PowerDeliveryRes.ResponseCode = contactorOk ? dinresponseCodeType_OK
-                                                                                   : dinresponseCodeType_FAILED_PowerDeliveryNotApplied;
-            populateDcEvseStatus(&dinDocEnc.V2G_Message.Body.PowerDeliveryRes.DC_EVSEStatus, currentEvseStatusCode());
-            dinDocEnc.V2G_Message.Body.PowerDeliveryRes.DC_EVSEStatus_isUsed = 1;
-            dinDocEnc.V2G_Message.Body.PowerDeliveryRes.EVSEStatus_isUsed = 0;
-            dinDocEnc.V2G_Message.Body.PowerDeliveryRes.AC_EVSEStatus_isUsed = 0;
-            send_din_message();
-
-            fsmState = (ready && contactorOk) ? stateWaitForCurrentDemandRequest : stateWaitForSessionStopRequest;
-        }
+    // Now prepare the 'ChargeParameterDiscoveryResponse' message to send back to the EV
+    prepare_din_message();
 
-    } else if (fsmState == stateWaitForCurrentDemandRequest) {
-
-        if (g_hlc_protocol == HlcProtocol::Iso2) {
-            if (iso2DocDec.V2G_Message.Body.PowerDeliveryReq_isUsed) {
-                auto progress = iso2DocDec.V2G_Message.Body.PowerDeliveryReq.ChargeProgress;
-                uint8_t nextState = stateWaitForSessionStopRequest;
-                bool contactorOk = true;
-                iso2_responseCodeType resp = iso_process_power_delivery(progress, contactorOk, nextState);
-                prepare_iso2_message();
-                iso2DocEnc.V2G_Message.Body.PowerDeliveryRes_isUsed = 1;
-                init_iso2PowerDeliveryResType(&iso2DocEnc.V2G_Message.Body.PowerDeliveryRes);
-                auto &res = iso2DocEnc.V2G_Message.Body.PowerDeliveryRes;
-                res.ResponseCode = resp;
-                res.AC_EVSEStatus_isUsed = 0;
-                res.EVSEStatus_isUsed = 0;
-                res.DC_EVSEStatus_isUsed = 1;
-                iso_populate_dc_evse_status(&res.DC_EVSEStatus, iso_current_evse_status_code());
-                send_iso2_message();
-                fsmState = nextState;
-                return;
-            } else if (iso2DocDec.V2G_Message.Body.CurrentDemandReq_isUsed) {
-                const auto &req = iso2DocDec.V2G_Message.Body.CurrentDemandReq;
-                float targetVoltage = iso_decode_physical_value(req.EVTargetVoltage);
-                float targetCurrent = iso_decode_physical_value(req.EVTargetCurrent);
-                if (targetVoltage < 0) targetVoltage = 0;
-                if (targetCurrent < 0) targetCurrent = 0;
-                dc_set_targets(targetVoltage, targetCurrent);
-                chargingActive = true;
-
-                prepare_iso2_message();
-                iso2DocEnc.V2G_Message.Body.CurrentDemandRes_isUsed = 1;
-                init_iso2CurrentDemandResType(&iso2DocEnc.V2G_Message.Body.CurrentDemandRes);
-                auto &res = iso2DocEnc.V2G_Message.Body.CurrentDemandRes;
-                res.ResponseCode = iso2_responseCodeType_OK;
-                iso_populate_dc_evse_status(&res.DC_EVSEStatus, iso_current_evse_status_code());
-                float presentVoltage = dc_get_bus_voltage();
-                float presentCurrent = dc_get_bus_current();
-                iso_set_physical_value(&res.EVSEPresentVoltage, iso2_unitSymbolType_V, presentVoltage);
-                iso_set_physical_value(&res.EVSEPresentCurrent, iso2_unitSymbolType_A, presentCurrent);
-                res.EVSECurrentLimitAchieved = (targetCurrent >= EVSE_MAX_CURRENT);
-                res.EVSEVoltageLimitAchieved = (targetVoltage >= EVSE_MAX_VOLTAGE);
-                res.EVSEPowerLimitAchieved =
-                    ((targetVoltage * targetCurrent) >= (EVSE_MAX_POWER_KW * 1000.0f));
-                iso_set_physical_value(&res.EVSEMaximumVoltageLimit, iso2_unitSymbolType_V, EVSE_MAX_VOLTAGE);
-                res.EVSEMaximumVoltageLimit_isUsed = 1;
-                iso_set_physical_value(&res.EVSEMaximumCurrentLimit, iso2_unitSymbolType_A, EVSE_MAX_CURRENT);
-                res.EVSEMaximumCurrentLimit_isUsed = 1;
-                iso_set_physical_value(&res.EVSEMaximumPowerLimit, iso2_unitSymbolType_W,
-                                       EVSE_MAX_POWER_KW * 1000.0f);
-                res.EVSEMaximumPowerLimit_isUsed = 1;
-                iso_set_evse_id(res.EVSEID.characters, res.EVSEID.charactersLen, iso2_EVSEID_CHARACTER_SIZE);
-                res.SAScheduleTupleID = kDefaultSasTupleId;
-                res.MeterInfo_isUsed = 0;
-                res.ReceiptRequired_isUsed = 0;
-                send_iso2_message();
-                iso_watchdog_start_state(stateWaitForCurrentDemandRequest);
-                return;
-            } else if (handle_iso_metering_receipt()) {
-                // stay in current demand
-            }
-        }
+    dinDocEnc.V2G_Message.Body.ChargeParameterDiscoveryRes_isUsed = 1;
+    init_dinChargeParameterDiscoveryResType(&dinDocEnc.V2G_Message.Body.ChargeParameterDiscoveryRes);
+    auto &res = dinDocEnc.V2G_Message.Body.ChargeParameterDiscoveryRes;
+    res.ResponseCode = dinresponseCodeType_OK;
+    res.EVSEProcessing = dinEVSEProcessingType_Finished;
+    res.SASchedules_isUsed = 0;
+    res.SAScheduleList_isUsed = 0;
+    res.EVSEChargeParameter_isUsed = 0;
+    res.AC_EVSEChargeParameter_isUsed = 0;
+    res.DC_EVSEChargeParameter_isUsed = 1;
+    init_din_DC_EVSEChargeParameterType(&res.DC_EVSEChargeParameter);
+    populateDcEvseStatus(&res.DC_EVSEChargeParameter.DC_EVSEStatus, currentEvseStatusCode());
+    setPhysicalValue(&res.DC_EVSEChargeParameter.EVSEMaximumVoltageLimit, dinunitSymbolType_V,
+                     static_cast<int16_t>(EVSE_MAX_VOLTAGE), 0, false);
+    setPhysicalValue(&res.DC_EVSEChargeParameter.EVSEMinimumVoltageLimit, dinunitSymbolType_V, 200, 0, false);
+    setPhysicalValue(&res.DC_EVSEChargeParameter.EVSEMaximumCurrentLimit, dinunitSymbolType_A,
+                     static_cast<int16_t>(EVSE_MAX_CURRENT), 0, false);
+    setPhysicalValue(&res.DC_EVSEChargeParameter.EVSEMinimumCurrentLimit, dinunitSymbolType_A, 1, 0, false);
+    const int16_t powerMagnitude = 10;
+    setPhysicalValue(&res.DC_EVSEChargeParameter.EVSEMaximumPowerLimit, dinunitSymbolType_W,
+                     powerMagnitude, 3, false);
+    res.DC_EVSEChargeParameter.EVSEMaximumPowerLimit_isUsed = 1;
+    setPhysicalValue(&res.DC_EVSEChargeParameter.EVSEPeakCurrentRipple, dinunitSymbolType_A, 5, 0, false);
+    res.DC_EVSEChargeParameter.EVSECurrentRegulationTolerance_isUsed = 1;
+    setPhysicalValue(&res.DC_EVSEChargeParameter.EVSECurrentRegulationTolerance, dinunitSymbolType_A, 5, 0, false);
+    res.DC_EVSEChargeParameter.EVSEEnergyToBeDelivered_isUsed = 0;
+
+    // Send response to EV
+    send_din_message();
+    fsmState = stateWaitForCableCheckRequest;
+}
 
-        if (dinDocDec.V2G_Message.Body.PowerDeliveryReq_isUsed) {
-            bool ready = dinDocDec.V2G_Message.Body.PowerDeliveryReq.ReadyToChargeState != 0;
-            bool contactorOk = true;
-            if (ready) {
-                contactorOk = cp_contactor_command(true);
-                if (contactorOk) {
-                    chargingActive = true;
-                    dc_enable_output(true);
-                } else {
-                    chargingActive = false;
-                    dc_enable_output(false);
-                }
-            } else {
-                chargingActive = false;
-                dc_enable_output(false);
-                cp_contactor_command(false);
-            }
-            prepare_din_message();
-            dinDocEnc.V2G_Message.Body.PowerDeliveryRes_isUsed = 1;
-            init_dinPowerDeliveryResType(&dinDocEnc.V2G_Message.Body.PowerDeliveryRes);
-            dinDocEnc.V2G_Message.Body.PowerDeliveryRes.ResponseCode = contactorOk ? dinresponseCodeType_OK
-                                                                                   : dinresponseCodeType_FAILED_PowerDeliveryNotApplied;
-            init_dinEVSEStatusType(&dinDocEnc.V2G_Message.Body.PowerDeliveryRes.EVSEStatus);
-            send_din_message();
-
-            if (!(ready && contactorOk)) {
-                fsmState = stateWaitForSessionStopRequest;
-            }
+static void iso_cable_check(void) {
+    PLC_LOGI("[ISO-2] CableCheckReq\n");
+    prepare_iso2_message();
+    iso2DocEnc.V2G_Message.Body.CableCheckRes_isUsed = 1;
+    init_iso2CableCheckResType(&iso2DocEnc.V2G_Message.Body.CableCheckRes);
+    auto &res = iso2DocEnc.V2G_Message.Body.CableCheckRes;
+    res.ResponseCode = iso2_responseCodeType_OK;
+    iso_populate_dc_evse_status(&res.DC_EVSEStatus, iso_current_evse_status_code());
+    res.EVSEProcessing = iso2_EVSEProcessingType_Finished;
+    send_iso2_message();
+    fsmState = stateWaitForPreChargeRequest;
+    iso_watchdog_start_state(stateWaitForPreChargeRequest);
+}
 
-        } else if (dinDocDec.V2G_Message.Body.CurrentDemandReq_isUsed) {
-            const dinCurrentDemandReqType &req = dinDocDec.V2G_Message.Body.CurrentDemandReq;
-            float targetVoltage = decodePhysicalValue(req.EVTargetVoltage);
-            float targetCurrent = decodePhysicalValue(req.EVTargetCurrent);
-            if (targetVoltage < 0) targetVoltage = 0;
-            if (targetCurrent < 0) targetCurrent = 0;
-            dc_set_targets(targetVoltage, targetCurrent);
-
-            if (req.ChargingComplete) {
-                chargingActive = false;
-                dc_enable_output(false);
-                cp_contactor_command(false);
-            }
+static void din_cable_check(void) {
+    prepare_din_message();
+    dinDocEnc.V2G_Message.Body.CableCheckRes_isUsed = 1;
+    init_dinCableCheckResType(&dinDocEnc.V2G_Message.Body.CableCheckRes);
+    dinDocEnc.V2G_Message.Body.CableCheckRes.ResponseCode = dinresponseCodeType_OK;
+    populateDcEvseStatus(&dinDocEnc.V2G_Message.Body.CableCheckRes.DC_EVSEStatus, currentEvseStatusCode());
+    dinDocEnc.V2G_Message.Body.CableCheckRes.EVSEProcessing = dinEVSEProcessingType_Finished;
 
-            prepare_din_message();
-            dinDocEnc.V2G_Message.Body.CurrentDemandRes_isUsed = 1;
-            init_dinCurrentDemandResType(&dinDocEnc.V2G_Message.Body.CurrentDemandRes);
-            dinDocEnc.V2G_Message.Body.CurrentDemandRes.ResponseCode = dinresponseCodeType_OK;
-            populateDcEvseStatus(&dinDocEnc.V2G_Message.Body.CurrentDemandRes.DC_EVSEStatus,
-                                 currentEvseStatusCode());
-            setPhysicalValue(&dinDocEnc.V2G_Message.Body.CurrentDemandRes.EVSEPresentVoltage, dinunitSymbolType_V,
-                             static_cast<int16_t>(lroundf(dc_get_bus_voltage())), 0, true);
-            float measuredCurrent = chargingActive ? dc_get_bus_current() : 0.0f;
-            setPhysicalValue(&dinDocEnc.V2G_Message.Body.CurrentDemandRes.EVSEPresentCurrent, dinunitSymbolType_A,
-                             static_cast<int16_t>(lroundf(measuredCurrent)), 0, true);
-            dinDocEnc.V2G_Message.Body.CurrentDemandRes.EVSECurrentLimitAchieved = 1;
-            dinDocEnc.V2G_Message.Body.CurrentDemandRes.EVSEVoltageLimitAchieved = 0;
-            dinDocEnc.V2G_Message.Body.CurrentDemandRes.EVSEPowerLimitAchieved = 0;
-            dinDocEnc.V2G_Message.Body.CurrentDemandRes.EVSEMaximumVoltageLimit_isUsed = 0;
-            dinDocEnc.V2G_Message.Body.CurrentDemandRes.EVSEMaximumCurrentLimit_isUsed = 0;
-            dinDocEnc.V2G_Message.Body.CurrentDemandRes.EVSEMaximumPowerLimit_isUsed = 0;
-
-            send_din_message();
-
-        } else if (handleMeteringReceipt()) {
-            // stay in current demand state
-        }
+    send_din_message();
+    fsmState = stateWaitForPreChargeRequest;
+}
 
-    } else if (fsmState == stateWaitForSessionStopRequest) {
-
-        if (g_hlc_protocol == HlcProtocol::Iso2) {
-            if (handle_iso_metering_receipt()) {
-                // wait for SessionStopReq
-            } else if (iso2DocDec.V2G_Message.Body.SessionStopReq_isUsed) {
-                Serial.println("[ISO-2] SessionStopReq");
-                prepare_iso2_message();
-                iso2DocEnc.V2G_Message.Body.SessionStopRes_isUsed = 1;
-                init_iso2SessionStopResType(&iso2DocEnc.V2G_Message.Body.SessionStopRes);
-                iso2DocEnc.V2G_Message.Body.SessionStopRes.ResponseCode = iso2_responseCodeType_OK;
-                send_iso2_message();
-                stop_evse_power_output();
-                fsmState = stateWaitForSupportedApplicationProtocolRequest;
-                return;
-            } else if (iso2DocDec.V2G_Message.Body.PowerDeliveryReq_isUsed) {
-                auto progress = iso2DocDec.V2G_Message.Body.PowerDeliveryReq.ChargeProgress;
-                uint8_t nextState = stateWaitForSessionStopRequest;
-                bool contactorOk = true;
-                iso2_responseCodeType resp = iso_process_power_delivery(progress, contactorOk, nextState);
-                prepare_iso2_message();
-                iso2DocEnc.V2G_Message.Body.PowerDeliveryRes_isUsed = 1;
-                init_iso2PowerDeliveryResType(&iso2DocEnc.V2G_Message.Body.PowerDeliveryRes);
-                auto &res = iso2DocEnc.V2G_Message.Body.PowerDeliveryRes;
-                res.ResponseCode = resp;
-                res.AC_EVSEStatus_isUsed = 0;
-                res.EVSEStatus_isUsed = 0;
-                res.DC_EVSEStatus_isUsed = 1;
-                iso_populate_dc_evse_status(&res.DC_EVSEStatus, iso_current_evse_status_code());
-                send_iso2_message();
-                fsmState = nextState;
-                return;
-            }
-        }
+static void iso_precharge(void) {
+    PLC_LOGI("[ISO-2] PreChargeReq\n");
+    prepare_iso2_message();
+    iso2DocEnc.V2G_Message.Body.PreChargeRes_isUsed = 1;
+    init_iso2PreChargeResType(&iso2DocEnc.V2G_Message.Body.PreChargeRes);
+    auto &res = iso2DocEnc.V2G_Message.Body.PreChargeRes;
+    res.ResponseCode = iso2_responseCodeType_OK;
+    iso_populate_dc_evse_status(&res.DC_EVSEStatus, iso_current_evse_status_code());
+    iso_set_physical_value(&res.EVSEPresentVoltage, iso2_unitSymbolType_V, dc_get_bus_voltage());
+    send_iso2_message();
+    fsmState = stateWaitForPowerDeliveryRequest;
+    iso_watchdog_start_state(stateWaitForPowerDeliveryRequest);
+}
+
+static void din_precharge(void) {
+    send_precharge_response(true);
+}
+
+// The EV may repeat PreChargeReq until the voltage matches; answer without moving on.
+static void din_precharge_repeat(void) {
+    send_precharge_response(false);
+}
+
+// Shared by every state that accepts PowerDeliveryReq. Returns the state the
+// requested ChargeProgress leads to.
+static uint8_t iso_send_power_delivery_res(void) {
+    auto progress = iso2DocDec.V2G_Message.Body.PowerDeliveryReq.ChargeProgress;
+    uint8_t nextState = stateWaitForSessionStopRequest;
+    bool contactorOk = true;
+    iso2_responseCodeType resp = iso_process_power_delivery(progress, contactorOk, nextState);
+    prepare_iso2_message();
+    iso2DocEnc.V2G_Message.Body.PowerDeliveryRes_isUsed = 1;
+    init_iso2PowerDeliveryResType(&iso2DocEnc.V2G_Message.Body.PowerDeliveryRes);
+    auto &res = iso2DocEnc.V2G_Message.Body.PowerDeliveryRes;
+    res.ResponseCode = resp;
+    res.AC_EVSEStatus_isUsed = 0;
+    res.EVSEStatus_isUsed = 0;
+    res.DC_EVSEStatus_isUsed = 1;
+    iso_populate_dc_evse_status(&res.DC_EVSEStatus, iso_current_evse_status_code());
+    send_iso2_message();
+    return nextState;
+}
 
-        if (handleMeteringReceipt()) {
-            // wait for SessionStopReq
-        } else if (dinDocDec.V2G_Message.Body.SessionStopReq_isUsed) {
-            prepare_din_message();
-            dinDocEnc.V2G_Message.Body.SessionStopRes_isUsed = 1;
-            init_dinSessionStopResType(&dinDocEnc.V2G_Message.Body.SessionStopRes);
-            dinDocEnc.V2G_Message.Body.SessionStopRes.ResponseCode = dinresponseCodeType_OK;
+static void iso_power_delivery(void) {
+    uint8_t nextState = iso_send_power_delivery_res();
+    fsmState = nextState;
+    iso_watchdog_start_state(nextState);
+}
 
-            send_din_message();
+static void iso_power_delivery_charging(void) {
+    fsmState = iso_send_power_delivery_res();
+}
+
+// Contactor and output for DIN PowerDeliveryReq. Returns false when the
+// contactor did not close.
+static bool din_apply_ready_to_charge(bool ready) {
+    bool contactorOk = true;
+    if (ready) {
+        contactorOk = cp_contactor_command(true);
+        if (contactorOk) {
+            chargingActive = true;
+            dc_enable_output(true);
+        } else {
             chargingActive = false;
-            fsmState = stateWaitForSupportedApplicationProtocolRequest;
-        } else if (dinDocDec.V2G_Message.Body.PowerDeliveryReq_isUsed) {
-            // Treat unexpected PowerDelivery during stop as start/stop handshake.
-            bool ready = dinDocDec.V2G_Message.Body.PowerDeliveryReq.ReadyToChargeState != 0;
-            prepare_din_message();
-            dinDocEnc.V2G_Message.Body.PowerDeliveryRes_isUsed = 1;
-            init_dinPowerDeliveryResType(&dinDocEnc.V2G_Message.Body.PowerDeliveryRes);
-            dinDocEnc.V2G_Message.Body.PowerDeliveryRes.ResponseCode = dinresponseCodeType_OK;
-            init_dinEVSEStatusType(&dinDocEnc.V2G_Message.Body.PowerDeliveryRes.EVSEStatus);
-            send_din_message();
-            chargingActive = ready;
-            if (ready) {
-                fsmState = stateWaitForCurrentDemandRequest;
-            }
+            dc_enable_output(false);
         }
+    } else {
+        chargingActive = false;
+        dc_enable_output(false);
+        cp_contactor_command(false);
+    }
+    return contactorOk;
+}
 
+static void din_power_delivery(void) {
+    bool ready = dinDocDec.V2G_Message.Body.PowerDeliveryReq.ReadyToChargeState != 0;
+    bool contactorOk = din_apply_ready_to_charge(ready);
+
+    prepare_din_message();
+    dinDocEnc.V2G_Message.Body.PowerDeliveryRes_isUsed = 1;
+    init_dinPowerDeliveryResType(&dinDocEnc.V2G_Message.Body.PowerDeliveryRes);
+    dinDocEnc.V2G_Message.Body.PowerDeliveryRes.ResponseCode = contactorOk ? dinresponseCodeType_OK
+                                                                           : dinresponseCodeType_FAILED_PowerDeliveryNotApplied;
+    populateDcEvseStatus(&dinDocEnc.V2G_Message.Body.PowerDeliveryRes.DC_EVSEStatus, currentEvseStatusCode());
+    dinDocEnc.V2G_Message.Body.PowerDeliveryRes.DC_EVSEStatus_isUsed = 1;
+    dinDocEnc.V2G_Message.Body.PowerDeliveryRes.EVSEStatus_isUsed = 0;
+    dinDocEnc.V2G_Message.Body.PowerDeliveryRes.AC_EVSEStatus_isUsed = 0;
+    send_din_message();
+
+    fsmState = (ready && contactorOk) ? stateWaitForCurrentDemandRequest : stateWaitForSessionStopRequest;
+}
+
+static void din_power_delivery_charging(void) {
+    bool ready = dinDocDec.V2G_Message.Body.PowerDeliveryReq.ReadyToChargeState != 0;
+    bool contactorOk = din_apply_ready_to_charge(ready);
+    prepare_din_message();
+    dinDocEnc.V2G_Message.Body.PowerDeliveryRes_isUsed = 1;
+    init_dinPowerDeliveryResType(&dinDocEnc.V2G_Message.Body.PowerDeliveryRes);
+    dinDocEnc.V2G_Message.Body.PowerDeliveryRes.ResponseCode = contactorOk ? dinresponseCodeType_OK
+                                                                           : dinresponseCodeType_FAILED_PowerDeliveryNotApplied;
+    init_dinEVSEStatusType(&dinDocEnc.V2G_Message.Body.PowerDeliveryRes.EVSEStatus);
+    send_din_message();
+
+    if (!(ready && contactorOk)) {
+        fsmState = stateWaitForSessionStopRequest;
     }
-    
+}
+
+static void iso_current_demand(void) {
+    float targetVoltage = cd_req_physical(CDQ_VOLTAGE_MULT, CDQ_VOLTAGE);
+    float targetCurrent = cd_req_physical(CDQ_CURRENT_MULT, CDQ_CURRENT);
+    if (targetVoltage < 0) targetVoltage = 0;
+    if (targetCurrent < 0) targetCurrent = 0;
+    dc_set_targets(targetVoltage, targetCurrent);
+    chargingActive = true;
+
+    int32_t values[CD_ISO_FIELDS];
+    values[CD_STATUS] = iso_current_evse_status_code();
+    values[CD_VOLTAGE] = iso_physical_value_raw(dc_get_bus_voltage());
+    values[CD_CURRENT] = iso_physical_value_raw(dc_get_bus_current());
+    values[CD_CURRENT_LIMIT] = (targetCurrent >= EVSE_MAX_CURRENT);
+    values[CD_VOLTAGE_LIMIT] = (targetVoltage >= EVSE_MAX_VOLTAGE);
+    values[CD_POWER_LIMIT] = ((targetVoltage * targetCurrent) >= (EVSE_MAX_POWER_KW * 1000.0f));
+    send_current_demand_res(values, CD_ISO_FIELDS, iso_encode_current_demand_res, 0);
+    iso_watchdog_start_state(stateWaitForCurrentDemandRequest);
+}
+
+static void din_current_demand(void) {
+    float targetVoltage = cd_req_physical(CDQ_VOLTAGE_MULT, CDQ_VOLTAGE);
+    float targetCurrent = cd_req_physical(CDQ_CURRENT_MULT, CDQ_CURRENT);
+    if (targetVoltage < 0) targetVoltage = 0;
+    if (targetCurrent < 0) targetCurrent = 0;
+    dc_set_targets(targetVoltage, targetCurrent);
+
+    if (g_cd_req[CDQ_COMPLETE]) {
+        chargingActive = false;
+        dc_enable_output(false);
+        cp_contactor_command(false);
+    }
+
+    int32_t values[CD_DIN_FIELDS];
+    values[CD_STATUS] = currentEvseStatusCode();
+    values[CD_VOLTAGE] = static_cast<int16_t>(lroundf(dc_get_bus_voltage()));
+    float measuredCurrent = chargingActive ? dc_get_bus_current() : 0.0f;
+    values[CD_CURRENT] = static_cast<int16_t>(lroundf(measuredCurrent));
+    send_current_demand_res(values, CD_DIN_FIELDS, din_encode_current_demand_res, din_isolation_used());
+}
+
+static void iso_session_stop(void) {
+    PLC_LOGI("[ISO-2] SessionStopReq\n");
+    prepare_iso2_message();
+    iso2DocEnc.V2G_Message.Body.SessionStopRes_isUsed = 1;
+    init_iso2SessionStopResType(&iso2DocEnc.V2G_Message.Body.SessionStopRes);
+    iso2DocEnc.V2G_Message.Body.SessionStopRes.ResponseCode = iso2_responseCodeType_OK;
+    send_iso2_message();
+    stop_evse_power_output();
+    fsmState = stateWaitForSupportedApplicationProtocolRequest;
+}
+
+static void din_session_stop(void) {
+    prepare_din_message();
+    dinDocEnc.V2G_Message.Body.SessionStopRes_isUsed = 1;
+    init_dinSessionStopResType(&dinDocEnc.V2G_Message.Body.SessionStopRes);
+    dinDocEnc.V2G_Message.Body.SessionStopRes.ResponseCode = dinresponseCodeType_OK;
+
+    send_din_message();
+    chargingActive = false;
+    fsmState = stateWaitForSupportedApplicationProtocolRequest;
+}
+
+static void din_power_delivery_stopped(void) {
+    // Treat unexpected PowerDelivery during stop as start/stop handshake.
+    bool ready = dinDocDec.V2G_Message.Body.PowerDeliveryReq.ReadyToChargeState != 0;
+    prepare_din_message();
+    dinDocEnc.V2G_Message.Body.PowerDeliveryRes_isUsed = 1;
+    init_dinPowerDeliveryResType(&dinDocEnc.V2G_Message.Body.PowerDeliveryRes);
+    dinDocEnc.V2G_Message.Body.PowerDeliveryRes.ResponseCode = dinresponseCodeType_OK;
+    init_dinEVSEStatusType(&dinDocEnc.V2G_Message.Body.PowerDeliveryRes.EVSEStatus);
+    send_din_message();
+    chargingActive = ready;
+    if (ready) {
+        fsmState = stateWaitForCurrentDemandRequest;
+    }
+}
+
+// HLC dispatch. Every request the FSM accepts is one route: protocol, state
+// and request body select the handler, which sends the response and moves
+// fsmState. `next` lists the states the handler may leave behind; anything
+// else is a handler bug and resets the session. Going back to
+// stateWaitForSupportedApplicationProtocolRequest is always allowed, since a
+// handler may end or reset the session. A request without a route is dropped.
+enum HlcMsg : uint8_t {
+    HLC_MSG_NONE = 0,
+    HLC_MSG_APP_PROTOCOL,
+    HLC_MSG_SESSION_SETUP,
+    HLC_MSG_SERVICE_DISCOVERY,
+    HLC_MSG_PAYMENT_SELECTION,
+    HLC_MSG_PAYMENT_DETAILS,
+    HLC_MSG_AUTHORIZATION,      // DIN ContractAuthenticationReq, ISO-2 AuthorizationReq
+    HLC_MSG_CHARGE_PARAMETER,
+    HLC_MSG_CABLE_CHECK,
+    HLC_MSG_PRECHARGE,
+    HLC_MSG_POWER_DELIVERY,
+    HLC_MSG_CURRENT_DEMAND,
+    HLC_MSG_METERING_RECEIPT,
+    HLC_MSG_SESSION_STOP,
+    HLC_MSG_COUNT
+};
+
+#define HLC_PROTOCOL_COUNT 2
+#define HLC_STATE_COUNT (stateWaitForSessionStopRequest + 1)
+#define HLC_NEXT(state) ((uint16_t)(1u << (state)))
+
+struct HlcRoute {
+    HlcProtocol protocol;
+    uint8_t state;
+    uint8_t msg;
+    void (*handler)(void);
+    uint16_t next;
+    const char *name;
+};
+
+static constexpr HlcRoute kHlcRoutes[] = {
+    {HlcProtocol::Din, stateWaitForSupportedApplicationProtocolRequest, HLC_MSG_APP_PROTOCOL, hlc_app_protocol,
+     HLC_NEXT(stateWaitForSessionSetupRequest), "SupportedAppProtocol"},
+    {HlcProtocol::Din, stateWaitForSessionSetupRequest, HLC_MSG_SESSION_SETUP, din_session_setup,
+     HLC_NEXT(stateWaitForServiceDiscoveryRequest), "SessionSetup"},
+    {HlcProtocol::Din, stateWaitForServiceDiscoveryRequest, HLC_MSG_SERVICE_DISCOVERY, din_service_discovery,
+     HLC_NEXT(stateWaitForServicePaymentSelectionRequest), "ServiceDiscovery"},
+    {HlcProtocol::Din, stateWaitForServicePaymentSelectionRequest, HLC_MSG_PAYMENT_SELECTION, din_payment_selection,
+     HLC_NEXT(stateWaitForServicePaymentSelectionRequest) | HLC_NEXT(stateWaitForContractAuthenticationRequest),
+     "ServicePaymentSelection"},
+    {HlcProtocol::Din, stateWaitForContractAuthenticationRequest, HLC_MSG_AUTHORIZATION, din_contract_authentication,
+     HLC_NEXT(stateWaitForChargeParameterDiscoveryRequest), "ContractAuthentication"},
+    {HlcProtocol::Din, stateWaitForChargeParameterDiscoveryRequest, HLC_MSG_CHARGE_PARAMETER, din_charge_parameter_discovery,
+     HLC_NEXT(stateWaitForCableCheckRequest), "ChargeParameterDiscovery"},
+    {HlcProtocol::Din, stateWaitForCableCheckRequest, HLC_MSG_CABLE_CHECK, din_cable_check,
+     HLC_NEXT(stateWaitForPreChargeRequest), "CableCheck"},
+    {HlcProtocol::Din, stateWaitForPreChargeRequest, HLC_MSG_PRECHARGE, din_precharge,
+     HLC_NEXT(stateWaitForPowerDeliveryRequest), "PreCharge"},
+    {HlcProtocol::Din, stateWaitForPowerDeliveryRequest, HLC_MSG_PRECHARGE, din_precharge_repeat,
+     HLC_NEXT(stateWaitForPowerDeliveryRequest), "PreCharge"},
+    {HlcProtocol::Din, stateWaitForPowerDeliveryRequest, HLC_MSG_POWER_DELIVERY, din_power_delivery,
+     HLC_NEXT(stateWaitForCurrentDemandRequest) | HLC_NEXT(stateWaitForSessionStopRequest), "PowerDelivery"},
+    {HlcProtocol::Din, stateWaitForCurrentDemandRequest, HLC_MSG_POWER_DELIVERY, din_power_delivery_charging,
+     HLC_NEXT(stateWaitForCurrentDemandRequest) | HLC_NEXT(stateWaitForSessionStopRequest), "PowerDelivery"},
+    {HlcProtocol::Din, stateWaitForCurrentDemandRequest, HLC_MSG_CURRENT_DEMAND, din_current_demand,
+     HLC_NEXT(stateWaitForCurrentDemandRequest), "CurrentDemand"},
+    {HlcProtocol::Din, stateWaitForCurrentDemandRequest, HLC_MSG_METERING_RECEIPT, handleMeteringReceipt,
+     HLC_NEXT(stateWaitForCurrentDemandRequest), "MeteringReceipt"},
+    {HlcProtocol::Din, stateWaitForSessionStopRequest, HLC_MSG_METERING_RECEIPT, handleMeteringReceipt,
+     HLC_NEXT(stateWaitForSessionStopRequest), "MeteringReceipt"},
+    {HlcProtocol::Din, stateWaitForSessionStopRequest, HLC_MSG_SESSION_STOP, din_session_stop,
+     HLC_NEXT(stateWaitForSupportedApplicationProtocolRequest), "SessionStop"},
+    {HlcProtocol::Din, stateWaitForSessionStopRequest, HLC_MSG_POWER_DELIVERY, din_power_delivery_stopped,
+     HLC_NEXT(stateWaitForCurrentDemandRequest) | HLC_NEXT(stateWaitForSessionStopRequest), "PowerDelivery"},
+
+    // an ISO-2 session that ended with SessionStop is back in state 0 without a reset
+    {HlcProtocol::Iso2, stateWaitForSupportedApplicationProtocolRequest, HLC_MSG_APP_PROTOCOL, hlc_app_protocol,
+     HLC_NEXT(stateWaitForSessionSetupRequest), "SupportedAppProtocol"},
+    {HlcProtocol::Iso2, stateWaitForSessionSetupRequest, HLC_MSG_SESSION_SETUP, iso_session_setup,
+     HLC_NEXT(stateWaitForServiceDiscoveryRequest), "SessionSetup"},
+    {HlcProtocol::Iso2, stateWaitForServiceDiscoveryRequest, HLC_MSG_SERVICE_DISCOVERY, iso_service_discovery,
+     HLC_NEXT(stateWaitForServicePaymentSelectionRequest), "ServiceDiscovery"},
+    {HlcProtocol::Iso2, stateWaitForServicePaymentSelectionRequest, HLC_MSG_PAYMENT_SELECTION, iso_payment_selection,
+     HLC_NEXT(stateWaitForContractAuthenticationRequest), "PaymentServiceSelection"},
+    {HlcProtocol::Iso2, stateWaitForContractAuthenticationRequest, HLC_MSG_PAYMENT_DETAILS, iso_payment_details,
+     HLC_NEXT(stateWaitForContractAuthenticationRequest), "PaymentDetails"},
+    {HlcProtocol::Iso2, stateWaitForContractAuthenticationRequest, HLC_MSG_AUTHORIZATION, iso_authorization,
+     HLC_NEXT(stateWaitForContractAuthenticationRequest) | HLC_NEXT(stateWaitForChargeParameterDiscoveryRequest),
+     "Authorization"},
+    {HlcProtocol::Iso2, stateWaitForChargeParameterDiscoveryRequest, HLC_MSG_CHARGE_PARAMETER, iso_charge_parameter_discovery,
+     HLC_NEXT(stateWaitForCableCheckRequest), "ChargeParameterDiscovery"},
+    {HlcProtocol::Iso2, stateWaitForCableCheckRequest, HLC_MSG_CABLE_CHECK, iso_cable_check,
+     HLC_NEXT(stateWaitForPreChargeRequest), "CableCheck"},
+    {HlcProtocol::Iso2, stateWaitForPreChargeRequest, HLC_MSG_PRECHARGE, iso_precharge,
+     HLC_NEXT(stateWaitForPowerDeliveryRequest), "PreCharge"},
+    {HlcProtocol::Iso2, stateWaitForPowerDeliveryRequest, HLC_MSG_POWER_DELIVERY, iso_power_delivery,
+     HLC_NEXT(stateWaitForChargeParameterDiscoveryRequest) | HLC_NEXT(stateWaitForCurrentDemandRequest) |
+         HLC_NEXT(stateWaitForSessionStopRequest), "PowerDelivery"},
+    {HlcProtocol::Iso2, stateWaitForCurrentDemandRequest, HLC_MSG_POWER_DELIVERY, iso_power_delivery_charging,
+     HLC_NEXT(stateWaitForChargeParameterDiscoveryRequest) | HLC_NEXT(stateWaitForCurrentDemandRequest) |
+         HLC_NEXT(stateWaitForSessionStopRequest), "PowerDelivery"},
+    {HlcProtocol::Iso2, stateWaitForCurrentDemandRequest, HLC_MSG_CURRENT_DEMAND, iso_current_demand,
+     HLC_NEXT(stateWaitForCurrentDemandRequest), "CurrentDemand"},
+    {HlcProtocol::Iso2, stateWaitForCurrentDemandRequest, HLC_MSG_METERING_RECEIPT, handle_iso_metering_receipt,
+     HLC_NEXT(stateWaitForCurrentDemandRequest), "MeteringReceipt"},
+    {HlcProtocol::Iso2, stateWaitForSessionStopRequest, HLC_MSG_METERING_RECEIPT, handle_iso_metering_receipt,
+     HLC_NEXT(stateWaitForSessionStopRequest), "MeteringReceipt"},
+    {HlcProtocol::Iso2, stateWaitForSessionStopRequest, HLC_MSG_SESSION_STOP, iso_session_stop,
+     HLC_NEXT(stateWaitForSupportedApplicationProtocolRequest), "SessionStop"},
+    {HlcProtocol::Iso2, stateWaitForSessionStopRequest, HLC_MSG_POWER_DELIVERY, iso_power_delivery_charging,
+     HLC_NEXT(stateWaitForChargeParameterDiscoveryRequest) | HLC_NEXT(stateWaitForCurrentDemandRequest) |
+         HLC_NEXT(stateWaitForSessionStopRequest), "PowerDelivery"},
+};
+
+#define HLC_ROUTE_COUNT (sizeof(kHlcRoutes) / sizeof(kHlcRoutes[0]))
+static_assert(HLC_ROUTE_COUNT < 256, "route index is 8 bit");
+
+struct HlcRouteCounters {
+    uint32_t calls;
+    uint32_t max_cycles;
+    uint64_t sum_cycles;
+};
+
+static HlcRouteCounters g_hlc_route_stats[HLC_ROUTE_COUNT];
+static uint32_t g_hlc_unrouted = 0;
+static uint32_t g_hlc_bad_transitions = 0;
+
+// Dispatch index, generated from kHlcRoutes at compile time: route number + 1
+// per (protocol, state, message) cell, 0 where no route exists. Written with
+// C++11 constexpr (recursion, no loops) for the Arduino core's gnu++11.
+#define HLC_CELL_COUNT (HLC_PROTOCOL_COUNT * HLC_STATE_COUNT * HLC_MSG_COUNT)
+
+static constexpr uint16_t hlc_cell(HlcProtocol protocol, uint8_t state, uint8_t msg) {
+    return (static_cast<uint8_t>(protocol) * HLC_STATE_COUNT + state) * HLC_MSG_COUNT + msg;
+}
+
+static constexpr uint16_t hlc_route_cell(uint8_t r) {
+    return hlc_cell(kHlcRoutes[r].protocol, kHlcRoutes[r].state, kHlcRoutes[r].msg);
+}
+
+// route number + 1 of the first route from r on that serves cell, 0 for none
+static constexpr uint8_t hlc_cell_route(uint16_t cell, uint8_t r) {
+    return r == HLC_ROUTE_COUNT ? 0 : hlc_route_cell(r) == cell ? r + 1 : hlc_cell_route(cell, r + 1);
+}
+
+static constexpr bool hlc_routes_unique(uint8_t r) {
+    return r == HLC_ROUTE_COUNT || (hlc_cell_route(hlc_route_cell(r), 0) == r + 1 && hlc_routes_unique(r + 1));
+}
+static_assert(hlc_routes_unique(0), "two routes for one protocol, state and message");
+
+struct HlcRouteIndex {
+    uint8_t route[HLC_CELL_COUNT];
+};
+
+template <uint16_t... Cells> struct HlcCells {};
+template <uint16_t N, uint16_t... Cells> struct HlcMakeCells : HlcMakeCells<N - 1, N - 1, Cells...> {};
+template <uint16_t... Cells> struct HlcMakeCells<0, Cells...> {
+    typedef HlcCells<Cells...> type;
+};
+
+template <uint16_t... Cells> static constexpr HlcRouteIndex hlc_route_index(HlcCells<Cells...>) {
+    return HlcRouteIndex{{hlc_cell_route(Cells, 0)...}};
+}
+
+static constexpr HlcRouteIndex kHlcRouteIndex = hlc_route_index(HlcMakeCells<HLC_CELL_COUNT>::type());
+
+static uint8_t hlc_classify_handshake(void) {
+    return appHandDoc.supportedAppProtocolReq_isUsed ? HLC_MSG_APP_PROTOCOL : HLC_MSG_NONE;
+}
+
+static uint8_t hlc_classify_din(void) {
+    const auto &body = dinDocDec.V2G_Message.Body;
+    if (body.CurrentDemandReq_isUsed) return HLC_MSG_CURRENT_DEMAND;
+    if (body.PreChargeReq_isUsed) return HLC_MSG_PRECHARGE;
+    if (body.PowerDeliveryReq_isUsed) return HLC_MSG_POWER_DELIVERY;
+    if (body.MeteringReceiptReq_isUsed) return HLC_MSG_METERING_RECEIPT;
+    if (body.SessionSetupReq_isUsed) return HLC_MSG_SESSION_SETUP;
+    if (body.ServiceDiscoveryReq_isUsed) return HLC_MSG_SERVICE_DISCOVERY;
+    if (body.ServicePaymentSelectionReq_isUsed) return HLC_MSG_PAYMENT_SELECTION;
+    if (body.ContractAuthenticationReq_isUsed) return HLC_MSG_AUTHORIZATION;
+    if (body.ChargeParameterDiscoveryReq_isUsed) return HLC_MSG_CHARGE_PARAMETER;
+    if (body.CableCheckReq_isUsed) return HLC_MSG_CABLE_CHECK;
+    if (body.SessionStopReq_isUsed) return HLC_MSG_SESSION_STOP;
+    return HLC_MSG_NONE;
+}
+
+static uint8_t hlc_classify_iso2(void) {
+    const auto &body = iso2DocDec.V2G_Message.Body;
+    if (body.CurrentDemandReq_isUsed) return HLC_MSG_CURRENT_DEMAND;
+    if (body.PreChargeReq_isUsed) return HLC_MSG_PRECHARGE;
+    if (body.PowerDeliveryReq_isUsed) return HLC_MSG_POWER_DELIVERY;
+    if (body.MeteringReceiptReq_isUsed) return HLC_MSG_METERING_RECEIPT;
+    if (body.SessionSetupReq_isUsed) return HLC_MSG_SESSION_SETUP;
+    if (body.ServiceDiscoveryReq_isUsed) return HLC_MSG_SERVICE_DISCOVERY;
+    if (body.PaymentServiceSelectionReq_isUsed) return HLC_MSG_PAYMENT_SELECTION;
+    if (body.PaymentDetailsReq_isUsed) return HLC_MSG_PAYMENT_DETAILS;
+    if (body.AuthorizationReq_isUsed) return HLC_MSG_AUTHORIZATION;
+    if (body.ChargeParameterDiscoveryReq_isUsed) return HLC_MSG_CHARGE_PARAMETER;
+    if (body.CableCheckReq_isUsed) return HLC_MSG_CABLE_CHECK;
+    if (body.SessionStopReq_isUsed) return HLC_MSG_SESSION_STOP;
+    return HLC_MSG_NONE;
+}
+
+static void hlc_dispatch(uint8_t msg) {
+    uint8_t state = fsmState;
+    uint8_t r = kHlcRouteIndex.route[hlc_cell(g_hlc_protocol, state, msg)];
+    if (!r) {
+        g_hlc_unrouted++;
+        PLC_LOGW("[HLC] No handler for message %u in state %u\n", msg, state);
+        return;
+    }
+    const HlcRoute &route = kHlcRoutes[r - 1];
+    HlcRouteCounters &stats = g_hlc_route_stats[r - 1];
+#if PERF_PROBES_ENABLE
+    uint32_t t0 = perf_probe_now();
+    route.handler();
+    uint32_t cycles = perf_probe_now() - t0;
+    stats.sum_cycles += cycles;
+    if (cycles > stats.max_cycles) stats.max_cycles = cycles;
+#else
+    route.handler();
+#endif
+    stats.calls++;
+    uint16_t allowed = route.next | HLC_NEXT(stateWaitForSupportedApplicationProtocolRequest);
+    if (fsmState >= HLC_STATE_COUNT || !(allowed & HLC_NEXT(fsmState))) {
+        g_hlc_bad_transitions++;
+        PLC_LOGE("[HLC] %s moved state %u to %u\n", route.name, state, fsmState);
+        resetHlcSession();
+    }
+}
+
+uint8_t tcp_hlc_route_count(void) {
+    return HLC_ROUTE_COUNT;
+}
+
+bool tcp_hlc_route_stats(uint8_t idx, HlcRouteStats *out) {
+    if (idx >= HLC_ROUTE_COUNT || !out) return false;
+    const HlcRoute &route = kHlcRoutes[idx];
+    const HlcRouteCounters &stats = g_hlc_route_stats[idx];
+    uint32_t cpu = perf_probe_cycles_per_us();
+    out->name = route.name;
+    out->protocol = static_cast<uint8_t>(route.protocol);
+    out->state = route.state;
+    out->calls = stats.calls;
+    out->max_us = stats.max_cycles / cpu;
+    out->avg_us = stats.calls ? (uint32_t)(stats.sum_cycles / stats.calls / cpu) : 0;
+    return true;
+}
+
+void tcp_hlc_dispatch_counters(uint32_t *unrouted, uint32_t *bad_transitions) {
+    if (unrouted) *unrouted = g_hlc_unrouted;
+    if (bad_transitions) *bad_transitions = g_hlc_bad_transitions;
+}
+
+void tcp_hlc_current_demand_stats(HlcCurrentDemandStats *out) {
+    memset(out, 0, sizeof(*out));
+#if EXI_PATCH_ENABLE
+    out->res_patched = g_current_demand_cache.patched;
+    out->res_encoded = g_current_demand_cache.encoded;
+    out->res_rejected = g_current_demand_cache.rejected;
+    out->req_matched = g_current_demand_req_cache.patched;
+    out->req_decoded = g_current_demand_req_cache.encoded;
+    out->req_rejected = g_current_demand_req_cache.rejected;
+#endif
+}
+
+void tcp_hlc_rx_stats(V2gtpFramerStats *out) {
+    *out = g_v2gtp_rx.stats;
+}
+
+void tcp_hlc_tx_stats(TcpSenderStats *out) {
+    *out = g_tcp_tx.stats;
+}
+
+void tcp_hlc_stats_reset(void) {
+    memset(g_hlc_route_stats, 0, sizeof(g_hlc_route_stats));
+    g_hlc_unrouted = 0;
+    g_hlc_bad_transitions = 0;
+#if EXI_PATCH_ENABLE
+    exi_patch_reset(&g_current_demand_cache);
+    exi_patch_reset(&g_current_demand_req_cache);
+#endif
+}
+
+void decodeV2GTP(void) {
+    routeDecoderInputData();
+    if (fsmState == stateWaitForCurrentDemandRequest && hlc_match_current_demand_req()) {
+        g_rx_frame.len = 0;
+        hlc_dispatch(HLC_MSG_CURRENT_DEMAND);
+        return;
+    }
+    bool decodeOk = false;
+    if (fsmState == stateWaitForSupportedApplicationProtocolRequest) {
+        decodeOk = decode_handshake_message();
+    } else if (g_hlc_protocol == HlcProtocol::Iso2) {
+        decodeOk = decode_iso2_message();
+    } else {
+        decodeOk = decode_din_message();
+    }
+    if (!decodeOk) {
+        g_rx_frame.len = 0; /* mark the input data as "consumed" */
+        return;
+    }
+
+    uint8_t msg;
+    if (fsmState == stateWaitForSupportedApplicationProtocolRequest) {
+        msg = hlc_classify_handshake();
+    } else if (g_hlc_protocol == HlcProtocol::Iso2) {
+        msg = hlc_classify_iso2();
+    } else {
+        msg = hlc_classify_din();
+    }
+    if (msg == HLC_MSG_CURRENT_DEMAND) hlc_take_current_demand_req();   // learns from the raw frame
+    g_rx_frame.len = 0;
+    hlc_dispatch(msg);
 }
 
 
@@ -1474,11 +1851,11 @@ void tcp_packRequestIntoEthernet(void) {
                                                     // #  6 bytes source MAC
                                                     // #  2 bytes EtherType
     //# fill the destination MAC with the MAC of the charger
-    setMacAt(pevMac, 0);
+    setMacAt(slac_primary().pev_mac, 0);
     setMacAt(myMac, 6); // bytes 6 to 11 are the source MAC
     txbuffer[12] = 0x86; // # 86dd is IPv6
     txbuffer[13] = 0xdd;
-    memcpy(txbuffer+14, TcpIpRequest, length);
+    // the IP packet is at txbuffer+14 already (TcpIpRequest)
     
     //Serial.print("[TX] ");
     //for(int x=0; x<length; x++) Serial.printf("%02x",txbuffer[x]);
@@ -1513,9 +1890,7 @@ void tcp_packRequestIntoIp(void) {
     for (i=0; i<16; i++) {
         TcpIpRequest[24+i] = EvccIp[i]; // destination IP address
     }
-    for (i=0; i<TcpTransmitPacketLen; i++) {
-        TcpIpRequest[40+i] = TcpTransmitPacket[i];
-    }
+    // the TCP segment is at TcpIpRequest+40 already (TcpTransmitPacket)
     //showAsHex(TcpIpRequest, TcpIpRequestLen, "TcpIpRequest");
     tcp_packRequestIntoEthernet();
 }
@@ -1553,8 +1928,9 @@ void tcp_prepareTcpHeader(uint8_t tcpFlag) {
     TcpTransmitPacket[12] = (tcpHeaderLen/4) << 4; /* 70 High-nibble: DataOffset in 4-byte-steps. Low-nibble: Reserved=0. */
 
     TcpTransmitPacket[13] = tcpFlag; 
-    TcpTransmitPacket[14] = (uint8_t)(TCP_RECEIVE_WINDOW>>8);
-    TcpTransmitPacket[15] = (uint8_t)(TCP_RECEIVE_WINDOW);
+    uint16_t window = tcp_receiveWindow();
+    TcpTransmitPacket[14] = (uint8_t)(window>>8);
+    TcpTransmitPacket[15] = (uint8_t)(window);
 
     // checksum will be calculated afterwards
     TcpTransmitPacket[16] = 0;
@@ -1566,8 +1942,8 @@ void tcp_prepareTcpHeader(uint8_t tcpFlag) {
     if (tcpHeaderLen > 20) {
         TcpTransmitPacket[20] = 0x02; // MSS option
         TcpTransmitPacket[21] = 0x04;
-        TcpTransmitPacket[22] = 0x05;
-        TcpTransmitPacket[23] = 0xa0;
+        TcpTransmitPacket[22] = (uint8_t)(TCP_TX_MSS >> 8);
+        TcpTransmitPacket[23] = (uint8_t)(TCP_TX_MSS);
     }
     
 
@@ -1580,7 +1956,7 @@ void tcp_prepareTcpHeader(uint8_t tcpFlag) {
 
 
 void tcp_sendFirstAck(void) {
-    Serial.printf("[TCP] sending first ACK\n");
+    PLC_LOGD("[TCP] sending first ACK\n");
     tcpHeaderLen = 24;
     tcpPayloadLen = 0;
     tcp_prepareTcpHeader(TCP_FLAG_ACK | TCP_FLAG_SYN);	
@@ -1588,7 +1964,7 @@ void tcp_sendFirstAck(void) {
 }
 
 void tcp_sendAck(void) {
-   Serial.printf("[TCP] sending ACK\n");
+   PLC_LOGD("[TCP] sending ACK\n");
    tcpHeaderLen = 20; /* 20 bytes normal header, no options */
    tcpPayloadLen = 0;   
    tcp_prepareTcpHeader(TCP_FLAG_ACK);	
@@ -1596,21 +1972,35 @@ void tcp_sendAck(void) {
 }
 
 
-void evaluateTcpPacket(uint16_t payloadOffset, uint16_t ipPayloadLen) {
+// MSS option of the EV's SYN, capped to what we send in one frame.
+static uint16_t tcp_synPeerMss(const uint8_t *tcp, uint16_t hdrLen) {
+    uint16_t mss = TCP_DEFAULT_PEER_MSS;
+    uint16_t i = 20;
+    while (i < hdrLen && tcp[i] != 0) {   // 0: end of option list
+        if (tcp[i] == 1) { i++; continue; }   // NOP
+        if (i + 1 >= hdrLen || tcp[i+1] < 2) break;
+        if (tcp[i] == 2 && tcp[i+1] == 4 && i + 4 <= hdrLen) mss = (tcp[i+2] << 8) | tcp[i+3];
+        i += tcp[i+1];
+    }
+    if (mss == 0) mss = TCP_DEFAULT_PEER_MSS;
+    if (mss > TCP_TX_MSS) mss = TCP_TX_MSS;
+    return mss;
+}
+
+void evaluateTcpPacket(const uint8_t *tcp, uint16_t ipPayloadLen) {
     uint8_t flags;
     uint32_t remoteSeqNr;
     uint32_t remoteAckNr;
-    uint16_t SourcePort, DestinationPort, hdrLen, tmpPayloadLen;
-    const uint8_t *tcp = rxbuffer + payloadOffset;
+    uint16_t SourcePort, DestinationPort, hdrLen, tmpPayloadLen, peerWindow;
         
     if (ipPayloadLen < 20) {
-        Serial.printf("[TCP] payload too short (%u). Drop.\n", ipPayloadLen);
+        PLC_LOGW("[TCP] payload too short (%u). Drop.\n", ipPayloadLen);
         return;
     }
 
     hdrLen = (tcp[12]>>4) * 4; /* header length in byte */
     if (hdrLen < 20 || hdrLen > ipPayloadLen) {
-        Serial.printf("[TCP] invalid header length %u (payload %u)\n", hdrLen, ipPayloadLen);
+        PLC_LOGW("[TCP] invalid header length %u (payload %u)\n", hdrLen, ipPayloadLen);
         return;
     }
     tmpPayloadLen = ipPayloadLen - hdrLen;
@@ -1618,7 +2008,7 @@ void evaluateTcpPacket(uint16_t payloadOffset, uint16_t ipPayloadLen) {
     SourcePort = (tcp[0] << 8) | tcp[1];
     DestinationPort = (tcp[2] << 8) | tcp[3];
     if (DestinationPort != 15118) {
-        Serial.printf("[TCP] wrong port.\n");
+        PLC_LOGW("[TCP] wrong port.\n");
         return; /* wrong port */
     }
     tcpLastActivity = millis();
@@ -1633,10 +2023,10 @@ void evaluateTcpPacket(uint16_t payloadOffset, uint16_t ipPayloadLen) {
             (((uint32_t)tcp[10])<<8) +
             (((uint32_t)tcp[11]));
     flags = tcp[13];
+    peerWindow = (tcp[14] << 8) | tcp[15]; /* no window scaling: we never send the option */
     if (flags & TCP_FLAG_RST) {
-        Serial.printf("TCP RST received\n");
+        PLC_LOGW("TCP RST received\n");
         tcpState = TCP_STATE_CLOSED;
-        tcpAwaitingAck = false;
         resetHlcSession();
         return;
     }
@@ -1644,6 +2034,7 @@ void evaluateTcpPacket(uint16_t payloadOffset, uint16_t ipPayloadLen) {
     if ((flags & TCP_FLAG_SYN) && !(flags & TCP_FLAG_ACK)) { /* connection setup request */
         if (tcpState == TCP_STATE_CLOSED) {
             evccTcpPort = SourcePort; // update the evccTcpPort to the new TCP port
+            tcpPeerMss = tcp_synPeerMss(tcp, hdrLen);
             TcpSeqNr = 0x01020304; // We start with a 'random' sequence nr
             TcpAckNr = remoteSeqNr+1; // The ACK number of our next transmit packet is one more than the received seq number.
             tcpState = TCP_STATE_SYN_ACK;
@@ -1653,50 +2044,47 @@ void evaluateTcpPacket(uint16_t payloadOffset, uint16_t ipPayloadLen) {
     }    
     if ((flags & TCP_FLAG_ACK) && (tcpState == TCP_STATE_SYN_ACK)) {
         if (remoteAckNr == (TcpSeqNr + 1) ) {
-            Serial.printf("-------------- TCP connection established ---------------\n\n");
+            PLC_LOGI("-------------- TCP connection established ---------------\n\n");
             tcpState = TCP_STATE_ESTABLISHED;
             tcpLastActivity = millis();
+            TcpSeqNr = remoteAckNr;
+            tcp_sender_reset(&g_tcp_tx, TcpSeqNr, tcpPeerMss, peerWindow);
         }
         return;
     }
     /* It is no connection setup. We can have the following situations here: */
     if (tcpState != TCP_STATE_ESTABLISHED) {
         /* received something while the connection is closed. Just ignore it. */
-        Serial.printf("[TCP] ignore, not connected.\n");
+        PLC_LOGD("[TCP] ignore, not connected.\n");
         return;    
     } 
 
     // It can be an ACK, or a data package, or a combination of both. We treat the ACK and the data independent from each other,
-    // to treat each combination. 
+    // to treat each combination. The ACK goes first: it may release the frame in flight before the data brings the next one.
+   if (flags & TCP_FLAG_ACK) {
+       PLC_LOGD("This was an ACK\n\n");
+       tcp_sender_ack(&g_tcp_tx, remoteAckNr, peerWindow, tmpPayloadLen == 0, millis());
+       tcp_sendPending();   // the window may have moved, or three duplicates asked for a resend
+   }
+
    if (tmpPayloadLen > 0) {
-        if (tmpPayloadLen >= TCP_RX_DATA_LEN) {
-            Serial.printf("TCP payload too large (%u)\n", tmpPayloadLen);
-            resetHlcSession();
+        if (remoteSeqNr != TcpAckNr || tmpPayloadLen > tcp_receiveWindow()) {
+            // A resent, out-of-order or oversized segment is not buffered;
+            // the ACK tells the EV which byte we expect.
+            PLC_LOGD("[TCP] segment %08x (%u) outside the window\n", remoteSeqNr, tmpPayloadLen);
+            tcp_sendAck();
             return;
         }
         /* This is a data transfer packet. */
         TcpAckNr = remoteSeqNr + tmpPayloadLen; // ACK references end of payload
-        TcpSeqNr = remoteAckNr;
         tcp_sendAck();  // Send Ack, then process data
         tcp_bufferPayload(tcp + hdrLen, tmpPayloadLen, false);
     }
 
-   if (flags & TCP_FLAG_ACK) {
-       Serial.printf("This was an ACK\n\n");
-       //nTcpPacketsReceived+=1000;
-       TcpSeqNr = remoteAckNr; /* The sequence number of our next transmit packet is given by the received ACK number. */
-       if (tcpAwaitingAck && remoteAckNr >= expectedTcpAckNr) {
-           tcpAwaitingAck = false;
-           lastTcpPayloadLen = 0;
-           tcpRetransmitAttempts = 0;
-       }
-   }
-
    if (flags & TCP_FLAG_FIN) {
        TcpAckNr = remoteSeqNr + tmpPayloadLen + 1;
        tcp_sendAck();
        tcpState = TCP_STATE_CLOSED;
-       tcpAwaitingAck = false;
        resetHlcSession();
        return;
    }
@@ -0,0 +1,156 @@
+#include "tcp_sender.h"
+
+#include <string.h>
+
+namespace {
+uint16_t min16(uint32_t a, uint32_t b) {
+    return (uint16_t)(a < b ? a : b);
+}
+
+// RFC 6298 2.2/2.3 in the usual fixed point: srtt8 = 8 * SRTT, rttvar4 = 4 * RTTVAR.
+void rtt_sample(TcpSender *s, uint32_t r) {
+    if (!s->stats.rtt_samples) {
+        s->srtt8 = r << 3;
+        s->rttvar4 = r << 1;
+    } else {
+        int32_t delta = (int32_t)r - (int32_t)(s->srtt8 >> 3);
+        s->srtt8 += delta;
+        if (delta < 0) delta = -delta;
+        s->rttvar4 += delta - (int32_t)(s->rttvar4 >> 2);
+    }
+    uint32_t rto = (s->srtt8 >> 3) + (s->rttvar4 ? s->rttvar4 : 1);
+    if (rto < TCP_RTO_MIN_MS) rto = TCP_RTO_MIN_MS;
+    if (rto > TCP_RTO_MAX_MS) rto = TCP_RTO_MAX_MS;
+    s->rto_ms = (uint16_t)rto;
+    s->stats.rtt_samples++;
+    s->stats.srtt_ms = (uint16_t)(s->srtt8 >> 3);
+    s->stats.rttvar_ms = (uint16_t)(s->rttvar4 >> 2);
+    s->stats.rto_ms = s->rto_ms;
+}
+}
+
+void tcp_sender_reset(TcpSender *s, uint32_t seq, uint16_t mss, uint16_t peer_wnd) {
+    memset(s, 0, sizeof(*s));
+    s->seq = seq;
+    s->mss = mss ? mss : 1;
+    s->peer_wnd = peer_wnd;
+    s->burst = TCP_TX_WINDOW_SEGMENTS;
+    s->rto_ms = TCP_RTO_INITIAL_MS;
+    s->stats.rto_ms = s->rto_ms;
+}
+
+void tcp_sender_start(TcpSender *s, const uint8_t *data, uint16_t len) {
+    s->seq += s->high;
+    s->data = data;
+    s->len = len;
+    s->una = s->nxt = s->high = 0;
+    s->dup_acks = 0;
+    s->fast_rexmit = false;
+    s->timeouts = 0;
+    s->timing = false;
+    s->timer_on = false;
+}
+
+bool tcp_sender_busy(const TcpSender *s) {
+    return s->una < s->len;
+}
+
+uint32_t tcp_sender_snd_nxt(const TcpSender *s) {
+    return s->seq + s->high;
+}
+
+void tcp_sender_ack(TcpSender *s, uint32_t ack, uint16_t wnd, bool pure, uint32_t now) {
+    uint32_t off = ack - s->seq;
+    if (off > s->high) return;      // old (wrapped) or for data never sent
+    if (off > s->una) {
+        if (s->timing && off >= s->timed_end) {
+            rtt_sample(s, now - s->timed_at);
+            s->timing = false;
+        }
+        s->una = (uint16_t)off;
+        if (s->nxt < s->una) s->nxt = s->una;   // acked past a go-back-N restart
+        s->peer_wnd = wnd;
+        s->dup_acks = 0;
+        s->fast_rexmit = false;
+        s->timeouts = 0;
+        s->burst = TCP_TX_WINDOW_SEGMENTS;
+        s->timer_at = now;          // RFC 6298 5.3
+        if (s->una == s->high) s->timer_on = false;
+        if (s->una == s->len) {
+            // frame done: sequence numbers continue after it
+            s->seq += s->len;
+            s->data = 0;
+            s->len = s->una = s->nxt = s->high = 0;
+        }
+        return;
+    }
+    if (off != s->una) return;
+    if (!pure || wnd != s->peer_wnd || s->una == s->high) {
+        s->peer_wnd = wnd;          // window update, not a duplicate
+        return;
+    }
+    if (++s->dup_acks == TCP_DUP_ACK_THRESHOLD) {
+        s->fast_rexmit = true;
+        s->timing = false;
+    }
+}
+
+bool tcp_sender_next(TcpSender *s, uint32_t now, TcpSegment *out) {
+    if (s->una >= s->len) return false;
+    uint16_t off;
+    if (s->fast_rexmit) {
+        s->fast_rexmit = false;
+        off = s->una;
+        s->stats.fast_retransmits++;
+    } else {
+        if (s->nxt >= s->len) return false;
+        uint16_t inflight = (uint16_t)(s->nxt - s->una);
+        uint16_t n = min16(s->len - s->nxt, s->mss);
+        uint32_t wnd = (uint32_t)s->mss * s->burst;
+        if (s->peer_wnd < wnd) wnd = s->peer_wnd;
+        // An empty pipe always gets one segment, which also probes a closed window.
+        if (inflight && (uint32_t)inflight + n > wnd) return false;
+        off = s->nxt;
+        if (off < s->high) s->stats.retransmits++;
+    }
+    uint16_t n = min16(s->len - off, s->mss);
+    out->seq = s->seq + off;
+    out->data = s->data + off;
+    out->len = n;
+    out->push = off + n == s->len;
+    if (off == s->nxt) {
+        s->nxt = (uint16_t)(s->nxt + n);
+        if (s->nxt > s->high) {
+            if (!s->timing && off >= s->high) {
+                s->timing = true;
+                s->timed_end = s->nxt;
+                s->timed_at = now;
+            }
+            s->high = s->nxt;
+        }
+    }
+    if (!s->timer_on) {
+        s->timer_on = true;
+        s->timer_at = now;
+    }
+    uint16_t inflight = (uint16_t)(s->high - s->una);
+    if (inflight > s->stats.max_inflight) s->stats.max_inflight = inflight;
+    s->stats.segments++;
+    return true;
+}
+
+TcpSenderTick tcp_sender_tick(TcpSender *s, uint32_t now) {
+    if (!s->timer_on || s->una >= s->len || now - s->timer_at < s->rto_ms) return TCP_SENDER_IDLE;
+    if (s->timeouts >= TCP_MAX_RETRANSMIT) return TCP_SENDER_GIVE_UP;
+    s->timeouts++;
+    s->stats.timeouts++;
+    s->rto_ms = min16((uint32_t)s->rto_ms * 2, TCP_RTO_MAX_MS);    // RFC 6298 5.5
+    s->stats.rto_ms = s->rto_ms;
+    s->nxt = s->una;
+    s->burst = 1;
+    s->dup_acks = 0;
+    s->fast_rexmit = false;
+    s->timing = false;
+    s->timer_at = now;
+    return TCP_SENDER_RETRANSMIT;
+}
@@ -0,0 +1,86 @@
+#include "tls_session_cache.h"
+
+#include <stddef.h>
+#include <string.h>
+
+namespace {
+bool expired(const TlsSessionCache *cache, const TlsSessionEntry *e, uint32_t now_s) {
+    return now_s - e->stored_at >= cache->timeout_s;
+}
+
+void drop(TlsSessionCache *cache, TlsSessionEntry *e) {
+    e->len = 0;
+    cache->stats.entries--;
+}
+
+TlsSessionEntry *lookup(TlsSessionCache *cache, const uint8_t *id, uint8_t id_len) {
+    for (TlsSessionEntry &e : cache->entries) {
+        if (e.len && e.id_len == id_len && !memcmp(e.id, id, id_len)) return &e;
+    }
+    return nullptr;
+}
+
+// A free entry, else an expired one, else the least recently used.
+TlsSessionEntry *victim(TlsSessionCache *cache, uint32_t now_s) {
+    TlsSessionEntry *lru = nullptr;
+    for (TlsSessionEntry &e : cache->entries) {
+        if (!e.len) return &e;
+        if (expired(cache, &e, now_s)) {
+            drop(cache, &e);
+            cache->stats.expired++;
+            return &e;
+        }
+        if (!lru || now_s - e.used_at > now_s - lru->used_at) lru = &e;
+    }
+    drop(cache, lru);
+    cache->stats.evicted++;
+    return lru;
+}
+}  // namespace
+
+void tls_session_cache_reset(TlsSessionCache *cache, uint32_t timeout_s) {
+    for (TlsSessionEntry &e : cache->entries) e.len = 0;
+    cache->timeout_s = timeout_s;
+    memset(&cache->stats, 0, sizeof(cache->stats));
+}
+
+const uint8_t *tls_session_cache_find(TlsSessionCache *cache, const uint8_t *id, uint8_t id_len,
+                                      uint32_t now_s, uint16_t *len) {
+    TlsSessionEntry *e = id_len ? lookup(cache, id, id_len) : nullptr;
+    if (e && expired(cache, e, now_s)) {
+        drop(cache, e);
+        cache->stats.expired++;
+        e = nullptr;
+    }
+    if (!e) {
+        cache->stats.misses++;
+        return nullptr;
+    }
+    e->used_at = now_s;
+    cache->stats.hits++;
+    *len = e->len;
+    return e->blob;
+}
+
+uint8_t *tls_session_cache_reserve(TlsSessionCache *cache, const uint8_t *id, uint8_t id_len, uint32_t now_s) {
+    if (id_len == 0 || id_len > TLS_SESSION_ID_MAX) return nullptr;
+    TlsSessionEntry *e = lookup(cache, id, id_len);
+    if (e) drop(cache, e);
+    if (!e) e = victim(cache, now_s);
+    memcpy(e->id, id, id_len);
+    e->id_len = id_len;
+    e->stored_at = now_s;
+    e->used_at = now_s;
+    return e->blob;
+}
+
+void tls_session_cache_commit(TlsSessionCache *cache, uint8_t *blob, uint16_t len) {
+    if (!len || len > TLS_SESSION_BLOB_MAX) {
+        cache->stats.too_big++;
+        return;
+    }
+    TlsSessionEntry *e = reinterpret_cast<TlsSessionEntry *>(blob - offsetof(TlsSessionEntry, blob));
+    e->len = len;
+    cache->stats.stored++;
+    cache->stats.entries++;
+}
@@ -0,0 +1,115 @@
+#include "v2gtp_framer.h"
+
+#include <string.h>
+
+namespace {
+const uint16_t kMask = V2GTP_RX_RING_BYTES - 1;
+
+uint8_t peek(const V2gtpFramer *f, uint16_t off) {
+    return f->ring[(uint16_t)(f->head + off) & kMask];
+}
+
+void drop(V2gtpFramer *f, uint16_t n) {
+    f->level = (uint16_t)(f->level - n);
+    // An empty ring starts over at 0, so the next frames rarely wrap.
+    f->head = f->level ? (uint16_t)(f->head + n) & kMask : 0;
+}
+}
+
+void v2gtp_framer_reset(V2gtpFramer *f) {
+    f->head = 0;
+    f->level = 0;
+    f->pending = 0;
+    f->skip = 0;
+    memset(&f->stats, 0, sizeof(f->stats));
+}
+
+uint16_t v2gtp_framer_write(V2gtpFramer *f, const uint8_t *data, uint16_t len) {
+    uint16_t taken = 0;
+    if (f->skip && !f->level) {
+        // rest of an oversize frame: drop it before it reaches the ring
+        uint16_t n = f->skip < len ? (uint16_t)f->skip : len;
+        f->skip -= n;
+        data += n;
+        len = (uint16_t)(len - n);
+        taken = n;
+    }
+    uint16_t room = (uint16_t)(V2GTP_RX_RING_BYTES - f->level);
+    uint16_t n = len < room ? len : room;
+    if (!n) return taken;
+    uint16_t tail = (uint16_t)(f->head + f->level) & kMask;
+    // Sizes from the overhang, not min(n, room): a bounded size makes GCC
+    // inline a much slower `rep movsq` on x86 hosts.
+    size_t wrap = tail + n > V2GTP_RX_RING_BYTES ? tail + n - V2GTP_RX_RING_BYTES : 0;
+    memcpy(f->ring + tail, data, n - wrap);
+    if (wrap) memcpy(f->ring, data + n - wrap, wrap);
+    f->level = (uint16_t)(f->level + n);
+    if (f->level > f->stats.max_level) f->stats.max_level = f->level;
+    return (uint16_t)(taken + n);
+}
+
+void v2gtp_framer_flush(V2gtpFramer *f) {
+    f->head = 0;
+    f->level = 0;
+    f->pending = 0;
+    f->skip = 0;
+}
+
+void v2gtp_framer_release(V2gtpFramer *f) {
+    if (!f->pending) return;
+    drop(f, f->pending);
+    f->pending = 0;
+}
+
+V2gtpNext v2gtp_framer_next(V2gtpFramer *f, V2gtpFrame *out) {
+    v2gtp_framer_release(f);
+    for (;;) {
+        if (f->skip) {
+            uint16_t n = f->skip < f->level ? (uint16_t)f->skip : f->level;
+            drop(f, n);
+            f->skip -= n;
+            if (f->skip) return V2GTP_NEED_MORE;
+        }
+        if (f->level < V2GTP_HEADER_BYTES) return V2GTP_NEED_MORE;
+        uint8_t hdr[V2GTP_HEADER_BYTES];
+        const uint8_t *h = f->ring + f->head;
+        if (f->head > V2GTP_RX_RING_BYTES - V2GTP_HEADER_BYTES) {
+            for (uint8_t i = 0; i < V2GTP_HEADER_BYTES; i++) hdr[i] = peek(f, i);
+            h = hdr;
+        }
+        if (h[0] != 0x01 || h[1] != 0xFE) {
+            f->stats.bad_header++;
+            drop(f, f->level);
+            return V2GTP_BAD_HEADER;
+        }
+        uint32_t payload_len = ((uint32_t)h[4] << 24) | ((uint32_t)h[5] << 16) | ((uint32_t)h[6] << 8) | h[7];
+        if (payload_len > V2GTP_MAX_FRAME_BYTES - V2GTP_HEADER_BYTES) {
+            f->stats.oversize++;
+            drop(f, V2GTP_HEADER_BYTES);
+            f->skip = payload_len;
+            continue;
+        }
+        uint16_t frame_len = (uint16_t)(V2GTP_HEADER_BYTES + payload_len);
+        if (f->level < frame_len) return V2GTP_NEED_MORE;
+
+        out->payload_type = (uint16_t)((h[2] << 8) | h[3]);
+        out->len = (uint16_t)payload_len;
+        uint16_t start = (uint16_t)(f->head + V2GTP_HEADER_BYTES) & kMask;
+        size_t wrap = start + payload_len > V2GTP_RX_RING_BYTES ? start + payload_len - V2GTP_RX_RING_BYTES : 0;
+        if (!wrap) {
+            out->payload = f->ring + start;
+        } else {
+            memcpy(f->linear, f->ring + start, payload_len - wrap);
+            memcpy(f->linear + payload_len - wrap, f->ring, wrap);
+            out->payload = f->linear;
+            f->stats.linearized++;
+        }
+        f->pending = frame_len;
+        f->stats.frames++;
+        return V2GTP_FRAME;
+    }
+}
+
+uint16_t v2gtp_framer_level(const V2gtpFramer *f) {
+    return f->level;
+}
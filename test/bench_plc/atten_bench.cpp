@@ -0,0 +1,87 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "atten_engine.h"
+
+namespace {
+
+// One sounding at the largest count the EVSE negotiates (MAX_SUPPORTED_SOUND_COUNT).
+constexpr int kSounds = 20;
+
+std::vector<uint8_t> profiles() {
+    std::vector<uint8_t> p(kSounds * SLAC_ATTEN_GROUPS);
+    uint32_t x = 15118;
+    for (uint8_t &v : p) {
+        x = x * 1103515245u + 12345u;
+        v = static_cast<uint8_t>(20 + ((x >> 16) % 40));
+    }
+    return p;
+}
+
+// What SlacManager and setACVarField did: per-byte sums, per-byte divide.
+void BM_AttenLegacyMeanOnly(benchmark::State &state) {
+    std::vector<uint8_t> p = profiles();
+    uint16_t avg[SLAC_ATTEN_GROUPS];
+    uint8_t out[SLAC_ATTEN_GROUPS];
+    for (auto _ : state) {
+        std::memset(avg, 0, sizeof(avg));
+        for (int s = 0; s < kSounds; ++s) {
+            const uint8_t *frame = p.data() + s * SLAC_ATTEN_GROUPS;
+            for (uint8_t x = 0; x < SLAC_ATTEN_GROUPS; x++) avg[x] += frame[x];
+        }
+        for (uint8_t x = 0; x < SLAC_ATTEN_GROUPS; x++) out[x] = static_cast<uint8_t>(avg[x] / kSounds);
+        benchmark::DoNotOptimize(out);
+    }
+}
+
+// Mean, variance and trimmed mean computed one group at a time.
+void BM_AttenScalarStats(benchmark::State &state) {
+    std::vector<uint8_t> p = profiles();
+    uint16_t sum[SLAC_ATTEN_GROUPS];
+    uint32_t sq[SLAC_ATTEN_GROUPS];
+    uint8_t mn[SLAC_ATTEN_GROUPS], mx[SLAC_ATTEN_GROUPS];
+    AttenStats st;
+    for (auto _ : state) {
+        std::memset(sum, 0, sizeof(sum));
+        std::memset(sq, 0, sizeof(sq));
+        std::memset(mn, 0xFF, sizeof(mn));
+        std::memset(mx, 0, sizeof(mx));
+        for (int s = 0; s < kSounds; ++s) {
+            const uint8_t *frame = p.data() + s * SLAC_ATTEN_GROUPS;
+            for (uint8_t x = 0; x < SLAC_ATTEN_GROUPS; x++) {
+                uint8_t v = frame[x];
+                sum[x] += v;
+                sq[x] += v * v;
+                if (v < mn[x]) mn[x] = v;
+                if (v > mx[x]) mx[x] = v;
+            }
+        }
+        for (uint8_t x = 0; x < SLAC_ATTEN_GROUPS; x++) {
+            st.mean[x] = static_cast<uint8_t>(sum[x] / kSounds);
+            st.var[x] = static_cast<uint16_t>((kSounds * sq[x] - sum[x] * sum[x]) / (kSounds * kSounds));
+            st.trimmed[x] = static_cast<uint8_t>((sum[x] - mn[x] - mx[x]) / (kSounds - 2));
+        }
+        benchmark::DoNotOptimize(st);
+    }
+}
+
+void BM_AttenEngine(benchmark::State &state) {
+    std::vector<uint8_t> p = profiles();
+    AttenAccum acc;
+    AttenStats st;
+    for (auto _ : state) {
+        atten_reset(&acc);
+        for (int s = 0; s < kSounds; ++s) atten_add(&acc, p.data() + s * SLAC_ATTEN_GROUPS);
+        atten_finish(&acc, &st);
+        benchmark::DoNotOptimize(st);
+    }
+}
+
+} // namespace
+
+BENCHMARK(BM_AttenLegacyMeanOnly);
+BENCHMARK(BM_AttenScalarStats);
+BENCHMARK(BM_AttenEngine);
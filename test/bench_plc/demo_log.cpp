@@ -0,0 +1,51 @@
+#include "demo_log.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+namespace {
+
+bool parse_frame_line(const std::string &line, std::vector<uint8_t> *out) {
+    size_t pos = line.find(" has ");
+    if (pos == std::string::npos) return false;
+    size_t declared = std::strtoul(line.c_str() + pos + 5, nullptr, 10);
+    size_t colon = line.rfind(':');
+    if (colon == std::string::npos || declared == 0) return false;
+    out->clear();
+    int hi = -1;
+    for (size_t i = colon + 1; i < line.size(); ++i) {
+        char c = line[i];
+        if (!std::isxdigit(static_cast<unsigned char>(c))) continue;
+        int nibble = std::isdigit(static_cast<unsigned char>(c)) ? c - '0' : (std::tolower(c) - 'a' + 10);
+        if (hi < 0) {
+            hi = nibble;
+        } else {
+            out->push_back(static_cast<uint8_t>((hi << 4) | nibble));
+            hi = -1;
+        }
+    }
+    return hi < 0 && out->size() == declared;
+}
+
+} // namespace
+
+bool demo_log_load(const char *path, DemoLogFrames *requests, DemoLogFrames *responses) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+    std::string line;
+    std::vector<uint8_t> frame;
+    bool expect_response = false;
+    while (std::getline(file, line)) {
+        if (line.find("tcpPayload has") != std::string::npos) {
+            if (parse_frame_line(line, &frame)) requests->push_back(frame);
+        } else if (line.find("In state") != std::string::npos && line.find("received") != std::string::npos) {
+            expect_response = true;
+        } else if (expect_response && line.find(" has ") != std::string::npos) {
+            if (parse_frame_line(line, &frame)) responses->push_back(frame);
+            expect_response = false;
+        }
+    }
+    return !requests->empty();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// V2GTP frames of the demo charging log the DIN replay test uses (same line
+// format as iso_flow_test.cpp). The log is not part of the tree; benchmarks
+// that need it skip their log vectors when it is missing.
+
+#ifndef DEMO_CHARGING_LOG_PATH
+#define DEMO_CHARGING_LOG_PATH "../../temp/ccs32berta/doc/2023-07-04_demoChargingWorks.log"
+#endif
+
+using DemoLogFrames = std::vector<std::vector<uint8_t>>;
+
+// EV requests and EVSE responses in log order, V2GTP header included. False
+// when the log cannot be read or has no request.
+bool demo_log_load(const char *path, DemoLogFrames *requests, DemoLogFrames *responses);
@@ -0,0 +1,478 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "demo_log.h"
+
+extern "C" {
+#include "cbv2g/app_handshake/appHand_Datatypes.h"
+#include "cbv2g/app_handshake/appHand_Decoder.h"
+#include "cbv2g/app_handshake/appHand_Encoder.h"
+#include "cbv2g/common/exi_bitstream.h"
+#include "cbv2g/din/din_msgDefDatatypes.h"
+#include "cbv2g/din/din_msgDefDecoder.h"
+#include "cbv2g/din/din_msgDefEncoder.h"
+#include "cbv2g/iso_2/iso2_msgDefDatatypes.h"
+#include "cbv2g/iso_2/iso2_msgDefDecoder.h"
+#include "cbv2g/iso_2/iso2_msgDefEncoder.h"
+}
+
+// libcbv2g encode/decode cost of every message the HLC FSM handles, one
+// BM_ExiDecode/<proto>/<message> and BM_ExiEncode/<proto>/<message> pair per
+// type. Handshake and DIN frames come from the demo charging log the DIN
+// replay test uses; that log has no ISO-2 session, so the ISO-2 frames are
+// built here with the fields the firmware and a typical EV fill in.
+
+namespace {
+
+constexpr size_t kV2gtpHeader = 8;
+constexpr size_t kMaxFramesPerType = 16;
+constexpr size_t kEncodeBuffer = 1024;
+
+using Frames = std::vector<std::vector<uint8_t>>;
+
+struct MessageFrames {
+    std::string name;       // "<proto>/<message>"
+    Frames frames;          // EXI payloads without the V2GTP header
+};
+
+void add_frame(std::vector<MessageFrames> &out, const std::string &name, const uint8_t *exi, size_t len) {
+    for (MessageFrames &m : out) {
+        if (m.name != name) continue;
+        if (m.frames.size() < kMaxFramesPerType) m.frames.emplace_back(exi, exi + len);
+        return;
+    }
+    out.push_back(MessageFrames{name, Frames{std::vector<uint8_t>(exi, exi + len)}});
+}
+
+#define DIN_BODY(msg) {#msg, [](const din_BodyType &b) { return b.msg##_isUsed != 0; }}
+
+const struct {
+    const char *name;
+    bool (*used)(const din_BodyType &);
+} kDinBodies[] = {
+    DIN_BODY(SessionSetupReq), DIN_BODY(SessionSetupRes),
+    DIN_BODY(ServiceDiscoveryReq), DIN_BODY(ServiceDiscoveryRes),
+    DIN_BODY(ServicePaymentSelectionReq), DIN_BODY(ServicePaymentSelectionRes),
+    DIN_BODY(ContractAuthenticationReq), DIN_BODY(ContractAuthenticationRes),
+    DIN_BODY(ChargeParameterDiscoveryReq), DIN_BODY(ChargeParameterDiscoveryRes),
+    DIN_BODY(CableCheckReq), DIN_BODY(CableCheckRes),
+    DIN_BODY(PreChargeReq), DIN_BODY(PreChargeRes),
+    DIN_BODY(PowerDeliveryReq), DIN_BODY(PowerDeliveryRes),
+    DIN_BODY(CurrentDemandReq), DIN_BODY(CurrentDemandRes),
+    DIN_BODY(MeteringReceiptReq), DIN_BODY(MeteringReceiptRes),
+    DIN_BODY(SessionStopReq), DIN_BODY(SessionStopRes),
+};
+
+void classify_log_frame(std::vector<MessageFrames> &out, const std::vector<uint8_t> &frame, bool handshake) {
+    if (frame.size() <= kV2gtpHeader) return;
+    uint8_t *exi = const_cast<uint8_t *>(frame.data()) + kV2gtpHeader;
+    size_t len = frame.size() - kV2gtpHeader;
+    exi_bitstream_t s;
+    exi_bitstream_init(&s, exi, len, 0, nullptr);
+    if (handshake) {
+        std::unique_ptr<appHand_exiDocument> doc(new appHand_exiDocument);
+        if (decode_appHand_exiDocument(&s, doc.get()) != 0) return;
+        add_frame(out, doc->supportedAppProtocolReq_isUsed ? "apphand/SupportedAppProtocolReq"
+                                                            : "apphand/SupportedAppProtocolRes",
+                  exi, len);
+        return;
+    }
+    std::unique_ptr<din_exiDocument> doc(new din_exiDocument);
+    if (decode_din_exiDocument(&s, doc.get()) != 0) return;
+    for (const auto &body : kDinBodies) {
+        if (body.used(doc->V2G_Message.Body)) {
+            add_frame(out, std::string("din/") + body.name, exi, len);
+            return;
+        }
+    }
+}
+
+// ---- ISO-2 frames ----
+
+const uint8_t kSessionId[8] = {0x4A, 0x1B, 0x3C, 0x00, 0x21, 0x77, 0x10, 0x05};
+
+void iso2_header(iso2_exiDocument *doc) {
+    init_iso2_exiDocument(doc);
+    init_iso2_V2G_Message(&doc->V2G_Message);
+    init_iso2_MessageHeaderType(&doc->V2G_Message.Header);
+    init_iso2_BodyType(&doc->V2G_Message.Body);
+    std::memcpy(doc->V2G_Message.Header.SessionID.bytes, kSessionId, sizeof(kSessionId));
+    doc->V2G_Message.Header.SessionID.bytesLen = sizeof(kSessionId);
+}
+
+void iso2_value(iso2_PhysicalValueType *p, iso2_unitSymbolType unit, int8_t multiplier, int16_t value) {
+    init_iso2_PhysicalValueType(p);
+    p->Unit = unit;
+    p->Multiplier = multiplier;
+    p->Value = value;
+}
+
+void iso2_ev_status(iso2_DC_EVStatusType *s) {
+    init_iso2_DC_EVStatusType(s);
+    s->EVReady = 1;
+    s->EVErrorCode = iso2_DC_EVErrorCodeType_NO_ERROR;
+    s->EVRESSSOC = 42;
+}
+
+void iso2_evse_status(iso2_DC_EVSEStatusType *s) {
+    init_iso2_DC_EVSEStatusType(s);
+    s->NotificationMaxDelay = 0;
+    s->EVSENotification = iso2_EVSENotificationType_None;
+    s->EVSEStatusCode = iso2_DC_EVSEStatusCodeType_EVSE_Ready;
+    s->EVSEIsolationStatus = iso2_isolationLevelType_Valid;
+    s->EVSEIsolationStatus_isUsed = 1;
+}
+
+template <size_t N>
+void iso2_chars(char (&dst)[N], uint16_t &len, const char *src) {
+    len = static_cast<uint16_t>(std::min(std::strlen(src), N));
+    std::memcpy(dst, src, len);
+}
+
+#define ISO2_MSG(msg) \
+    b.msg##_isUsed = 1; \
+    init_iso2_##msg##Type(&b.msg); \
+    auto &m = b.msg; \
+    (void)m
+
+using Iso2Builder = void (*)(iso2_BodyType &b);
+
+const struct {
+    const char *name;
+    Iso2Builder build;
+} kIso2Messages[] = {
+    {"SessionSetupReq", [](iso2_BodyType &b) {
+         ISO2_MSG(SessionSetupReq);
+         const uint8_t evcc[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+         std::memcpy(m.EVCCID.bytes, evcc, sizeof(evcc));
+         m.EVCCID.bytesLen = sizeof(evcc);
+     }},
+    {"SessionSetupRes", [](iso2_BodyType &b) {
+         ISO2_MSG(SessionSetupRes);
+         m.ResponseCode = iso2_responseCodeType_OK_NewSessionEstablished;
+         iso2_chars(m.EVSEID.characters, m.EVSEID.charactersLen, "DE*ESP*E0001");
+         m.EVSETimeStamp_isUsed = 0;
+     }},
+    {"ServiceDiscoveryReq", [](iso2_BodyType &b) {
+         ISO2_MSG(ServiceDiscoveryReq);
+         m.ServiceScope_isUsed = 0;
+         m.ServiceCategory_isUsed = 0;
+     }},
+    {"ServiceDiscoveryRes", [](iso2_BodyType &b) {
+         ISO2_MSG(ServiceDiscoveryRes);
+         m.ResponseCode = iso2_responseCodeType_OK;
+         m.PaymentOptionList.PaymentOption.arrayLen = 1;
+         m.PaymentOptionList.PaymentOption.array[0] = iso2_paymentOptionType_ExternalPayment;
+         m.ChargeService.ServiceID = 1;
+         m.ChargeService.ServiceCategory = iso2_serviceCategoryType_EVCharging;
+         m.ChargeService.FreeService = 0;
+         m.ChargeService.ServiceName_isUsed = 0;
+         m.ChargeService.ServiceScope_isUsed = 0;
+         m.ChargeService.SupportedEnergyTransferMode.EnergyTransferMode.arrayLen = 1;
+         m.ChargeService.SupportedEnergyTransferMode.EnergyTransferMode.array[0] =
+             iso2_EnergyTransferModeType_DC_extended;
+         m.ServiceList_isUsed = 0;
+     }},
+    {"PaymentServiceSelectionReq", [](iso2_BodyType &b) {
+         ISO2_MSG(PaymentServiceSelectionReq);
+         m.SelectedPaymentOption = iso2_paymentOptionType_ExternalPayment;
+         m.SelectedServiceList.SelectedService.arrayLen = 1;
+         m.SelectedServiceList.SelectedService.array[0].ServiceID = 1;
+         m.SelectedServiceList.SelectedService.array[0].ParameterSetID_isUsed = 0;
+     }},
+    {"PaymentServiceSelectionRes", [](iso2_BodyType &b) {
+         ISO2_MSG(PaymentServiceSelectionRes);
+         m.ResponseCode = iso2_responseCodeType_OK;
+     }},
+    {"PaymentDetailsReq", [](iso2_BodyType &b) {
+         ISO2_MSG(PaymentDetailsReq);
+         iso2_chars(m.eMAID.characters, m.eMAID.charactersLen, "DE8AAA1B2C3D4E5");
+         m.ContractSignatureCertChain.Id_isUsed = 0;
+         m.ContractSignatureCertChain.SubCertificates_isUsed = 0;
+         m.ContractSignatureCertChain.Certificate.bytesLen = 400;     // typical DER size
+         for (uint16_t i = 0; i < 400; ++i) m.ContractSignatureCertChain.Certificate.bytes[i] = (uint8_t)(i * 7);
+     }},
+    {"PaymentDetailsRes", [](iso2_BodyType &b) {
+         ISO2_MSG(PaymentDetailsRes);
+         m.ResponseCode = iso2_responseCodeType_OK;
+         m.GenChallenge.bytesLen = 16;
+         for (uint8_t i = 0; i < 16; ++i) m.GenChallenge.bytes[i] = (uint8_t)(0xA5 ^ i);
+         m.EVSETimeStamp = 1700000000;
+     }},
+    {"AuthorizationReq", [](iso2_BodyType &b) {
+         ISO2_MSG(AuthorizationReq);
+         m.Id_isUsed = 0;
+         m.GenChallenge_isUsed = 0;
+     }},
+    {"AuthorizationRes", [](iso2_BodyType &b) {
+         ISO2_MSG(AuthorizationRes);
+         m.ResponseCode = iso2_responseCodeType_OK;
+         m.EVSEProcessing = iso2_EVSEProcessingType_Finished;
+     }},
+    {"ChargeParameterDiscoveryReq", [](iso2_BodyType &b) {
+         ISO2_MSG(ChargeParameterDiscoveryReq);
+         m.MaxEntriesSAScheduleTuple_isUsed = 0;
+         m.RequestedEnergyTransferMode = iso2_EnergyTransferModeType_DC_extended;
+         m.AC_EVChargeParameter_isUsed = 0;
+         m.EVChargeParameter_isUsed = 0;
+         m.DC_EVChargeParameter_isUsed = 1;
+         init_iso2_DC_EVChargeParameterType(&m.DC_EVChargeParameter);
+         auto &p = m.DC_EVChargeParameter;
+         p.DepartureTime_isUsed = 0;
+         iso2_ev_status(&p.DC_EVStatus);
+         iso2_value(&p.EVMaximumCurrentLimit, iso2_unitSymbolType_A, 0, 125);
+         iso2_value(&p.EVMaximumVoltageLimit, iso2_unitSymbolType_V, 0, 420);
+         iso2_value(&p.EVMaximumPowerLimit, iso2_unitSymbolType_W, 3, 50);
+         p.EVMaximumPowerLimit_isUsed = 1;
+         p.EVEnergyCapacity_isUsed = 0;
+         p.EVEnergyRequest_isUsed = 0;
+         p.FullSOC_isUsed = 0;
+         p.BulkSOC_isUsed = 0;
+     }},
+    {"ChargeParameterDiscoveryRes", [](iso2_BodyType &b) {
+         ISO2_MSG(ChargeParameterDiscoveryRes);
+         m.ResponseCode = iso2_responseCodeType_OK;
+         m.EVSEProcessing = iso2_EVSEProcessingType_Finished;
+         m.SAScheduleList_isUsed = 0;
+         m.SASchedules_isUsed = 0;
+         m.AC_EVSEChargeParameter_isUsed = 0;
+         m.EVSEChargeParameter_isUsed = 0;
+         m.DC_EVSEChargeParameter_isUsed = 1;
+         init_iso2_DC_EVSEChargeParameterType(&m.DC_EVSEChargeParameter);
+         auto &p = m.DC_EVSEChargeParameter;
+         iso2_evse_status(&p.DC_EVSEStatus);
+         iso2_value(&p.EVSEMaximumVoltageLimit, iso2_unitSymbolType_V, -1, 5000);
+         iso2_value(&p.EVSEMinimumVoltageLimit, iso2_unitSymbolType_V, -1, 1500);
+         iso2_value(&p.EVSEMaximumCurrentLimit, iso2_unitSymbolType_A, -1, 1250);
+         iso2_value(&p.EVSEMinimumCurrentLimit, iso2_unitSymbolType_A, -1, 0);
+         iso2_value(&p.EVSEMaximumPowerLimit, iso2_unitSymbolType_W, 1, 3000);
+         iso2_value(&p.EVSEPeakCurrentRipple, iso2_unitSymbolType_A, -1, 20);
+         p.EVSECurrentRegulationTolerance_isUsed = 0;
+         p.EVSEEnergyToBeDelivered_isUsed = 0;
+     }},
+    {"CableCheckReq", [](iso2_BodyType &b) {
+         ISO2_MSG(CableCheckReq);
+         iso2_ev_status(&m.DC_EVStatus);
+     }},
+    {"CableCheckRes", [](iso2_BodyType &b) {
+         ISO2_MSG(CableCheckRes);
+         m.ResponseCode = iso2_responseCodeType_OK;
+         iso2_evse_status(&m.DC_EVSEStatus);
+         m.EVSEProcessing = iso2_EVSEProcessingType_Finished;
+     }},
+    {"PreChargeReq", [](iso2_BodyType &b) {
+         ISO2_MSG(PreChargeReq);
+         iso2_ev_status(&m.DC_EVStatus);
+         iso2_value(&m.EVTargetVoltage, iso2_unitSymbolType_V, -1, 3980);
+         iso2_value(&m.EVTargetCurrent, iso2_unitSymbolType_A, -1, 20);
+     }},
+    {"PreChargeRes", [](iso2_BodyType &b) {
+         ISO2_MSG(PreChargeRes);
+         m.ResponseCode = iso2_responseCodeType_OK;
+         iso2_evse_status(&m.DC_EVSEStatus);
+         iso2_value(&m.EVSEPresentVoltage, iso2_unitSymbolType_V, -1, 3975);
+     }},
+    {"PowerDeliveryReq", [](iso2_BodyType &b) {
+         ISO2_MSG(PowerDeliveryReq);
+         m.ChargeProgress = iso2_chargeProgressType_Start;
+         m.SAScheduleTupleID = 1;
+         m.ChargingProfile_isUsed = 0;
+         m.EVPowerDeliveryParameter_isUsed = 0;
+         m.DC_EVPowerDeliveryParameter_isUsed = 1;
+         init_iso2_DC_EVPowerDeliveryParameterType(&m.DC_EVPowerDeliveryParameter);
+         iso2_ev_status(&m.DC_EVPowerDeliveryParameter.DC_EVStatus);
+         m.DC_EVPowerDeliveryParameter.BulkChargingComplete_isUsed = 0;
+         m.DC_EVPowerDeliveryParameter.ChargingComplete = 0;
+     }},
+    {"PowerDeliveryRes", [](iso2_BodyType &b) {
+         ISO2_MSG(PowerDeliveryRes);
+         m.ResponseCode = iso2_responseCodeType_OK;
+         m.AC_EVSEStatus_isUsed = 0;
+         m.EVSEStatus_isUsed = 0;
+         m.DC_EVSEStatus_isUsed = 1;
+         iso2_evse_status(&m.DC_EVSEStatus);
+     }},
+    {"CurrentDemandReq", [](iso2_BodyType &b) {
+         ISO2_MSG(CurrentDemandReq);
+         iso2_ev_status(&m.DC_EVStatus);
+         iso2_value(&m.EVTargetCurrent, iso2_unitSymbolType_A, -1, 1000);
+         iso2_value(&m.EVMaximumVoltageLimit, iso2_unitSymbolType_V, 0, 420);
+         m.EVMaximumVoltageLimit_isUsed = 1;
+         m.EVMaximumCurrentLimit_isUsed = 0;
+         m.EVMaximumPowerLimit_isUsed = 0;
+         m.BulkChargingComplete_isUsed = 0;
+         m.ChargingComplete = 0;
+         iso2_value(&m.RemainingTimeToFullSoC, iso2_unitSymbolType_s, 0, 1800);
+         m.RemainingTimeToFullSoC_isUsed = 1;
+         m.RemainingTimeToBulkSoC_isUsed = 0;
+         iso2_value(&m.EVTargetVoltage, iso2_unitSymbolType_V, -1, 4000);
+     }},
+    {"CurrentDemandRes", [](iso2_BodyType &b) {
+         ISO2_MSG(CurrentDemandRes);
+         m.ResponseCode = iso2_responseCodeType_OK;
+         iso2_evse_status(&m.DC_EVSEStatus);
+         iso2_value(&m.EVSEPresentVoltage, iso2_unitSymbolType_V, -1, 3990);
+         iso2_value(&m.EVSEPresentCurrent, iso2_unitSymbolType_A, -1, 998);
+         m.EVSECurrentLimitAchieved = 0;
+         m.EVSEVoltageLimitAchieved = 0;
+         m.EVSEPowerLimitAchieved = 0;
+         iso2_value(&m.EVSEMaximumVoltageLimit, iso2_unitSymbolType_V, -1, 5000);
+         m.EVSEMaximumVoltageLimit_isUsed = 1;
+         iso2_value(&m.EVSEMaximumCurrentLimit, iso2_unitSymbolType_A, -1, 1250);
+         m.EVSEMaximumCurrentLimit_isUsed = 1;
+         iso2_value(&m.EVSEMaximumPowerLimit, iso2_unitSymbolType_W, 1, 3000);
+         m.EVSEMaximumPowerLimit_isUsed = 1;
+         iso2_chars(m.EVSEID.characters, m.EVSEID.charactersLen, "DE*ESP*E0001");
+         m.SAScheduleTupleID = 1;
+         m.MeterInfo_isUsed = 0;
+         m.ReceiptRequired_isUsed = 0;
+     }},
+    {"MeteringReceiptReq", [](iso2_BodyType &b) {
+         ISO2_MSG(MeteringReceiptReq);
+         m.Id_isUsed = 0;
+         std::memcpy(m.SessionID.bytes, kSessionId, sizeof(kSessionId));
+         m.SessionID.bytesLen = sizeof(kSessionId);
+         m.SAScheduleTupleID_isUsed = 0;
+         iso2_chars(m.MeterInfo.MeterID.characters, m.MeterInfo.MeterID.charactersLen, "METER01");
+         m.MeterInfo.MeterReading = 123456;
+         m.MeterInfo.MeterReading_isUsed = 1;
+         m.MeterInfo.SigMeterReading_isUsed = 0;
+         m.MeterInfo.MeterStatus_isUsed = 0;
+         m.MeterInfo.TMeter_isUsed = 0;
+     }},
+    {"MeteringReceiptRes", [](iso2_BodyType &b) {
+         ISO2_MSG(MeteringReceiptRes);
+         m.ResponseCode = iso2_responseCodeType_OK;
+         m.AC_EVSEStatus_isUsed = 0;
+         m.EVSEStatus_isUsed = 0;
+         m.DC_EVSEStatus_isUsed = 1;
+         iso2_evse_status(&m.DC_EVSEStatus);
+     }},
+    {"SessionStopReq", [](iso2_BodyType &b) {
+         ISO2_MSG(SessionStopReq);
+         m.ChargingSession = iso2_chargingSessionType_Terminate;
+     }},
+    {"SessionStopRes", [](iso2_BodyType &b) {
+         ISO2_MSG(SessionStopRes);
+         m.ResponseCode = iso2_responseCodeType_OK;
+     }},
+};
+
+void build_iso2_frames(std::vector<MessageFrames> &out) {
+    std::unique_ptr<iso2_exiDocument> doc(new iso2_exiDocument);
+    uint8_t buf[kEncodeBuffer];
+    for (const auto &msg : kIso2Messages) {
+        iso2_header(doc.get());
+        msg.build(doc->V2G_Message.Body);
+        exi_bitstream_t s;
+        exi_bitstream_init(&s, buf, sizeof(buf), 0, nullptr);
+        if (encode_iso2_exiDocument(&s, doc.get()) != 0) {
+            std::fprintf(stderr, "exi_codec_bench: ISO-2 %s does not encode\n", msg.name);
+            continue;
+        }
+        add_frame(out, std::string("iso2/") + msg.name, buf, exi_bitstream_get_length(&s));
+    }
+}
+
+// ---- benchmarks ----
+
+template <typename Doc, int (*Decode)(exi_bitstream_t *, Doc *)>
+void bench_decode(benchmark::State &state, const Frames *frames) {
+    std::unique_ptr<Doc> doc(new Doc);
+    size_t i = 0;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        const std::vector<uint8_t> &f = (*frames)[i++ % frames->size()];
+        exi_bitstream_t s;
+        exi_bitstream_init(&s, const_cast<uint8_t *>(f.data()), f.size(), 0, nullptr);
+        if (Decode(&s, doc.get()) != 0) {
+            state.SkipWithError("decode failed");
+            break;
+        }
+        benchmark::DoNotOptimize(doc.get());
+        bytes += static_cast<int64_t>(f.size());
+    }
+    state.SetBytesProcessed(bytes);
+}
+
+template <typename Doc, int (*Decode)(exi_bitstream_t *, Doc *), int (*Encode)(exi_bitstream_t *, Doc *)>
+void bench_encode(benchmark::State &state, const Frames *frames) {
+    std::vector<std::unique_ptr<Doc>> docs;
+    for (const std::vector<uint8_t> &f : *frames) {
+        std::unique_ptr<Doc> doc(new Doc);
+        exi_bitstream_t s;
+        exi_bitstream_init(&s, const_cast<uint8_t *>(f.data()), f.size(), 0, nullptr);
+        if (Decode(&s, doc.get()) == 0) docs.push_back(std::move(doc));
+    }
+    if (docs.empty()) {
+        state.SkipWithError("no decodable frame");
+        return;
+    }
+    uint8_t buf[kEncodeBuffer];
+    size_t i = 0;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        exi_bitstream_t s;
+        exi_bitstream_init(&s, buf, sizeof(buf), 0, nullptr);
+        if (Encode(&s, docs[i++ % docs.size()].get()) != 0) {
+            state.SkipWithError("encode failed");
+            break;
+        }
+        benchmark::DoNotOptimize(buf);
+        bytes += static_cast<int64_t>(exi_bitstream_get_length(&s));
+    }
+    state.SetBytesProcessed(bytes);
+}
+
+template <typename Doc, int (*Decode)(exi_bitstream_t *, Doc *), int (*Encode)(exi_bitstream_t *, Doc *)>
+void register_pair(const MessageFrames &m) {
+    const Frames *frames = &m.frames;
+    size_t total = 0;
+    for (const std::vector<uint8_t> &f : m.frames) total += f.size();
+    const double avg = static_cast<double>(total) / m.frames.size();
+    benchmark::RegisterBenchmark(("BM_ExiDecode/" + m.name).c_str(), [frames, avg](benchmark::State &st) {
+        bench_decode<Doc, Decode>(st, frames);
+        st.counters["bytes"] = avg;
+    });
+    benchmark::RegisterBenchmark(("BM_ExiEncode/" + m.name).c_str(), [frames, avg](benchmark::State &st) {
+        bench_encode<Doc, Decode, Encode>(st, frames);
+        st.counters["bytes"] = avg;
+    });
+}
+
+std::vector<MessageFrames> &all_frames() {
+    static std::vector<MessageFrames> frames;
+    return frames;
+}
+
+const bool g_registered = [] {
+    std::vector<MessageFrames> &frames = all_frames();
+    Frames requests, responses;
+    if (demo_log_load(DEMO_CHARGING_LOG_PATH, &requests, &responses)) {
+        for (size_t i = 0; i < requests.size(); ++i) classify_log_frame(frames, requests[i], i == 0);
+        for (size_t i = 0; i < responses.size(); ++i) classify_log_frame(frames, responses[i], i == 0);
+    } else {
+        std::fprintf(stderr, "exi_codec_bench: %s not found, DIN vectors skipped\n", DEMO_CHARGING_LOG_PATH);
+    }
+    build_iso2_frames(frames);
+    for (const MessageFrames &m : frames) {
+        if (m.name.compare(0, 8, "apphand/") == 0) {
+            register_pair<appHand_exiDocument, decode_appHand_exiDocument, encode_appHand_exiDocument>(m);
+        } else if (m.name.compare(0, 4, "din/") == 0) {
+            register_pair<din_exiDocument, decode_din_exiDocument, encode_din_exiDocument>(m);
+        } else {
+            register_pair<iso2_exiDocument, decode_iso2_exiDocument, encode_iso2_exiDocument>(m);
+        }
+    }
+    return true;
+}();
+
+} // namespace
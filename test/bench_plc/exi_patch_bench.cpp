@@ -0,0 +1,396 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "demo_log.h"
+#include "exi_patch.h"
+
+extern "C" {
+#include "cbv2g/common/exi_bitstream.h"
+#include "cbv2g/din/din_msgDefDatatypes.h"
+#include "cbv2g/din/din_msgDefDecoder.h"
+#include "cbv2g/din/din_msgDefEncoder.h"
+#include "cbv2g/iso_2/iso2_msgDefDatatypes.h"
+#include "cbv2g/iso_2/iso2_msgDefDecoder.h"
+#include "cbv2g/iso_2/iso2_msgDefEncoder.h"
+}
+
+namespace {
+
+// CurrentDemandRes as tcp.cpp builds it, one response per 100 ms loop with a
+// slowly moving present current. Values are the same for both variants.
+enum { kStatus, kVoltage, kCurrent, kCurrentLimit, kVoltageLimit, kPowerLimit, kFields };
+
+const ExiFieldSpec kSpec[kFields] = {
+    {EXI_FIELD_NBIT, 4}, {EXI_FIELD_INT, 0}, {EXI_FIELD_INT, 0},
+    {EXI_FIELD_BOOL, 0}, {EXI_FIELD_BOOL, 0}, {EXI_FIELD_BOOL, 0},
+};
+
+const uint8_t kSessionId[8] = {0x10, 0x32, 0x54, 0x76, 0x98, 0xBA, 0xDC, 0xFE};
+
+din_exiDocument g_din;
+iso2_exiDocument g_iso2;
+
+int din_encode(const int32_t *v, uint8_t *out, uint16_t cap) {
+    init_din_exiDocument(&g_din);
+    init_din_V2G_Message(&g_din.V2G_Message);
+    init_din_MessageHeaderType(&g_din.V2G_Message.Header);
+    init_din_BodyType(&g_din.V2G_Message.Body);
+    std::memcpy(g_din.V2G_Message.Header.SessionID.bytes, kSessionId, sizeof(kSessionId));
+    g_din.V2G_Message.Header.SessionID.bytesLen = sizeof(kSessionId);
+    g_din.V2G_Message.Body.CurrentDemandRes_isUsed = 1;
+    auto &res = g_din.V2G_Message.Body.CurrentDemandRes;
+    init_din_CurrentDemandResType(&res);
+    res.ResponseCode = din_responseCodeType_OK;
+    init_din_DC_EVSEStatusType(&res.DC_EVSEStatus);
+    res.DC_EVSEStatus.EVSEStatusCode = static_cast<din_DC_EVSEStatusCodeType>(v[kStatus]);
+    res.DC_EVSEStatus.EVSENotification = din_EVSENotificationType_None;
+    init_din_PhysicalValueType(&res.EVSEPresentVoltage);
+    res.EVSEPresentVoltage.Unit = din_unitSymbolType_V;
+    res.EVSEPresentVoltage.Unit_isUsed = 1;
+    res.EVSEPresentVoltage.Value = static_cast<int16_t>(v[kVoltage]);
+    init_din_PhysicalValueType(&res.EVSEPresentCurrent);
+    res.EVSEPresentCurrent.Unit = din_unitSymbolType_A;
+    res.EVSEPresentCurrent.Unit_isUsed = 1;
+    res.EVSEPresentCurrent.Value = static_cast<int16_t>(v[kCurrent]);
+    res.EVSECurrentLimitAchieved = 1;
+    exi_bitstream_t s;
+    exi_bitstream_init(&s, out, cap, 0, nullptr);
+    if (encode_din_exiDocument(&s, &g_din) != 0) return -1;
+    return static_cast<int>(exi_bitstream_get_length(&s));
+}
+
+void iso2_value(iso2_PhysicalValueType *p, iso2_unitSymbolType unit, int32_t raw) {
+    init_iso2_PhysicalValueType(p);
+    p->Unit = unit;
+    p->Multiplier = -1;
+    p->Value = static_cast<int16_t>(raw);
+}
+
+int iso2_encode(const int32_t *v, uint8_t *out, uint16_t cap) {
+    init_iso2_exiDocument(&g_iso2);
+    init_iso2_V2G_Message(&g_iso2.V2G_Message);
+    init_iso2_MessageHeaderType(&g_iso2.V2G_Message.Header);
+    init_iso2_BodyType(&g_iso2.V2G_Message.Body);
+    std::memcpy(g_iso2.V2G_Message.Header.SessionID.bytes, kSessionId, sizeof(kSessionId));
+    g_iso2.V2G_Message.Header.SessionID.bytesLen = sizeof(kSessionId);
+    g_iso2.V2G_Message.Body.CurrentDemandRes_isUsed = 1;
+    auto &res = g_iso2.V2G_Message.Body.CurrentDemandRes;
+    init_iso2_CurrentDemandResType(&res);
+    res.ResponseCode = iso2_responseCodeType_OK;
+    init_iso2_DC_EVSEStatusType(&res.DC_EVSEStatus);
+    res.DC_EVSEStatus.EVSEStatusCode = static_cast<iso2_DC_EVSEStatusCodeType>(v[kStatus]);
+    res.DC_EVSEStatus.EVSENotification = iso2_EVSENotificationType_None;
+    res.DC_EVSEStatus.EVSEIsolationStatus = iso2_isolationLevelType_Valid;
+    res.DC_EVSEStatus.EVSEIsolationStatus_isUsed = 1;
+    iso2_value(&res.EVSEPresentVoltage, iso2_unitSymbolType_V, v[kVoltage]);
+    iso2_value(&res.EVSEPresentCurrent, iso2_unitSymbolType_A, v[kCurrent]);
+    res.EVSECurrentLimitAchieved = v[kCurrentLimit];
+    res.EVSEVoltageLimitAchieved = v[kVoltageLimit];
+    res.EVSEPowerLimitAchieved = v[kPowerLimit];
+    iso2_value(&res.EVSEMaximumVoltageLimit, iso2_unitSymbolType_V, 5000);
+    res.EVSEMaximumVoltageLimit_isUsed = 1;
+    iso2_value(&res.EVSEMaximumCurrentLimit, iso2_unitSymbolType_A, 1250);
+    res.EVSEMaximumCurrentLimit_isUsed = 1;
+    iso2_value(&res.EVSEMaximumPowerLimit, iso2_unitSymbolType_W, 300000 / 10);
+    res.EVSEMaximumPowerLimit_isUsed = 1;
+    std::memcpy(res.EVSEID.characters, "DE*ESP*E1", 9);
+    res.EVSEID.charactersLen = 9;
+    res.SAScheduleTupleID = 1;
+    exi_bitstream_t s;
+    exi_bitstream_init(&s, out, cap, 0, nullptr);
+    if (encode_iso2_exiDocument(&s, &g_iso2) != 0) return -1;
+    return static_cast<int>(exi_bitstream_get_length(&s));
+}
+
+void next_values(int32_t *v, uint32_t i, int32_t scale) {
+    v[kStatus] = 1;                                 // EVSE_Ready
+    v[kVoltage] = 400 * scale + static_cast<int32_t>(i % 3);
+    v[kCurrent] = 40 * scale + static_cast<int32_t>(i % 8);
+    v[kCurrentLimit] = 0;
+    v[kVoltageLimit] = 0;
+    v[kPowerLimit] = (i & 64) ? 1 : 0;
+}
+
+void encode_every_time(benchmark::State &state, ExiEncodeFn encode, int32_t scale) {
+    uint8_t out[EXI_PATCH_CACHE_BYTES];
+    int32_t v[kFields];
+    uint32_t i = 0;
+    for (auto _ : state) {
+        next_values(v, i++, scale);
+        benchmark::DoNotOptimize(encode(v, out, sizeof(out)));
+        benchmark::DoNotOptimize(out);
+    }
+}
+
+void patched(benchmark::State &state, ExiEncodeFn encode, uint8_t n, int32_t scale) {
+    ExiPatchCache cache;
+    exi_patch_reset(&cache);
+    int32_t v[kFields];
+    uint32_t i = 0;
+    for (auto _ : state) {
+        next_values(v, i++, scale);
+        benchmark::DoNotOptimize(exi_patch_encode(&cache, kSessionId, sizeof(kSessionId), kSpec, v, n, encode));
+        benchmark::DoNotOptimize(cache.bytes);
+    }
+    state.counters["patched"] = cache.patched;
+    state.counters["encoded"] = cache.encoded;
+}
+
+void BM_DinCurrentDemandEncode(benchmark::State &state) { encode_every_time(state, din_encode, 1); }
+void BM_DinCurrentDemandPatched(benchmark::State &state) { patched(state, din_encode, 3, 1); }
+void BM_Iso2CurrentDemandEncode(benchmark::State &state) { encode_every_time(state, iso2_encode, 10); }
+void BM_Iso2CurrentDemandPatched(benchmark::State &state) { patched(state, iso2_encode, kFields, 10); }
+
+// CurrentDemandReq the way the EV in the demo charging log sends it: fixed
+// limits and remaining times, moving targets and SoC.
+enum { kReady, kError, kSoc, kVoltageMult, kTargetVoltage, kCurrentMult, kTargetCurrent, kComplete, kReqFields };
+
+const ExiFieldSpec kReqSpec[kReqFields] = {
+    {EXI_FIELD_BOOL, 0}, {EXI_FIELD_NBIT, 4}, {EXI_FIELD_NBIT, 7}, {EXI_FIELD_NBIT, 3},
+    {EXI_FIELD_INT, 0},  {EXI_FIELD_NBIT, 3}, {EXI_FIELD_INT, 0},  {EXI_FIELD_BOOL, 0},
+};
+
+int din_encode_req(const int32_t *v, uint8_t *out, uint16_t cap) {
+    init_din_exiDocument(&g_din);
+    init_din_V2G_Message(&g_din.V2G_Message);
+    init_din_MessageHeaderType(&g_din.V2G_Message.Header);
+    init_din_BodyType(&g_din.V2G_Message.Body);
+    std::memcpy(g_din.V2G_Message.Header.SessionID.bytes, kSessionId, sizeof(kSessionId));
+    g_din.V2G_Message.Header.SessionID.bytesLen = sizeof(kSessionId);
+    g_din.V2G_Message.Body.CurrentDemandReq_isUsed = 1;
+    auto &req = g_din.V2G_Message.Body.CurrentDemandReq;
+    init_din_CurrentDemandReqType(&req);
+    init_din_DC_EVStatusType(&req.DC_EVStatus);
+    req.DC_EVStatus.EVReady = v[kReady];
+    req.DC_EVStatus.EVErrorCode = static_cast<din_DC_EVErrorCodeType>(v[kError]);
+    req.DC_EVStatus.EVRESSSOC = static_cast<int8_t>(v[kSoc]);
+    init_din_PhysicalValueType(&req.EVTargetVoltage);
+    req.EVTargetVoltage.Multiplier = static_cast<int8_t>(v[kVoltageMult] - 3);
+    req.EVTargetVoltage.Unit = din_unitSymbolType_V;
+    req.EVTargetVoltage.Unit_isUsed = 1;
+    req.EVTargetVoltage.Value = static_cast<int16_t>(v[kTargetVoltage]);
+    init_din_PhysicalValueType(&req.EVTargetCurrent);
+    req.EVTargetCurrent.Multiplier = static_cast<int8_t>(v[kCurrentMult] - 3);
+    req.EVTargetCurrent.Unit = din_unitSymbolType_A;
+    req.EVTargetCurrent.Unit_isUsed = 1;
+    req.EVTargetCurrent.Value = static_cast<int16_t>(v[kTargetCurrent]);
+    req.ChargingComplete = v[kComplete];
+    init_din_PhysicalValueType(&req.EVMaximumVoltageLimit);
+    req.EVMaximumVoltageLimit.Unit = din_unitSymbolType_V;
+    req.EVMaximumVoltageLimit.Unit_isUsed = 1;
+    req.EVMaximumVoltageLimit.Value = 420;
+    req.EVMaximumVoltageLimit_isUsed = 1;
+    init_din_PhysicalValueType(&req.RemainingTimeToFullSoC);
+    req.RemainingTimeToFullSoC.Unit = din_unitSymbolType_s;
+    req.RemainingTimeToFullSoC.Unit_isUsed = 1;
+    req.RemainingTimeToFullSoC.Value = 1800;
+    req.RemainingTimeToFullSoC_isUsed = 1;
+    exi_bitstream_t s;
+    exi_bitstream_init(&s, out, cap, 0, nullptr);
+    if (encode_din_exiDocument(&s, &g_din) != 0) return -1;
+    return static_cast<int>(exi_bitstream_get_length(&s));
+}
+
+void iso2_req_value(iso2_PhysicalValueType *p, iso2_unitSymbolType unit, int32_t mult, int32_t raw) {
+    init_iso2_PhysicalValueType(p);
+    p->Unit = unit;
+    p->Multiplier = static_cast<int8_t>(mult);
+    p->Value = static_cast<int16_t>(raw);
+}
+
+int iso2_encode_req(const int32_t *v, uint8_t *out, uint16_t cap) {
+    init_iso2_exiDocument(&g_iso2);
+    init_iso2_V2G_Message(&g_iso2.V2G_Message);
+    init_iso2_MessageHeaderType(&g_iso2.V2G_Message.Header);
+    init_iso2_BodyType(&g_iso2.V2G_Message.Body);
+    std::memcpy(g_iso2.V2G_Message.Header.SessionID.bytes, kSessionId, sizeof(kSessionId));
+    g_iso2.V2G_Message.Header.SessionID.bytesLen = sizeof(kSessionId);
+    g_iso2.V2G_Message.Body.CurrentDemandReq_isUsed = 1;
+    auto &req = g_iso2.V2G_Message.Body.CurrentDemandReq;
+    init_iso2_CurrentDemandReqType(&req);
+    init_iso2_DC_EVStatusType(&req.DC_EVStatus);
+    req.DC_EVStatus.EVReady = v[kReady];
+    req.DC_EVStatus.EVErrorCode = static_cast<iso2_DC_EVErrorCodeType>(v[kError]);
+    req.DC_EVStatus.EVRESSSOC = static_cast<int8_t>(v[kSoc]);
+    iso2_req_value(&req.EVTargetVoltage, iso2_unitSymbolType_V, v[kVoltageMult] - 3, v[kTargetVoltage]);
+    iso2_req_value(&req.EVTargetCurrent, iso2_unitSymbolType_A, v[kCurrentMult] - 3, v[kTargetCurrent]);
+    req.ChargingComplete = v[kComplete];
+    iso2_req_value(&req.EVMaximumVoltageLimit, iso2_unitSymbolType_V, 0, 420);
+    req.EVMaximumVoltageLimit_isUsed = 1;
+    iso2_req_value(&req.RemainingTimeToFullSoC, iso2_unitSymbolType_s, 0, 1800);
+    req.RemainingTimeToFullSoC_isUsed = 1;
+    exi_bitstream_t s;
+    exi_bitstream_init(&s, out, cap, 0, nullptr);
+    if (encode_iso2_exiDocument(&s, &g_iso2) != 0) return -1;
+    return static_cast<int>(exi_bitstream_get_length(&s));
+}
+
+// 64 consecutive requests of a charging loop; targets stay within one 7 bit group.
+std::vector<std::vector<uint8_t>> request_frames(ExiEncodeFn encode, int32_t scale) {
+    std::vector<std::vector<uint8_t>> frames;
+    for (int32_t i = 0; i < 64; ++i) {
+        int32_t v[kReqFields] = {1, 0, 40 + i / 8, scale > 1 ? 2 : 3, 400 * scale, scale > 1 ? 2 : 3,
+                                 40 * scale + (i % 8), 0};
+        std::vector<uint8_t> f(EXI_PATCH_CACHE_BYTES);
+        f.resize(encode(v, f.data(), static_cast<uint16_t>(f.size())));
+        frames.push_back(f);
+    }
+    return frames;
+}
+
+void BM_DinCurrentDemandReqDecode(benchmark::State &state) {
+    std::vector<std::vector<uint8_t>> frames = request_frames(din_encode_req, 1);
+    size_t i = 0;
+    for (auto _ : state) {
+        std::vector<uint8_t> &f = frames[i++ % frames.size()];
+        exi_bitstream_t s;
+        exi_bitstream_init(&s, f.data(), f.size(), 0, nullptr);
+        benchmark::DoNotOptimize(decode_din_exiDocument(&s, &g_din));
+        benchmark::DoNotOptimize(g_din.V2G_Message.Body.CurrentDemandReq.EVTargetCurrent.Value);
+    }
+}
+
+void BM_Iso2CurrentDemandReqDecode(benchmark::State &state) {
+    std::vector<std::vector<uint8_t>> frames = request_frames(iso2_encode_req, 10);
+    size_t i = 0;
+    for (auto _ : state) {
+        std::vector<uint8_t> &f = frames[i++ % frames.size()];
+        exi_bitstream_t s;
+        exi_bitstream_init(&s, f.data(), f.size(), 0, nullptr);
+        benchmark::DoNotOptimize(decode_iso2_exiDocument(&s, &g_iso2));
+        benchmark::DoNotOptimize(g_iso2.V2G_Message.Body.CurrentDemandReq.EVTargetCurrent.Value);
+    }
+}
+
+void matched(benchmark::State &state, ExiEncodeFn encode, int32_t scale) {
+    std::vector<std::vector<uint8_t>> frames = request_frames(encode, scale);
+    int32_t v[kReqFields] = {1, 0, 40, scale > 1 ? 2 : 3, 400 * scale, scale > 1 ? 2 : 3, 40 * scale, 0};
+    ExiPatchCache cache;
+    exi_patch_reset(&cache);
+    if (!exi_patch_learn(&cache, kSessionId, sizeof(kSessionId), frames[0].data(),
+                         static_cast<uint16_t>(frames[0].size()), kReqSpec, v, kReqFields, encode)) {
+        state.SkipWithError("template did not verify");
+        return;
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        std::vector<uint8_t> &f = frames[i++ % frames.size()];
+        benchmark::DoNotOptimize(exi_patch_match(&cache, kSessionId, sizeof(kSessionId), f.data(),
+                                                 static_cast<uint16_t>(f.size()), kReqSpec, v));
+        benchmark::DoNotOptimize(v);
+    }
+    state.counters["matched"] = cache.patched;
+    state.counters["decoded"] = cache.encoded;
+}
+
+void BM_DinCurrentDemandReqMatch(benchmark::State &state) { matched(state, din_encode_req, 1); }
+void BM_Iso2CurrentDemandReqMatch(benchmark::State &state) { matched(state, iso2_encode_req, 10); }
+
+// The demo log's CurrentDemandReq frames, taken the way decodeV2GTP() takes
+// them: template match first, else a full decode that (re)learns the template
+// from the re-encoded request. "hit_rate" is the share read from the template
+// on real EV traffic. The log holds one DIN session, so one layout.
+constexpr size_t kV2gtpHeader = 8;
+
+din_exiDocument g_din_rx;
+bool g_din_rx_copied = false;
+
+void read_din_req(const din_CurrentDemandReqType &req, int32_t *v) {
+    v[kReady] = req.DC_EVStatus.EVReady;
+    v[kError] = req.DC_EVStatus.EVErrorCode;
+    v[kSoc] = req.DC_EVStatus.EVRESSSOC;
+    v[kVoltageMult] = req.EVTargetVoltage.Multiplier + 3;
+    v[kTargetVoltage] = req.EVTargetVoltage.Value;
+    v[kCurrentMult] = req.EVTargetCurrent.Multiplier + 3;
+    v[kTargetCurrent] = req.EVTargetCurrent.Value;
+    v[kComplete] = req.ChargingComplete;
+}
+
+// Like din_encode_current_demand_req() in tcp.cpp: the decoded request is
+// copied once, then only the fields change.
+int din_reencode_req(const int32_t *v, uint8_t *out, uint16_t cap) {
+    if (!g_din_rx_copied) {
+        g_din = g_din_rx;
+        g_din_rx_copied = true;
+    }
+    auto &req = g_din.V2G_Message.Body.CurrentDemandReq;
+    req.DC_EVStatus.EVReady = v[kReady];
+    req.DC_EVStatus.EVErrorCode = static_cast<din_DC_EVErrorCodeType>(v[kError]);
+    req.DC_EVStatus.EVRESSSOC = static_cast<int8_t>(v[kSoc]);
+    req.EVTargetVoltage.Multiplier = static_cast<int8_t>(v[kVoltageMult] - 3);
+    req.EVTargetVoltage.Value = static_cast<int16_t>(v[kTargetVoltage]);
+    req.EVTargetCurrent.Multiplier = static_cast<int8_t>(v[kCurrentMult] - 3);
+    req.EVTargetCurrent.Value = static_cast<int16_t>(v[kTargetCurrent]);
+    req.ChargingComplete = v[kComplete];
+    exi_bitstream_t s;
+    exi_bitstream_init(&s, out, cap, 0, nullptr);
+    if (encode_din_exiDocument(&s, &g_din) != 0) return -1;
+    return static_cast<int>(exi_bitstream_get_length(&s));
+}
+
+std::vector<std::vector<uint8_t>> log_current_demand_reqs() {
+    std::vector<std::vector<uint8_t>> frames;
+    DemoLogFrames requests, responses;
+    if (!demo_log_load(DEMO_CHARGING_LOG_PATH, &requests, &responses)) return frames;
+    for (const std::vector<uint8_t> &request : requests) {
+        if (request.size() <= kV2gtpHeader) continue;
+        std::vector<uint8_t> exi(request.begin() + kV2gtpHeader, request.end());
+        exi_bitstream_t s;
+        exi_bitstream_init(&s, exi.data(), exi.size(), 0, nullptr);
+        if (decode_din_exiDocument(&s, &g_din_rx) == 0 && g_din_rx.V2G_Message.Body.CurrentDemandReq_isUsed) {
+            frames.push_back(exi);
+        }
+    }
+    return frames;
+}
+
+void BM_DinCurrentDemandReqLog(benchmark::State &state) {
+    static std::vector<std::vector<uint8_t>> frames = log_current_demand_reqs();
+    if (frames.empty()) {
+        state.SkipWithError("no CurrentDemandReq in " DEMO_CHARGING_LOG_PATH);
+        return;
+    }
+    ExiPatchCache cache;
+    int32_t v[kReqFields];
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    for (auto _ : state) {
+        exi_patch_reset(&cache);    // one charging session per iteration
+        for (std::vector<uint8_t> &f : frames) {
+            const uint16_t len = static_cast<uint16_t>(f.size());
+            if (exi_patch_match(&cache, kSessionId, sizeof(kSessionId), f.data(), len, kReqSpec, v)) {
+                benchmark::DoNotOptimize(v);
+                continue;
+            }
+            exi_bitstream_t s;
+            exi_bitstream_init(&s, f.data(), f.size(), 0, nullptr);
+            if (decode_din_exiDocument(&s, &g_din_rx) != 0) continue;
+            read_din_req(g_din_rx.V2G_Message.Body.CurrentDemandReq, v);
+            g_din_rx_copied = false;
+            exi_patch_learn(&cache, kSessionId, sizeof(kSessionId), f.data(), len, kReqSpec, v, kReqFields,
+                            din_reencode_req);
+        }
+        hits += cache.patched;
+        misses += cache.encoded;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * frames.size()));
+    state.counters["frames"] = static_cast<double>(frames.size());
+    state.counters["hit_rate"] = hits + misses ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+    state.counters["learned"] = cache.learned;
+    state.counters["rejected"] = cache.rejected;
+}
+
+} // namespace
+
+BENCHMARK(BM_DinCurrentDemandEncode);
+BENCHMARK(BM_DinCurrentDemandPatched);
+BENCHMARK(BM_Iso2CurrentDemandEncode);
+BENCHMARK(BM_Iso2CurrentDemandPatched);
+BENCHMARK(BM_DinCurrentDemandReqDecode);
+BENCHMARK(BM_DinCurrentDemandReqMatch);
+BENCHMARK(BM_Iso2CurrentDemandReqDecode);
+BENCHMARK(BM_Iso2CurrentDemandReqMatch);
+BENCHMARK(BM_DinCurrentDemandReqLog);
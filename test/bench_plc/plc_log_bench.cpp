@@ -0,0 +1,82 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "plc_log.h"
+
+namespace {
+
+// Stand-in for the UART: Serial.printf on the target blocks until the bytes
+// fit in the TX FIFO, so the sink spins in proportion to the line length.
+void UartSink(const char *line, size_t len) {
+    static volatile uint32_t sink;
+    for (size_t i = 0; i < len * 64; ++i) sink = sink + (uint8_t)line[i % len];
+}
+
+// A SLAC/HLC handler body with the log calls the real ones make per message.
+uint32_t HandleMessage(uint8_t *frame, uint32_t seq) {
+    uint32_t sum = 0;
+    PLC_LOGI("received CM_SLAC_PARAM.REQ\n");
+    for (int i = 0; i < 60; ++i) {
+        frame[i] = (uint8_t)(frame[i] ^ seq);
+        sum += frame[i];
+    }
+    PLC_LOGI("Negotiated %u sounds, timeout field %u (~%lums)\n", 10u, 6u, 600ul);
+    PLC_LOGI("transmitting CM_SLAC_PARAM.CNF\n");
+    return sum;
+}
+
+void run_handler(benchmark::State &state, bool sync) {
+    plc_log_reset();
+    plc_log_set_sink(&UartSink);
+    plc_log_set_sync(sync);
+    uint8_t frame[60];
+    std::memset(frame, 0x5A, sizeof(frame));
+    uint32_t seq = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(HandleMessage(frame, seq++));
+        // the PlcLog task drains at its own pace; keep the ring from filling up
+        if (!sync && (seq & 31) == 0) {
+            state.PauseTiming();
+            plc_log_flush();
+            state.ResumeTiming();
+        }
+    }
+    plc_log_flush();
+    PlcLogStats st;
+    plc_log_stats(&st);
+    state.counters["dropped"] = st.dropped;
+    plc_log_reset();
+}
+
+void BM_HandlerPrintfLogging(benchmark::State &state) {
+    run_handler(state, true);
+}
+
+void BM_HandlerRingLogging(benchmark::State &state) {
+    run_handler(state, false);
+}
+
+// Cost of a call site whose level is compiled out.
+void BM_HandlerLoggingCompiledOut(benchmark::State &state) {
+    uint8_t frame[60];
+    std::memset(frame, 0x5A, sizeof(frame));
+    uint32_t seq = 0;
+    for (auto _ : state) {
+        uint32_t sum = 0;
+        for (int i = 0; i < 60; ++i) {
+            frame[i] = (uint8_t)(frame[i] ^ seq);
+            sum += frame[i];
+        }
+        seq++;
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+} // namespace
+
+BENCHMARK(BM_HandlerPrintfLogging);
+BENCHMARK(BM_HandlerRingLogging);
+BENCHMARK(BM_HandlerLoggingCompiledOut);
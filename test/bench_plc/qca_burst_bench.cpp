@@ -0,0 +1,136 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "qca_frame.h"
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+constexpr size_t kRxBufferSize = 3164;
+
+Bytes ethernet_frame(uint16_t ethertype, uint16_t mmtype, size_t len) {
+    Bytes frame(len, 0);
+    const uint8_t evse[6] = {0x70, 0xB3, 0xD5, 0x00, 0x00, 0x01};
+    const uint8_t pev[6] = {0xFE, 0xED, 0xBE, 0xEF, 0xAF, 0xFE};
+    std::memcpy(frame.data(), evse, 6);
+    std::memcpy(frame.data() + 6, pev, 6);
+    frame[12] = static_cast<uint8_t>(ethertype >> 8);
+    frame[13] = static_cast<uint8_t>(ethertype);
+    frame[14] = 0x01;
+    frame[15] = static_cast<uint8_t>(mmtype);
+    frame[16] = static_cast<uint8_t>(mmtype >> 8);
+    for (size_t i = 19; i < len; ++i) frame[i] = static_cast<uint8_t>(i);
+    return frame;
+}
+
+void append_spi_frame(Bytes &burst, const Bytes &frame) {
+    uint32_t total = static_cast<uint32_t>(frame.size() + 10);
+    for (int i = 0; i < 4; ++i) burst.push_back(static_cast<uint8_t>(total >> (8 * i)));
+    burst.insert(burst.end(), {0xAA, 0xAA, 0xAA, 0xAA});
+    burst.push_back(static_cast<uint8_t>(frame.size()));
+    burst.push_back(static_cast<uint8_t>(frame.size() >> 8));
+    burst.insert(burst.end(), {0x00, 0x00});
+    burst.insert(burst.end(), frame.begin(), frame.end());
+    burst.insert(burst.end(), {0x55, 0x55});
+}
+
+// Bursts shaped like the traffic recorded on the bench: the sounding phase
+// (MNBC_SOUND + ATTEN_PROFILE pairs), a V2G exchange (TCP ACK + data segment)
+// and a modem buffer filled with minimum-size frames.
+Bytes sounding_burst() {
+    Bytes burst;
+    for (int i = 0; i < 5; ++i) {
+        append_spi_frame(burst, ethernet_frame(0x88E1, 0x6076, 71));
+        append_spi_frame(burst, ethernet_frame(0x88E1, 0x6086, 90));
+    }
+    return burst;
+}
+
+Bytes v2g_burst() {
+    Bytes burst;
+    append_spi_frame(burst, ethernet_frame(0x86DD, 0, 74));
+    append_spi_frame(burst, ethernet_frame(0x86DD, 0, 170));
+    append_spi_frame(burst, ethernet_frame(0x86DD, 0, 74));
+    return burst;
+}
+
+Bytes full_burst() {
+    Bytes burst;
+    while (burst.size() + 60 + QCA_FRAME_OVERHEAD <= 3163) {
+        append_spi_frame(burst, ethernet_frame(0x88E1, 0x6076, 60));
+    }
+    return burst;
+}
+
+const Bytes &burst_for(int64_t id) {
+    static const Bytes bursts[] = {sounding_burst(), v2g_burst(), full_burst()};
+    return bursts[id];
+}
+
+const char *burst_label(int64_t id) {
+    static const char *labels[] = {"sounding", "v2g", "full_buffer"};
+    return labels[id];
+}
+
+inline void consume(const uint8_t *frame, uint16_t len, uint32_t &sink) {
+    sink += frame[12] + frame[15] + len;
+}
+
+// Pre-change Timer20ms loop: strip the header with a memcpy, dispatch, then
+// move the rest of the burst to the front of rxbuffer for the next frame.
+uint32_t legacy_demux(uint8_t *rxbuffer, uint16_t reg16) {
+    uint32_t sink = 0;
+    while (reg16) {
+        uint16_t rxbytes = rxbuffer[8] + (rxbuffer[9] << 8);
+        if (rxbuffer[4] == 0xaa && rxbuffer[5] == 0xaa && rxbuffer[6] == 0xaa && rxbuffer[7] == 0xaa && rxbytes >= 60) {
+            memmove(rxbuffer, rxbuffer + 12, reg16 - 14);
+            consume(rxbuffer, rxbytes, sink);
+            if ((int16_t)reg16 - rxbytes - 14 >= 74) {
+                reg16 = reg16 - rxbytes - 14;
+                memmove(rxbuffer, rxbuffer + 2 + rxbytes, reg16);
+            } else reg16 = 0;
+        } else reg16 = 0;
+    }
+    return sink;
+}
+
+uint32_t cursor_demux(const uint8_t *rxbuffer, uint16_t reg16) {
+    uint32_t sink = 0;
+    QcaBurstCursor cursor;
+    QcaFrameView frame;
+    qca_burst_begin(&cursor, rxbuffer, reg16);
+    while (qca_burst_next(&cursor, &frame)) consume(frame.data, frame.len, sink);
+    return sink;
+}
+
+// Both variants start from the burst as the SPI read left it in rxbuffer.
+void BM_QcaBurstLegacy(benchmark::State &state) {
+    const Bytes &burst = burst_for(state.range(0));
+    static uint8_t rxbuffer[kRxBufferSize];
+    for (auto _ : state) {
+        std::memcpy(rxbuffer, burst.data(), burst.size());
+        benchmark::DoNotOptimize(legacy_demux(rxbuffer, static_cast<uint16_t>(burst.size())));
+    }
+    state.SetLabel(burst_label(state.range(0)));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * burst.size());
+}
+
+void BM_QcaBurstCursor(benchmark::State &state) {
+    const Bytes &burst = burst_for(state.range(0));
+    static uint8_t rxbuffer[kRxBufferSize];
+    for (auto _ : state) {
+        std::memcpy(rxbuffer, burst.data(), burst.size());
+        benchmark::DoNotOptimize(cursor_demux(rxbuffer, static_cast<uint16_t>(burst.size())));
+    }
+    state.SetLabel(burst_label(state.range(0)));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * burst.size());
+}
+
+} // namespace
+
+BENCHMARK(BM_QcaBurstLegacy)->DenseRange(0, 2);
+BENCHMARK(BM_QcaBurstCursor)->DenseRange(0, 2);
@@ -0,0 +1,232 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/ecp.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_ticket.h"
+#include "mbedtls/x509_crt.h"
+
+#include "tls_session_cache.h"
+
+// TLS 1.2 handshakes between two in-memory mbedTLS endpoints, configured like
+// hlc_server.cpp: the RSA-2048 development key the SECC used to ship against
+// the secp256r1 one with the ECDHE-ECDSA suites, full and resumed. x86 time
+// is no S3 time, but the ratio between the key types carries over.
+
+namespace {
+
+enum class Key { Rsa2048, P256 };
+enum class Resume { None, SessionId, Ticket };
+
+const int kEcdsaSuites[] = {
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256,
+    MBEDTLS_TLS_ECDH_ECDSA_WITH_AES_128_CBC_SHA256,
+    0,
+};
+const mbedtls_ecp_group_id kCurves[] = {MBEDTLS_ECP_DP_SECP256R1, MBEDTLS_ECP_DP_NONE};
+
+mbedtls_entropy_context g_entropy;
+mbedtls_ctr_drbg_context g_drbg;
+TlsSessionCache g_cache;
+uint32_t g_resumed = 0;
+
+// One direction of the link.
+using Pipe = std::deque<unsigned char>;
+
+struct Endpoint {
+    Pipe *out;
+    Pipe *in;
+};
+
+int pipe_send(void *ctx, const unsigned char *buf, size_t len) {
+    Endpoint *e = static_cast<Endpoint *>(ctx);
+    e->out->insert(e->out->end(), buf, buf + len);
+    return static_cast<int>(len);
+}
+
+int pipe_recv(void *ctx, unsigned char *buf, size_t len) {
+    Endpoint *e = static_cast<Endpoint *>(ctx);
+    if (e->in->empty()) return MBEDTLS_ERR_SSL_WANT_READ;
+    size_t n = len < e->in->size() ? len : e->in->size();
+    std::copy(e->in->begin(), e->in->begin() + n, buf);
+    e->in->erase(e->in->begin(), e->in->begin() + n);
+    return static_cast<int>(n);
+}
+
+int cache_get(void *data, mbedtls_ssl_session *session) {
+    uint16_t len = 0;
+    const uint8_t *blob = tls_session_cache_find(static_cast<TlsSessionCache *>(data), session->id,
+                                                 static_cast<uint8_t>(session->id_len), 0, &len);
+    if (!blob || mbedtls_ssl_session_load(session, blob, len) != 0) return 1;
+    g_resumed++;
+    return 0;
+}
+
+int cache_set(void *data, const mbedtls_ssl_session *session) {
+    TlsSessionCache *cache = static_cast<TlsSessionCache *>(data);
+    uint8_t *blob = tls_session_cache_reserve(cache, session->id, static_cast<uint8_t>(session->id_len), 0);
+    if (!blob) return 1;
+    size_t len = 0;
+    int ret = mbedtls_ssl_session_save(session, blob, TLS_SESSION_BLOB_MAX, &len);
+    tls_session_cache_commit(cache, blob, ret == 0 ? static_cast<uint16_t>(len) : 0);
+    return ret == 0 ? 0 : 1;
+}
+
+int ticket_parse(void *p_ticket, mbedtls_ssl_session *session, unsigned char *buf, size_t len) {
+    int ret = mbedtls_ssl_ticket_parse(p_ticket, session, buf, len);
+    if (ret == 0) g_resumed++;
+    return ret;
+}
+
+void check(int ret, const char *what) {
+    if (ret == 0) return;
+    std::fprintf(stderr, "%s failed (-0x%04x)\n", what, -ret);
+    std::abort();
+}
+
+struct Server {
+    mbedtls_x509_crt cert;
+    mbedtls_pk_context key;
+    mbedtls_ssl_ticket_context ticket;
+    mbedtls_ssl_config conf;
+
+    explicit Server(Key type) {
+        mbedtls_x509_crt_init(&cert);
+        mbedtls_pk_init(&key);
+        mbedtls_ssl_ticket_init(&ticket);
+        mbedtls_ssl_config_init(&conf);
+        std::string dir = CERTS_DIR;
+        bool ec = type == Key::P256;
+        check(mbedtls_x509_crt_parse_file(&cert, (dir + (ec ? "/dev_tls_ec_cert.pem" : "/dev_tls_cert.pem")).c_str()),
+              "certificate");
+        check(mbedtls_pk_parse_keyfile(&key, (dir + (ec ? "/dev_tls_ec_key.pem" : "/dev_tls_key.pem")).c_str(),
+                                       nullptr),
+              "key");
+        check(mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT),
+              "server config");
+        check(mbedtls_ssl_conf_own_cert(&conf, &cert, &key), "own cert");
+        mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &g_drbg);
+        mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_NONE);
+        mbedtls_ssl_conf_min_version(&conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+        if (ec) {
+            mbedtls_ssl_conf_ciphersuites(&conf, kEcdsaSuites);
+            mbedtls_ssl_conf_curves(&conf, kCurves);
+        }
+        mbedtls_ssl_conf_session_cache(&conf, &g_cache, cache_get, cache_set);
+        check(mbedtls_ssl_ticket_setup(&ticket, mbedtls_ctr_drbg_random, &g_drbg, MBEDTLS_CIPHER_AES_256_GCM, 3600),
+              "ticket key");
+        mbedtls_ssl_conf_session_tickets_cb(&conf, mbedtls_ssl_ticket_write, ticket_parse, &ticket);
+    }
+
+    ~Server() {
+        mbedtls_ssl_config_free(&conf);
+        mbedtls_ssl_ticket_free(&ticket);
+        mbedtls_pk_free(&key);
+        mbedtls_x509_crt_free(&cert);
+    }
+};
+
+struct Client {
+    mbedtls_ssl_config conf;
+
+    explicit Client(bool tickets) {
+        mbedtls_ssl_config_init(&conf);
+        check(mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT),
+              "client config");
+        mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &g_drbg);
+        mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_NONE);
+        mbedtls_ssl_conf_session_tickets(&conf, tickets ? MBEDTLS_SSL_SESSION_TICKETS_ENABLED
+                                                        : MBEDTLS_SSL_SESSION_TICKETS_DISABLED);
+    }
+
+    ~Client() { mbedtls_ssl_config_free(&conf); }
+};
+
+// Runs one handshake; a non-null session is offered for resumption and
+// replaced by the one negotiated.
+void handshake(const Server &server, const Client &client, mbedtls_ssl_session *session) {
+    Pipe to_server;
+    Pipe to_client;
+    Endpoint srv_end{&to_client, &to_server};
+    Endpoint cli_end{&to_server, &to_client};
+    mbedtls_ssl_context srv;
+    mbedtls_ssl_context cli;
+    mbedtls_ssl_init(&srv);
+    mbedtls_ssl_init(&cli);
+    check(mbedtls_ssl_setup(&srv, &server.conf), "server setup");
+    check(mbedtls_ssl_setup(&cli, &client.conf), "client setup");
+    mbedtls_ssl_set_bio(&srv, &srv_end, pipe_send, pipe_recv, nullptr);
+    mbedtls_ssl_set_bio(&cli, &cli_end, pipe_send, pipe_recv, nullptr);
+    if (session && session->id_len + session->ticket_len) check(mbedtls_ssl_set_session(&cli, session), "set session");
+
+    bool srv_done = false;
+    bool cli_done = false;
+    while (!srv_done || !cli_done) {
+        if (!cli_done) {
+            int ret = mbedtls_ssl_handshake(&cli);
+            cli_done = ret == 0;
+            if (ret != 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) check(ret, "client");
+        }
+        if (!srv_done) {
+            int ret = mbedtls_ssl_handshake(&srv);
+            srv_done = ret == 0;
+            if (ret != 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) check(ret, "server");
+        }
+    }
+    if (session) {
+        mbedtls_ssl_session_free(session);
+        mbedtls_ssl_session_init(session);
+        check(mbedtls_ssl_get_session(&cli, session), "get session");
+    }
+    mbedtls_ssl_free(&cli);
+    mbedtls_ssl_free(&srv);
+}
+
+void setup_rng() {
+    static bool done = false;
+    if (done) return;
+    done = true;
+    mbedtls_entropy_init(&g_entropy);
+    mbedtls_ctr_drbg_init(&g_drbg);
+    const char *pers = "tls_handshake_bench";
+    check(mbedtls_ctr_drbg_seed(&g_drbg, mbedtls_entropy_func, &g_entropy,
+                                reinterpret_cast<const unsigned char *>(pers), std::strlen(pers)),
+          "drbg");
+}
+
+void BM_TlsHandshake(benchmark::State &state, Key key, Resume resume) {
+    setup_rng();
+    tls_session_cache_reset(&g_cache, 3600);
+    Server server(key);
+    Client client(resume == Resume::Ticket);
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    if (resume != Resume::None) handshake(server, client, &session);     // the session to resume
+    g_resumed = 0;
+    for (auto _ : state) {
+        handshake(server, client, resume == Resume::None ? nullptr : &session);
+    }
+    mbedtls_ssl_session_free(&session);
+    state.counters["resumed"] = benchmark::Counter(g_resumed, benchmark::Counter::kAvgIterations);
+    state.counters["handshakes_per_s"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+
+} // namespace
+
+BENCHMARK_CAPTURE(BM_TlsHandshake, rsa2048_full, Key::Rsa2048, Resume::None)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_TlsHandshake, p256_full, Key::P256, Resume::None)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_TlsHandshake, p256_session_id, Key::P256, Resume::SessionId)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_TlsHandshake, p256_ticket, Key::P256, Resume::Ticket)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,97 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "v2gtp_framer.h"
+
+namespace {
+
+// Stream 0 is a charge loop as it reaches tcp_bufferPayload(): CurrentDemandReq
+// sized frames, sometimes two in one segment, sometimes a frame split in two.
+// Stream 1 is certificate-sized ISO-2 requests (600..990 bytes) arriving in
+// 536 byte segments.
+struct Stream {
+    std::vector<uint8_t> bytes;
+    std::vector<uint16_t> segments;
+    size_t frames = 0;
+};
+
+Stream make_stream(int kind) {
+    Stream s;
+    uint32_t x = 70121;
+    for (int i = 0; i < 256; ++i) {
+        x = x * 1103515245u + 12345u;
+        uint32_t len = kind ? 600 + ((x >> 16) % 382) : 30 + ((x >> 16) % 40);
+        const uint8_t hdr[8] = {0x01, 0xFE, 0x80, 0x01, 0, 0, static_cast<uint8_t>(len >> 8), static_cast<uint8_t>(len)};
+        s.bytes.insert(s.bytes.end(), hdr, hdr + 8);
+        for (uint32_t k = 0; k < len; ++k) s.bytes.push_back(static_cast<uint8_t>(x >> (k & 15)));
+        s.frames++;
+    }
+    size_t pos = 0;
+    while (pos < s.bytes.size()) {
+        x = x * 1103515245u + 12345u;
+        size_t seg = kind ? 536 : 20 + ((x >> 16) % 140);
+        if (seg > s.bytes.size() - pos) seg = s.bytes.size() - pos;
+        s.segments.push_back(static_cast<uint16_t>(seg));
+        pos += seg;
+    }
+    return s;
+}
+
+// The old tcp_rxdata path: append, check and hand out the frame at offset 0,
+// memmove the remainder down.
+void BM_V2gtpLinearMemmove(benchmark::State &state) {
+    Stream s = make_stream(static_cast<int>(state.range(0)));
+    static uint8_t buf[V2GTP_RX_RING_BYTES];   // 1000 in tcp.cpp, which overflows on stream 1
+    uint16_t level = 0;
+    uint32_t sum = 0;
+    for (auto _ : state) {
+        const uint8_t *p = s.bytes.data();
+        for (uint16_t seg : s.segments) {
+            std::memcpy(buf + level, p, seg);
+            level = static_cast<uint16_t>(level + seg);
+            p += seg;
+            while (level >= 8) {
+                if (buf[0] != 0x01 || buf[1] != 0xFE) state.SkipWithError("bad header");
+                uint16_t type = static_cast<uint16_t>((buf[2] << 8) | buf[3]);
+                uint32_t len = (static_cast<uint32_t>(buf[4]) << 24) | (static_cast<uint32_t>(buf[5]) << 16) |
+                               (static_cast<uint32_t>(buf[6]) << 8) | buf[7];
+                uint32_t frame = 8 + len;
+                if (frame > sizeof(buf) || type != 0x8001) state.SkipWithError("bad frame");
+                if (level < frame) break;
+                sum += buf[8];
+                level = static_cast<uint16_t>(level - frame);
+                if (level) std::memmove(buf, buf + frame, level);
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * s.frames);
+}
+
+void BM_V2gtpRingFramer(benchmark::State &state) {
+    Stream s = make_stream(static_cast<int>(state.range(0)));
+    static V2gtpFramer f;
+    v2gtp_framer_reset(&f);
+    uint32_t sum = 0;
+    for (auto _ : state) {
+        const uint8_t *p = s.bytes.data();
+        for (uint16_t seg : s.segments) {
+            p += v2gtp_framer_write(&f, p, seg);
+            V2gtpFrame frame;
+            while (v2gtp_framer_next(&f, &frame) == V2GTP_FRAME) {
+                if (frame.payload_type != 0x8001) state.SkipWithError("bad frame");
+                sum += frame.payload[0];
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * s.frames);
+}
+
+} // namespace
+
+BENCHMARK(BM_V2gtpLinearMemmove)->Arg(0)->Arg(1);
+BENCHMARK(BM_V2gtpRingFramer)->Arg(0)->Arg(1);
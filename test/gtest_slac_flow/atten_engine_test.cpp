@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "atten_engine.h"
+
+namespace {
+
+using Profile = std::vector<uint8_t>;
+
+// Straightforward per-group statistics the engine has to reproduce.
+void ExpectMatchesReference(const std::vector<Profile> &profiles) {
+    AttenAccum acc;
+    atten_reset(&acc);
+    for (const Profile &p : profiles) ASSERT_TRUE(atten_add(&acc, p.data()));
+    AttenStats st;
+    atten_finish(&acc, &st);
+
+    uint32_t n = profiles.size();
+    ASSERT_EQ(st.samples, n);
+    uint16_t max_var = 0;
+    for (int g = 0; g < SLAC_ATTEN_GROUPS; ++g) {
+        uint32_t sum = 0, sq = 0;
+        uint8_t mn = 255, mx = 0;
+        for (const Profile &p : profiles) {
+            sum += p[g];
+            sq += p[g] * p[g];
+            mn = std::min(mn, p[g]);
+            mx = std::max(mx, p[g]);
+        }
+        ASSERT_EQ(atten_group_sum(&acc, g), sum) << "group " << g;
+        if (n == 0) {
+            EXPECT_EQ(st.mean[g], 0);
+            continue;
+        }
+        EXPECT_EQ(st.mean[g], sum / n) << "group " << g;
+        uint16_t var = (uint16_t)((n * sq - sum * sum) / (n * n));
+        EXPECT_EQ(st.var[g], var) << "group " << g;
+        max_var = std::max(max_var, var);
+        uint32_t trimmed = n >= 3 ? (sum - mn - mx) / (n - 2) : sum / n;
+        EXPECT_EQ(st.trimmed[g], trimmed) << "group " << g;
+    }
+    EXPECT_EQ(st.max_var, max_var);
+}
+
+} // namespace
+
+TEST(AttenEngineTest, MatchesPerGroupReference) {
+    std::mt19937 rng(15118);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (size_t n : {0u, 1u, 2u, 3u, 10u, 20u, 255u}) {
+        std::vector<Profile> profiles(n, Profile(SLAC_ATTEN_GROUPS));
+        for (Profile &p : profiles) {
+            for (uint8_t &v : p) v = (uint8_t)byte(rng);
+        }
+        ExpectMatchesReference(profiles);
+    }
+    // the lane limits: all 0xFF into every lane, and alternating extremes
+    ExpectMatchesReference(std::vector<Profile>(255, Profile(SLAC_ATTEN_GROUPS, 0xFF)));
+    std::vector<Profile> extremes;
+    for (int i = 0; i < 20; ++i) extremes.push_back(Profile(SLAC_ATTEN_GROUPS, i & 1 ? 0xFF : 0x00));
+    ExpectMatchesReference(extremes);
+}
+
+TEST(AttenEngineTest, TrimmedMeanRejectsASingleSpike) {
+    AttenAccum acc;
+    atten_reset(&acc);
+    Profile quiet(SLAC_ATTEN_GROUPS, 30);
+    Profile spike = quiet;
+    spike[5] = 90;
+    for (int i = 0; i < 9; ++i) atten_add(&acc, quiet.data());
+    atten_add(&acc, spike.data());
+    AttenStats st;
+    atten_finish(&acc, &st);
+    EXPECT_EQ(st.mean[5], 36);
+    EXPECT_EQ(st.trimmed[5], 30);
+    EXPECT_EQ(st.var[5], 324);
+    EXPECT_EQ(st.max_var, 324);
+    EXPECT_EQ(st.mean[4], 30);
+    EXPECT_EQ(st.var[4], 0);
+}
+
+TEST(AttenEngineTest, StopsAtTheLaneLimit) {
+    AttenAccum acc;
+    atten_reset(&acc);
+    Profile p(SLAC_ATTEN_GROUPS, 0xFF);
+    for (int i = 0; i < ATTEN_MAX_SAMPLES; ++i) ASSERT_TRUE(atten_add(&acc, p.data()));
+    EXPECT_FALSE(atten_add(&acc, p.data()));
+    EXPECT_EQ(atten_group_sum(&acc, 57), 255u * 255u);
+}
@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "bridge_queue.h"
+
+namespace {
+
+void *Item(uintptr_t n) {
+    return reinterpret_cast<void *>(n);
+}
+
+} // namespace
+
+TEST(BridgeQueueTest, KeepsOrderAcrossWrap) {
+    BridgeQueue q;
+    bridge_queue_init(&q, 5);
+    uintptr_t next_in = 1, next_out = 1;
+    for (int round = 0; round < 7; ++round) {
+        for (int i = 0; i < 3; ++i) ASSERT_TRUE(bridge_queue_push(&q, Item(next_in++)));
+        EXPECT_EQ(bridge_queue_peek(&q), Item(next_out));
+        for (int i = 0; i < 3; ++i) EXPECT_EQ(bridge_queue_pop(&q), Item(next_out++));
+    }
+    EXPECT_EQ(bridge_queue_pop(&q), nullptr);
+    EXPECT_EQ(bridge_queue_peek(&q), nullptr);
+    EXPECT_EQ(q.stats.pushed, 21u);
+    EXPECT_EQ(q.stats.popped, 21u);
+    EXPECT_EQ(q.stats.high_water, 3u);
+}
+
+TEST(BridgeQueueTest, FullQueueRefusesAndCounts) {
+    BridgeQueue q;
+    bridge_queue_init(&q, LWIP_BRIDGE_TX_QUEUE);
+    for (uintptr_t i = 1; i <= LWIP_BRIDGE_TX_QUEUE; ++i) ASSERT_TRUE(bridge_queue_push(&q, Item(i)));
+    EXPECT_FALSE(bridge_queue_push(&q, Item(99)));
+    EXPECT_FALSE(bridge_queue_push(&q, Item(100)));
+    EXPECT_EQ(q.stats.overflow, 2u);
+    EXPECT_EQ(q.stats.high_water, LWIP_BRIDGE_TX_QUEUE);
+    // nothing was overwritten
+    for (uintptr_t i = 1; i <= LWIP_BRIDGE_TX_QUEUE; ++i) EXPECT_EQ(bridge_queue_pop(&q), Item(i));
+}
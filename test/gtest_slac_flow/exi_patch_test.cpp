@@ -0,0 +1,244 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "exi_patch.h"
+
+namespace {
+
+// Stand-in for a cbv2g encoder: event codes, a length-prefixed string whose
+// size is part of the layout, then the fields the cache patches.
+struct BitWriter {
+    uint8_t *buf;
+    uint16_t cap;
+    uint32_t bit = 0;
+
+    void put(uint32_t value, uint8_t width) {
+        for (uint8_t i = 0; i < width; ++i, ++bit) {
+            uint8_t mask = 0x80 >> (bit & 7);
+            if ((value >> (width - 1 - i)) & 1) {
+                buf[bit >> 3] |= mask;
+            } else {
+                buf[bit >> 3] &= ~mask;
+            }
+        }
+    }
+    void put_int(int32_t v, bool msb_group_first) {
+        put(v < 0 ? 1 : 0, 1);
+        uint32_t m = v < 0 ? (uint32_t)(-(v + 1)) : (uint32_t)v;
+        std::vector<uint8_t> groups;
+        do {
+            groups.push_back(m & 0x7F);
+            m >>= 7;
+        } while (m);
+        if (msb_group_first) std::reverse(groups.begin(), groups.end());
+        for (size_t i = 0; i < groups.size(); ++i) put(groups[i] | (i + 1 < groups.size() ? 0x80 : 0), 8);
+    }
+    int length() const { return (int)((bit + 7) / 8); }
+};
+
+enum { kStatus, kVoltage, kCurrent, kLimit, kFieldCount };
+
+const ExiFieldSpec kSpec[kFieldCount] = {
+    {EXI_FIELD_NBIT, 4},
+    {EXI_FIELD_INT, 0},
+    {EXI_FIELD_INT, 0},
+    {EXI_FIELD_BOOL, 0},
+};
+
+uint8_t g_name_len = 5;
+bool g_msb_group_first = false;
+int g_encoder_calls = 0;
+
+int ToyEncode(const int32_t *v, uint8_t *out, uint16_t cap) {
+    g_encoder_calls++;
+    std::memset(out, 0, cap);
+    BitWriter w{out, cap};
+    w.put(0x80, 8);                 // EXI header
+    w.put(3, 6);                    // event code
+    w.put(g_name_len, 8);
+    for (uint8_t i = 0; i < g_name_len; ++i) w.put('a' + i, 7);
+    w.put((uint32_t)v[kStatus], 4);
+    w.put(1, 2);
+    w.put_int(v[kVoltage], g_msb_group_first);
+    w.put(0, 3);                    // multiplier
+    w.put_int(v[kCurrent], g_msb_group_first);
+    w.put(v[kLimit] ? 1 : 0, 1);
+    w.put(0x2A, 6);
+    w.put(0, 1);                    // end element
+    return w.length();
+}
+
+std::vector<uint8_t> Reference(const int32_t *v) {
+    std::vector<uint8_t> out(EXI_PATCH_CACHE_BYTES);
+    int calls = g_encoder_calls;
+    out.resize(ToyEncode(v, out.data(), out.size()));
+    g_encoder_calls = calls;
+    return out;
+}
+
+class ExiPatchTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        exi_patch_reset(&cache_);
+        g_name_len = 5;
+        g_msb_group_first = false;
+        g_encoder_calls = 0;
+    }
+
+    int Encode(const int32_t *v) {
+        const uint8_t layout[] = {g_name_len};
+        return exi_patch_encode(&cache_, layout, sizeof(layout), kSpec, v, kFieldCount, ToyEncode);
+    }
+
+    void ExpectMatches(const int32_t *v) {
+        int len = Encode(v);
+        std::vector<uint8_t> ref = Reference(v);
+        ASSERT_EQ(len, (int)ref.size());
+        ASSERT_EQ(0, std::memcmp(cache_.bytes, ref.data(), ref.size()))
+            << "status " << v[kStatus] << " voltage " << v[kVoltage] << " current " << v[kCurrent];
+    }
+
+    ExiPatchCache cache_;
+};
+
+} // namespace
+
+TEST_F(ExiPatchTest, PatchedFramesMatchTheEncoder) {
+    std::mt19937 rng(15118);
+    int32_t v[kFieldCount] = {1, 4000, 125, 0};
+    ExpectMatches(v);
+    EXPECT_EQ(cache_.learned, 1u);
+    for (int i = 0; i < 2000; ++i) {
+        v[kStatus] = rng() % 13;
+        v[kVoltage] = 3500 + (int32_t)(rng() % 1000);
+        v[kCurrent] = 20 + (int32_t)(rng() % 100);
+        if (i % 50 == 0) v[kCurrent] = (int32_t)(rng() % 600) - 100;   // crosses sign and group boundaries
+        v[kLimit] = rng() & 1;
+        ExpectMatches(v);
+    }
+    EXPECT_GT(cache_.patched, cache_.encoded);
+    EXPECT_EQ(cache_.rejected, 0u);
+}
+
+TEST_F(ExiPatchTest, WidthOrLayoutChangeGoesThroughTheEncoder) {
+    int32_t v[kFieldCount] = {1, 4000, 100, 0};
+    ExpectMatches(v);
+    v[kCurrent] = 101;
+    ExpectMatches(v);
+    EXPECT_EQ(cache_.patched, 1u);
+    EXPECT_EQ(cache_.encoded, 1u);
+
+    v[kCurrent] = 200;              // one more 7 bit group
+    ExpectMatches(v);
+    EXPECT_EQ(cache_.encoded, 2u);
+    v[kCurrent] = -5;               // sign change
+    ExpectMatches(v);
+    EXPECT_EQ(cache_.encoded, 3u);
+    g_name_len = 9;                 // longer string in front of every field
+    ExpectMatches(v);
+    EXPECT_EQ(cache_.encoded, 4u);
+    EXPECT_EQ(cache_.learned, 4u);
+
+    int calls = g_encoder_calls;
+    v[kVoltage] = 4001;
+    ExpectMatches(v);
+    EXPECT_EQ(g_encoder_calls, calls);
+}
+
+TEST_F(ExiPatchTest, LayoutThatDoesNotVerifyIsNeverPatched) {
+    g_msb_group_first = true;       // not the integer encoding the cache writes
+    int32_t v[kFieldCount] = {1, 4000, 300, 1};
+    ExpectMatches(v);
+    EXPECT_EQ(cache_.rejected, 1u);
+    v[kVoltage] = 4010;
+    ExpectMatches(v);
+    EXPECT_EQ(cache_.patched, 0u);
+    EXPECT_EQ(cache_.encoded, 2u);
+}
+
+TEST_F(ExiPatchTest, MisdeclaredEnumerationWidthNeverChangesTheFrame) {
+    g_name_len = 0;                 // zero bits in front of the status, so the low-bit probes agree
+    const uint8_t layout[] = {g_name_len};
+    ExiFieldSpec spec[kFieldCount];
+    std::memcpy(spec, kSpec, sizeof(spec));
+    int32_t v[kFieldCount] = {1, 4000, 125, 0};
+    spec[kStatus].nbits = 7;        // encoded as 4
+    exi_patch_encode(&cache_, layout, sizeof(layout), spec, v, kFieldCount, ToyEncode);
+    EXPECT_FALSE(cache_.valid);
+    EXPECT_EQ(cache_.rejected, 1u);
+
+    exi_patch_reset(&cache_);
+    spec[kStatus].nbits = 2;        // statuses above 3 must go through the encoder
+    for (int32_t status = 0; status < 13; ++status) {
+        v[kStatus] = status;
+        int len = exi_patch_encode(&cache_, layout, sizeof(layout), spec, v, kFieldCount, ToyEncode);
+        std::vector<uint8_t> ref = Reference(v);
+        ASSERT_EQ(len, (int)ref.size());
+        ASSERT_EQ(0, std::memcmp(cache_.bytes, ref.data(), ref.size())) << "status " << status;
+    }
+    EXPECT_EQ(cache_.patched, 3u);
+    EXPECT_EQ(cache_.rejected, 9u);  // a status that does not fit is not learned either
+}
+
+TEST_F(ExiPatchTest, ReceivedFramesAreReadFromTheTemplate) {
+    const uint8_t layout[] = {1};
+    int32_t v[kFieldCount] = {1, 4000, 125, 0};
+    std::vector<uint8_t> frame = Reference(v);
+    ASSERT_TRUE(exi_patch_learn(&cache_, layout, sizeof(layout), frame.data(), frame.size(), kSpec, v,
+                                kFieldCount, ToyEncode));
+
+    std::mt19937 rng(70121);
+    int matched = 0;
+    for (int i = 0; i < 2000; ++i) {
+        v[kStatus] = rng() % 13;
+        v[kVoltage] = 3500 + (int32_t)(rng() % 1000);
+        v[kCurrent] = (int32_t)(rng() % 300) - 50;
+        v[kLimit] = rng() & 1;
+        frame = Reference(v);
+        int32_t out[kFieldCount] = {};
+        if (!exi_patch_match(&cache_, layout, sizeof(layout), frame.data(), frame.size(), kSpec, out)) {
+            // Only a current outside one 7 bit group (or negative) changes the frame's shape.
+            EXPECT_TRUE(v[kCurrent] < 0 || v[kCurrent] > 127) << v[kCurrent];
+            continue;
+        }
+        matched++;
+        for (int f = 0; f < kFieldCount; ++f) EXPECT_EQ(out[f], v[f]) << "field " << f;
+    }
+    EXPECT_GT(matched, 600);
+    EXPECT_EQ(cache_.patched, (uint32_t)matched);
+}
+
+TEST_F(ExiPatchTest, FrameThatDiffersOutsideTheFieldsIsDecoded) {
+    const uint8_t layout[] = {1};
+    int32_t v[kFieldCount] = {1, 4000, 125, 0};
+    std::vector<uint8_t> frame = Reference(v);
+    ASSERT_TRUE(exi_patch_learn(&cache_, layout, sizeof(layout), frame.data(), frame.size(), kSpec, v,
+                                kFieldCount, ToyEncode));
+    int32_t out[kFieldCount];
+    g_name_len = 6;
+    frame = Reference(v);
+    EXPECT_FALSE(exi_patch_match(&cache_, layout, sizeof(layout), frame.data(), frame.size(), kSpec, out));
+    g_name_len = 5;
+    frame = Reference(v);
+    frame[frame.size() - 1] ^= 0x02;    // constant bits behind the last field
+    EXPECT_FALSE(exi_patch_match(&cache_, layout, sizeof(layout), frame.data(), frame.size(), kSpec, out));
+
+    // The template missed before it earned EXI_PATCH_MIN_HITS: the layout is not learned again.
+    int calls = g_encoder_calls;
+    EXPECT_FALSE(exi_patch_learn(&cache_, layout, sizeof(layout), frame.data(), frame.size(), kSpec, v,
+                                 kFieldCount, ToyEncode));
+    EXPECT_EQ(g_encoder_calls, calls);
+    frame = Reference(v);
+    EXPECT_FALSE(exi_patch_match(&cache_, layout, sizeof(layout), frame.data(), frame.size(), kSpec, out));
+
+    // A new session layout learns again.
+    const uint8_t next[] = {2};
+    EXPECT_TRUE(exi_patch_learn(&cache_, next, sizeof(next), frame.data(), frame.size(), kSpec, v,
+                                kFieldCount, ToyEncode));
+    EXPECT_EQ(cache_.learned, 2u);
+}
@@ -439,3 +439,219 @@ TEST_F(DinEndToEndTest, ReplayDemoLogProducesRecordedResponses) {
 
     EXPECT_TRUE(g_tcp_frames.empty());
 }
+
+TEST_F(DinEndToEndTest, RequestWithoutRouteIsDropped) {
+    const LogTrace trace = LoadLogTrace(kDemoLogPath);
+    ASSERT_GT(trace.requests.size(), 2u) << "No requests parsed from " << kDemoLogPath;
+    tcp_hlc_stats_reset();
+
+    SendFrame(trace.requests[0]);   // supportedAppProtocolReq
+    ASSERT_EQ(g_tcp_frames.size(), 1u);
+    g_tcp_frames.clear();
+    SendFrame(trace.requests[2]);   // anything but SessionSetupReq
+    EXPECT_TRUE(g_tcp_frames.empty());
+    SendFrame(trace.requests[1]);   // the session carries on
+    EXPECT_EQ(g_tcp_frames.size(), 1u);
+
+    uint32_t unrouted = 0, bad = 0;
+    tcp_hlc_dispatch_counters(&unrouted, &bad);
+    EXPECT_EQ(unrouted, 1u);
+    EXPECT_EQ(bad, 0u);
+    uint32_t calls = 0;
+    HlcRouteStats r;
+    for (uint8_t i = 0; i < tcp_hlc_route_count(); ++i) {
+        ASSERT_TRUE(tcp_hlc_route_stats(i, &r));
+        calls += r.calls;
+    }
+    EXPECT_EQ(calls, 2u);
+}
+
+namespace {
+
+std::vector<std::vector<uint8_t>> g_eth_frames;
+
+void CaptureEthFrame(const uint8_t *data, uint32_t len) {
+    g_eth_frames.emplace_back(data, data + len);
+}
+
+constexpr size_t kTcpOffset = 14 + 40;
+constexpr uint16_t kEvPort = 0xC001;
+constexpr uint32_t kEvIsn = 1000;
+
+// EV side of the raw-TCP transport: segments go straight into evaluateTcpPacket().
+std::vector<uint8_t> EvSegment(uint32_t seq, uint32_t ack, uint8_t flags,
+                               const std::vector<uint8_t> &payload = {}, uint16_t mss = 0) {
+    std::vector<uint8_t> s(mss ? 24 : 20, 0);
+    s[0] = kEvPort >> 8;
+    s[1] = kEvPort & 0xFF;
+    s[2] = 15118 >> 8;
+    s[3] = 15118 & 0xFF;
+    for (int i = 0; i < 4; ++i) {
+        s[4 + i] = static_cast<uint8_t>(seq >> (24 - 8 * i));
+        s[8 + i] = static_cast<uint8_t>(ack >> (24 - 8 * i));
+    }
+    s[12] = static_cast<uint8_t>((s.size() / 4) << 4);
+    s[13] = flags;
+    s[14] = 0x10;   // window 4096
+    if (mss) {
+        s[20] = 0x02;
+        s[21] = 0x04;
+        s[22] = static_cast<uint8_t>(mss >> 8);
+        s[23] = static_cast<uint8_t>(mss);
+    }
+    s.insert(s.end(), payload.begin(), payload.end());
+    return s;
+}
+
+void SendEvSegment(const std::vector<uint8_t> &s) {
+    evaluateTcpPacket(s.data(), static_cast<uint16_t>(s.size()));
+}
+
+struct SentSegment {
+    uint32_t seq = 0;
+    uint32_t ack = 0;
+    uint8_t flags = 0;
+    uint16_t mss = 0;
+    bool checksum_ok = false;
+    std::vector<uint8_t> payload;
+};
+
+SentSegment ParseSent(const std::vector<uint8_t> &eth) {
+    SentSegment out;
+    EXPECT_GE(eth.size(), kTcpOffset + 20);
+    if (eth.size() < kTcpOffset + 20) return out;
+    uint16_t tcpLen = static_cast<uint16_t>((eth[18] << 8) | eth[19]);
+    EXPECT_EQ(eth.size(), kTcpOffset + tcpLen);
+    std::vector<uint8_t> tcp(eth.begin() + kTcpOffset, eth.end());
+    for (int i = 0; i < 4; ++i) {
+        out.seq = (out.seq << 8) | tcp[4 + i];
+        out.ack = (out.ack << 8) | tcp[8 + i];
+    }
+    out.flags = tcp[13];
+    size_t hdr = (tcp[12] >> 4) * 4;
+    if (hdr >= 24 && tcp[20] == 0x02) out.mss = static_cast<uint16_t>((tcp[22] << 8) | tcp[23]);
+    uint16_t sent = static_cast<uint16_t>((tcp[16] << 8) | tcp[17]);
+    tcp[16] = tcp[17] = 0;
+    out.checksum_ok = calculateUdpAndTcpChecksumForIPv6(tcp.data(), static_cast<uint16_t>(tcp.size()),
+                                                        SeccIp, EvccIp, 0x06) == sent;
+    out.payload.assign(tcp.begin() + hdr, tcp.end());
+    return out;
+}
+
+std::vector<SentSegment> TakeSent() {
+    std::vector<SentSegment> out;
+    for (const auto &eth : g_eth_frames) out.push_back(ParseSent(eth));
+    g_eth_frames.clear();
+    return out;
+}
+
+class RawTcpTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        slac_test_reset_state();
+        tcp_register_socket_sender(nullptr);
+        tcp_transport_reset();
+        g_eth_frames.clear();
+        slac_test_set_millis(0);
+        std::copy(kEvseMac.begin(), kEvseMac.end(), myMac);
+        setSeccIp();
+        memcpy(EvccIp, kEvIp.data(), kEvIp.size());
+        dc_stub_reset_measurements();
+        tcp_test_clear_evse_status_override();
+        slac_test_set_tx_hook(&CaptureEthFrame);
+    }
+
+    void TearDown() override {
+        slac_test_set_tx_hook(nullptr);
+        tcp_transport_reset();
+    }
+
+    // Three-way handshake; returns the EVSE's first data sequence number.
+    uint32_t Connect(uint16_t mss) {
+        SendEvSegment(EvSegment(kEvIsn, 0, 0x02, {}, mss));
+        auto synAck = TakeSent();
+        EXPECT_EQ(synAck.size(), 1u);
+        if (synAck.empty()) return 0;
+        EXPECT_EQ(synAck[0].flags, 0x12);
+        EXPECT_EQ(synAck[0].ack, kEvIsn + 1);
+        EXPECT_EQ(synAck[0].mss, TCP_TX_MSS);
+        uint32_t next = synAck[0].seq + 1;
+        SendEvSegment(EvSegment(kEvIsn + 1, next, 0x10));
+        EXPECT_TRUE(TakeSent().empty());
+        return next;
+    }
+};
+
+}  // namespace
+
+TEST_F(RawTcpTest, ResponseIsSplitIntoPeerMssSegments) {
+    const LogTrace trace = LoadLogTrace(kDemoLogPath);
+    ASSERT_FALSE(trace.requests.empty()) << "No requests parsed from " << kDemoLogPath;
+    const auto &req = trace.requests[0];
+    const auto &res = trace.responses[0];
+    const uint16_t mss = 3;
+    ASSERT_GT(res.size(), 2u * mss);
+    uint32_t seq = Connect(mss);
+    uint32_t evSeq = kEvIsn + 1 + static_cast<uint32_t>(req.size());
+
+    SendEvSegment(EvSegment(kEvIsn + 1, seq, 0x18, req));
+    auto sent = TakeSent();
+    ASSERT_GE(sent.size(), 2u);
+    EXPECT_EQ(sent[0].flags, 0x10);     // ACK of the request comes first
+    EXPECT_TRUE(sent[0].payload.empty());
+    EXPECT_EQ(sent[0].ack, evSeq);
+    sent.erase(sent.begin());
+
+    // The EV acks each burst; at most TCP_TX_WINDOW_SEGMENTS are in flight.
+    std::vector<uint8_t> stream;
+    size_t segments = 0;
+    while (!sent.empty()) {
+        EXPECT_LE(sent.size(), static_cast<size_t>(TCP_TX_WINDOW_SEGMENTS));
+        for (const auto &seg : sent) {
+            SCOPED_TRACE("segment " + std::to_string(segments));
+            EXPECT_TRUE(seg.checksum_ok);
+            EXPECT_EQ(seg.seq, seq + stream.size());
+            EXPECT_LE(seg.payload.size(), mss);
+            stream.insert(stream.end(), seg.payload.begin(), seg.payload.end());
+            EXPECT_EQ(seg.flags, stream.size() == res.size() ? 0x18 : 0x10);   // PSH on the last one
+            ++segments;
+        }
+        SendEvSegment(EvSegment(evSeq, seq + static_cast<uint32_t>(stream.size()), 0x10));
+        sent = TakeSent();
+    }
+    EXPECT_EQ(segments, (res.size() + mss - 1) / mss);
+    ExpectFrameEq(res, stream, 0);
+}
+
+TEST_F(RawTcpTest, TimeoutResendsFromTheFirstUnackedByte) {
+    const LogTrace trace = LoadLogTrace(kDemoLogPath);
+    ASSERT_FALSE(trace.requests.empty()) << "No requests parsed from " << kDemoLogPath;
+    const auto &req = trace.requests[0];
+    const auto &res = trace.responses[0];
+    const uint16_t mss = 3;
+    uint32_t seq = Connect(mss);
+    uint32_t evSeq = kEvIsn + 1 + static_cast<uint32_t>(req.size());
+
+    SendEvSegment(EvSegment(kEvIsn + 1, seq, 0x18, req));
+    TakeSent();
+    SendEvSegment(EvSegment(evSeq, seq + 2 * mss, 0x10));   // first two segments arrived
+    TakeSent();                                             // the window moves on
+
+    slac_test_set_millis(TCP_RTO_INITIAL_MS + 1);
+    tcp_tick();
+    auto resent = TakeSent();
+    ASSERT_EQ(resent.size(), 1u);       // one segment at a time after a timeout
+    EXPECT_EQ(resent[0].seq, seq + 2 * mss);
+    EXPECT_EQ(resent[0].payload, std::vector<uint8_t>(res.begin() + 2 * mss, res.begin() + 3 * mss));
+
+    // The same request again (its ACK got lost) is acked, not answered twice.
+    SendEvSegment(EvSegment(kEvIsn + 1, seq + static_cast<uint32_t>(res.size()), 0x18, req));
+    auto dup = TakeSent();
+    ASSERT_EQ(dup.size(), 1u);
+    EXPECT_TRUE(dup[0].payload.empty());
+    EXPECT_EQ(dup[0].ack, evSeq);
+
+    slac_test_set_millis(4 * TCP_RTO_INITIAL_MS);
+    tcp_tick();
+    EXPECT_TRUE(TakeSent().empty());    // everything was acked
+}
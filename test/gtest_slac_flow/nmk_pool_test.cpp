@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "evse_config.h"
+#include "main.h"
+#include "nmk_pool.h"
+#include "slac_session.h"
+
+extern "C" {
+void slac_test_set_tx_hook(void (*hook)(const uint8_t *, uint32_t));
+void slac_test_reset_state(void);
+void slac_test_timer_tick(void);
+void cp_stub_set_connected(bool connected);
+}
+
+void slac_test_set_millis(unsigned long value);
+
+namespace {
+
+using Frame = std::vector<uint8_t>;
+
+std::vector<Frame> g_tx;
+uint8_t g_next_byte = 0;
+
+void CaptureTx(const uint8_t *data, uint32_t len) {
+    g_tx.emplace_back(data, data + len);
+}
+
+// Key n is 16 bytes counting up from 16 * n.
+void CountingFill(void *buf, uint32_t len) {
+    uint8_t *p = static_cast<uint8_t *>(buf);
+    for (uint32_t i = 0; i < len; ++i) p[i] = g_next_byte++;
+}
+
+Frame SetKeyCnf() {
+    Frame f(60, 0);
+    f[12] = 0x88;
+    f[13] = 0xE1;
+    f[15] = 0x09;
+    f[16] = 0x60;
+    f[19] = 0x01;
+    return f;
+}
+
+Frame SlacParamReq() {
+    Frame f(60, 0);
+    f[12] = 0x88;
+    f[13] = 0xE1;
+    f[14] = 0x01;
+    f[15] = 0x64;
+    f[16] = 0x60;
+    f[25] = 3;
+    f[26] = 0x08;
+    return f;
+}
+
+class NmkPoolTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        g_tx.clear();
+        g_next_byte = 0;
+        nmk_pool_set_source(&CountingFill);
+        slac_test_reset_state();
+        slac_test_set_tx_hook(&CaptureTx);
+        slac_test_set_millis(0);
+    }
+    void TearDown() override {
+        cp_stub_set_connected(true);
+        nmk_pool_set_source(nullptr);
+        slac_test_reset_state();
+    }
+};
+
+} // namespace
+
+TEST_F(NmkPoolTest, HandsOutPreDrawnKeysInOrder) {
+    nmk_pool_refill();
+    NmkPoolStats st;
+    nmk_pool_stats(&st);
+    EXPECT_EQ(st.level, NMK_POOL_SIZE);
+    EXPECT_EQ(st.drawn, uint32_t(NMK_POOL_SIZE));
+
+    uint8_t nmk[16], nid[7];
+    for (int k = 0; k < NMK_POOL_SIZE; ++k) {
+        nmk_pool_take(nmk, nid);
+        EXPECT_EQ(nmk[0], 16 * k);
+        EXPECT_EQ(nmk[15], 16 * k + 15);
+        EXPECT_EQ(nid[0], (16 * k) & 0x3F);
+        EXPECT_EQ(0, std::memcmp(nid + 1, nmk + 1, 6));
+    }
+    nmk_pool_stats(&st);
+    EXPECT_EQ(st.level, 0);
+    EXPECT_EQ(st.empty, 0u);
+
+    // dry pool: drawn inline
+    nmk_pool_take(nmk, nid);
+    EXPECT_EQ(nmk[0], 16 * NMK_POOL_SIZE);
+    nmk_pool_stats(&st);
+    EXPECT_EQ(st.empty, 1u);
+    EXPECT_EQ(st.taken, uint32_t(NMK_POOL_SIZE + 1));
+}
+
+TEST_F(NmkPoolTest, PlugOutPushesTheNextKeyImmediately) {
+    nmk_pool_refill();
+    SlacSession &s = slac_primary();
+    s.modem_state = MODEM_LINK_READY;
+    cp_stub_set_connected(true);
+    slac_test_timer_tick();
+    g_tx.clear();
+
+    // the SET_KEY.REQ leaves from the CP task in the tick that sees the plug-out
+    slac_test_set_millis(100);
+    cp_stub_set_connected(false);
+    slac_test_timer_tick();
+    ASSERT_EQ(g_tx.size(), 1u);
+    ASSERT_EQ(g_tx[0].size(), size_t(SLAC_SET_KEY_REQ_LEN));
+    EXPECT_EQ(g_tx[0][15], 0x08);
+    EXPECT_EQ(g_tx[0][41], 0x00);       // first pooled key
+    EXPECT_EQ(g_tx[0][56], 0x0F);
+    EXPECT_EQ(0, std::memcmp(s.nmk, g_tx[0].data() + 41, 16));
+    EXPECT_EQ(s.modem_state, MODEM_CM_SET_KEY_CNF);
+    EXPECT_EQ(s.key_rotations, 1u);
+
+    // the proto step of the same tick put a new key into the pool
+    NmkPoolStats st;
+    nmk_pool_stats(&st);
+    EXPECT_EQ(st.level, NMK_POOL_SIZE);
+    EXPECT_EQ(st.empty, 0u);
+
+    slac_test_set_millis(130);
+    Frame cnf = SetKeyCnf();
+    SlacManager(cnf.data(), cnf.size());
+    EXPECT_EQ(s.modem_state, MODEM_CONFIGURED);
+    EXPECT_EQ(s.key_ready_ms, 30u);
+
+    // the next vehicle finds the key in place
+    slac_test_set_millis(1000);
+    cp_stub_set_connected(true);
+    slac_test_timer_tick();
+    slac_test_set_millis(1450);
+    Frame req = SlacParamReq();
+    SlacManager(req.data(), req.size());
+    EXPECT_EQ(s.modem_state, SLAC_PARAM_CNF);
+    EXPECT_EQ(s.plug_to_param_ms, 450u);
+    EXPECT_EQ(s.plug_to_param_max_ms, 450u);
+    EXPECT_EQ(s.plugs_before_key, 0u);
+}
+
+TEST_F(NmkPoolTest, PlugInBeforeTheKeyIsConfirmedIsCounted) {
+    SlacSession &s = slac_primary();
+    s.modem_state = MODEM_LINK_READY;
+    slac_test_timer_tick();
+    cp_stub_set_connected(false);
+    slac_test_timer_tick();
+    ASSERT_EQ(s.modem_state, MODEM_CM_SET_KEY_CNF);
+    cp_stub_set_connected(true);
+    slac_test_timer_tick();
+    EXPECT_EQ(s.plugs_before_key, 1u);
+}
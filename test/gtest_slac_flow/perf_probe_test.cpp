@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "perf_probe.h"
+
+extern "C" {
+void slac_test_timer_tick(void);
+void slac_test_reset_state(void);
+}
+
+namespace {
+
+class PerfProbeTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        perf_probe_reset();
+    }
+
+    void TearDown() override {
+        perf_probe_reset();
+    }
+
+    static uint32_t Cycles(uint32_t us) {
+        return us * perf_probe_cycles_per_us();
+    }
+};
+
+} // namespace
+
+TEST_F(PerfProbeTest, SummarisesSamples) {
+    for (int i = 0; i < 99; ++i) perf_probe_record(PERF_CP_TICK, Cycles(100));
+    perf_probe_record(PERF_CP_TICK, Cycles(5000));
+
+    PerfProbeStats s;
+    ASSERT_TRUE(perf_probe_get(PERF_CP_TICK, &s));
+    EXPECT_STREQ(s.name, "cp_tick");
+    EXPECT_EQ(s.count, 100u);
+    EXPECT_EQ(s.min_us, 100u);
+    EXPECT_EQ(s.max_us, 5000u);
+    EXPECT_EQ(s.avg_us, 149u);
+    // percentiles are bucket edges: within 2x of the real value, never above max
+    EXPECT_GE(s.p50_us, 100u);
+    EXPECT_LT(s.p50_us, 200u);
+    EXPECT_GE(s.p99_us, 100u);
+    EXPECT_LT(s.p99_us, 5000u);
+}
+
+TEST_F(PerfProbeTest, HistogramUsesLog2Buckets) {
+    perf_probe_record(PERF_TCP_TICK, 0);
+    perf_probe_record(PERF_TCP_TICK, 1);
+    perf_probe_record(PERF_TCP_TICK, 1023);
+    perf_probe_record(PERF_TCP_TICK, 1024);
+    perf_probe_record(PERF_TCP_TICK, 0xFFFFFFFFu);
+    uint32_t buckets[PERF_PROBE_BUCKETS];
+    ASSERT_TRUE(perf_probe_histogram(PERF_TCP_TICK, buckets));
+    EXPECT_EQ(buckets[0], 1u);
+    EXPECT_EQ(buckets[1], 1u);
+    EXPECT_EQ(buckets[10], 1u);
+    EXPECT_EQ(buckets[11], 1u);
+    EXPECT_EQ(buckets[PERF_PROBE_BUCKETS - 1], 1u);
+    EXPECT_FALSE(perf_probe_histogram(PERF_PROBE_COUNT, buckets));
+}
+
+TEST_F(PerfProbeTest, MarkRecordsIntervals) {
+    perf_probe_mark(PERF_PROTO_PERIOD);
+    PerfProbeStats s;
+    perf_probe_get(PERF_PROTO_PERIOD, &s);
+    EXPECT_EQ(s.count, 0u);
+    perf_probe_mark(PERF_PROTO_PERIOD);
+    perf_probe_mark(PERF_PROTO_PERIOD);
+    perf_probe_get(PERF_PROTO_PERIOD, &s);
+    EXPECT_EQ(s.count, 2u);
+    EXPECT_EQ(perf_probe_find("proto_period"), PERF_PROTO_PERIOD);
+    EXPECT_EQ(perf_probe_find("nope"), -1);
+}
+
+#if PERF_PROBES_ENABLE
+TEST_F(PerfProbeTest, ControlLoopStagesAreInstrumented) {
+    slac_test_reset_state();
+    slac_test_timer_tick();
+    PerfProbeStats s;
+    for (uint8_t id : {PERF_CP_TICK, PERF_DC_CAN_TICK, PERF_TCP_TICK}) {
+        ASSERT_TRUE(perf_probe_get(id, &s));
+        EXPECT_EQ(s.count, 1u) << s.name;
+    }
+    slac_test_reset_state();
+}
+#endif
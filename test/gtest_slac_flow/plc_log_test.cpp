@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "plc_log.h"
+
+namespace {
+
+std::vector<std::string> g_lines;
+
+void CaptureSink(const char *line, size_t len) {
+    g_lines.emplace_back(line, len);
+}
+
+class PlcLogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        plc_log_reset();
+        plc_log_set_sync(false);
+        plc_log_set_sink(&CaptureSink);
+        g_lines.clear();
+    }
+
+    void TearDown() override {
+        plc_log_reset();
+    }
+};
+
+} // namespace
+
+TEST_F(PlcLogTest, RecordsAreFormattedOnFlushInOrder) {
+    static const char kState[] = "SLAC_PARAM_CNF";
+    PLC_LOGI("state %s\n", kState);
+    PLC_LOGW("retry %u/%u\n", 2u, 5u);
+    PLC_LOGE("EVCCID=%02x%02x%02x%02x%02x%02x\n", 0xFE, 0xED, 0xBE, 0xEF, 0xAF, 0xFE);
+    EXPECT_TRUE(g_lines.empty());
+
+    EXPECT_EQ(plc_log_flush(), 3u);
+    ASSERT_EQ(g_lines.size(), 3u);
+    EXPECT_EQ(g_lines[0], "state SLAC_PARAM_CNF\n");
+    EXPECT_EQ(g_lines[1], "retry 2/5\n");
+    EXPECT_EQ(g_lines[2], "EVCCID=feedbeefaffe\n");
+
+    PlcLogStats st;
+    plc_log_stats(&st);
+    EXPECT_EQ(st.written, 3u);
+    EXPECT_EQ(st.flushed, 3u);
+    EXPECT_EQ(st.dropped, 0u);
+    EXPECT_EQ(st.high_water, 3u);
+}
+
+TEST_F(PlcLogTest, FullRingDropsInsteadOfBlocking) {
+    for (uint32_t i = 0; i < PLC_LOG_RING_SIZE + 10; ++i) PLC_LOGI("n=%u\n", i);
+
+    PlcLogStats st;
+    plc_log_stats(&st);
+    EXPECT_EQ(st.written, (uint32_t)PLC_LOG_RING_SIZE);
+    EXPECT_EQ(st.dropped, 10u);
+
+    EXPECT_EQ(plc_log_flush(), (uint32_t)PLC_LOG_RING_SIZE);
+    EXPECT_EQ(g_lines.front(), "n=0\n");
+    EXPECT_EQ(g_lines.back(), "n=" + std::to_string(PLC_LOG_RING_SIZE - 1) + "\n");
+
+    // slots are reusable once drained
+    PLC_LOGI("again\n");
+    EXPECT_EQ(plc_log_flush(), 1u);
+    EXPECT_EQ(g_lines.back(), "again\n");
+}
+
+TEST_F(PlcLogTest, SyncModeFormatsInCallerAfterDrainingRing) {
+    PLC_LOGI("queued\n");
+    plc_log_set_sync(true);
+    ASSERT_EQ(g_lines.size(), 1u);
+    EXPECT_EQ(g_lines[0], "queued\n");
+
+    PLC_LOGI("direct %d\n", -7);
+    ASSERT_EQ(g_lines.size(), 2u);
+    EXPECT_EQ(g_lines[1], "direct -7\n");
+    EXPECT_EQ(plc_log_flush(), 0u);
+}
+
+TEST_F(PlcLogTest, ConcurrentProducersLoseNothing) {
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = PLC_LOG_RING_SIZE / kThreads;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < kThreads; ++t) {
+        producers.emplace_back([t] {
+            for (int i = 0; i < kPerThread; ++i) PLC_LOGI("t%d %d\n", t, i);
+        });
+    }
+    for (auto &p : producers) p.join();
+
+    EXPECT_EQ(plc_log_flush(), (uint32_t)(kThreads * kPerThread));
+    // per-producer order survives the interleaving
+    std::vector<int> next(kThreads, 0);
+    for (const auto &line : g_lines) {
+        int t = 0, i = 0;
+        ASSERT_EQ(std::sscanf(line.c_str(), "t%d %d", &t, &i), 2);
+        EXPECT_EQ(i, next[t]++);
+    }
+}
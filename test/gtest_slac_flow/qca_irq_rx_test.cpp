@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "evse_config.h"
+#include "main.h"
+#include "slac_session.h"
+
+extern "C" {
+void slac_test_set_tx_hook(void (*hook)(const uint8_t *, uint32_t));
+void slac_test_set_rx_hook(uint32_t (*hook)(uint8_t *, uint32_t));
+void slac_test_set_rx_irq_mode(bool enabled);
+void slac_test_qca_irq(void);
+bool slac_test_run_spi_task(void);
+void slac_test_timer_tick(void);
+void slac_test_reset_state(void);
+}
+
+unsigned long millis();
+void slac_test_set_millis(unsigned long value);
+
+namespace {
+
+using Frame = std::vector<uint8_t>;
+
+Frame g_pending_burst;
+std::vector<unsigned long> g_tx_times;
+
+// Simulated modem read buffer: hands out the queued burst once.
+uint32_t FakeModemRead(uint8_t *dst, uint32_t max) {
+    if (g_pending_burst.empty() || g_pending_burst.size() > max) return 0;
+    std::memcpy(dst, g_pending_burst.data(), g_pending_burst.size());
+    uint32_t len = static_cast<uint32_t>(g_pending_burst.size());
+    g_pending_burst.clear();
+    return len;
+}
+
+void RecordTx(const uint8_t *, uint32_t) {
+    g_tx_times.push_back(millis());
+}
+
+// SLAC_PARAM.REQ wrapped in the QCA7000 SPI framing (length, SOF, FL, RSVD, frame, EOF).
+Frame MakeSlacParamBurst() {
+    Frame frame(60, 0);
+    const uint8_t pev[6] = {0xFE, 0xED, 0xBE, 0xEF, 0xAF, 0xFE};
+    std::memcpy(frame.data() + 6, pev, sizeof(pev));
+    frame[12] = 0x88;
+    frame[13] = 0xE1;
+    frame[14] = 0x01;
+    frame[15] = 0x64;
+    frame[16] = 0x60;
+    frame[25] = 3;
+    frame[26] = 0x08;
+
+    Frame burst;
+    uint32_t total = static_cast<uint32_t>(frame.size() + 10);
+    for (int i = 0; i < 4; ++i) burst.push_back(static_cast<uint8_t>(total >> (8 * i)));
+    burst.insert(burst.end(), {0xAA, 0xAA, 0xAA, 0xAA});
+    burst.push_back(static_cast<uint8_t>(frame.size() & 0xFF));
+    burst.push_back(static_cast<uint8_t>(frame.size() >> 8));
+    burst.insert(burst.end(), {0x00, 0x00});
+    burst.insert(burst.end(), frame.begin(), frame.end());
+    burst.insert(burst.end(), {0x55, 0x55});
+    return burst;
+}
+
+constexpr unsigned long kTickMs = 20;
+constexpr unsigned long kBaseMs = 1000;
+
+struct LatencyStats {
+    unsigned long total = 0;
+    unsigned long max = 0;
+    unsigned samples = 0;
+    void add(unsigned long v) {
+        total += v;
+        max = std::max(max, v);
+        samples++;
+    }
+    double mean() const { return samples ? static_cast<double>(total) / samples : 0.0; }
+};
+
+class QcaIrqRxTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        slac_test_reset_state();
+        g_pending_burst.clear();
+        g_tx_times.clear();
+        slac_test_set_tx_hook(&RecordTx);
+        slac_test_set_rx_hook(&FakeModemRead);
+        slac_test_set_millis(kBaseMs);
+    }
+
+    void TearDown() override {
+        slac_test_reset_state();
+    }
+};
+
+} // namespace
+
+TEST_F(QcaIrqRxTest, TimerTickDoesNotDispatchInIrqMode) {
+    slac_test_set_rx_irq_mode(true);
+    slac_test_timer_tick();                 // consumes the fallback kick window
+    while (slac_test_run_spi_task()) {}
+
+    g_pending_burst = MakeSlacParamBurst();
+    slac_test_set_millis(kBaseMs + kTickMs);
+    slac_test_timer_tick();
+    EXPECT_TRUE(g_tx_times.empty());
+    EXPECT_FALSE(g_pending_burst.empty());
+
+    slac_test_qca_irq();
+    EXPECT_TRUE(slac_test_run_spi_task());
+    ASSERT_EQ(g_tx_times.size(), 1u);
+    EXPECT_EQ(slac_primary().modem_state, SLAC_PARAM_CNF);
+}
+
+TEST_F(QcaIrqRxTest, FallbackPollRecoversMissedEdge) {
+    slac_test_set_rx_irq_mode(true);
+    g_pending_burst = MakeSlacParamBurst();
+    slac_test_set_millis(kBaseMs + QCA_RX_FALLBACK_POLL_MS);
+    slac_test_timer_tick();
+    EXPECT_TRUE(slac_test_run_spi_task());
+    EXPECT_EQ(g_tx_times.size(), 1u);
+}
+
+TEST_F(QcaIrqRxTest, IrqReducesFrameToDispatchLatency) {
+    LatencyStats polled;
+    LatencyStats irq;
+
+    for (unsigned long offset = 1; offset < kTickMs; offset += 2) {
+        // Polling: the frame waits for the next 20 ms tick to kick the SPI task.
+        SetUp();
+        slac_test_set_rx_irq_mode(false);
+        slac_test_timer_tick();
+        unsigned long arrival = kBaseMs + offset;
+        slac_test_set_millis(arrival);
+        g_pending_burst = MakeSlacParamBurst();
+        for (unsigned long tick = kBaseMs + kTickMs; g_tx_times.empty() && tick <= kBaseMs + 5 * kTickMs; tick += kTickMs) {
+            slac_test_set_millis(tick);
+            slac_test_timer_tick();
+            while (slac_test_run_spi_task()) {}
+        }
+        ASSERT_EQ(g_tx_times.size(), 1u);
+        polled.add(g_tx_times[0] - arrival);
+
+        // IRQ: the edge wakes the SPI task straight away.
+        SetUp();
+        slac_test_set_rx_irq_mode(true);
+        slac_test_timer_tick();
+        while (slac_test_run_spi_task()) {}
+        slac_test_set_millis(arrival);
+        g_pending_burst = MakeSlacParamBurst();
+        slac_test_qca_irq();
+        ASSERT_TRUE(slac_test_run_spi_task());
+        ASSERT_EQ(g_tx_times.size(), 1u);
+        irq.add(g_tx_times[0] - arrival);
+    }
+
+    std::printf("[QCA RX] frame-to-dispatch latency: polled mean %.1f ms (max %lu), irq mean %.1f ms (max %lu)\n",
+                polled.mean(), polled.max, irq.mean(), irq.max);
+    RecordProperty("polled_mean_ms", static_cast<int>(polled.mean()));
+    RecordProperty("polled_max_ms", static_cast<int>(polled.max));
+    RecordProperty("irq_max_ms", static_cast<int>(irq.max));
+
+    EXPECT_LE(polled.max, kTickMs);
+    EXPECT_EQ(irq.max, 0u);
+    EXPECT_LT(irq.mean(), polled.mean());
+}
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "evse_config.h"
+#include "qca_rx_pool.h"
+
+namespace {
+
+QcaRxPool g_pool;
+
+class QcaRxPoolTest : public ::testing::Test {
+protected:
+    void SetUp() override { qca_rx_pool_reset(&g_pool); }
+};
+
+} // namespace
+
+TEST_F(QcaRxPoolTest, BufferReturnsOnlyAfterTheLastReference) {
+    uint8_t *burst = qca_rx_pool_take(&g_pool);
+    ASSERT_NE(burst, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(burst) % 4, 0u);
+    // two frames of the burst lent out, then the drain lets go
+    int8_t index = qca_rx_pool_index(&g_pool, burst + 12);
+    ASSERT_GE(index, 0);
+    EXPECT_EQ(qca_rx_pool_index(&g_pool, burst + QCA_RX_BUFFER_BYTES - 1), index);
+    qca_rx_pool_ref(&g_pool, index);
+    qca_rx_pool_ref(&g_pool, qca_rx_pool_index(&g_pool, burst + 700));
+    qca_rx_pool_unref(&g_pool, index);
+    EXPECT_EQ(g_pool.stats.in_use, 1u);
+
+    qca_rx_pool_unref(&g_pool, index);
+    EXPECT_EQ(g_pool.stats.in_use, 1u);
+    qca_rx_pool_unref(&g_pool, index);
+    EXPECT_EQ(g_pool.stats.in_use, 0u);
+    qca_rx_pool_unref(&g_pool, index);      // extra release is ignored
+    EXPECT_EQ(g_pool.refs[index], 0u);
+}
+
+TEST_F(QcaRxPoolTest, HeldBuffersAreNotHandedOutAgain) {
+    uint8_t *held[QCA_RX_POOL_BUFFERS];
+    for (int i = 0; i < QCA_RX_POOL_BUFFERS; ++i) {
+        held[i] = qca_rx_pool_take(&g_pool);
+        ASSERT_NE(held[i], nullptr);
+        for (int j = 0; j < i; ++j) EXPECT_NE(held[i], held[j]);
+    }
+    EXPECT_EQ(qca_rx_pool_take(&g_pool), nullptr);
+    EXPECT_EQ(g_pool.stats.exhausted, 1u);
+    EXPECT_EQ(g_pool.stats.high_water, QCA_RX_POOL_BUFFERS);
+
+    qca_rx_pool_unref(&g_pool, qca_rx_pool_index(&g_pool, held[1]));
+    EXPECT_EQ(qca_rx_pool_take(&g_pool), held[1]);
+    EXPECT_EQ(g_pool.stats.taken, QCA_RX_POOL_BUFFERS + 1u);
+}
+
+TEST_F(QcaRxPoolTest, MemoryOutsideThePoolHasNoIndex) {
+    static uint8_t other[64];
+    EXPECT_EQ(qca_rx_pool_index(&g_pool, other), -1);
+    EXPECT_EQ(qca_rx_pool_index(&g_pool, g_pool.buf[0] - 1), -1);
+    EXPECT_EQ(qca_rx_pool_index(&g_pool, g_pool.buf[QCA_RX_POOL_BUFFERS - 1] + QCA_RX_BUFFER_BYTES), -1);
+}
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "evse_config.h"
+#include "main.h"
+#include "qca_spi.h"
+#include "qca_spi_fake.h"
+#include "slac_session.h"
+
+extern "C" {
+void slac_test_set_qca_bus(const QcaSpiBus *bus);
+void slac_test_set_rx_irq_mode(bool enabled);
+void slac_test_qca_irq(void);
+bool slac_test_run_spi_task(void);
+void slac_test_timer_tick(void);
+void slac_test_reset_state(void);
+}
+
+void slac_test_set_millis(unsigned long value);
+
+namespace {
+
+std::vector<uint8_t> MakeSlacParamReq() {
+    std::vector<uint8_t> frame(60, 0);
+    const uint8_t pev[6] = {0xFE, 0xED, 0xBE, 0xEF, 0xAF, 0xFE};
+    std::memcpy(frame.data() + 6, pev, sizeof(pev));
+    frame[12] = 0x88;
+    frame[13] = 0xE1;
+    frame[14] = 0x01;
+    frame[15] = 0x64;
+    frame[16] = 0x60;
+    frame[25] = 3;
+    frame[26] = 0x08;
+    return frame;
+}
+
+class QcaSpiBusTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        slac_test_reset_state();
+        qca_fake_reset();
+        slac_test_set_qca_bus(qca_fake_bus());
+        slac_test_set_millis(1000);
+    }
+
+    void TearDown() override {
+        slac_test_reset_state();
+    }
+
+    static void Queue(uint16_t len, uint8_t fill) {
+        std::vector<uint8_t> frame(len, fill);
+        qcaspi_write_burst(frame.data(), len);
+    }
+};
+
+} // namespace
+
+TEST_F(QcaSpiBusTest, PowerupHandshakeConfiguresWatermarksAndMask) {
+    slac_test_set_rx_irq_mode(true);
+    slac_primary().modem_state = MODEM_POWERUP;
+    slac_test_timer_tick();
+    EXPECT_EQ(slac_primary().modem_state, MODEM_WRITESPACE);
+    slac_test_timer_tick();
+    EXPECT_EQ(slac_primary().modem_state, MODEM_SPI_CONFIG);
+    slac_test_timer_tick();
+    EXPECT_EQ(slac_primary().modem_state, MODEM_CM_SET_KEY_REQ);
+
+    QcaFakeModem &modem = qca_fake_modem();
+    EXPECT_EQ(modem.intr_enable, QCA_INTR_ENABLE_MASK);
+    EXPECT_EQ(modem.written.count(SPI_REG_WRBUF_WATERMARK), QCA_WRBUF_WATERMARK ? 1u : 0u);
+    EXPECT_EQ(modem.written.count(SPI_REG_RDBUF_WATERMARK), QCA_RDBUF_WATERMARK ? 1u : 0u);
+}
+
+TEST_F(QcaSpiBusTest, QueuedFramesShareOneExternalWrite) {
+    slac_test_set_rx_irq_mode(true);
+    Queue(60, 0x01);
+    Queue(300, 0x02);
+    Queue(1514, 0x03);
+    ASSERT_TRUE(slac_test_run_spi_task());
+
+    QcaFakeModem &modem = qca_fake_modem();
+    ASSERT_EQ(modem.tx_frames.size(), 3u);
+    ASSERT_EQ(modem.tx_batch_frames.size(), 1u);
+    EXPECT_EQ(modem.tx_batch_frames[0], 3u);
+    EXPECT_EQ(modem.tx_frames[1].size(), 300u);
+    EXPECT_EQ(modem.tx_frames[2][0], 0x03);
+    EXPECT_EQ(modem.wrbuf_space, QCA7K_BUFFER_SIZE - (60 + 300 + 1514 + 3 * 10));
+}
+
+TEST_F(QcaSpiBusTest, WriteSpaceStallHoldsFramesUntilModemDrains) {
+    slac_test_set_rx_irq_mode(true);
+    QcaFakeModem &modem = qca_fake_modem();
+    modem.wrbuf_space = 100;
+    Queue(200, 0x0A);
+    Queue(60, 0x0B);
+    ASSERT_TRUE(slac_test_run_spi_task());
+    EXPECT_TRUE(modem.tx_frames.empty());
+
+    // the stall arms WRBUF_BELOW_WM instead of having Timer20ms retry every tick
+    EXPECT_TRUE(modem.intr_enable & SPI_INT_WRBUF_BELOW_WM);
+    slac_test_set_millis(1020);
+    slac_test_timer_tick();
+    EXPECT_FALSE(slac_test_run_spi_task());
+
+    modem.wrbuf_space = QCA7K_BUFFER_SIZE;
+    modem.intr_cause |= SPI_INT_WRBUF_BELOW_WM;
+    slac_test_qca_irq();
+    ASSERT_TRUE(slac_test_run_spi_task());
+    ASSERT_EQ(modem.tx_frames.size(), 2u);
+    EXPECT_EQ(modem.tx_frames[0][0], 0x0A);
+    EXPECT_EQ(modem.tx_frames[1][0], 0x0B);
+}
+
+TEST_F(QcaSpiBusTest, ReceivedFrameAndResponseUseBus) {
+    slac_test_set_rx_irq_mode(true);
+    QcaFakeModem &modem = qca_fake_modem();
+    modem.rdbuf.push_back(qca_fake_make_burst(MakeSlacParamReq()));
+    slac_test_qca_irq();
+    ASSERT_TRUE(slac_test_run_spi_task());
+
+    EXPECT_EQ(slac_primary().modem_state, SLAC_PARAM_CNF);
+    EXPECT_TRUE(modem.rdbuf.empty());
+    ASSERT_EQ(modem.tx_frames.size(), 1u);
+    const std::vector<uint8_t> &cnf = modem.tx_frames[0];
+    ASSERT_GE(cnf.size(), 17u);
+    EXPECT_EQ(cnf[15] | (cnf[16] << 8), CM_SLAC_PARAM | MMTYPE_CNF);
+    EXPECT_EQ(modem.stats.rx_bursts, 1u);
+    EXPECT_EQ(modem.stats.tx_bursts, 1u);
+}
+
+TEST_F(QcaSpiBusTest, RdbufErrorFlushesReadBufferWithoutReset) {
+    slac_test_set_rx_irq_mode(true);
+    QcaFakeModem &modem = qca_fake_modem();
+    modem.rdbuf.push_back(std::vector<uint8_t>(40, 0xEE));
+    modem.intr_cause = SPI_INT_RDBUF_ERR;
+    slac_test_qca_irq();
+    ASSERT_TRUE(slac_test_run_spi_task());
+
+    QcaIrqStats irq;
+    qcaspi_irq_stats(&irq);
+    EXPECT_TRUE(modem.rdbuf.empty());
+    EXPECT_EQ(modem.intr_cause, 0u);
+    EXPECT_EQ(slac_primary().modem_state, MODEM_CONFIGURED);
+    EXPECT_EQ(modem.written.count(SPI_REG_SPI_CONFIG), 0u);
+    EXPECT_EQ(irq.rdbuf_err, 1u);
+    EXPECT_EQ(irq.rdbuf_flushes, 1u);
+    EXPECT_EQ(irq.resets, 0u);
+
+    // a clean wake-up afterwards handles traffic normally again
+    modem.rdbuf.push_back(qca_fake_make_burst(MakeSlacParamReq()));
+    modem.intr_cause = SPI_INT_PKT_AVLBL;
+    slac_test_qca_irq();
+    ASSERT_TRUE(slac_test_run_spi_task());
+    EXPECT_EQ(slac_primary().modem_state, SLAC_PARAM_CNF);
+}
+
+TEST_F(QcaSpiBusTest, RepeatedBufferErrorsEscalateToModemReset) {
+    slac_test_set_rx_irq_mode(true);
+    QcaFakeModem &modem = qca_fake_modem();
+    for (int i = 0; i < QCA_BUF_ERR_RESET_THRESHOLD; ++i) {
+        ASSERT_EQ(modem.written.count(SPI_REG_SPI_CONFIG), 0u);
+        modem.intr_cause = SPI_INT_WRBUF_ERR;
+        slac_test_qca_irq();
+        ASSERT_TRUE(slac_test_run_spi_task());
+    }
+    QcaIrqStats irq;
+    qcaspi_irq_stats(&irq);
+    EXPECT_EQ(irq.wrbuf_err, static_cast<uint32_t>(QCA_BUF_ERR_RESET_THRESHOLD));
+    EXPECT_EQ(irq.resets, 1u);
+    EXPECT_EQ(modem.written.count(SPI_REG_SPI_CONFIG), 1u);
+    EXPECT_EQ(slac_primary().modem_state, MODEM_POWERUP);
+}
+
+TEST_F(QcaSpiBusTest, CpuOnRerunsConfigurationStage) {
+    slac_test_set_rx_irq_mode(true);
+    QcaFakeModem &modem = qca_fake_modem();
+    modem.intr_cause = SPI_INT_CPU_ON | SPI_INT_PKT_AVLBL;
+    slac_test_qca_irq();
+    ASSERT_TRUE(slac_test_run_spi_task());
+    EXPECT_EQ(slac_primary().modem_state, MODEM_WRITESPACE);
+
+    slac_test_timer_tick();
+    slac_test_timer_tick();
+    EXPECT_EQ(slac_primary().modem_state, MODEM_CM_SET_KEY_REQ);
+
+    QcaIrqStats irq;
+    qcaspi_irq_stats(&irq);
+    EXPECT_EQ(irq.cpu_on, 1u);
+    EXPECT_EQ(irq.pkt_avlbl, 1u);
+    EXPECT_EQ(irq.resets, 0u);
+}
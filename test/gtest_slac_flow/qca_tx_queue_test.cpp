@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "evse_config.h"
+#include "main.h"
+#include "qca_tx_queue.h"
+
+extern "C" {
+void slac_test_reset_state(void);
+}
+
+namespace {
+
+QcaTxQueue g_queue;
+
+std::vector<uint8_t> MakeFrame(uint16_t len, uint8_t fill) {
+    return std::vector<uint8_t>(len, fill);
+}
+
+class QcaTxQueueTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        qca_tx_queue_reset(&g_queue);
+    }
+};
+
+} // namespace
+
+TEST_F(QcaTxQueueTest, PreservesOrderAcrossWrap) {
+    for (uint8_t round = 0; round < 3; ++round) {
+        for (uint8_t i = 0; i < QCA_TX_QUEUE_DEPTH; ++i) {
+            auto frame = MakeFrame(60 + i, static_cast<uint8_t>(round * 16 + i));
+            ASSERT_TRUE(qca_tx_queue_push(&g_queue, frame.data(), static_cast<uint16_t>(frame.size())));
+        }
+        for (uint8_t i = 0; i < QCA_TX_QUEUE_DEPTH; ++i) {
+            const QcaTxSlot *slot = qca_tx_queue_peek(&g_queue, 0);
+            ASSERT_NE(slot, nullptr);
+            EXPECT_EQ(slot->len, 60 + i);
+            EXPECT_EQ(slot->data[0], static_cast<uint8_t>(round * 16 + i));
+            qca_tx_queue_pop(&g_queue, 1, slot->len, 1000);
+        }
+        EXPECT_EQ(qca_tx_queue_peek(&g_queue, 0), nullptr);
+    }
+    EXPECT_EQ(g_queue.stats.frames_sent, 3u * QCA_TX_QUEUE_DEPTH);
+    EXPECT_EQ(g_queue.stats.high_water, QCA_TX_QUEUE_DEPTH);
+}
+
+TEST_F(QcaTxQueueTest, FullQueueRejectsInsteadOfOverwriting) {
+    auto frame = MakeFrame(100, 0x11);
+    for (uint8_t i = 0; i < QCA_TX_QUEUE_DEPTH; ++i) {
+        ASSERT_TRUE(qca_tx_queue_push(&g_queue, frame.data(), 100));
+    }
+    auto late = MakeFrame(100, 0x22);
+    EXPECT_FALSE(qca_tx_queue_push(&g_queue, late.data(), 100));
+    EXPECT_EQ(qca_tx_queue_reserve(&g_queue, 100), nullptr);
+    EXPECT_EQ(g_queue.stats.dropped, 2u);
+    for (uint8_t i = 0; i < QCA_TX_QUEUE_DEPTH; ++i) {
+        EXPECT_EQ(qca_tx_queue_peek(&g_queue, i)->data[0], 0x11);
+    }
+
+    // oversize frames never take a slot
+    EXPECT_EQ(qca_tx_queue_reserve(&g_queue, QCA_TX_SLOT_SIZE + 1), nullptr);
+}
+
+TEST_F(QcaTxQueueTest, BatchPopTracksThroughput) {
+    auto frame = MakeFrame(500, 0x33);
+    for (int i = 0; i < 4; ++i) qca_tx_queue_push(&g_queue, frame.data(), 500);
+    qca_tx_queue_pop(&g_queue, 2, 1000, 1000);
+    qca_tx_queue_pop(&g_queue, 2, 1000, 1500);
+    EXPECT_EQ(g_queue.stats.bytes_per_s, 0u);   // window not complete yet
+
+    qca_tx_queue_push(&g_queue, frame.data(), 500);
+    qca_tx_queue_pop(&g_queue, 1, 500, 2000);
+    EXPECT_EQ(g_queue.stats.batches, 3u);
+    EXPECT_EQ(g_queue.stats.frames_sent, 5u);
+    EXPECT_EQ(g_queue.stats.bytes_sent, 2500u);
+    EXPECT_EQ(g_queue.stats.bytes_per_s, 2500u);
+    EXPECT_EQ(g_queue.stats.depth, 0u);
+}
+
+TEST_F(QcaTxQueueTest, CommittedSlotIsFramedForTheWire) {
+    auto frame = MakeFrame(301, 0x44);
+    ASSERT_TRUE(qca_tx_queue_push(&g_queue, frame.data(), 301));
+    const QcaTxSlot *slot = qca_tx_queue_peek(&g_queue, 0);
+    const uint8_t sof[8] = {0xAA, 0xAA, 0xAA, 0xAA, 301 & 0xFF, 301 >> 8, 0, 0};
+    EXPECT_EQ(std::memcmp(slot->sof, sof, 8), 0);
+    EXPECT_EQ(slot->data + 0, slot->sof + 8);   // header, frame and EOF are one block
+    EXPECT_EQ(slot->data[301], 0x55);
+    EXPECT_EQ(slot->data[302], 0x55);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(slot->sof) % 4, 0u);
+}
+
+TEST(QcaTxBackpressure, ReserveFailsWhileSpiTaskIsBehind) {
+    slac_test_reset_state();
+    uint16_t len = 64;
+    for (uint8_t i = 0; i < QCA_TX_QUEUE_DEPTH; ++i) {
+        uint8_t *slot = qcaspi_tx_reserve(len);
+        ASSERT_NE(slot, nullptr);
+        std::memset(slot, i, len);
+        qcaspi_tx_commit(len);
+    }
+    EXPECT_EQ(qcaspi_tx_reserve(len), nullptr);
+    slac_test_reset_state();
+    uint8_t *slot = qcaspi_tx_reserve(len);
+    EXPECT_NE(slot, nullptr);
+    qcaspi_tx_cancel();
+    slac_test_reset_state();
+}
@@ -7,26 +7,15 @@
 #include <cstring>
 
 #include "main.h"
+#include "slac_session.h"
 
 extern "C" {
 void slac_test_set_tx_hook(void (*hook)(const uint8_t *, uint32_t));
 void slac_test_reset_state(void);
 }
 
-void SlacManager(uint16_t rxbytes);
 void slac_test_set_millis(unsigned long value);
-extern uint8_t txbuffer[];
-extern uint8_t rxbuffer[];
-extern uint8_t modem_state;
 extern uint8_t myMac[];
-extern uint8_t pevMac[];
-extern uint8_t pevRunId[];
-extern uint8_t NMK[];
-extern uint8_t NID[];
-extern uint8_t negotiatedSoundCount;
-extern uint8_t negotiatedSoundTimeoutField;
-extern uint32_t currentSoundWindowMs;
-extern uint32_t currentMatchWindowMs;
 
 namespace {
 
@@ -182,8 +171,7 @@ void ExpectFrameEq(const Frame &expected, const Frame &actual, const char *label
 }
 
 void feed_frame(const Frame &frame) {
-    std::memcpy(rxbuffer, frame.data(), frame.size());
-    SlacManager(static_cast<uint16_t>(frame.size()));
+    SlacManager(frame.data(), static_cast<uint16_t>(frame.size()));
 }
 
 class SlacFlowTest : public ::testing::Test {
@@ -193,8 +181,8 @@ protected:
         slac_test_reset_state();
         slac_test_set_tx_hook(&CaptureTx);
         std::copy(kEvseMac.begin(), kEvseMac.end(), myMac);
-        std::copy(kLogNmK.begin(), kLogNmK.end(), NMK);
-        std::copy(kLogNid.begin(), kLogNid.end(), NID);
+        std::copy(kLogNmK.begin(), kLogNmK.end(), slac_primary().nmk);
+        std::copy(kLogNid.begin(), kLogNid.end(), slac_primary().nid);
         slac_test_set_millis(0);
     }
 };
@@ -204,18 +192,18 @@ protected:
 TEST_F(SlacFlowTest, ReplaysRecordedSequence) {
     auto slac_param_req = make_slac_param_req(kSoundCount, kSoundTimeoutField);
     feed_frame(slac_param_req);
-    ASSERT_EQ(modem_state, SLAC_PARAM_CNF);
-    EXPECT_EQ(0, std::memcmp(pevMac, kPevMac.data(), kPevMac.size()));
-    EXPECT_EQ(0, std::memcmp(pevRunId, kRunId.data(), kRunId.size()));
+    ASSERT_EQ(slac_primary().modem_state, SLAC_PARAM_CNF);
+    EXPECT_EQ(0, std::memcmp(slac_primary().pev_mac, kPevMac.data(), kPevMac.size()));
+    EXPECT_EQ(0, std::memcmp(slac_primary().run_id, kRunId.data(), kRunId.size()));
     ASSERT_EQ(g_captured_frames.size(), 1u);
     ExpectFrameEq(expected_slac_param_cnf(), g_captured_frames[0], "SLAC_PARAM.CNF");
     g_captured_frames.clear();
 
     auto start_atten = make_start_atten_char(kSoundCount, kSoundTimeoutField);
     feed_frame(start_atten);
-    ASSERT_EQ(modem_state, MNBC_SOUND);
-    EXPECT_EQ(negotiatedSoundCount, kSoundCount);
-    EXPECT_EQ(negotiatedSoundTimeoutField, kSoundTimeoutField);
+    ASSERT_EQ(slac_primary().modem_state, MNBC_SOUND);
+    EXPECT_EQ(slac_primary().negotiated_sound_count, kSoundCount);
+    EXPECT_EQ(slac_primary().negotiated_sound_timeout_field, kSoundTimeoutField);
 
     for (int i = 0; i < kSoundCount; ++i) {
         feed_frame(make_mnbc_sound(static_cast<uint8_t>(kSoundCount - 1 - i)));
@@ -226,11 +214,11 @@ TEST_F(SlacFlowTest, ReplaysRecordedSequence) {
     g_captured_frames.clear();
 
     feed_frame(make_atten_char_rsp());
-    ASSERT_EQ(modem_state, ATTEN_CHAR_RSP);
-    EXPECT_GT(currentMatchWindowMs, currentSoundWindowMs);
+    ASSERT_EQ(slac_primary().modem_state, ATTEN_CHAR_RSP);
+    EXPECT_GT(slac_primary().match_window_ms, slac_primary().sound_window_ms);
 
     feed_frame(make_slac_match_req());
-    ASSERT_EQ(modem_state, MODEM_GET_SW_REQ);
+    ASSERT_EQ(slac_primary().modem_state, MODEM_GET_SW_REQ);
     ASSERT_EQ(g_captured_frames.size(), 1u);
     ExpectFrameEq(expected_slac_match_cnf(), g_captured_frames[0], "SLAC_MATCH.CNF");
 }
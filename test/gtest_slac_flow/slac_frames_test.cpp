@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "main.h"
+#include "slac_frames.h"
+#include "slac_session.h"
+
+extern "C" {
+void slac_test_set_tx_hook(void (*hook)(const uint8_t *, uint32_t));
+void slac_test_reset_state(void);
+}
+
+void slac_test_set_millis(unsigned long value);
+extern uint8_t myMac[];
+
+namespace {
+
+using Frame = std::vector<uint8_t>;
+
+// Same session as SlacFlowTest.ReplaysRecordedSequence.
+constexpr std::array<uint8_t, 6> kEvseMac{{0x70, 0xB3, 0xD5, 0x00, 0x00, 0x01}};
+constexpr std::array<uint8_t, 6> kPevMac{{0xFE, 0xED, 0xBE, 0xEF, 0xAF, 0xFE}};
+constexpr std::array<uint8_t, 8> kRunId{{0x10, 0x11, 0x12, 0x13, 0x03, 0x08, 0x16, 0x17}};
+constexpr std::array<uint8_t, 16> kNmk{{0x77, 0x77, 0x73, 0x7F, 0x77, 0x77, 0x77, 0x77,
+                                        0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77}};
+constexpr std::array<uint8_t, 7> kNid{{0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07}};
+constexpr uint8_t kSoundCount = 3;
+constexpr uint8_t kSoundTimeoutField = 0x08;
+
+// The byte-by-byte compose routines the templates replaced, kept as the reference.
+struct Legacy {
+    uint8_t tx[160];
+    uint16_t avg[58];
+
+    void mac(const uint8_t *m, int ofs) { std::memcpy(tx + ofs, m, 6); }
+    void run_id(int ofs) { std::memcpy(tx + ofs, kRunId.data(), 8); }
+    void nid(int ofs) { std::memcpy(tx + ofs, kNid.data(), 7); }
+    void nmk(int ofs) { std::memcpy(tx + ofs, kNmk.data(), 16); }
+
+    void set_key() {
+        std::memset(tx, 0x00, 60);
+        tx[0]=0x00; tx[1]=0xB0; tx[2]=0x52; tx[3]=0x00; tx[4]=0x00; tx[5]=0x01;
+        mac(kEvseMac.data(), 6);
+        tx[12]=0x88; tx[13]=0xE1; tx[14]=0x01; tx[15]=0x08; tx[16]=0x60;
+        tx[17]=0x00; tx[18]=0x00; tx[19]=0x01;
+        tx[28]=0x04; tx[29]=0x00; tx[30]=0x00; tx[31]=0x00; tx[32]=0x00;
+        nid(33);
+        tx[40]=0x01;
+        nmk(41);
+    }
+    void get_sw() {
+        std::memset(tx, 0x00, 60);
+        std::memset(tx, 0xff, 6);
+        mac(kEvseMac.data(), 6);
+        tx[12]=0x88; tx[13]=0xE1; tx[14]=0x00; tx[15]=0x00; tx[16]=0xA0;
+        tx[17]=0x00; tx[18]=0xB0; tx[19]=0x52;
+    }
+    void factory_defaults() {
+        std::memset(tx, 0x00, 60);
+        tx[0]=0x00; tx[1]=0xB0; tx[2]=0x52; tx[3]=0x00; tx[4]=0x00; tx[5]=0x01;
+        mac(kEvseMac.data(), 6);
+        tx[12]=0x88; tx[13]=0xE1; tx[14]=0x00; tx[15]=0x7C; tx[16]=0xA0;
+        tx[17]=0x00; tx[18]=0xB0; tx[19]=0x52;
+    }
+    void param_cnf(uint8_t sounds, uint8_t timeout) {
+        std::memset(tx, 0x00, 60);
+        mac(kPevMac.data(), 0);
+        mac(kEvseMac.data(), 6);
+        tx[12]=0x88; tx[13]=0xE1; tx[14]=0x01; tx[15]=0x65; tx[16]=0x60;
+        tx[17]=0x00; tx[18]=0x00;
+        for (int i = 19; i < 25; ++i) tx[i] = 0xff;
+        tx[25]=sounds; tx[26]=timeout; tx[27]=0x01;
+        mac(kPevMac.data(), 28);
+        tx[34]=0x00; tx[35]=0x00;
+        run_id(36);
+    }
+    void atten_char_ind(uint8_t sounds, uint8_t samples) {
+        std::memset(tx, 0x00, 130);
+        mac(kPevMac.data(), 0);
+        mac(kEvseMac.data(), 6);
+        tx[12]=0x88; tx[13]=0xE1; tx[14]=0x01; tx[15]=0x6E; tx[16]=0x60;
+        tx[17]=0x00; tx[18]=0x00; tx[19]=0x00; tx[20]=0x00;
+        mac(kPevMac.data(), 21);
+        run_id(27);
+        tx[35]=0x00; tx[52]=0x00;
+        tx[69]=sounds; tx[70]=0x3A;
+        for (int i = 0; i < 58; ++i) tx[71 + i] = mean(i, samples);
+    }
+    uint8_t mean(int group, uint8_t samples) const {
+        uint8_t divisor = samples ? samples : 1;
+        return (uint8_t)(avg[group] / divisor);
+    }
+    void match_cnf() {
+        std::memset(tx, 0x00, 109);
+        mac(kPevMac.data(), 0);
+        mac(kEvseMac.data(), 6);
+        tx[12]=0x88; tx[13]=0xE1; tx[14]=0x01; tx[15]=0x7D; tx[16]=0x60;
+        tx[17]=0x00; tx[18]=0x00; tx[19]=0x00; tx[20]=0x00;
+        tx[21]=0x3E; tx[22]=0x00;
+        mac(kPevMac.data(), 40);
+        mac(kEvseMac.data(), 63);
+        run_id(69);
+        nid(85);
+        nmk(93);
+    }
+};
+
+SlacFrameFields Fields() {
+    return SlacFrameFields{kEvseMac.data(), kPevMac.data(), kRunId.data(), kNid.data(), kNmk.data()};
+}
+
+void ExpectSame(const uint8_t *legacy, const uint8_t *templated, uint16_t len, const char *label) {
+    for (uint16_t i = 0; i < len; ++i) {
+        EXPECT_EQ(legacy[i], templated[i]) << label << " byte " << i;
+    }
+}
+
+std::vector<Frame> g_tx;
+
+void CaptureTx(const uint8_t *data, uint32_t len) {
+    g_tx.emplace_back(data, data + len);
+}
+
+} // namespace
+
+TEST(SlacFramesTest, TemplatesMatchLegacyCompose) {
+    Legacy legacy{};
+    uint8_t out[160];
+    SlacFrameFields f = Fields();
+
+    legacy.set_key();
+    ASSERT_EQ(slac_frame_set_key_req(out, &f), 60);
+    ExpectSame(legacy.tx, out, 60, "SET_KEY.REQ");
+
+    legacy.get_sw();
+    ASSERT_EQ(slac_frame_get_sw_req(out, &f), 60);
+    ExpectSame(legacy.tx, out, 60, "GET_SW.REQ");
+
+    legacy.factory_defaults();
+    ASSERT_EQ(slac_frame_factory_defaults(out, &f), 60);
+    ExpectSame(legacy.tx, out, 60, "factory defaults");
+
+    legacy.param_cnf(kSoundCount, kSoundTimeoutField);
+    ASSERT_EQ(slac_frame_param_cnf(out, &f, kSoundCount, kSoundTimeoutField), 60);
+    ExpectSame(legacy.tx, out, 60, "SLAC_PARAM.CNF");
+
+    // sums of the three profiles (base 10, 11, 12) the flow test feeds, over several sample counts
+    for (int i = 0; i < 58; ++i) legacy.avg[i] = (uint16_t)(33 + 3 * i);
+    for (uint8_t samples : {uint8_t(0), uint8_t(1), uint8_t(3), uint8_t(7)}) {
+        legacy.atten_char_ind(kSoundCount, samples);
+        uint8_t atten[58];
+        for (int i = 0; i < 58; ++i) atten[i] = legacy.mean(i, samples);
+        ASSERT_EQ(slac_frame_atten_char_ind(out, &f, kSoundCount, atten), 130);
+        ExpectSame(legacy.tx, out, 130, "ATTEN_CHAR.IND");
+    }
+
+    legacy.match_cnf();
+    ASSERT_EQ(slac_frame_match_cnf(out, &f), 109);
+    ExpectSame(legacy.tx, out, 109, "SLAC_MATCH.CNF");
+}
+
+TEST(SlacFramesTest, AttenCharRetryResendsTheFirstFrame) {
+    slac_test_reset_state();
+    g_tx.clear();
+    slac_test_set_tx_hook(&CaptureTx);
+    std::memcpy(myMac, kEvseMac.data(), 6);
+    SlacSession &s = slac_primary();
+    std::memcpy(s.pev_mac, kPevMac.data(), 6);
+    std::memcpy(s.run_id, kRunId.data(), 8);
+    uint8_t profile[58];
+    for (int i = 0; i < 58; ++i) profile[i] = (uint8_t)(10 + i);
+    atten_reset(&s.atten);
+    for (int n = 0; n < kSoundCount; ++n) atten_add(&s.atten, profile);
+    s.negotiated_sound_count = kSoundCount;
+    s.received_sounds = kSoundCount;
+    s.received_profiles = kSoundCount;
+    s.modem_state = MNBC_SOUND;
+    slac_test_set_millis(0);
+
+    s.transmit_atten_char_ind("sounds complete", 0);
+    // clobbering the measurements must not leak into a plain retry
+    atten_reset(&s.atten);
+    s.transmit_atten_char_ind("waiting for RSP", 0);
+    ASSERT_EQ(g_tx.size(), 2u);
+    EXPECT_EQ(g_tx[0], g_tx[1]);
+    EXPECT_EQ(g_tx[0][71], 10);
+
+    // a late profile changes the averages, so the retry is rebuilt
+    s.received_profiles++;
+    s.transmit_atten_char_ind("waiting for RSP", 0);
+    ASSERT_EQ(g_tx.size(), 3u);
+    EXPECT_NE(g_tx[1], g_tx[2]);
+    EXPECT_EQ(g_tx[2][71], 0);
+
+    slac_test_reset_state();
+}
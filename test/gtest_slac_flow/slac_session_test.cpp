@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "main.h"
+#include "slac_session.h"
+
+namespace {
+
+using Frame = std::vector<uint8_t>;
+using Mac = std::array<uint8_t, 6>;
+
+constexpr uint8_t kSoundCount = 3;
+constexpr uint8_t kSoundTimeoutField = 0x08;
+
+// One outlet: its own modem port, EVSE MAC and the PEV plugged into it.
+struct Outlet {
+    Mac evse_mac;
+    Mac pev_mac;
+    Mac modem_mac;
+    Mac pev_modem_mac;
+    std::array<uint8_t, 8> run_id;
+    uint8_t profile_base;
+    std::vector<Frame> tx;
+    SlacSessionPort port;
+    SlacSession session;
+};
+
+void CaptureTx(void *ctx, const uint8_t *frame, uint16_t len) {
+    static_cast<Outlet *>(ctx)->tx.emplace_back(frame, frame + len);
+}
+
+void MakeOutlet(Outlet &o, uint8_t idx) {
+    o.evse_mac = Mac{{0x70, 0xB3, 0xD5, 0x00, 0x00, static_cast<uint8_t>(0x01 + idx)}};
+    o.pev_mac = Mac{{0xFE, 0xED, 0xBE, 0xEF, 0xA0, static_cast<uint8_t>(idx)}};
+    o.modem_mac = Mac{{0x00, 0xB0, 0x52, 0x00, 0x10, static_cast<uint8_t>(idx)}};
+    o.pev_modem_mac = Mac{{0x00, 0xB0, 0x52, 0x00, 0x20, static_cast<uint8_t>(idx)}};
+    o.run_id = {{0x10, 0x11, 0x12, 0x13, kSoundCount, kSoundTimeoutField, idx, 0x17}};
+    o.profile_base = static_cast<uint8_t>(10 + 20 * idx);
+    o.tx.clear();
+    o.port = SlacSessionPort{&CaptureTx, &o};
+    o.session.begin(idx, o.evse_mac.data(), &o.port);
+}
+
+Frame Base(const Outlet &o, const Mac &src, uint8_t mmtype_low, size_t size) {
+    Frame frame(size, 0);
+    std::copy(o.evse_mac.begin(), o.evse_mac.end(), frame.begin());
+    std::copy(src.begin(), src.end(), frame.begin() + 6);
+    frame[12] = 0x88;
+    frame[13] = 0xE1;
+    frame[14] = 0x01;
+    frame[15] = mmtype_low;
+    frame[16] = 0x60;
+    return frame;
+}
+
+void Feed(Outlet &o, const Frame &frame, unsigned long now) {
+    o.session.rx(frame.data(), static_cast<uint16_t>(frame.size()), now);
+}
+
+// The local modem took the key: SET_KEY.CNF tells the session its modem MAC.
+void ConfigureModem(Outlet &o) {
+    Frame f = Base(o, o.modem_mac, 0x09, 60);
+    f[19] = 0x01;
+    Feed(o, f, 0);
+    ASSERT_EQ(o.session.modem_state, MODEM_CONFIGURED);
+}
+
+// The PEV side of one step of the matching exchange.
+void Step(Outlet &o, int step, unsigned long now) {
+    Frame f;
+    switch (step) {
+    case 0:
+        f = Base(o, o.pev_mac, 0x64, 60);
+        std::copy(o.run_id.begin(), o.run_id.end(), f.begin() + 21);
+        f[25] = kSoundCount;
+        f[26] = kSoundTimeoutField;
+        break;
+    case 1:
+        f = Base(o, o.pev_mac, 0x6A, 60);
+        f[21] = kSoundCount;
+        f[22] = kSoundTimeoutField;
+        break;
+    case 2: case 3: case 4:
+        f = Base(o, o.pev_mac, 0x86, 90);
+        for (size_t i = 0; i < 58; ++i) f[27 + i] = static_cast<uint8_t>(o.profile_base + i);
+        break;
+    case 5:
+        f = Base(o, o.pev_mac, 0x6F, 70);
+        std::copy(o.pev_mac.begin(), o.pev_mac.end(), f.begin() + 21);
+        std::copy(o.run_id.begin(), o.run_id.end(), f.begin() + 27);
+        break;
+    case 6:
+        f = Base(o, o.pev_mac, 0x7C, 109);
+        f[21] = 0x3E;
+        std::copy(o.pev_mac.begin(), o.pev_mac.end(), f.begin() + 40);
+        std::copy(o.evse_mac.begin(), o.evse_mac.end(), f.begin() + 63);
+        std::copy(o.run_id.begin(), o.run_id.end(), f.begin() + 69);
+        break;
+    case 7:
+        o.session.tick(now);    // sends GET_SW.REQ
+        return;
+    case 8: case 9:
+        // GET_SW.CNF from the local modem, then from the PEV's
+        f = Base(o, step == 8 ? o.modem_mac : o.pev_modem_mac, 0x01, 60);
+        f[14] = 0x00;
+        f[16] = 0xA0;
+        break;
+    default:
+        o.session.tick(now + 2000);    // modem search window over
+        return;
+    }
+    Feed(o, f, now);
+}
+
+constexpr int kSteps = 11;
+
+void ExpectMatched(const Outlet &o) {
+    const SlacSession &s = o.session;
+    EXPECT_TRUE(s.link_ready()) << "outlet " << int(s.index);
+    EXPECT_EQ(0, std::memcmp(s.pev_mac, o.pev_mac.data(), 6));
+    EXPECT_EQ(0, std::memcmp(s.run_id, o.run_id.data(), 8));
+    EXPECT_EQ(0, std::memcmp(s.modem_mac, o.modem_mac.data(), 6));
+    EXPECT_EQ(0, std::memcmp(s.pev_modem_mac, o.pev_modem_mac.data(), 6));
+    EXPECT_EQ(s.modems_found, 2);
+
+    // PARAM.CNF, ATTEN_CHAR.IND, MATCH.CNF, GET_SW.REQ; all from this outlet's EVSE MAC
+    ASSERT_EQ(o.tx.size(), 4u) << "outlet " << int(s.index);
+    for (const Frame &f : o.tx) {
+        EXPECT_TRUE(std::equal(o.evse_mac.begin(), o.evse_mac.end(), f.begin() + 6));
+    }
+    const Frame &ind = o.tx[1];
+    ASSERT_EQ(ind.size(), size_t(SLAC_ATTEN_CHAR_IND_LEN));
+    EXPECT_TRUE(std::equal(o.pev_mac.begin(), o.pev_mac.end(), ind.begin()));
+    EXPECT_TRUE(std::equal(o.run_id.begin(), o.run_id.end(), ind.begin() + 27));
+    EXPECT_EQ(ind[69], kSoundCount);
+    EXPECT_EQ(ind[71], o.profile_base);
+    const Frame &cnf = o.tx[2];
+    ASSERT_EQ(cnf.size(), size_t(SLAC_MATCH_CNF_LEN));
+    EXPECT_EQ(0, std::memcmp(cnf.data() + 85, s.nid, 7));
+    EXPECT_EQ(0, std::memcmp(cnf.data() + 93, s.nmk, 16));
+}
+
+} // namespace
+
+TEST(SlacSessionTest, InterleavedOutletsMatchIndependently) {
+    std::array<Outlet, 3> outlets;
+    for (uint8_t i = 0; i < outlets.size(); ++i) {
+        MakeOutlet(outlets[i], i);
+        ConfigureModem(outlets[i]);
+    }
+
+    // outlet 2 lags one step behind, so the sessions never sit in the same state
+    for (int step = 0; step <= kSteps; ++step) {
+        for (uint8_t i = 0; i < outlets.size(); ++i) {
+            int s = step - (i == 2 ? 1 : 0);
+            if (s >= 0 && s < kSteps) Step(outlets[i], s, 100 * step);
+        }
+        if (step == 3) {
+            EXPECT_EQ(outlets[0].session.received_profiles, 2);
+            EXPECT_EQ(outlets[2].session.received_profiles, 1);
+        }
+    }
+    for (const Outlet &o : outlets) ExpectMatched(o);
+}
+
+TEST(SlacSessionTest, FailureOnOneOutletLeavesTheOthersAlone) {
+    std::array<Outlet, 2> outlets;
+    for (uint8_t i = 0; i < outlets.size(); ++i) {
+        MakeOutlet(outlets[i], i);
+        ConfigureModem(outlets[i]);
+    }
+    for (int step = 0; step < 5; ++step) {
+        for (Outlet &o : outlets) Step(o, step, 0);
+    }
+    ASSERT_EQ(outlets[0].session.modem_state, ATTEN_CHAR_IND);
+    ASSERT_EQ(outlets[1].session.modem_state, ATTEN_CHAR_IND);
+
+    // outlet 1's PEV never answers; outlet 0 goes on matching
+    Step(outlets[0], 5, 100);
+    for (unsigned long now = 600; now <= 1800; now += 600) outlets[1].session.tick(now);
+    EXPECT_EQ(outlets[1].session.modem_state, MODEM_CM_SET_KEY_CNF);
+    EXPECT_EQ(outlets[1].session.slac_retries, 1);
+    ASSERT_EQ(outlets[1].tx.size(), 5u);    // PARAM.CNF, three ATTEN_CHAR.IND and a fresh SET_KEY.REQ
+    EXPECT_EQ(outlets[1].tx[4].size(), size_t(SLAC_SET_KEY_REQ_LEN));
+
+    for (int step = 6; step < kSteps; ++step) Step(outlets[0], step, 200);
+    ExpectMatched(outlets[0]);
+    EXPECT_EQ(outlets[0].session.slac_retries, 0);
+}
+
+TEST(SlacSessionTest, ConcurrentSessionsOnSeparateThreads) {
+    std::array<Outlet, 4> outlets;
+    for (uint8_t i = 0; i < outlets.size(); ++i) {
+        MakeOutlet(outlets[i], i);
+        ConfigureModem(outlets[i]);
+    }
+
+    // one protocol task per modem, as on a multi-outlet controller
+    std::vector<std::thread> tasks;
+    for (Outlet &o : outlets) {
+        tasks.emplace_back([&o] {
+            for (int round = 0; round < 50; ++round) {
+                o.tx.clear();
+                o.session.modem_state = MODEM_CONFIGURED;
+                for (int step = 0; step < kSteps; ++step) Step(o, step, 10 * step);
+                if (!o.session.link_ready()) return;
+            }
+        });
+    }
+    for (std::thread &t : tasks) t.join();
+    for (const Outlet &o : outlets) ExpectMatched(o);
+}
@@ -8,6 +8,7 @@
 #define LOW 0
 #define INPUT 0
 #define OUTPUT 1
+#define IRAM_ATTR
 
 inline void pinMode(int, int) {}
 inline void digitalWrite(int, int) {}
@@ -34,6 +35,7 @@ public:
 extern SerialStub Serial;
 
 unsigned long millis();
+inline unsigned long micros() { return millis() * 1000UL; }
 inline void delay(unsigned long ms) {
     extern void slac_test_advance_time(unsigned long ms);
     slac_test_advance_time(ms);
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
+
+#define MSBFIRST 1
+#define SPI_MODE3 3
 
 class SPISettings {
 public:
@@ -14,6 +18,7 @@ public:
     uint8_t transfer(uint8_t data) { return data; }
     void transfer(uint8_t *, size_t) {}
     uint16_t transfer16(uint16_t data) { return data; }
+    void writeBytes(const uint8_t *, uint32_t) {}
 };
 
 extern SPIClass SPI;
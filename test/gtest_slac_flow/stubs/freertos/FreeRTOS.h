@@ -5,7 +5,16 @@
 using BaseType_t = int;
 using UBaseType_t = unsigned;
 using StackType_t = uint32_t;
+using TickType_t = uint32_t;
 using TaskFunction_t = void (*)(void *);
 
+struct tskTaskControlBlock;
+using TaskHandle_t = tskTaskControlBlock *;
+
 #define pdPASS 1
+#define pdTRUE 1
+#define pdFALSE 0
 #define portTICK_PERIOD_MS 1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portYIELD_FROM_ISR(...) ((void)0)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
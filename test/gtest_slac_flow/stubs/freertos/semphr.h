@@ -0,0 +1,22 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+struct QueueDefinition;
+using SemaphoreHandle_t = QueueDefinition *;
+
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    static int dummy;
+    return reinterpret_cast<SemaphoreHandle_t>(&dummy);
+}
+
+inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t) { return pdTRUE; }
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+    static int dummy;
+    return reinterpret_cast<SemaphoreHandle_t>(&dummy);
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
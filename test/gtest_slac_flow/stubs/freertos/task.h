@@ -2,8 +2,43 @@
 
 #include "FreeRTOS.h"
 
-inline BaseType_t xTaskCreate(TaskFunction_t, const char *, uint32_t, void *, UBaseType_t, void *) {
+// Host builds never schedule tasks: the tests call the task step functions
+// directly. Task notifications collapse into one counter, which is enough
+// while a single task (the QCA SPI task) is notification driven.
+inline uint32_t &freertos_stub_notify_count() {
+    static uint32_t count = 0;
+    return count;
+}
+
+inline TaskHandle_t freertos_stub_task_handle() {
+    static int dummy;
+    return reinterpret_cast<TaskHandle_t>(&dummy);
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t, const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *handle) {
+    if (handle) *handle = freertos_stub_task_handle();
     return pdPASS;
 }
 
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                          UBaseType_t prio, TaskHandle_t *handle, BaseType_t) {
+    return xTaskCreate(fn, name, stack, arg, prio, handle);
+}
+
 inline void vTaskDelay(uint32_t) {}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t) {
+    freertos_stub_notify_count()++;
+    return pdPASS;
+}
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t, BaseType_t *woken) {
+    freertos_stub_notify_count()++;
+    if (woken) *woken = pdTRUE;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t) {
+    uint32_t value = freertos_stub_notify_count();
+    if (value) freertos_stub_notify_count() = clear_on_exit ? 0 : value - 1;
+    return value;
+}
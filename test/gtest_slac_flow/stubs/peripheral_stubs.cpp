@@ -7,17 +7,22 @@
 #include "pki_store.h"
 #include "sdp_server.h"
 #include "tcp.h"
-#include "tcp_socket_server.h"
 #include "tls_credentials.h"
-#include "tls_server.h"
+#include "hlc_server.h"
 
 #include <cstring>
 
+static bool g_stub_cp_connected = true;
+
+extern "C" void cp_stub_set_connected(bool connected) {
+    g_stub_cp_connected = connected;
+}
+
 void cp_init() {}
 void cp_tick() {}
 char cp_get_state() { return 0; }
 int cp_get_latest_mv() { return 0; }
-bool cp_is_connected() { return true; }
+bool cp_is_connected() { return g_stub_cp_connected; }
 bool cp_contactor_command(bool) { return true; }
 bool cp_contactor_feedback() { return true; }
 bool cp_is_contactor_commanded() { return false; }
@@ -57,6 +62,9 @@ void lwip_bridge_init() {}
 void lwip_bridge_poll() {}
 bool lwip_bridge_ready() { return true; }
 void lwip_bridge_on_frame(const uint8_t *, uint16_t) {}
+uint8_t *lwip_bridge_rx_begin() { return nullptr; }
+void lwip_bridge_rx_end(uint8_t *) {}
+void lwip_bridge_stats(LwipBridgeStats *out) { std::memset(out, 0, sizeof(*out)); }
 
 bool pki_store_init() { return true; }
 bool pki_store_set_server_cert(const std::string &) { return true; }
@@ -66,6 +74,7 @@ bool pki_store_get_server_cert(std::string &) { return false; }
 bool pki_store_get_server_key(std::string &) { return false; }
 bool pki_store_get_root_ca(std::string &) { return false; }
 
+tls_key_result_t tls_credentials_set_server_key(const unsigned char *, size_t) { return TLS_KEY_OK; }
 void tls_credentials_reload() {}
 
 void iso20_init() {}
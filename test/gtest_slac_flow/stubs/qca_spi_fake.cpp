@@ -0,0 +1,107 @@
+#include "qca_spi_fake.h"
+
+#include <cstring>
+
+#include "main.h"
+
+static QcaFakeModem g_modem;
+
+QcaFakeModem &qca_fake_modem() {
+    return g_modem;
+}
+
+void qca_fake_reset() {
+    g_modem.signature = QCASPI_GOOD_SIGNATURE;
+    g_modem.wrbuf_space = QCA7K_BUFFER_SIZE;
+    g_modem.intr_cause = 0;
+    g_modem.intr_enable = 0;
+    g_modem.written.clear();
+    g_modem.rdbuf.clear();
+    g_modem.tx_frames.clear();
+    g_modem.tx_batch_frames.clear();
+    std::memset(&g_modem.stats, 0, sizeof(g_modem.stats));
+}
+
+static bool fake_init() {
+    return true;
+}
+
+static uint16_t fake_read_register(uint16_t reg) {
+    g_modem.stats.transactions++;
+    g_modem.stats.bytes += 4;
+    switch (reg) {
+        case SPI_REG_SIGNATURE: return g_modem.signature;
+        case SPI_REG_WRBUF_SPC_AVA: return g_modem.wrbuf_space;
+        case SPI_REG_RDBUF_BYTE_AVA:
+            return g_modem.rdbuf.empty() ? 0 : static_cast<uint16_t>(g_modem.rdbuf.front().size());
+        case SPI_REG_INTR_CAUSE: return g_modem.intr_cause;
+        case SPI_REG_INTR_ENABLE: return g_modem.intr_enable;
+        default: return 0;
+    }
+}
+
+static void fake_write_register(uint16_t reg, uint16_t value) {
+    g_modem.stats.transactions++;
+    g_modem.stats.bytes += 4;
+    g_modem.written[reg] = value;
+    switch (reg) {
+        case SPI_REG_INTR_CAUSE: g_modem.intr_cause &= static_cast<uint16_t>(~value); break;
+        case SPI_REG_INTR_ENABLE: g_modem.intr_enable = value; break;
+        default: break;
+    }
+}
+
+static uint32_t fake_read_burst(uint8_t *dst, uint32_t max) {
+    uint16_t available = fake_read_register(SPI_REG_RDBUF_BYTE_AVA);
+    if (!available || available > max) return 0;
+    fake_write_register(SPI_REG_BFR_SIZE, available);
+    std::memcpy(dst, g_modem.rdbuf.front().data(), available);
+    g_modem.rdbuf.pop_front();
+    g_modem.stats.transactions++;
+    g_modem.stats.bytes += 2 + available;
+    g_modem.stats.rx_bursts++;
+    return available;
+}
+
+static void fake_write_frames(const QcaTxSlot *const *frames, uint8_t n, uint16_t total) {
+    fake_write_register(SPI_REG_BFR_SIZE, total);
+    for (uint8_t i = 0; i < n; ++i) {
+        g_modem.tx_frames.emplace_back(frames[i]->data, frames[i]->data + frames[i]->len);
+    }
+    g_modem.tx_batch_frames.push_back(n);
+    g_modem.wrbuf_space = total > g_modem.wrbuf_space ? 0 : static_cast<uint16_t>(g_modem.wrbuf_space - total);
+    g_modem.stats.transactions++;
+    g_modem.stats.bytes += 2 + total;
+    g_modem.stats.tx_bursts++;
+}
+
+static void fake_get_stats(QcaSpiStats *out) {
+    *out = g_modem.stats;
+}
+
+static const QcaSpiBus g_fake_bus = {
+    "fake",
+    fake_init,
+    fake_read_register,
+    fake_write_register,
+    fake_read_burst,
+    fake_write_frames,
+    fake_get_stats,
+};
+
+const QcaSpiBus *qca_fake_bus() {
+    return &g_fake_bus;
+}
+
+std::vector<uint8_t> qca_fake_make_burst(const std::vector<uint8_t> &frame) {
+    std::vector<uint8_t> burst;
+    uint32_t total = static_cast<uint32_t>(frame.size() + 10);
+    for (int i = 0; i < 4; ++i) burst.push_back(static_cast<uint8_t>(total >> (8 * i)));
+    burst.insert(burst.end(), {0xAA, 0xAA, 0xAA, 0xAA});
+    burst.push_back(static_cast<uint8_t>(frame.size() & 0xFF));
+    burst.push_back(static_cast<uint8_t>(frame.size() >> 8));
+    burst.insert(burst.end(), {0x00, 0x00});
+    burst.insert(burst.end(), frame.begin(), frame.end());
+    burst.insert(burst.end(), {0x55, 0x55});
+    return burst;
+}
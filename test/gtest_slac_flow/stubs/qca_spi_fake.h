@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "qca_spi.h"
+
+// Host model of the QCA7005 behind the QcaSpiBus interface: a register file,
+// a read buffer fed by the test and a write buffer that records every frame.
+struct QcaFakeModem {
+    uint16_t signature;
+    uint16_t wrbuf_space;
+    uint16_t intr_cause;
+    uint16_t intr_enable;
+    std::map<uint16_t, uint16_t> written;            // last value written per register
+    std::deque<std::vector<uint8_t>> rdbuf;          // one entry per RDBUF burst
+    std::vector<std::vector<uint8_t>> tx_frames;     // Ethernet frames written by the host
+    std::vector<uint8_t> tx_batch_frames;            // frames per external write
+    QcaSpiStats stats;
+};
+
+QcaFakeModem &qca_fake_modem();
+void qca_fake_reset();
+const QcaSpiBus *qca_fake_bus();
+
+// Wraps an Ethernet frame in the QCA7000 SPI framing (length, SOF, FL, RSVD, frame, EOF).
+std::vector<uint8_t> qca_fake_make_burst(const std::vector<uint8_t> &frame);
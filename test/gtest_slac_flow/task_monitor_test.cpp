@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include "task_monitor.h"
+
+namespace {
+
+class TaskMonitorTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        task_monitor_reset();
+    }
+
+    void TearDown() override {
+        task_monitor_reset();
+    }
+
+    static void Run(int id, uint32_t start_us, uint32_t exec_us) {
+        task_monitor_begin(id, start_us);
+        task_monitor_end(id, start_us + exec_us);
+    }
+};
+
+} // namespace
+
+TEST_F(TaskMonitorTest, TracksExecutionTimeAndOverruns) {
+    int cp = task_monitor_register("cp", 20, 20000);
+    ASSERT_EQ(cp, 0);
+    Run(cp, 0, 4000);
+    Run(cp, 20000, 25000);      // slow ADC burst blows the 20 ms budget
+    Run(cp, 45000, 4000);
+
+    TaskMonitorStats s;
+    ASSERT_TRUE(task_monitor_get(cp, &s));
+    EXPECT_STREQ(s.name, "cp");
+    EXPECT_EQ(s.iterations, 3u);
+    EXPECT_EQ(s.last_us, 4000u);
+    EXPECT_EQ(s.max_us, 25000u);
+    EXPECT_EQ(s.overruns, 1u);
+    EXPECT_GT(s.avg_us, 4000u);
+    EXPECT_LT(s.avg_us, 25000u);
+}
+
+TEST_F(TaskMonitorTest, CountsMissedPeriods) {
+    int proto = task_monitor_register("proto", 20, 20000);
+    Run(proto, 0, 100);
+    Run(proto, 21000, 100);     // jitter, not late
+    Run(proto, 80000, 100);     // a whole period skipped
+    TaskMonitorStats s;
+    ASSERT_TRUE(task_monitor_get(proto, &s));
+    EXPECT_EQ(s.late_starts, 1u);
+    EXPECT_EQ(s.overruns, 0u);
+}
+
+TEST_F(TaskMonitorTest, EventDrivenTaskHasNoDeadline) {
+    int plc = task_monitor_register("plc", 0, 5000);
+    Run(plc, 0, 100);
+    Run(plc, 1000000, 6000);
+    TaskMonitorStats s;
+    ASSERT_TRUE(task_monitor_get(plc, &s));
+    EXPECT_EQ(s.late_starts, 0u);
+    EXPECT_EQ(s.overruns, 1u);
+}
+
+TEST_F(TaskMonitorTest, TableIsBounded) {
+    for (int i = 0; i < TASK_MONITOR_MAX; ++i) {
+        EXPECT_EQ(task_monitor_register("t", 10, 0), i);
+    }
+    EXPECT_EQ(task_monitor_register("overflow", 10, 0), -1);
+    EXPECT_EQ(task_monitor_count(), TASK_MONITOR_MAX);
+    task_monitor_begin(-1, 0);    // ignored
+    task_monitor_end(-1, 10);
+    TaskMonitorStats s;
+    EXPECT_FALSE(task_monitor_get(TASK_MONITOR_MAX, &s));
+}
@@ -0,0 +1,228 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "evse_config.h"
+#include "tcp_sender.h"
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+constexpr uint32_t kIss = 0xFFFFF000u;     // wraps during the longer runs
+constexpr uint16_t kMss = 536;
+constexpr uint16_t kPeerWindow = 8192;
+
+Bytes Pattern(size_t len, uint8_t seed) {
+    Bytes b(len);
+    for (size_t i = 0; i < len; ++i) b[i] = static_cast<uint8_t>(seed + i * 7);
+    return b;
+}
+
+// Sender and EV joined by a link that delays, jitters and drops packets. The
+// EV side buffers out-of-order data and ACKs every segment it gets, which is
+// what produces duplicate ACKs after a loss.
+class LinkSim {
+public:
+    struct Packet {
+        uint32_t at;
+        bool to_ev;
+        uint32_t seq;
+        Bytes data;
+        uint32_t ack;
+    };
+
+    LinkSim(uint32_t seed, double loss, uint32_t delay_ms, uint32_t jitter_ms)
+        : rng_(seed), loss_(loss), delay_(delay_ms), jitter_(jitter_ms), rcv_nxt_(kIss) {
+        tcp_sender_reset(&s_, kIss, kMss, kPeerWindow);
+    }
+
+    // Drop the n-th data segment sent (0-based), whatever the loss rate says.
+    void DropSegment(uint32_t n) { forced_drops_.push_back(n); }
+
+    // Sends one frame and runs the link until it is acked. Returns false on
+    // TCP_SENDER_GIVE_UP or when limit_ms runs out.
+    bool Transfer(const Bytes &frame, uint32_t limit_ms = 60000) {
+        tcp_sender_start(&s_, frame.data(), static_cast<uint16_t>(frame.size()));
+        Pump();
+        for (uint32_t end = now_ + limit_ms; now_ < end; ++now_) {
+            Deliver();
+            if (!tcp_sender_busy(&s_)) return true;
+            TcpSenderTick t = tcp_sender_tick(&s_, now_);
+            if (t == TCP_SENDER_GIVE_UP) return false;
+            Pump();
+        }
+        return false;
+    }
+
+    TcpSender s_;
+    Bytes received_;
+    uint32_t now_ = 0;
+    uint32_t max_segment_ = 0;
+    std::vector<uint32_t> sent_seqs_;
+
+private:
+    bool Lost() { return std::uniform_real_distribution<double>(0, 1)(rng_) < loss_; }
+    uint32_t Delay() { return delay_ + (jitter_ ? rng_() % (jitter_ + 1) : 0); }
+
+    void Pump() {
+        TcpSegment seg;
+        while (tcp_sender_next(&s_, now_, &seg)) {
+            EXPECT_LE(seg.len, kMss);
+            if (seg.len > max_segment_) max_segment_ = seg.len;
+            uint32_t index = static_cast<uint32_t>(sent_seqs_.size());
+            sent_seqs_.push_back(seg.seq);
+            bool drop = Lost();
+            for (uint32_t n : forced_drops_) drop |= n == index;
+            if (drop) continue;
+            link_.push_back({now_ + Delay(), true, seg.seq, Bytes(seg.data, seg.data + seg.len), 0});
+        }
+    }
+
+    void Deliver() {
+        for (size_t i = 0; i < link_.size();) {
+            if (link_[i].at > now_) {
+                ++i;
+                continue;
+            }
+            Packet p = link_[i];
+            link_.erase(link_.begin() + i);
+            if (p.to_ev) {
+                EvReceive(p);
+            } else {
+                tcp_sender_ack(&s_, p.ack, kPeerWindow, true, now_);
+                Pump();
+            }
+        }
+    }
+
+    void EvReceive(const Packet &p) {
+        int32_t ahead = static_cast<int32_t>(p.seq - rcv_nxt_);
+        if (ahead > 0) ooo_[p.seq] = p.data;
+        if (ahead == 0) {
+            received_.insert(received_.end(), p.data.begin(), p.data.end());
+            rcv_nxt_ += static_cast<uint32_t>(p.data.size());
+            for (auto it = ooo_.find(rcv_nxt_); it != ooo_.end(); it = ooo_.find(rcv_nxt_)) {
+                received_.insert(received_.end(), it->second.begin(), it->second.end());
+                rcv_nxt_ += static_cast<uint32_t>(it->second.size());
+                ooo_.erase(it);
+            }
+        }
+        if (!Lost()) link_.push_back({now_ + Delay(), false, 0, {}, rcv_nxt_});
+    }
+
+    std::mt19937 rng_;
+    double loss_;
+    uint32_t delay_;
+    uint32_t jitter_;
+    uint32_t rcv_nxt_;
+    std::map<uint32_t, Bytes> ooo_;
+    std::vector<Packet> link_;
+    std::vector<uint32_t> forced_drops_;
+};
+
+TEST(TcpSenderTest, CleanLinkKeepsTheWindowFull) {
+    LinkSim sim(1, 0.0, 20, 0);
+    Bytes frame = Pattern(4000, 3);     // 8 segments
+    ASSERT_TRUE(sim.Transfer(frame));
+    EXPECT_EQ(sim.received_, frame);
+    EXPECT_EQ(sim.s_.stats.segments, 8u);
+    EXPECT_EQ(sim.s_.stats.retransmits + sim.s_.stats.fast_retransmits, 0u);
+    EXPECT_EQ(sim.s_.stats.max_inflight, TCP_TX_WINDOW_SEGMENTS * kMss);
+    // Stop-and-wait needs 8 round trips of 40 ms; a 4 segment window needs 2.
+    EXPECT_LE(sim.now_, 2 * 40 + 2u);
+    EXPECT_EQ(sim.max_segment_, kMss);
+}
+
+TEST(TcpSenderTest, RttEstimateConvergesOnTheLink) {
+    LinkSim sim(2, 0.0, 30, 0);
+    for (int i = 0; i < 20; ++i) ASSERT_TRUE(sim.Transfer(Pattern(1500, static_cast<uint8_t>(i))));
+    EXPECT_EQ(sim.s_.stats.rtt_samples, 20u);      // one timed segment per window
+    EXPECT_NEAR(sim.s_.stats.srtt_ms, 60, 2);
+    EXPECT_LE(sim.s_.stats.rttvar_ms, 5);
+    EXPECT_EQ(sim.s_.rto_ms, TCP_RTO_MIN_MS);   // 60 ms + 4 * RTTVAR is under the floor
+}
+
+TEST(TcpSenderTest, DuplicateAcksResendBeforeTheTimeout) {
+    LinkSim sim(3, 0.0, 20, 0);
+    sim.DropSegment(0);
+    Bytes frame = Pattern(4000, 9);
+    ASSERT_TRUE(sim.Transfer(frame));
+    EXPECT_EQ(sim.received_, frame);
+    EXPECT_EQ(sim.s_.stats.fast_retransmits, 1u);
+    EXPECT_EQ(sim.s_.stats.timeouts, 0u);
+    EXPECT_LT(sim.now_, static_cast<uint32_t>(TCP_RTO_INITIAL_MS));
+    ASSERT_GT(sim.sent_seqs_.size(), 4u);
+    EXPECT_EQ(sim.sent_seqs_[4], kIss);         // after the first window
+}
+
+TEST(TcpSenderTest, TimeoutsBackOffAndThenGiveUp) {
+    LinkSim sim(4, 1.0, 20, 0);
+    EXPECT_FALSE(sim.Transfer(Pattern(3000, 1)));
+    EXPECT_EQ(sim.s_.stats.timeouts, static_cast<uint32_t>(TCP_MAX_RETRANSMIT));
+    EXPECT_EQ(sim.s_.stats.retransmits, static_cast<uint32_t>(TCP_MAX_RETRANSMIT));   // one segment per RTO
+    // Each RTO doubles up to TCP_RTO_MAX_MS; the expiry after the last
+    // retransmit gives up.
+    uint32_t rto = TCP_RTO_INITIAL_MS, elapsed = 0;
+    for (int i = 0; i <= TCP_MAX_RETRANSMIT; ++i) {
+        elapsed += rto;
+        rto = std::min<uint32_t>(rto * 2, TCP_RTO_MAX_MS);
+    }
+    EXPECT_EQ(sim.s_.rto_ms, std::min<uint32_t>(TCP_RTO_INITIAL_MS << TCP_MAX_RETRANSMIT, TCP_RTO_MAX_MS));
+    EXPECT_EQ(sim.now_, elapsed);
+}
+
+TEST(TcpSenderTest, PeerWindowLimitsTheFlight) {
+    TcpSender s;
+    tcp_sender_reset(&s, kIss, kMss, 600);
+    Bytes frame = Pattern(2000, 5);
+    tcp_sender_start(&s, frame.data(), static_cast<uint16_t>(frame.size()));
+    TcpSegment seg;
+    ASSERT_TRUE(tcp_sender_next(&s, 0, &seg));
+    EXPECT_FALSE(tcp_sender_next(&s, 0, &seg));
+    tcp_sender_ack(&s, kIss + kMss, 1200, true, 10);
+    ASSERT_TRUE(tcp_sender_next(&s, 10, &seg));
+    ASSERT_TRUE(tcp_sender_next(&s, 10, &seg));
+    EXPECT_FALSE(tcp_sender_next(&s, 10, &seg));
+    EXPECT_EQ(s.stats.max_inflight, 2 * kMss);
+}
+
+TEST(TcpSenderTest, OldAndFutureAcksAreIgnored) {
+    TcpSender s;
+    tcp_sender_reset(&s, kIss, kMss, kPeerWindow);
+    Bytes frame = Pattern(1000, 5);
+    tcp_sender_start(&s, frame.data(), static_cast<uint16_t>(frame.size()));
+    TcpSegment seg;
+    while (tcp_sender_next(&s, 0, &seg)) {}
+    tcp_sender_ack(&s, kIss - 1, kPeerWindow, true, 5);
+    tcp_sender_ack(&s, kIss + 2000, kPeerWindow, true, 5);
+    EXPECT_EQ(s.una, 0u);
+    tcp_sender_ack(&s, kIss + 1000, kPeerWindow, true, 5);
+    EXPECT_FALSE(tcp_sender_busy(&s));
+    EXPECT_EQ(tcp_sender_snd_nxt(&s), kIss + 1000);
+}
+
+// Many frames over a link that loses 5% of the packets either way with
+// 10..30 ms of delay, so segments arrive reordered. Every frame has to come
+// out intact and in order, through fast retransmits and timeouts alike.
+TEST(TcpSenderTest, LossyDelayedLinkDeliversEveryFrame) {
+    LinkSim sim(0x5EED, 0.05, 10, 20);
+    std::mt19937 rng(7);
+    Bytes want;
+    for (int i = 0; i < 300; ++i) {
+        Bytes frame = Pattern(1 + rng() % 4000, static_cast<uint8_t>(i));
+        ASSERT_TRUE(sim.Transfer(frame)) << "frame " << i;
+        want.insert(want.end(), frame.begin(), frame.end());
+        ASSERT_EQ(sim.received_.size(), want.size()) << "frame " << i;
+    }
+    EXPECT_EQ(sim.received_, want);
+    EXPECT_GT(sim.s_.stats.fast_retransmits, 0u);
+    EXPECT_GT(sim.s_.stats.timeouts, 0u);
+    EXPECT_LE(sim.s_.stats.max_inflight, TCP_TX_WINDOW_SEGMENTS * kMss);
+}
+
+} // namespace
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+
+#include "evse_config.h"
+#include "tls_session_cache.h"
+
+namespace {
+
+TlsSessionCache g_cache;
+constexpr uint32_t kTimeout = 100;
+
+class TlsSessionCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override { tls_session_cache_reset(&g_cache, kTimeout); }
+
+    void Store(uint8_t n, uint32_t now, uint16_t len = 40) {
+        uint8_t id[TLS_SESSION_ID_MAX];
+        memset(id, n, sizeof(id));
+        uint8_t *blob = tls_session_cache_reserve(&g_cache, id, sizeof(id), now);
+        ASSERT_NE(blob, nullptr);
+        memset(blob, n, len);
+        tls_session_cache_commit(&g_cache, blob, len);
+    }
+
+    bool Find(uint8_t n, uint32_t now) {
+        uint8_t id[TLS_SESSION_ID_MAX];
+        memset(id, n, sizeof(id));
+        uint16_t len = 0;
+        const uint8_t *blob = tls_session_cache_find(&g_cache, id, sizeof(id), now, &len);
+        if (blob) {
+            EXPECT_EQ(blob[len - 1], n);
+        }
+        return blob != nullptr;
+    }
+};
+
+} // namespace
+
+TEST_F(TlsSessionCacheTest, StoredSessionResumesUntilItExpires) {
+    Store(1, 10, 300);
+    EXPECT_TRUE(Find(1, 10 + kTimeout - 1));
+    EXPECT_FALSE(Find(2, 20));
+    EXPECT_FALSE(Find(1, 10 + kTimeout));
+    EXPECT_FALSE(Find(1, 11));      // an expired entry is gone for good
+    EXPECT_EQ(g_cache.stats.hits, 1u);
+    EXPECT_EQ(g_cache.stats.misses, 3u);
+    EXPECT_EQ(g_cache.stats.expired, 1u);
+    EXPECT_EQ(g_cache.stats.entries, 0u);
+
+    Store(3, 50);
+    Store(3, 60, 80);               // same ID again replaces, never duplicates
+    EXPECT_EQ(g_cache.stats.entries, 1u);
+    uint8_t id[TLS_SESSION_ID_MAX];
+    memset(id, 3, sizeof(id));
+    uint16_t len = 0;
+    ASSERT_NE(tls_session_cache_find(&g_cache, id, sizeof(id), 61, &len), nullptr);
+    EXPECT_EQ(len, 80u);
+}
+
+TEST_F(TlsSessionCacheTest, FullCacheEvictsTheLeastRecentlyUsed) {
+    for (uint8_t i = 0; i < TLS_SESSION_CACHE_ENTRIES; ++i) Store(i + 1, i);
+    EXPECT_TRUE(Find(1, 50));       // the oldest, but just used
+    Store(0x80, 51);
+    EXPECT_EQ(g_cache.stats.evicted, 1u);
+    EXPECT_TRUE(Find(1, 52));
+    EXPECT_FALSE(Find(2, 52));
+    EXPECT_TRUE(Find(0x80, 52));
+    EXPECT_EQ(g_cache.stats.entries, TLS_SESSION_CACHE_ENTRIES);
+
+    // an expired entry is taken before a live one is pushed out
+    Store(0x81, 3 + kTimeout);
+    EXPECT_EQ(g_cache.stats.evicted, 1u);
+    EXPECT_EQ(g_cache.stats.expired, 1u);
+}
+
+TEST_F(TlsSessionCacheTest, SessionThatDidNotFitIsNotCached) {
+    uint8_t id[16] = {7};
+    uint8_t *blob = tls_session_cache_reserve(&g_cache, id, sizeof(id), 0);
+    ASSERT_NE(blob, nullptr);
+    tls_session_cache_commit(&g_cache, blob, 0);
+    uint16_t len = 0;
+    EXPECT_EQ(tls_session_cache_find(&g_cache, id, sizeof(id), 0, &len), nullptr);
+    EXPECT_EQ(g_cache.stats.too_big, 1u);
+    EXPECT_EQ(g_cache.stats.entries, 0u);
+    EXPECT_EQ(tls_session_cache_reserve(&g_cache, id, 0, 0), nullptr);
+    EXPECT_EQ(tls_session_cache_reserve(&g_cache, id, TLS_SESSION_ID_MAX + 1, 0), nullptr);
+}
@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "evse_config.h"
+#include "v2gtp_framer.h"
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+Bytes Frame(uint32_t payload_len, uint8_t seed, uint16_t type = 0x8001) {
+    Bytes f = {0x01, 0xFE, static_cast<uint8_t>(type >> 8), static_cast<uint8_t>(type),
+               static_cast<uint8_t>(payload_len >> 24), static_cast<uint8_t>(payload_len >> 16),
+               static_cast<uint8_t>(payload_len >> 8), static_cast<uint8_t>(payload_len)};
+    for (uint32_t i = 0; i < payload_len; ++i) f.push_back(static_cast<uint8_t>(seed + i * 13));
+    return f;
+}
+
+Bytes Payload(const Bytes &frame) {
+    return Bytes(frame.begin() + V2GTP_HEADER_BYTES, frame.end());
+}
+
+class V2gtpFramerTest : public ::testing::Test {
+protected:
+    void SetUp() override { v2gtp_framer_reset(&f_); }
+
+    // Same loop as tcp_bufferPayload(): write what fits, take every frame.
+    bool Feed(const uint8_t *data, size_t len) {
+        while (len) {
+            uint16_t n = v2gtp_framer_write(&f_, data, static_cast<uint16_t>(len));
+            if (!n) return false;
+            data += n;
+            len -= n;
+            V2gtpFrame frame;
+            V2gtpNext next;
+            while ((next = v2gtp_framer_next(&f_, &frame)) == V2GTP_FRAME) {
+                got_.emplace_back(frame.payload, frame.payload + frame.len);
+            }
+            if (next == V2GTP_BAD_HEADER) return false;
+        }
+        return true;
+    }
+    bool Feed(const Bytes &b) { return Feed(b.data(), b.size()); }
+
+    // Feeds filler frames and the first byte of next, so that next starts at
+    // ring offset at (an empty ring starts over at 0, hence the byte).
+    void Park(uint16_t at, const Bytes &next) {
+        Bytes stream;
+        for (uint16_t left = at; left;) {
+            uint16_t len = left > 1024 ? 512 : left;
+            Bytes filler = Frame(len - V2GTP_HEADER_BYTES, 0);
+            stream.insert(stream.end(), filler.begin(), filler.end());
+            left = static_cast<uint16_t>(left - len);
+        }
+        stream.push_back(next[0]);
+        ASSERT_TRUE(Feed(stream));
+        ASSERT_EQ(f_.head, at);
+        got_.clear();
+    }
+
+    V2gtpFramer f_;
+    std::vector<Bytes> got_;
+};
+
+TEST_F(V2gtpFramerTest, DeliversFrameInPlace) {
+    Bytes a = Frame(40, 1);
+    ASSERT_TRUE(Feed(a));
+    ASSERT_EQ(got_.size(), 1u);
+    EXPECT_EQ(got_[0], Payload(a));
+    EXPECT_EQ(f_.stats.linearized, 0u);
+    EXPECT_EQ(v2gtp_framer_level(&f_), 0u);
+    EXPECT_EQ(f_.head, 0u);
+}
+
+TEST_F(V2gtpFramerTest, WaitsForSplitHeaderAndPayload) {
+    Bytes a = Frame(100, 7);
+    ASSERT_TRUE(Feed(a.data(), 5));
+    ASSERT_TRUE(Feed(a.data() + 5, 50));
+    EXPECT_TRUE(got_.empty());
+    ASSERT_TRUE(Feed(a.data() + 55, a.size() - 55));
+    ASSERT_EQ(got_.size(), 1u);
+    EXPECT_EQ(got_[0], Payload(a));
+}
+
+TEST_F(V2gtpFramerTest, HeaderAcrossTheWrap) {
+    Bytes a = Frame(300, 9);
+    Park(V2GTP_RX_RING_BYTES - 3, a);
+    ASSERT_TRUE(Feed(a.data() + 1, a.size() - 1));
+    ASSERT_EQ(got_.size(), 1u);
+    EXPECT_EQ(got_[0], Payload(a));
+    EXPECT_EQ(f_.stats.linearized, 0u);     // payload itself did not wrap
+}
+
+TEST_F(V2gtpFramerTest, PayloadAcrossTheWrapIsLinearized) {
+    Bytes a = Frame(400, 4);
+    Park(V2GTP_RX_RING_BYTES - 100, a);
+    ASSERT_TRUE(Feed(a.data() + 1, 149));
+    ASSERT_TRUE(Feed(a.data() + 150, a.size() - 150));
+    ASSERT_EQ(got_.size(), 1u);
+    EXPECT_EQ(got_[0], Payload(a));
+    EXPECT_EQ(f_.stats.linearized, 1u);
+}
+
+TEST_F(V2gtpFramerTest, SkipsOversizeFrameAndKeepsGoing) {
+    Bytes big = Frame(V2GTP_MAX_FRAME_BYTES * 3, 5);
+    Bytes a = Frame(20, 6);
+    Bytes stream = big;
+    stream.insert(stream.end(), a.begin(), a.end());
+    for (size_t i = 0; i < stream.size(); i += 700) {
+        ASSERT_TRUE(Feed(stream.data() + i, std::min<size_t>(700, stream.size() - i)));
+    }
+    ASSERT_EQ(got_.size(), 1u);
+    EXPECT_EQ(got_[0], Payload(a));
+    EXPECT_EQ(f_.stats.oversize, 1u);
+    EXPECT_EQ(f_.stats.bad_header, 0u);
+}
+
+TEST_F(V2gtpFramerTest, LargestFrameFits) {
+    Bytes a = Frame(V2GTP_MAX_FRAME_BYTES - V2GTP_HEADER_BYTES, 8);
+    ASSERT_TRUE(Feed(Frame(700, 1)));
+    ASSERT_TRUE(Feed(a));
+    ASSERT_EQ(got_.size(), 2u);
+    EXPECT_EQ(got_[1], Payload(a));
+    EXPECT_EQ(f_.stats.oversize, 0u);
+}
+
+TEST_F(V2gtpFramerTest, BadVersionIsReported) {
+    Bytes a = Frame(10, 1);
+    a[1] = 0xFD;
+    EXPECT_FALSE(Feed(a));
+    EXPECT_EQ(f_.stats.bad_header, 1u);
+    EXPECT_EQ(v2gtp_framer_level(&f_), 0u);
+}
+
+TEST_F(V2gtpFramerTest, FlushDropsPartialFrame) {
+    Bytes a = Frame(50, 1);
+    ASSERT_TRUE(Feed(a.data(), 20));
+    v2gtp_framer_flush(&f_);
+    Bytes b = Frame(30, 2);
+    ASSERT_TRUE(Feed(b));
+    ASSERT_EQ(got_.size(), 1u);
+    EXPECT_EQ(got_[0], Payload(b));
+}
+
+// Random frame sizes, including oversize ones, cut into random chunks that
+// split headers, coalesce several frames and wrap the ring many times.
+TEST_F(V2gtpFramerTest, FuzzSplitAndCoalescedStreams) {
+    std::mt19937 rng(0x5EED);
+    std::vector<Bytes> want;
+    Bytes stream;
+    for (int i = 0; i < 3000; ++i) {
+        uint32_t len;
+        switch (rng() % 8) {
+        case 0: len = V2GTP_MAX_FRAME_BYTES - V2GTP_HEADER_BYTES; break;
+        case 1: len = V2GTP_MAX_FRAME_BYTES + rng() % 4000; break;   // skipped
+        case 2: len = 0; break;
+        default: len = rng() % 400; break;
+        }
+        Bytes f = Frame(len, static_cast<uint8_t>(i));
+        if (f.size() <= V2GTP_MAX_FRAME_BYTES) want.push_back(Payload(f));
+        stream.insert(stream.end(), f.begin(), f.end());
+    }
+    size_t pos = 0;
+    while (pos < stream.size()) {
+        size_t chunk = (rng() % 4 == 0) ? 1 + rng() % 8 : 1 + rng() % 2500;
+        chunk = std::min(chunk, stream.size() - pos);
+        ASSERT_TRUE(Feed(stream.data() + pos, chunk));
+        pos += chunk;
+    }
+    ASSERT_EQ(got_.size(), want.size());
+    for (size_t i = 0; i < want.size(); ++i) ASSERT_EQ(got_[i], want[i]) << "frame " << i;
+    EXPECT_EQ(f_.stats.frames, want.size());
+    EXPECT_GT(f_.stats.linearized, 0u);
+    EXPECT_GT(f_.stats.oversize, 0u);
+    EXPECT_LE(f_.stats.max_level, V2GTP_RX_RING_BYTES);
+    EXPECT_EQ(v2gtp_framer_level(&f_), 0u);
+}
+
+} // namespace